@@ -24,12 +24,15 @@
 #include <math.h>
 #include "facqi18n.h"
 #include "facqlog.h"
+#include "facqglibcompat.h"
 #include "gdouble.h"
 #include "facqunits.h"
 #include "facqchanlist.h"
 #include "facqstreamdata.h"
 #include "facqchunk.h"
 #include "facqfile.h"
+#include "facqfilereader.h"
+#include "facqfileindex.h"
 #include "facqcolor.h"
 #include "facqstatusbar.h"
 #include "facqresourcesicons.h"
@@ -58,6 +61,17 @@
  *
  * Also internally a #FacqFile object is created when a file is opened, to
  * manage the file. Also a #FacqStreamData will be created from the file.
+ *
+ * The file is shown as soon as it's opened, the integrity of the file is
+ * verified later in a separate thread with facq_file_reader_verify(), the
+ * progress is shown in the #FacqStatusbar and the result in the title of the
+ * window. The verification is cancelled if the file is closed before it ends.
+ *
+ * Pages with many slices are drawn from the #FacqFileIndex of the file, with
+ * the minimum and the maximum of each column, so the cost of drawing them
+ * doesn't depend on the size of the page. If the file has no index, or it
+ * doesn't match the file, the index is built with facq_file_index_build()
+ * in the same thread after the verification, and used once it's ready.
  * </para>
  * </sect1>
  *
@@ -77,11 +91,30 @@
 
 G_DEFINE_TYPE(FacqBAFView,facq_baf_view,G_TYPE_OBJECT);
 
+/* columns of a page drawn from the index, pages with less than
+ * FACQ_FILE_INDEX_DECIMATION slices per column are read from the file */
+#define FACQ_BAF_VIEW_INDEX_PIXELS 1024
+
 enum {
 	PROP_0,
 	PROP_PAGE_TIME
 };
 
+typedef struct _FacqBAFViewVerify {
+	FacqFileReader *reader;
+	GThread *thread;
+	gint finished;
+	gboolean ok;
+	GArray *corrupt;
+	GError *err;
+	gchar *filename;
+	GCancellable *cancellable;
+	gboolean build_index;
+	gint building;
+	gboolean index_ok;
+	GError *index_err;
+} FacqBAFViewVerify;
+
 struct _FacqBAFViewPrivate {
 	GtkWidget *window;
 	FacqBAFViewMenu *menu;
@@ -90,6 +123,11 @@ struct _FacqBAFViewPrivate {
 	FacqStatusbar *statusbar;
 	FacqLegend *legend;
 	FacqFile *file;
+	FacqFileReader *reader;
+	FacqFileIndex *index;
+	gdouble *page;
+	FacqBAFViewVerify *verify;
+	guint verify_source;
 	FacqStreamData *stmd;
 	guint64 written_samples;
 	guint samples_per_page;
@@ -104,6 +142,219 @@ static gboolean delete_event(GtkWidget *widget,GdkEvent *event,gpointer data)
 	return FALSE;
 }
 
+static void facq_baf_view_set_title(FacqBAFView *view,const gchar *filename,const gchar *state)
+{
+	gchar *name = NULL, *title = NULL;
+
+	if(!filename){
+		gtk_window_set_title(GTK_WINDOW(view->priv->window),
+					_("Binary Acquisition File Viewer"));
+		return;
+	}
+	name = g_filename_display_basename(filename);
+	title = g_strdup_printf("%s (%s) - %s",name,state,
+					_("Binary Acquisition File Viewer"));
+	gtk_window_set_title(GTK_WINDOW(view->priv->window),title);
+	g_free(title);
+	g_free(name);
+}
+
+static gpointer facq_baf_view_verify_fun(gpointer data)
+{
+	FacqBAFViewVerify *verify = (FacqBAFViewVerify *)data;
+
+	verify->ok = facq_file_reader_verify(verify->reader,0,FALSE,
+						verify->corrupt,&verify->err);
+	if(verify->build_index && !g_cancellable_is_cancelled(verify->cancellable)){
+		g_atomic_int_set(&verify->building,1);
+		verify->index_ok = facq_file_index_build(verify->filename,
+							verify->cancellable,
+								&verify->index_err);
+	}
+	g_atomic_int_set(&verify->finished,1);
+	return NULL;
+}
+
+static void facq_baf_view_verify_free(FacqBAFViewVerify *verify)
+{
+	if(verify->reader)
+		facq_file_reader_free(verify->reader);
+	if(verify->corrupt)
+		g_array_free(verify->corrupt,TRUE);
+	if(verify->err)
+		g_error_free(verify->err);
+	if(verify->index_err)
+		g_error_free(verify->index_err);
+	if(verify->cancellable)
+		g_object_unref(verify->cancellable);
+	g_free(verify->filename);
+	g_free(verify);
+}
+
+/*
+ * Opens the index of the file, if any, discarding it if it doesn't match the
+ * samples of the file, for example if the file has been overwritten.
+ */
+static gboolean facq_baf_view_index_open(FacqBAFView *view,const gchar *filename)
+{
+	gchar *index_filename = NULL;
+	FacqFileIndex *index = NULL;
+	GError *local_err = NULL;
+
+	if(view->priv->index){
+		facq_file_index_free(view->priv->index);
+		view->priv->index = NULL;
+	}
+	index_filename = facq_file_index_get_filename(filename);
+	index = facq_file_index_new(index_filename,&local_err);
+	g_free(index_filename);
+	if(!index){
+		if(local_err){
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
+					"Can't open the index: %s",local_err->message);
+			g_clear_error(&local_err);
+		}
+		return FALSE;
+	}
+	if(facq_file_index_get_n_slices(index) !=
+			facq_file_reader_get_n_slices(view->priv->reader) ||
+				facq_file_index_get_n_channels(index) !=
+					view->priv->stmd->n_channels){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+				"%s","The index doesn't match the file");
+		facq_file_index_free(index);
+		return FALSE;
+	}
+	view->priv->index = index;
+	return TRUE;
+}
+
+/*
+ * Called periodically while the file is being verified, shows the progress in
+ * the statusbar, and the result of the verification when the thread ends.
+ */
+static gboolean facq_baf_view_verify_callback(gpointer data)
+{
+	FacqBAFView *view = FACQ_BAF_VIEW(data);
+	FacqBAFViewVerify *verify = view->priv->verify;
+	FacqFileReaderRange *range = NULL;
+	gchar *filename = NULL;
+	gdouble page = 0;
+	guint i = 0;
+
+	if(!g_atomic_int_get(&verify->finished)){
+		if(g_atomic_int_get(&verify->building))
+			facq_statusbar_write_msg(view->priv->statusbar,"%s",
+						_("Building the index"));
+		else
+			facq_statusbar_write_msg(view->priv->statusbar,
+				_("Verifying file: %.0f%%"),
+					facq_file_reader_get_progress(verify->reader)*100);
+		return TRUE;
+	}
+	g_thread_join(verify->thread);
+	verify->thread = NULL;
+
+	filename = facq_file_get_filename(view->priv->file);
+	if(verify->ok){
+		facq_baf_view_set_title(view,filename,_("verified"));
+		facq_statusbar_write_msg(view->priv->statusbar,"%s",
+						_("The file has been verified"));
+	}
+	else if(verify->err && verify->err->domain == FACQ_FILE_READER_ERROR &&
+			verify->err->code == FACQ_FILE_READER_ERROR_CORRUPT){
+		facq_baf_view_set_title(view,filename,_("corrupt"));
+		facq_statusbar_write_msg(view->priv->statusbar,
+				_("The file is corrupt: %s"),verify->err->message);
+		for(i = 0;i < verify->corrupt->len;i++){
+			range = &g_array_index(verify->corrupt,FacqFileReaderRange,i);
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+					"Corrupt data from %.9g to %.9g seconds",
+						range->start,range->end);
+		}
+	}
+	else {
+		facq_baf_view_set_title(view,filename,_("unverified"));
+		facq_statusbar_write_msg(view->priv->statusbar,
+				_("Error verifying file: %s"),
+					verify->err ? verify->err->message : _("Unknown error"));
+	}
+
+	/* redraw the current page with the new index */
+	if(verify->index_ok && facq_baf_view_index_open(view,filename)){
+		page = view->priv->current_page;
+		view->priv->current_page = 0;
+		facq_baf_view_plot_page(view,page);
+	}
+	else if(verify->index_err){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+				"Error building the index: %s",verify->index_err->message);
+	}
+	g_free(filename);
+
+	facq_baf_view_verify_free(verify);
+	view->priv->verify = NULL;
+	view->priv->verify_source = 0;
+	return FALSE;
+}
+
+/*
+ * Starts the verification of the file in a new thread, the file is shown
+ * as unverified until the verification ends. If @build_index is %TRUE the
+ * index of the file is built after the verification.
+ */
+static void facq_baf_view_verify_start(FacqBAFView *view,const gchar *filename,gboolean build_index)
+{
+	FacqBAFViewVerify *verify = NULL;
+	GError *local_err = NULL;
+
+	facq_baf_view_set_title(view,filename,_("unverified"));
+
+	verify = g_new0(FacqBAFViewVerify,1);
+	verify->corrupt = g_array_new(FALSE,FALSE,sizeof(FacqFileReaderRange));
+	verify->filename = g_strdup(filename);
+	verify->cancellable = g_cancellable_new();
+	verify->build_index = build_index;
+	verify->reader = facq_file_reader_new(filename,&local_err);
+	if(local_err)
+		goto error;
+	verify->thread = g_thread_try_new("verify",
+				facq_baf_view_verify_fun,verify,&local_err);
+	if(local_err)
+		goto error;
+
+	view->priv->verify = verify;
+	view->priv->verify_source =
+		g_timeout_add(250,facq_baf_view_verify_callback,view);
+	return;
+
+	error:
+	facq_statusbar_write_msg(view->priv->statusbar,
+			_("Error verifying file: %s"),local_err->message);
+	g_clear_error(&local_err);
+	facq_baf_view_verify_free(verify);
+}
+
+/*
+ * Cancels the verification of the file and the building of the index, if any,
+ * waiting for the thread.
+ */
+static void facq_baf_view_verify_stop(FacqBAFView *view)
+{
+	if(!view->priv->verify)
+		return;
+
+	if(view->priv->verify_source){
+		g_source_remove(view->priv->verify_source);
+		view->priv->verify_source = 0;
+	}
+	facq_file_reader_cancel(view->priv->verify->reader);
+	g_cancellable_cancel(view->priv->verify->cancellable);
+	g_thread_join(view->priv->verify->thread);
+	facq_baf_view_verify_free(view->priv->verify);
+	view->priv->verify = NULL;
+}
+
 static void facq_baf_view_set_property(GObject *self,guint property_id,const GValue *value,GParamSpec *pspec)
 {
 	FacqBAFView *view = FACQ_BAF_VIEW(self);
@@ -178,10 +429,23 @@ static void facq_baf_view_finalize(GObject *self)
 {
 	FacqBAFView *view = FACQ_BAF_VIEW(self);
 
+	facq_baf_view_verify_stop(view);
+
 	if(FACQ_IS_FILE(view->priv->file)){
 		facq_file_free(view->priv->file);
 	}
 
+	if(FACQ_IS_FILE_READER(view->priv->reader)){
+		facq_file_reader_free(view->priv->reader);
+	}
+
+	if(FACQ_IS_FILE_INDEX(view->priv->index)){
+		facq_file_index_free(view->priv->index);
+	}
+
+	if(view->priv->page)
+		g_free(view->priv->page);
+
 	if(FACQ_IS_STREAM_DATA(view->priv->stmd)){
 		facq_stream_data_free(view->priv->stmd);
 	}
@@ -239,6 +503,11 @@ static void facq_baf_view_init(FacqBAFView *view)
 {
 	view->priv = G_TYPE_INSTANCE_GET_PRIVATE(view,FACQ_TYPE_BAF_VIEW,FacqBAFViewPrivate);
 	view->priv->written_samples = 0;
+	view->priv->reader = NULL;
+	view->priv->index = NULL;
+	view->priv->page = NULL;
+	view->priv->verify = NULL;
+	view->priv->verify_source = 0;
 }
 
 /**
@@ -310,14 +579,15 @@ void facq_baf_view_setup_page_time(FacqBAFView *view)
  * If the user presses the Open button in the dialog, the function
  * tries to retrieve the filename from the dialog, if successful
  * a message is written to the #FacqStatusbar with the name of the file.
- * In the next step the file is verified with the facq_file_verify() 
- * procedure, if the function fails the operation is canceled, else 
- * a new #FacqFile is created with the facq_file_open() function.
+ * In the next step a new #FacqFile is created with the facq_file_open()
+ * function.
  * The #FacqFile object is used for creating a new #FacqStreamData with
  * the facq_file_read_header() function, and then the facq_file_read_tail()
  * function is called for obtaining the number of total samples written to the
- * file. Then the #FacqStreamData object is used to fill the information in
- * the #FacqLegend object with the facq_legend_set_data() function.
+ * file. A #FacqFileReader is created for the file, it will be used to read
+ * the samples of each page. Then the #FacqStreamData object is used to fill
+ * the information in the #FacqLegend object with the facq_legend_set_data()
+ * function.
  *
  * After this step the number of samples per page is calculated using
  * and stored in the #FacqBAFView:
@@ -335,7 +605,12 @@ void facq_baf_view_setup_page_time(FacqBAFView *view)
  * The current page is set to page 0, the first page is displayed using the
  * facq_baf_view_plot_page(), and the close and export entries in the
  * #FacqBAFViewMenu are enabled.
- * 
+ *
+ * Finally the file is verified in a separate thread, so the first page can be
+ * seen without waiting for the verification, that can take some time in big
+ * files. The progress of the verification is shown in the #FacqStatusbar,
+ * and the title of the window shows if the file is unverified, verified or
+ * corrupt.
  *
  * This function it's called when the user presses the File->Open entry in the
  * #FacqBAFViewMenu.
@@ -348,6 +623,7 @@ void facq_baf_view_open_file(FacqBAFView *view)
 	gdouble total_pages = 0;
 	GError *local_err = NULL;
 	guint8 *digest = NULL;
+	gboolean has_index = FALSE;
 
 	g_return_if_fail(FACQ_IS_BAF_VIEW(view));
 
@@ -364,20 +640,8 @@ void facq_baf_view_open_file(FacqBAFView *view)
 			facq_statusbar_write_msg(view->priv->statusbar,
 							_("Opening %s"),utf8_filename);
 			g_free(utf8_filename);
+			facq_baf_view_verify_stop(view);
 			local_filename = facq_file_chooser_get_filename_for_system(chooser);
-			if(!facq_file_verify(local_filename,&local_err)){
-				if(local_err){
-					facq_statusbar_write_msg(view->priv->statusbar,
-							_("Error verifying file: %s"),local_err->message);
-					g_clear_error(&local_err);
-					goto exit;
-				}
-				else {
-					facq_statusbar_write_msg(view->priv->statusbar,"%s",
-							_("The file isn't valid"));
-					goto exit;
-				}
-			}
 			view->priv->file = facq_file_open(local_filename,&local_err);
 			g_free(local_filename);
 			if(local_err){
@@ -412,6 +676,25 @@ void facq_baf_view_open_file(FacqBAFView *view)
 				view->priv->stmd = NULL;
 				goto exit;
 			}
+			local_filename = facq_file_get_filename(view->priv->file);
+			view->priv->reader = facq_file_reader_new(local_filename,&local_err);
+			g_free(local_filename);
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						_("Error reading samples: %s"),local_err->message);
+				g_clear_error(&local_err);
+				facq_statusbar_write_msg(view->priv->statusbar,_("Error reading file"));
+				view->priv->reader = NULL;
+				facq_file_free(view->priv->file);
+				view->priv->file = NULL;
+				facq_stream_data_free(view->priv->stmd);
+				view->priv->stmd = NULL;
+				goto exit;
+			}
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
+					"File %s mapped in memory",
+						facq_file_reader_is_mapped(view->priv->reader) ?
+							"is" : "isn't");
 			facq_legend_set_data(view->priv->legend,view->priv->stmd);
 			facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
 					"period: %.9g written_samples: %lu n_channels: %u",
@@ -428,6 +711,8 @@ void facq_baf_view_open_file(FacqBAFView *view)
 					"Total pages %f and %u samples per page",
 								total_pages,samples_per_page);
 			view->priv->samples_per_page = samples_per_page;
+			g_free(view->priv->page);
+			view->priv->page = g_new(gdouble,(gsize)samples_per_page*view->priv->stmd->n_channels);
 			facq_baf_view_plot_setup(view->priv->plot,
 							samples_per_page,
 								view->priv->stmd->period,
@@ -436,9 +721,13 @@ void facq_baf_view_open_file(FacqBAFView *view)
 			facq_baf_view_toolbar_set_total_pages(view->priv->toolbar,total_pages);
 			view->priv->total_pages = total_pages;
 			view->priv->current_page = 0;
+			local_filename = facq_file_get_filename(view->priv->file);
+			has_index = facq_baf_view_index_open(view,local_filename);
 			facq_baf_view_plot_page(view,1);
 			facq_baf_view_menu_enable_close(view->priv->menu);
 			facq_baf_view_menu_enable_save_as(view->priv->menu);
+			facq_baf_view_verify_start(view,local_filename,!has_index);
+			g_free(local_filename);
 		}
 	}
 	exit:
@@ -521,8 +810,9 @@ void facq_baf_view_export_file(FacqBAFView *view)
  *
  * Closes a previously opened binary acquisition file.
  *
- * The function frees the #FacqFile and the #FacqStreamData, created
- * when the file is opened, set the number of written_samples to 0
+ * The function cancels the verification of the file if it's still running,
+ * frees the #FacqFile, the #FacqFileReader and the
+ * #FacqStreamData, created when the file is opened, set the number of written_samples to 0
  * disables the navigation buttons in the toolbar with
  * facq_baf_view_toolbar_disable_navigation(), and the navigation entries
  * in the menu with the facq_baf_view_menu_disable_navigation(). Finally
@@ -540,10 +830,23 @@ void facq_baf_view_close_file(FacqBAFView *view)
 {
 	g_return_if_fail(FACQ_IS_BAF_VIEW(view));
 
+	facq_baf_view_verify_stop(view);
 	if(FACQ_IS_FILE(view->priv->file)){
 		facq_file_free(view->priv->file);
 		view->priv->file = NULL;
 	}
+	if(FACQ_IS_FILE_READER(view->priv->reader)){
+		facq_file_reader_free(view->priv->reader);
+		view->priv->reader = NULL;
+	}
+	if(FACQ_IS_FILE_INDEX(view->priv->index)){
+		facq_file_index_free(view->priv->index);
+		view->priv->index = NULL;
+	}
+	if(view->priv->page){
+		g_free(view->priv->page);
+		view->priv->page = NULL;
+	}
 	if(FACQ_IS_STREAM_DATA(view->priv->stmd)){
 		facq_stream_data_free(view->priv->stmd);
 		view->priv->stmd = NULL;
@@ -556,16 +859,10 @@ void facq_baf_view_close_file(FacqBAFView *view)
 	facq_legend_clear_data(view->priv->legend);
 	facq_baf_view_toolbar_set_total_pages(view->priv->toolbar,1);
 	facq_baf_view_plot_clear(view->priv->plot);
+	facq_baf_view_set_title(view,NULL,NULL);
 	facq_statusbar_write_msg(view->priv->statusbar,"%s",_("File closed"));
 }
 
-static void iter_caller(gpointer data,gdouble *chunk)
-{
-	FacqBAFViewPlot *plot = FACQ_BAF_VIEW_PLOT(data);
-
-	facq_baf_view_plot_push_chunk(plot,chunk);
-}
-
 /**
  * facq_baf_view_plot_page:
  * @view: A #FacqBAFView object.
@@ -579,9 +876,13 @@ static void iter_caller(gpointer data,gdouble *chunk)
  * facq_baf_view_toolbar_disable_navigation().
  *
  * After this the function calculates the start slice, and the number of slices
- * for this page, and the function facq_baf_view_plot_push_chunk() is called
- * for each slice. Finally the facq_baf_view_plot_draw_page() function is
- * called, and the number of page is set into the toolbar and into the menu with
+ * for this page, the slices are read at once with facq_file_reader_read(), and
+ * the function facq_baf_view_plot_push_chunk() is called for each slice.
+ * If the file has a #FacqFileIndex and the page has at least
+ * #FACQ_FILE_INDEX_DECIMATION slices for each column, the minimum and the
+ * maximum of each column are retrieved with facq_file_index_query() instead,
+ * and pushed with facq_baf_view_plot_push_span().
+ * Finally the facq_baf_view_plot_draw_page() function is called, and the number of page is set into the toolbar and into the menu with
  * facq_baf_view_menu_goto_page() and facq_baf_view_toolbar_goto_page().
  *
  * This function is called by the facq_baf_view_plot_page_spin(),
@@ -591,11 +892,14 @@ static void iter_caller(gpointer data,gdouble *chunk)
 void facq_baf_view_plot_page(FacqBAFView *view,gdouble page)
 {
 	guint64 start = 0;
-	guint64 chunks = 0;
+	guint64 chunks = 0, i = 0;
+	guint n_channels = 0, c = 0;
+	FacqFileIndexBin *bins = NULL;
+	gdouble span = 0;
 	GError *local_err = NULL;
 
 	g_return_if_fail(FACQ_IS_BAF_VIEW(view));
-	g_return_if_fail(FACQ_IS_FILE(view->priv->file));
+	g_return_if_fail(FACQ_IS_FILE_READER(view->priv->reader));
 	g_return_if_fail(page > 0 && page <= view->priv->total_pages);
 	
 	if(view->priv->current_page == page)
@@ -606,15 +910,41 @@ void facq_baf_view_plot_page(FacqBAFView *view,gdouble page)
 	facq_baf_view_toolbar_disable_navigation(view->priv->toolbar);
 
 	start = (page-1)*view->priv->samples_per_page;
-	chunks = page*view->priv->samples_per_page;
+	chunks = facq_file_reader_get_n_slices(view->priv->reader);
+	chunks = (chunks > start) ? MIN(view->priv->samples_per_page,chunks - start) : 0;
+	n_channels = view->priv->stmd->n_channels;
 
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
-			"Loading chunks from %lu to %lu",start,chunks);
-
-	facq_file_chunk_iterator(view->priv->file,
+			"Loading %"G_GUINT64_FORMAT" chunks from %"G_GUINT64_FORMAT,chunks,start);
+
+	/* big pages are drawn from the index, pushing the minimum and the
+	 * maximum of each column, each one standing for half the column */
+	if(view->priv->index &&
+		chunks >= (guint64)FACQ_FILE_INDEX_DECIMATION*FACQ_BAF_VIEW_INDEX_PIXELS){
+		bins = g_new(FacqFileIndexBin,(gsize)FACQ_BAF_VIEW_INDEX_PIXELS*n_channels);
+		if(facq_file_index_query(view->priv->index,start,chunks,
+						FACQ_BAF_VIEW_INDEX_PIXELS,bins)){
+			span = (gdouble)chunks/FACQ_BAF_VIEW_INDEX_PIXELS/2;
+			for(i = 0;i < FACQ_BAF_VIEW_INDEX_PIXELS;i++){
+				for(c = 0;c < n_channels;c++){
+					view->priv->page[c] = bins[i*n_channels+c].min;
+					view->priv->page[n_channels+c] = bins[i*n_channels+c].max;
+				}
+				facq_baf_view_plot_push_span(view->priv->plot,
+							view->priv->page,span);
+				facq_baf_view_plot_push_span(view->priv->plot,
+							&view->priv->page[n_channels],span);
+			}
+		}
+		g_free(bins);
+	}
+	else if(chunks && facq_file_reader_read(view->priv->reader,
 					start,chunks,
-						iter_caller,
-							view->priv->plot,&local_err);
+						view->priv->page,&local_err)){
+		for(i = 0;i < chunks;i++)
+			facq_baf_view_plot_push_chunk(view->priv->plot,
+							&view->priv->page[i*n_channels]);
+	}
 	
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
 				"%s","Redrawing page\n");
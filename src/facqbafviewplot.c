@@ -39,6 +39,11 @@
  * facq_baf_view_plot_setup(). After this you should put slices to the plot with
  * facq_baf_view_plot_push_chunk() and when all the slices are pushed to the
  * plot use facq_baf_view_plot_draw_page() to plot them.
+ *
+ * Pages with too many slices can be drawn from a summary of the slices
+ * instead, pushing with facq_baf_view_plot_push_span() values that stand for
+ * a number of consecutive slices, like the minimum and the maximum of each
+ * column of the plot.
  */
 
 /**
@@ -73,6 +78,7 @@ struct _FacqBAFViewPlotPrivate {
 	gfloat max;
 	gfloat min;
 	guint next_chunk;
+	gdouble position;
 	GtkWidget *databox;
 	GtkWidget *table;
 	GPtrArray *signal;
@@ -282,6 +288,7 @@ static void facq_baf_view_plot_init(FacqBAFViewPlot *plot)
 	plot->priv->copy_time = NULL;
 	plot->priv->samples_per_page = 0;
 	plot->priv->next_chunk = 0;
+	plot->priv->position = 0;
 }
 
 /**
@@ -346,6 +353,7 @@ void facq_baf_view_plot_setup(FacqBAFViewPlot *plot,guint samples_per_page,gdoub
 	plot->priv->period = period;
 	plot->priv->n_channels = n_channels;
 	plot->priv->next_chunk = 0;
+	plot->priv->position = 0;
 	plot->priv->max = plot->priv->min = 0;
 	
 	/*ready to push!*/
@@ -364,6 +372,23 @@ void facq_baf_view_plot_setup(FacqBAFViewPlot *plot,guint samples_per_page,gdoub
  * the slices won't get into the buffer.
  */
 void facq_baf_view_plot_push_chunk(FacqBAFViewPlot *plot,gdouble *chunk)
+{
+	facq_baf_view_plot_push_span(plot,chunk,1);
+}
+
+/**
+ * facq_baf_view_plot_push_span:
+ * @plot: A #FacqBAFViewPlot object.
+ * @chunk: A pointer to an array of n_channels real numbers (A slice).
+ * @n_slices: The number of slices of the page represented by @chunk.
+ *
+ * Like facq_baf_view_plot_push_chunk() but the slice stands for @n_slices
+ * slices of the page, so the next slice will be plotted @n_slices periods
+ * later. This allows to draw a page from a summary of its slices, for
+ * example the minimum and the maximum of each column, see
+ * facq_file_index_query().
+ */
+void facq_baf_view_plot_push_span(FacqBAFViewPlot *plot,gdouble *chunk,gdouble n_slices)
 {
 	guint i = 0;
 	
@@ -378,6 +403,11 @@ void facq_baf_view_plot_push_chunk(FacqBAFViewPlot *plot,gdouble *chunk)
 		plot->priv->min = MIN(plot->priv->min,chunk[i]);
 	}
 
+	/* keep the position of the slice in the page, the time is computed
+	 * in facq_baf_view_plot_draw_page() */
+	plot->priv->time[plot->priv->next_chunk] = (gfloat) plot->priv->position;
+	plot->priv->position += n_slices;
+
 	/* increase current_chunk */
 	plot->priv->next_chunk++;
 }
@@ -410,11 +440,12 @@ void facq_baf_view_plot_draw_page(FacqBAFViewPlot *plot,gdouble n_page)
 	g_return_if_fail(FACQ_IS_BAF_VIEW_PLOT(plot));
 	g_return_if_fail(n_page >= 1);
 
-	/* set the time array in the temporal array */
+	/* set the time array in the temporal array, from the position of each
+	 * pushed slice in the page */
 	initial_time = ((n_page-1)*plot->priv->samples_per_page*plot->priv->period);
 	period = (gfloat)plot->priv->period;
-	for(i = 0;i < plot->priv->samples_per_page;i++){
-		plot->priv->time[i] = initial_time + i*period;
+	for(i = 0;i < plot->priv->next_chunk;i++){
+		plot->priv->time[i] = initial_time + plot->priv->time[i]*period;
 	}
 
 	/* erase any previous existing graph */
@@ -466,8 +497,8 @@ void facq_baf_view_plot_draw_page(FacqBAFViewPlot *plot,gdouble n_page)
 
 	/* set the limits */
 	gtk_databox_set_total_limits(GTK_DATABOX(plot->priv->databox),
-					plot->priv->time[0],
-						plot->priv->time[plot->priv->samples_per_page-1],
+					initial_time,
+						initial_time + (plot->priv->samples_per_page-1)*period,
 							plot->priv->max+0.5,plot->priv->min-0.5);
 
 	/* plot it! */
@@ -475,6 +506,7 @@ void facq_baf_view_plot_draw_page(FacqBAFViewPlot *plot,gdouble n_page)
 
 	/* set current_chunk to 0 so we can push more samples later */
 	plot->priv->next_chunk = 0;
+	plot->priv->position = 0;
 }
 
 /**
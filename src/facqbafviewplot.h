@@ -51,6 +51,7 @@ GType facq_baf_view_plot_get_type(void) G_GNUC_CONST;
 FacqBAFViewPlot *facq_baf_view_plot_new(void);
 void facq_baf_view_plot_setup(FacqBAFViewPlot *plot,guint samples_per_page,gdouble period,guint n_channels);
 void facq_baf_view_plot_push_chunk(FacqBAFViewPlot *plot,gdouble *chunk);
+void facq_baf_view_plot_push_span(FacqBAFViewPlot *plot,gdouble *chunk,gdouble n_slices);
 void facq_baf_view_plot_draw_page(FacqBAFViewPlot *plot,gdouble n_page);
 GtkWidget *facq_baf_view_plot_get_widget(const FacqBAFViewPlot *plot);
 void facq_baf_view_plot_clear(FacqBAFViewPlot *plot);
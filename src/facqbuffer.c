@@ -20,11 +20,13 @@
 #include <glib.h>
 #include <gio/gio.h>
 #include "facqglibcompat.h"
+#include "facqlog.h"
 #include "facqchunk.h"
 #include "facqbuffer.h"
 
 #define FACQ_BUFFER_DEF_SIZE 32
 #define FACQ_BUFFER_DEF_CHUNK_SIZE 1
+#define FACQ_BUFFER_CACHE_LINE 64
 
 /**
  * SECTION:facqbuffer
@@ -45,8 +47,27 @@
  * To free the buffer you should use facq_buffer_free().
  *
  * Also check the more advanced functions facq_buffer_try_pop(),
- * facq_buffer_timeout_pop(), facq_buffer_recycle(), facq_buffer_get_recycled(),
- * and facq_buffer_try_get_recycled().
+ * facq_buffer_timeout_pop(), facq_buffer_pop_batch(), facq_buffer_recycle(),
+ * facq_buffer_get_recycled(), and facq_buffer_try_get_recycled().
+ *
+ * When exactly one thread pushes and recycles and exactly one thread pops,
+ * the buffer can be created with facq_buffer_new_spsc(). In this mode the
+ * two #GAsyncQueue objects are replaced by lock-free single producer single
+ * consumer rings, where the head and the tail indexes live in different
+ * cache lines. A mutex and a condition variable are only used when one of
+ * the sides has to sleep because the ring is empty or full, so at high
+ * sample rates with small chunks the hop between threads doesn't take any
+ * lock.
+ *
+ * facq_buffer_new_queue() creates a bounded #FacqBuffer in the same mode but
+ * without any preallocated #FacqChunk, that can be used to pass chunks from
+ * one thread to the next one. facq_buffer_get_length() returns the number of
+ * chunks waiting to be popped, and facq_buffer_try_push() can be used to
+ * push a chunk only if there is room for it.
+ *
+ * The preallocated chunks are taken from a single #FacqChunkSlab, so the
+ * whole ring is one contiguous memory block, allocated with one call when the
+ * buffer is created, and their data areas are aligned for SIMD instructions.
  *
  * The expected behavior of the user is to create two threads, one of the
  * threads will be the producer and the other the consumer, the producer
@@ -88,22 +109,314 @@ enum {
 	PROP_0,
 	PROP_MAX_CHUNKS,
 	PROP_CHUNK_SIZE,
+	PROP_SPSC,
+	PROP_PREALLOCATE,
+	PROP_LOCKED_MEMORY
 };
 
-struct _FacqBufferPrivate {
-	guint max_chunks;
-	guint chunk_size;
-	gboolean exit;
+/*
+ * FacqRing:
+ *
+ * Lock-free single producer single consumer ring of #FacqChunk pointers.
+ * head is only written by the consumer side and tail only by the producer,
+ * both are free running counters, and are placed in their own cache line to
+ * avoid false sharing between the two threads. head is advanced with a
+ * compare and exchange, so the producer can also pop the oldest chunk, see
+ * facq_buffer_try_pop(). sleepers counts the threads
+ * waiting in the condition variable, so the other side only needs to take
+ * the mutex when someone is really sleeping. exit is set by
+ * facq_buffer_exit(), and makes the threads sleeping in a pop return.
+ */
+typedef struct _FacqRing {
+	gchar pad0[FACQ_BUFFER_CACHE_LINE];
+	volatile gint head;
+	gchar pad1[FACQ_BUFFER_CACHE_LINE-sizeof(gint)];
+	volatile gint tail;
+	gchar pad2[FACQ_BUFFER_CACHE_LINE-sizeof(gint)];
+	volatile gint sleepers;
+	gchar pad3[FACQ_BUFFER_CACHE_LINE-sizeof(gint)];
+	volatile gint exit;
+	guint mask;
+	FacqChunk **slots;
 #if GLIB_MINOR_VERSION >= 32
-	GMutex exit_mutex;
+	GMutex mutex;
+	GCond cond;
 #else
-	GMutex *exit_mutex;
+	GMutex *mutex;
+	GCond *cond;
 #endif
+} FacqRing;
+
+struct _FacqBufferPrivate {
+	guint max_chunks;
+	guint chunk_size;
+	gboolean spsc;
+	gboolean preallocate;
+	gboolean locked_memory;
+	volatile gint exit;
 	GAsyncQueue *q;
 	GAsyncQueue *t;
+	FacqRing *rq;
+	FacqRing *rt;
+	FacqChunkSlab *slab;
 	GError *construct_error;
 };
 
+/* In queue mode facq_buffer_exit() pushes this chunk to the queues, to wake
+ * up the threads waiting on them. It's never returned to the user. */
+static FacqChunk facq_buffer_sentinel;
+
+/* FacqRing private functions */
+static FacqRing *facq_ring_new(guint min_slots)
+{
+	FacqRing *ring = NULL;
+	guint slots = 1;
+
+	while(slots < min_slots)
+		slots <<= 1;
+
+	ring = g_new0(FacqRing,1);
+	ring->slots = g_new0(FacqChunk *,slots);
+	ring->mask = slots - 1;
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_init(&ring->mutex);
+	g_cond_init(&ring->cond);
+#else
+	ring->mutex = g_mutex_new();
+	ring->cond = g_cond_new();
+#endif
+	return ring;
+}
+
+static void facq_ring_wake(FacqRing *ring)
+{
+	if(g_atomic_int_get(&ring->sleepers) == 0)
+		return;
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&ring->mutex);
+	g_cond_broadcast(&ring->cond);
+	g_mutex_unlock(&ring->mutex);
+#else
+	g_mutex_lock(ring->mutex);
+	g_cond_broadcast(ring->cond);
+	g_mutex_unlock(ring->mutex);
+#endif
+}
+
+static gboolean facq_ring_is_empty(FacqRing *ring)
+{
+	return (g_atomic_int_get(&ring->head) == g_atomic_int_get(&ring->tail));
+}
+
+/* The check used by the pops, a ring that is exiting doesn't wait */
+static gboolean facq_ring_is_empty_running(FacqRing *ring)
+{
+	return (facq_ring_is_empty(ring) && !g_atomic_int_get(&ring->exit));
+}
+
+static gboolean facq_ring_is_full(FacqRing *ring)
+{
+	guint used = (guint)g_atomic_int_get(&ring->tail) - (guint)g_atomic_int_get(&ring->head);
+
+	return (used > ring->mask);
+}
+
+static gboolean facq_ring_try_push(FacqRing *ring,FacqChunk *chunk)
+{
+	guint tail = (guint)ring->tail;
+
+	if(tail - (guint)g_atomic_int_get(&ring->head) > ring->mask)
+		return FALSE;
+	ring->slots[tail & ring->mask] = chunk;
+	g_atomic_int_set(&ring->tail,(gint)(tail + 1));
+	facq_ring_wake(ring);
+	return TRUE;
+}
+
+static FacqChunk *facq_ring_try_pop(FacqRing *ring)
+{
+	guint head = 0;
+	FacqChunk *chunk = NULL;
+
+	/* the slot can't be reused by the producer until head is advanced, so
+	 * if the exchange succeeds the chunk read is the right one */
+	do {
+		head = (guint)g_atomic_int_get(&ring->head);
+		if(head == (guint)g_atomic_int_get(&ring->tail))
+			return NULL;
+		chunk = ring->slots[head & ring->mask];
+	} while(!g_atomic_int_compare_and_exchange(&ring->head,(gint)head,(gint)(head + 1)));
+	facq_ring_wake(ring);
+	return chunk;
+}
+
+/* Like facq_ring_try_pop() but takes up to max_chunks chunks at once,
+ * advancing head only one time. Returns the number of chunks taken. */
+static guint facq_ring_try_pop_batch(FacqRing *ring,FacqChunk **chunks,guint max_chunks)
+{
+	guint head = 0, n_chunks = 0, i = 0;
+
+	do {
+		head = (guint)g_atomic_int_get(&ring->head);
+		n_chunks = (guint)g_atomic_int_get(&ring->tail) - head;
+		if(!n_chunks)
+			return 0;
+		n_chunks = MIN(n_chunks,max_chunks);
+		for(i = 0;i < n_chunks;i++)
+			chunks[i] = ring->slots[(head + i) & ring->mask];
+	} while(!g_atomic_int_compare_and_exchange(&ring->head,(gint)head,(gint)(head + n_chunks)));
+	facq_ring_wake(ring);
+	return n_chunks;
+}
+
+/*
+ * facq_ring_sleep:
+ *
+ * Sleeps until check() returns %FALSE or end_time, in monotonic time, is
+ * reached. The sleepers counter is incremented before checking the ring
+ * state again with the mutex held, so a facq_ring_wake() call from the
+ * other side can't be lost. Use -1 as end_time to wait forever.
+ * Returns %FALSE if the time has elapsed.
+ */
+static gboolean facq_ring_sleep(FacqRing *ring,gboolean (*check)(FacqRing *),gint64 end_time)
+{
+	gboolean ret = TRUE;
+
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&ring->mutex);
+	g_atomic_int_inc(&ring->sleepers);
+	if(check(ring)){
+		if(end_time < 0)
+			g_cond_wait(&ring->cond,&ring->mutex);
+		else
+			ret = g_cond_wait_until(&ring->cond,&ring->mutex,end_time);
+	}
+	g_atomic_int_add(&ring->sleepers,-1);
+	g_mutex_unlock(&ring->mutex);
+#else
+	g_mutex_lock(ring->mutex);
+	g_atomic_int_inc(&ring->sleepers);
+	if(check(ring)){
+		if(end_time < 0)
+			g_cond_wait(ring->cond,ring->mutex);
+		else
+			ret = g_cond_wait_until(ring->cond,ring->mutex,end_time);
+	}
+	g_atomic_int_add(&ring->sleepers,-1);
+	g_mutex_unlock(ring->mutex);
+#endif
+	return ret;
+}
+
+static void facq_ring_push(FacqRing *ring,FacqChunk *chunk)
+{
+	while(!facq_ring_try_push(ring,chunk))
+		facq_ring_sleep(ring,facq_ring_is_full,-1);
+}
+
+static FacqChunk *facq_ring_pop(FacqRing *ring)
+{
+	FacqChunk *chunk = NULL;
+
+	while( (chunk = facq_ring_try_pop(ring)) == NULL){
+		if(g_atomic_int_get(&ring->exit))
+			return NULL;
+		facq_ring_sleep(ring,facq_ring_is_empty_running,-1);
+	}
+	return chunk;
+}
+
+static FacqChunk *facq_ring_timeout_pop(FacqRing *ring,guint64 timeout)
+{
+	FacqChunk *chunk = NULL;
+	gint64 end_time = 0;
+
+	end_time = g_get_monotonic_time() + timeout;
+	while( (chunk = facq_ring_try_pop(ring)) == NULL){
+		if(g_atomic_int_get(&ring->exit))
+			return NULL;
+		if(!facq_ring_sleep(ring,facq_ring_is_empty_running,end_time))
+			return facq_ring_try_pop(ring);
+	}
+	return chunk;
+}
+
+static guint facq_ring_timeout_pop_batch(FacqRing *ring,FacqChunk **chunks,guint max_chunks,guint64 timeout)
+{
+	guint n_chunks = 0;
+	gint64 end_time = 0;
+
+	end_time = g_get_monotonic_time() + timeout;
+	while( (n_chunks = facq_ring_try_pop_batch(ring,chunks,max_chunks)) == 0){
+		if(g_atomic_int_get(&ring->exit))
+			return 0;
+		if(!facq_ring_sleep(ring,facq_ring_is_empty_running,end_time))
+			return facq_ring_try_pop_batch(ring,chunks,max_chunks);
+	}
+	return n_chunks;
+}
+
+/* The flag is set before waking up the sleepers, and they check it with the
+ * mutex held, so the wake up can't be lost */
+static void facq_ring_exit(FacqRing *ring)
+{
+	g_atomic_int_set(&ring->exit,TRUE);
+	facq_ring_wake(ring);
+}
+
+/*
+ * facq_buffer_queue_filter:
+ *
+ * Used in queue mode after popping a chunk. If the chunk is the sentinel it's
+ * pushed back, so all the waiting threads see it, and the next chunk is
+ * returned instead, if any.
+ */
+static FacqChunk *facq_buffer_queue_filter(GAsyncQueue *q,FacqChunk *chunk)
+{
+	if(chunk != &facq_buffer_sentinel)
+		return chunk;
+	g_async_queue_lock(q);
+	chunk = g_async_queue_try_pop_unlocked(q);
+	if(chunk == &facq_buffer_sentinel)
+		chunk = NULL;
+	g_async_queue_push_unlocked(q,&facq_buffer_sentinel);
+	g_async_queue_unlock(q);
+	return chunk;
+}
+
+static void facq_ring_free(FacqRing *ring)
+{
+	FacqChunk *chunk = NULL;
+
+	while( (chunk = facq_ring_try_pop(ring)) != NULL)
+		facq_chunk_free(chunk);
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_clear(&ring->mutex);
+	g_cond_clear(&ring->cond);
+#else
+	g_mutex_free(ring->mutex);
+	g_cond_free(ring->cond);
+#endif
+	g_free(ring->slots);
+	g_free(ring);
+}
+
+static void facq_buffer_log_memory(FacqBuffer *buf)
+{
+	FacqChunkSlabFlags flags = 0;
+
+	flags = facq_chunk_slab_get_flags(buf->priv->slab);
+	facq_log_write_v((flags & FACQ_CHUNK_SLAB_LOCKED) ?
+				FACQ_LOG_MSG_TYPE_INFO : FACQ_LOG_MSG_TYPE_WARNING,
+			"Ring memory: %u chunks of %u bytes, mapped=%s huge pages=%s prefaulted=%s locked=%s",
+			buf->priv->max_chunks,
+			buf->priv->chunk_size,
+			(flags & FACQ_CHUNK_SLAB_MAPPED) ? "yes" : "no",
+			(flags & FACQ_CHUNK_SLAB_HUGE_PAGES) ? "yes" : "no",
+			(flags & FACQ_CHUNK_SLAB_PREFAULTED) ? "yes" : "no",
+			(flags & FACQ_CHUNK_SLAB_LOCKED) ? "yes" : "no");
+}
+
 /* GObject magic */
 static void facq_buffer_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
 {
@@ -114,6 +427,12 @@ static void facq_buffer_get_property(GObject *self,guint property_id,GValue *val
 	break;
 	case PROP_CHUNK_SIZE: g_value_set_uint(value,buf->priv->chunk_size);
 	break;
+	case PROP_SPSC: g_value_set_boolean(value,buf->priv->spsc);
+	break;
+	case PROP_PREALLOCATE: g_value_set_boolean(value,buf->priv->preallocate);
+	break;
+	case PROP_LOCKED_MEMORY: g_value_set_boolean(value,buf->priv->locked_memory);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (buf, property_id, pspec);
 	}
@@ -128,6 +447,12 @@ static void facq_buffer_set_property(GObject *self,guint property_id,const GValu
 	break;
 	case PROP_CHUNK_SIZE: buf->priv->chunk_size = g_value_get_uint(value);
 	break;
+	case PROP_SPSC: buf->priv->spsc = g_value_get_boolean(value);
+	break;
+	case PROP_PREALLOCATE: buf->priv->preallocate = g_value_get_boolean(value);
+	break;
+	case PROP_LOCKED_MEMORY: buf->priv->locked_memory = g_value_get_boolean(value);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (buf, property_id, pspec);
 	}
@@ -141,12 +466,14 @@ static void facq_buffer_finalize(GObject *self)
 		g_async_queue_unref(buf->priv->q);
 	if(buf->priv->t)
 		g_async_queue_unref(buf->priv->t);
-
-#if GLIB_MINOR_VERSION >= 32
-	g_mutex_clear(&buf->priv->exit_mutex);
-#else
-	g_mutex_free(buf->priv->exit_mutex);
-#endif
+	if(buf->priv->rq)
+		facq_ring_free(buf->priv->rq);
+	if(buf->priv->rt)
+		facq_ring_free(buf->priv->rt);
+	/* after the queues, facq_chunk_free() doesn't free the chunks of the
+	 * slab */
+	if(buf->priv->slab)
+		facq_chunk_slab_free(buf->priv->slab);
 
 	if(G_OBJECT_CLASS(facq_buffer_parent_class)->finalize)
     		(*G_OBJECT_CLASS(facq_buffer_parent_class)->finalize)(self);
@@ -158,28 +485,40 @@ static void facq_buffer_constructed(GObject *self)
 	FacqChunk *chunk = NULL;
 	guint i = 0;
 
-#if GLIB_MINOR_VERSION >= 32
-	g_mutex_init(&buf->priv->exit_mutex);
-#else
-	buf->priv->exit_mutex = g_mutex_new();
-#endif
-
-	buf->priv->q = g_async_queue_new_full((GDestroyNotify)facq_chunk_free);
-	buf->priv->t = g_async_queue_new_full((GDestroyNotify)facq_chunk_free);
+	if(buf->priv->spsc){
+		buf->priv->rq = facq_ring_new(buf->priv->max_chunks);
+		buf->priv->rt = facq_ring_new(buf->priv->max_chunks);
+	}
+	else {
+		buf->priv->q = g_async_queue_new_full((GDestroyNotify)facq_chunk_free);
+		buf->priv->t = g_async_queue_new_full((GDestroyNotify)facq_chunk_free);
+	}
 
-	for(i = 0;i < buf->priv->max_chunks;i++){
-		chunk = facq_chunk_new(buf->priv->chunk_size,NULL);
-		if(!chunk){
+	if(buf->priv->preallocate){
+		buf->priv->slab = facq_chunk_slab_new(buf->priv->max_chunks,
+						      buf->priv->chunk_size,
+						      buf->priv->locked_memory,
+						      NULL);
+		if(!buf->priv->slab){
 			g_set_error_literal(&buf->priv->construct_error,
 					    FACQ_BUFFER_ERROR,
 					    FACQ_BUFFER_ERROR_FAILED,
 					    "Error allocating memory");
 			return;
 		}
-		g_async_queue_push(buf->priv->t,chunk);
+		if(buf->priv->locked_memory)
+			facq_buffer_log_memory(buf);
 	}
 
-	buf->priv->exit = FALSE;
+	for(i = 0;buf->priv->preallocate && i < buf->priv->max_chunks;i++){
+		chunk = facq_chunk_slab_get_chunk(buf->priv->slab,i);
+		if(buf->priv->spsc)
+			facq_ring_push(buf->priv->rt,chunk);
+		else
+			g_async_queue_push(buf->priv->t,chunk);
+	}
+
+	g_atomic_int_set(&buf->priv->exit,FALSE);
 }
 
 static void facq_buffer_class_init(FacqBufferClass *klass)
@@ -225,6 +564,51 @@ static void facq_buffer_class_init(FacqBufferClass *klass)
 							G_PARAM_READWRITE |
 							G_PARAM_CONSTRUCT_ONLY |
 							G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * FacqBuffer:spsc:
+	 *
+	 * If %TRUE the buffer uses lock-free single producer single consumer
+	 * rings instead of #GAsyncQueue objects.
+	 */
+	g_object_class_install_property(object_class,PROP_SPSC,
+					g_param_spec_boolean("spsc",
+							"SPSC",
+							"Use lock-free single producer single consumer rings",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT_ONLY |
+							G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * FacqBuffer:preallocate:
+	 *
+	 * If %TRUE max-chunks chunks are allocated at construction time and
+	 * are available with facq_buffer_get_recycled().
+	 */
+	g_object_class_install_property(object_class,PROP_PREALLOCATE,
+					g_param_spec_boolean("preallocate",
+							"Preallocate",
+							"Allocate the chunks at construction time",
+							TRUE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT_ONLY |
+							G_PARAM_STATIC_STRINGS));
+
+	/**
+	 * FacqBuffer:locked-memory:
+	 *
+	 * If %TRUE the preallocated chunks use locked memory, see
+	 * facq_chunk_slab_new().
+	 */
+	g_object_class_install_property(object_class,PROP_LOCKED_MEMORY,
+					g_param_spec_boolean("locked-memory",
+							"Locked memory",
+							"Use prefaulted memory locked in RAM for the chunks",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT_ONLY |
+							G_PARAM_STATIC_STRINGS));
 }
 
 static void facq_buffer_init(FacqBuffer *buf)
@@ -233,6 +617,12 @@ static void facq_buffer_init(FacqBuffer *buf)
 	buf->priv->exit = FALSE;
 	buf->priv->max_chunks = 0;
 	buf->priv->chunk_size = 0;
+	buf->priv->spsc = FALSE;
+	buf->priv->preallocate = TRUE;
+	buf->priv->locked_memory = FALSE;
+	buf->priv->rq = NULL;
+	buf->priv->rt = NULL;
+	buf->priv->slab = NULL;
 }
 
 /* GInitable interface */
@@ -283,6 +673,83 @@ FacqBuffer *facq_buffer_new(guint max_chunks,guint chunk_size,GError **err)
 			    NULL);
 }
 
+/**
+ * facq_buffer_new_spsc:
+ * @max_chunks: Desired maximum chunks.
+ * @chunk_size: Desired chunk size in bytes.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Like facq_buffer_new() but the returned #FacqBuffer uses lock-free
+ * rings. Only one thread can call facq_buffer_push() and
+ * facq_buffer_get_recycled() (or facq_buffer_try_get_recycled()), and
+ * only one thread can call the pop functions and facq_buffer_recycle().
+ * This is the case of the producer and consumer threads in #FacqPipeline.
+ *
+ * Returns: A #FacqBuffer or %NULL on error.
+ */
+FacqBuffer *facq_buffer_new_spsc(guint max_chunks,guint chunk_size,GError **err)
+{
+	return g_initable_new(FACQ_TYPE_BUFFER,
+			    NULL,err,
+			    "max-chunks",max_chunks,
+			    "chunk-size",chunk_size,
+			    "spsc",TRUE,
+			    NULL);
+}
+
+/**
+ * facq_buffer_new_full:
+ * @max_chunks: Desired maximum chunks.
+ * @chunk_size: Desired chunk size in bytes.
+ * @spsc: %TRUE to create the buffer in single producer single consumer mode,
+ * see facq_buffer_new_spsc().
+ * @locked_memory: %TRUE to allocate the chunks in locked memory.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Like facq_buffer_new() but allows to choose the mode of the buffer, and
+ * the type of memory used for the chunks. With @locked_memory the chunks are
+ * backed by huge pages, prefaulted and locked in RAM when the system allows
+ * it, see facq_chunk_slab_new(), so the threads using the buffer never wait for
+ * a page fault, the result is written to the log. This is useful for long
+ * recordings at high sample rates, at the cost of a slower creation.
+ *
+ * Returns: A #FacqBuffer or %NULL on error.
+ */
+FacqBuffer *facq_buffer_new_full(guint max_chunks,guint chunk_size,gboolean spsc,gboolean locked_memory,GError **err)
+{
+	return g_initable_new(FACQ_TYPE_BUFFER,
+			    NULL,err,
+			    "max-chunks",max_chunks,
+			    "chunk-size",chunk_size,
+			    "spsc",spsc,
+			    "locked-memory",locked_memory,
+			    NULL);
+}
+
+/**
+ * facq_buffer_new_queue:
+ * @max_chunks: The maximum number of chunks in the queue.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Creates a new #FacqBuffer in single producer single consumer mode, see
+ * facq_buffer_new_spsc(), but without any preallocated #FacqChunk. The
+ * returned object can only be used with facq_buffer_push() and the pop
+ * functions, to pass chunks between two threads. facq_buffer_push() blocks
+ * when the queue is full, the capacity is @max_chunks rounded to the next
+ * power of two.
+ *
+ * Returns: A #FacqBuffer or %NULL on error.
+ */
+FacqBuffer *facq_buffer_new_queue(guint max_chunks,GError **err)
+{
+	return g_initable_new(FACQ_TYPE_BUFFER,
+			    NULL,err,
+			    "max-chunks",max_chunks,
+			    "spsc",TRUE,
+			    "preallocate",FALSE,
+			    NULL);
+}
+
 /**
  * facq_buffer_push:
  * @buf: A #FacqBuffer object.
@@ -296,7 +763,33 @@ void facq_buffer_push(FacqBuffer *buf,FacqChunk *chunk)
 	g_return_if_fail(FACQ_IS_BUFFER(buf));
 	g_return_if_fail(FACQ_IS_ARRAY(chunk));
 #endif
+	if(buf->priv->spsc)
+		facq_ring_push(buf->priv->rq,chunk);
+	else
+		g_async_queue_push(buf->priv->q,chunk);
+}
+
+/**
+ * facq_buffer_try_push:
+ * @buf: A #FacqBuffer object.
+ * @chunk: A pointer to a #FacqChunk containing a data chunk.
+ *
+ * Pushes @chunk to the @buf #FacqBuffer object without blocking. Only
+ * buffers created with facq_buffer_new_spsc() or facq_buffer_new_queue() can
+ * be full, in other case the push always succeeds.
+ *
+ * Returns: %TRUE if @chunk has been pushed, %FALSE if the buffer is full.
+ */
+gboolean facq_buffer_try_push(FacqBuffer *buf,FacqChunk *chunk)
+{
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_BUFFER(buf),FALSE);
+	g_return_val_if_fail(chunk != NULL,FALSE);
+#endif
+	if(buf->priv->spsc)
+		return facq_ring_try_push(buf->priv->rq,chunk);
 	g_async_queue_push(buf->priv->q,chunk);
+	return TRUE;
 }
 
 /**
@@ -304,16 +797,20 @@ void facq_buffer_push(FacqBuffer *buf,FacqChunk *chunk)
  * @buf: A #FacqBuffer object.
  *
  * Retrieves a chunk from the buffer, giving space to one more chunk.
- * It will block until a #FacqChunk is ready to be returned.
+ * It will block until a #FacqChunk is ready to be returned, or until
+ * facq_buffer_exit() is called.
  *
- * Return value: a #FacqChunk with data.
+ * Return value: a #FacqChunk with data, or %NULL if the buffer is empty and
+ * facq_buffer_exit() has been called.
  */
 FacqChunk *facq_buffer_pop(FacqBuffer *buf)
 {
 #if ENABLE_DEBUG
 	g_return_val_if_fail(FACQ_IS_BUFFER(buf),NULL);
 #endif
-	return g_async_queue_pop(buf->priv->q);
+	if(buf->priv->spsc)
+		return facq_ring_pop(buf->priv->rq);
+	return facq_buffer_queue_filter(buf->priv->q,g_async_queue_pop(buf->priv->q));
 }
 
 /**
@@ -321,6 +818,8 @@ FacqChunk *facq_buffer_pop(FacqBuffer *buf)
  * @buf: A #FacqBuffer object.
  *
  * Tries to pop a #FacqChunk from the buffer without blocking.
+ * In single producer single consumer mode the producer can also call this
+ * function, to take back the oldest chunk when there aren't recycled chunks.
  *
  * Returns: A previously stored #FacqChunk in the buffer, or %NULL
  * if any.
@@ -330,7 +829,9 @@ FacqChunk *facq_buffer_try_pop(FacqBuffer *buf)
 #if ENABLE_DEBUG
 	g_return_val_if_fail(FACQ_IS_BUFFER(buf),NULL);
 #endif
-	return g_async_queue_try_pop(buf->priv->q);
+	if(buf->priv->spsc)
+		return facq_ring_try_pop(buf->priv->rq);
+	return facq_buffer_queue_filter(buf->priv->q,g_async_queue_try_pop(buf->priv->q));
 }
 
 /**
@@ -351,7 +852,57 @@ FacqChunk *facq_buffer_timeout_pop(FacqBuffer *buf,gdouble seconds)
 	g_return_val_if_fail(FACQ_IS_BUFFER(buf),NULL);
 #endif
 	timeout = seconds*G_USEC_PER_SEC;
-	return g_async_queue_timeout_pop(buf->priv->q,timeout);
+	if(buf->priv->spsc)
+		return facq_ring_timeout_pop(buf->priv->rq,timeout);
+	return facq_buffer_queue_filter(buf->priv->q,g_async_queue_timeout_pop(buf->priv->q,timeout));
+}
+
+/**
+ * facq_buffer_pop_batch:
+ * @buf: A #FacqBuffer object.
+ * @chunks: An array where the popped chunks will be stored.
+ * @max_chunks: The length of @chunks, at least 1.
+ * @seconds: The maximum number of seconds to wait for the first #FacqChunk.
+ *
+ * Like facq_buffer_timeout_pop() but after the first #FacqChunk takes all
+ * the chunks waiting in the buffer, up to @max_chunks, without blocking
+ * again. The chunks are stored in @chunks in the same order they were pushed.
+ * This allows the consumer to process everything that is available with one
+ * wake up.
+ *
+ * Returns: The number of chunks stored in @chunks, 0 if the time elapses
+ * without receiving any #FacqChunk.
+ */
+guint facq_buffer_pop_batch(FacqBuffer *buf,FacqChunk **chunks,guint max_chunks,gdouble seconds)
+{
+	guint64 timeout = 0;
+	guint n_chunks = 0;
+
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_BUFFER(buf),0);
+	g_return_val_if_fail(chunks != NULL,0);
+	g_return_val_if_fail(max_chunks > 0,0);
+#endif
+	timeout = seconds*G_USEC_PER_SEC;
+	if(buf->priv->spsc)
+		return facq_ring_timeout_pop_batch(buf->priv->rq,chunks,max_chunks,timeout);
+
+	chunks[0] = facq_buffer_queue_filter(buf->priv->q,
+				g_async_queue_timeout_pop(buf->priv->q,timeout));
+	if(!chunks[0])
+		return 0;
+	n_chunks = 1;
+	g_async_queue_lock(buf->priv->q);
+	while(n_chunks < max_chunks &&
+		(chunks[n_chunks] = g_async_queue_try_pop_unlocked(buf->priv->q)) != NULL){
+		if(chunks[n_chunks] == &facq_buffer_sentinel){
+			g_async_queue_push_unlocked(buf->priv->q,&facq_buffer_sentinel);
+			break;
+		}
+		n_chunks++;
+	}
+	g_async_queue_unlock(buf->priv->q);
+	return n_chunks;
 }
 
 /**
@@ -369,7 +920,10 @@ void facq_buffer_recycle(FacqBuffer *buf,FacqChunk *chunk)
 	g_return_if_fail(FACQ_IS_BUFFER(buf));
 #endif
 	facq_chunk_clear(chunk);
-	g_async_queue_push(buf->priv->t,chunk);
+	if(buf->priv->spsc)
+		facq_ring_push(buf->priv->rt,chunk);
+	else
+		g_async_queue_push(buf->priv->t,chunk);
 }
 
 /**
@@ -379,14 +933,17 @@ void facq_buffer_recycle(FacqBuffer *buf,FacqChunk *chunk)
  * gets and empty #FacqChunk from the buffer.
  *
  * Returns: An empty #FacqChunk from the buffer, without the
- * need to reallocate a new one.
+ * need to reallocate a new one, or %NULL if facq_buffer_exit() has been
+ * called and there isn't any recycled chunk.
  */
 FacqChunk *facq_buffer_get_recycled(FacqBuffer *buf)
 {
 #if ENABLE_DEBUG
 	g_return_if_fail(FACQ_IS_BUFFER(buf));
 #endif
-	return g_async_queue_pop(buf->priv->t);
+	if(buf->priv->spsc)
+		return facq_ring_pop(buf->priv->rt);
+	return facq_buffer_queue_filter(buf->priv->t,g_async_queue_pop(buf->priv->t));
 }
 
 /**
@@ -403,7 +960,36 @@ FacqChunk *facq_buffer_try_get_recycled(FacqBuffer *buf)
 #if ENABLE_DEBUG
 	g_return_if_fail(FACQ_IS_BUFFER(buf));
 #endif
-	return g_async_queue_try_pop(buf->priv->t);
+	if(buf->priv->spsc)
+		return facq_ring_try_pop(buf->priv->rt);
+	return facq_buffer_queue_filter(buf->priv->t,g_async_queue_try_pop(buf->priv->t));
+}
+
+/**
+ * facq_buffer_get_length:
+ * @buf: A #FacqBuffer object.
+ *
+ * Gets the number of chunks pushed to the buffer that are waiting to be
+ * popped. The value is only an approximation if other threads are using
+ * the buffer at the same time.
+ *
+ * Returns: The number of chunks in the buffer.
+ */
+guint facq_buffer_get_length(FacqBuffer *buf)
+{
+	gint len = 0;
+
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_BUFFER(buf),0);
+#endif
+	if(buf->priv->spsc)
+		return (guint)g_atomic_int_get(&buf->priv->rq->tail) -
+				(guint)g_atomic_int_get(&buf->priv->rq->head);
+	len = g_async_queue_length(buf->priv->q);
+	/* don't count the sentinel */
+	if(g_atomic_int_get(&buf->priv->exit))
+		len--;
+	return (len > 0) ? len : 0;
 }
 
 /**
@@ -414,6 +1000,12 @@ FacqChunk *facq_buffer_try_get_recycled(FacqBuffer *buf)
  * It will set an internal property, that you can check with
  * facq_buffer_get_exit(), that can be used by your threads
  * to check the status.
+ *
+ * The threads waiting in facq_buffer_pop(), facq_buffer_timeout_pop(),
+ * facq_buffer_pop_batch() or facq_buffer_get_recycled() are woken up
+ * immediately, and these functions don't wait any more, returning %NULL
+ * (or 0) when there isn't any #FacqChunk available. The pushes aren't
+ * affected, so the remaining chunks can still be passed to the next thread.
  */
 void facq_buffer_exit(FacqBuffer *buf)
 {
@@ -421,15 +1013,16 @@ void facq_buffer_exit(FacqBuffer *buf)
 	g_return_if_fail(FACQ_IS_BUFFER(buf));
 #endif
 
-#if GLIB_MINOR_VERSION >= 32
-	g_mutex_lock(&buf->priv->exit_mutex);
-	buf->priv->exit = TRUE;
-	g_mutex_unlock(&buf->priv->exit_mutex);
-#else
-	g_mutex_lock(buf->priv->exit_mutex);
-	buf->priv->exit = TRUE;
-	g_mutex_unlock(buf->priv->exit_mutex);
-#endif
+	if(!g_atomic_int_compare_and_exchange(&buf->priv->exit,FALSE,TRUE))
+		return;
+	if(buf->priv->spsc){
+		facq_ring_exit(buf->priv->rq);
+		facq_ring_exit(buf->priv->rt);
+	}
+	else {
+		g_async_queue_push(buf->priv->q,&facq_buffer_sentinel);
+		g_async_queue_push(buf->priv->t,&facq_buffer_sentinel);
+	}
 }
 
 /**
@@ -444,22 +1037,11 @@ void facq_buffer_exit(FacqBuffer *buf)
  */
 gboolean facq_buffer_get_exit(FacqBuffer *buf)
 {
-	gboolean ret = FALSE;
-
 #if ENABLE_DEBUG
 	g_return_val_if_fail(FACQ_IS_BUFFER(buf),TRUE);
 #endif
 
-#if GLIB_MINOR_VERSION >= 32
-	g_mutex_lock(&buf->priv->exit_mutex);
-	ret = buf->priv->exit;
-	g_mutex_unlock(&buf->priv->exit_mutex);
-#else
-	g_mutex_lock(buf->priv->exit_mutex);
-	ret = buf->priv->exit;
-	g_mutex_unlock(buf->priv->exit_mutex);
-#endif
-	return ret;
+	return g_atomic_int_get(&buf->priv->exit);
 }
 
 /**
@@ -53,13 +53,19 @@ struct _FacqBufferClass {
 GType facq_buffer_get_type(void) G_GNUC_CONST;
 
 FacqBuffer *facq_buffer_new(guint max_chunks,guint chunk_size,GError **err);
+FacqBuffer *facq_buffer_new_spsc(guint max_chunks,guint chunk_size,GError **err);
+FacqBuffer *facq_buffer_new_full(guint max_chunks,guint chunk_size,gboolean spsc,gboolean locked_memory,GError **err);
+FacqBuffer *facq_buffer_new_queue(guint max_chunks,GError **err);
 void facq_buffer_push(FacqBuffer *buf,FacqChunk *chunk);
+gboolean facq_buffer_try_push(FacqBuffer *buf,FacqChunk *chunk);
 FacqChunk *facq_buffer_pop(FacqBuffer *buf);
 FacqChunk *facq_buffer_try_pop(FacqBuffer *buf);
 FacqChunk *facq_buffer_timeout_pop(FacqBuffer *buf,gdouble seconds);
+guint facq_buffer_pop_batch(FacqBuffer *buf,FacqChunk **chunks,guint max_chunks,gdouble seconds);
 void facq_buffer_recycle(FacqBuffer *buf,FacqChunk *chunk);
 FacqChunk *facq_buffer_get_recycled(FacqBuffer *buf);
 FacqChunk *facq_buffer_try_get_recycled(FacqBuffer *buf);
+guint facq_buffer_get_length(FacqBuffer *buf);
 void facq_buffer_exit(FacqBuffer *buf);
 gboolean facq_buffer_get_exit(FacqBuffer *buf);
 void facq_buffer_free(FacqBuffer *buf);
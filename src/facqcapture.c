@@ -68,6 +68,9 @@
  *
  * For showing the capture log a #FacqLogWindow is used.
  *
+ * While the stream is running the #FacqStatusbar shows the statistics of the
+ * pipeline, see facq_stream_get_stats(), updated each second.
+ *
  * For implementing the operations a #FacqStream and a #FacqCatalog are used.
  * Before creating a #FacqCapture object, you need to create a #FacqCatalog.
  * </para>
@@ -91,6 +94,7 @@ struct _FacqCapturePrivate {
 	const FacqCatalog *catalog;
 	FacqStream *stream;
 	guint ring_chunks;
+	guint stats_source;
 };
 
 /*****--- callbacks ---*****/
@@ -154,6 +158,37 @@ static void capture_error_callback(FacqPipelineMessage *msg,gpointer data)
 	g_free(info);
 }
 
+/*
+ * capture_stats_callback:
+ *
+ * Called each second while the stream is running, writes the statistics of
+ * the pipeline to the statusbar, so the user can see if the ring buffer is
+ * getting full, or if the time needed to process a chunk is getting close
+ * to the time needed to acquire it.
+ */
+static gboolean capture_stats_callback(gpointer data)
+{
+	FacqCapture *cap = FACQ_CAPTURE(data);
+	FacqPipelineStats stats;
+
+	if(!facq_stream_get_stats(cap->priv->stream,&stats)){
+		cap->priv->stats_source = 0;
+		return FALSE;
+	}
+	facq_statusbar_write_msg(cap->priv->statusbar,
+		_("In: %.2f MiB/s Out: %.2f MiB/s Ring: %u/%u (max %u) Read: %.3f ms Ops: %.3f ms Write: %.3f ms Latency: %.3f ms"),
+		(stats.elapsed > 0) ? (stats.bytes_in/1048576.0)/stats.elapsed : 0,
+		(stats.elapsed > 0) ? (stats.bytes_out/1048576.0)/stats.elapsed : 0,
+		stats.ring_length,
+		stats.ring_size,
+		stats.ring_high_water,
+		stats.read_time*1000,
+		stats.operation_time*1000,
+		stats.write_time*1000,
+		stats.latency*1000);
+	return TRUE;
+}
+
 static void facq_capture_set_property(GObject *self,guint property_id,const GValue *value,GParamSpec *pspec)
 {
 	FacqCapture *cap = FACQ_CAPTURE(self);
@@ -217,6 +252,9 @@ static void facq_capture_finalize(GObject *self)
 {
 	FacqCapture *cap = FACQ_CAPTURE(self);
 
+	if(cap->priv->stats_source)
+		g_source_remove(cap->priv->stats_source);
+
 	if(FACQ_IS_LOG_WINDOW(cap->priv->log_window)){
 		facq_log_window_free(cap->priv->log_window);
 	}
@@ -271,6 +309,7 @@ static void facq_capture_init(FacqCapture *cap)
 {
 	cap->priv = G_TYPE_INSTANCE_GET_PRIVATE(cap,FACQ_TYPE_CAPTURE,FacqCapturePrivate);
 	cap->priv->ring_chunks = 32;
+	cap->priv->stats_source = 0;
 }
 
 /**
@@ -912,7 +951,8 @@ void facq_capture_control_clear(FacqCapture *cap)
  * After this calls the facq_stream_start()
  * function, if the function is successful the #FacqStreamView status is
  * set to %FACQ_STREAM_VIEW_STATUS_PLAY and the message "Stream started"
- * is pushed to the #FacqStatusbar, if the function fails the Close,Play,
+ * is pushed to the #FacqStatusbar, that will show the statistics of the
+ * stream each second after that, if the function fails the Close,Play,
  * Remove,Clear buttons in the toolbar are enabled and the Stop button
  * is disabled, the #FacqStreamView status is set to
  * %FACQ_STREAM_VIEW_STATUS_ERROR, and the error is pushed to the
@@ -964,6 +1004,8 @@ void facq_capture_control_play(FacqCapture *cap)
 					FACQ_STREAM_VIEW_STATUS_PLAY);
 		facq_statusbar_write_msg(cap->priv->statusbar,"%s",
 					_("Stream started"));
+		cap->priv->stats_source =
+			g_timeout_add_seconds(1,capture_stats_callback,cap);
 	}
 }
 
@@ -993,6 +1035,10 @@ void facq_capture_control_stop(FacqCapture *cap)
 
 	facq_capture_menu_disable_stop(cap->priv->menu);
 	facq_capture_toolbar_disable_stop(cap->priv->toolbar);
+	if(cap->priv->stats_source){
+		g_source_remove(cap->priv->stats_source);
+		cap->priv->stats_source = 0;
+	}
 	facq_statusbar_write_msg(cap->priv->statusbar,"%s",
 				_("Stopping, this can take a while..."));
 
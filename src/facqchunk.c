@@ -23,51 +23,95 @@
 #include <glib.h>
 #include <gio/gio.h>
 #include <string.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include "facqi18n.h"
 #include "gdouble.h"
 #include "facqchunk.h"
 
-#define FACQ_CHUNK_DEF_SIZE 8
-
 /**
  * SECTION:facqchunk
  * @include:facqchunk.h
  * @short_description: a fixed size chunk implementation
- * @see_also: #GInitable
+ * @see_also: #FacqBuffer
  *
  * A #FacqChunk provides a generic chunk that can work with
  * any data type.
  *
- * You can create a new chunk with facq_chunk_new(), you can push
- * data to the chunk with facq_chunk_push(). You can check if the
- * data area of the chunk is full with facq_chunk_is_full().
+ * You can create a new chunk with facq_chunk_new(), you can write
+ * data to the chunk at facq_chunk_write_pos() and tell the chunk about it
+ * with facq_chunk_add_used_bytes(). You can check if the data area of the
+ * chunk is full with facq_chunk_get_free_bytes().
  * To destroy the chunk facq_chunk_free() is provided, if you want
  * to clear the data area instead so you can reuse it you can use
  * facq_chunk_clear().
  *
  * To get the chunk_size after the chunk has been created you 
- * can use facq_chunk_get_chunk_size(), also is posible to obtain
- * the data area size in bytes using facq_chunk_get_data_size().
+ * can use facq_chunk_get_chunk_size().
  *
  * Special functions for printing and converting to big endian the
  * data area are providad in the case you are using gdouble as 
  * data chunks, facq_chunk_data_double_print() prints the 
  * data to stderr and facq_chunk_data_double_to_be() converts the
  * data to big endian.
+ *
+ * When the same #FacqChunk is shared by more than one thread, for example
+ * when a #FacqPipeline writes it to more than one #FacqSink, the number of
+ * users can be set with facq_chunk_set_users(), each user calls
+ * facq_chunk_release() when it has finished with the chunk, and only the
+ * last one, the one receiving %TRUE, can clear or recycle it. Users should
+ * treat the data area of a shared chunk as read only.
+ *
+ * Each chunk also carries a sequence number and a timestamp, set by the
+ * producer of the data with facq_chunk_set_sequence() and
+ * facq_chunk_set_timestamp(). A #FacqPipeline numbers the chunks in the order
+ * they are read from the source, so a jump in the sequence means that some
+ * chunks have been lost, and uses the g_get_monotonic_time() value, in
+ * microseconds, when the chunk was filled as timestamp. Both values are kept
+ * until they are set again, facq_chunk_clear() doesn't change them.
+ *
+ * The #gdouble samples of a chunk are usually interleaved, all the channels
+ * of the first slice, then all the channels of the second one and so on, like
+ * they are read from the source. Operations working on each channel
+ * separately can use the chunk in planar layout instead, all the samples of
+ * the first channel, then all the samples of the second one, see
+ * #FacqChunkLayout. The layout is changed with facq_chunk_set_layout(), that
+ * transposes the samples with facq_chunk_transpose(), and each channel can be
+ * found with facq_chunk_get_plane(). facq_chunk_clear() sets the
+ * interleaved layout again.
+ *
+ * A #FacqChunk is a plain structure, not a #GObject, because thousands of
+ * them can go trough a #FacqPipeline each second. The data area is always
+ * aligned to %FACQ_CHUNK_ALIGNMENT bytes, so it can be used with SIMD
+ * instructions. When many chunks of the same size are needed, like in a
+ * #FacqBuffer, they can be allocated at once with facq_chunk_slab_new(), that
+ * places all the chunks and their data areas in a single contiguous memory
+ * block. The chunks of a #FacqChunkSlab are destroyed with
+ * facq_chunk_slab_free(), facq_chunk_free() does nothing on them.
+ *
+ * For long recordings the slab can be created with locked memory, in this
+ * case the block is mapped directly from the system, backed by transparent
+ * huge pages when available, touched page by page so all the page faults
+ * happen at creation time, and locked in RAM with mlock(), so it's never
+ * swapped out. Each step is optional, if the system doesn't support it or the
+ * user isn't allowed to do it (See the RLIMIT_MEMLOCK limit) the slab works
+ * anyway, facq_chunk_slab_get_flags() tells which steps succeeded.
  */
 
 /**
  * FacqChunk:
  * @data: a pointer to the data area.
- * @len: the number of chunks pushed to the chunk.
+ * @len: the size in bytes of the data area.
  *
  * Contains the public fields of a #FacqChunk.
  */
 
 /**
- * FacqChunkClass:
+ * FacqChunkSlab:
  *
- * Class for the #FacqChunk objects.
+ * A block of memory containing a fixed number of #FacqChunk objects.
  */
 
 /**
@@ -77,134 +121,108 @@
  * Enum values for errors in #FacqChunk.
  */
 
-static void facq_chunk_initable_iface_init(GInitableIface  *iface);
-static gboolean facq_chunk_initable_init(GInitable *initable,GCancellable *cancellable,GError **error);
-
-G_DEFINE_TYPE_WITH_CODE(FacqChunk,facq_chunk,G_TYPE_OBJECT,G_IMPLEMENT_INTERFACE(G_TYPE_INITABLE,facq_chunk_initable_iface_init));
+/**
+ * FacqChunkSlabFlags:
+ * @FACQ_CHUNK_SLAB_MAPPED: The memory has been mapped from the system.
+ * @FACQ_CHUNK_SLAB_HUGE_PAGES: The memory is backed by transparent huge
+ * pages, if the system has any available.
+ * @FACQ_CHUNK_SLAB_PREFAULTED: All the pages have been touched.
+ * @FACQ_CHUNK_SLAB_LOCKED: The memory is locked in RAM.
+ *
+ * Flags describing how the memory of a #FacqChunkSlab was allocated.
+ */
 
-GQuark facq_chunk_error_quark(void)
-{
-        return g_quark_from_static_string("facq-chunk-error-quark");
-}
+/**
+ * FacqChunkLayout:
+ * @FACQ_CHUNK_LAYOUT_INTERLEAVED: The samples are stored slice by slice.
+ * @FACQ_CHUNK_LAYOUT_PLANAR: The samples are stored channel by channel.
+ *
+ * Enum values for the order of the #gdouble samples in a #FacqChunk.
+ */
 
-enum {
-	PROP_0,
-	PROP_CHUNK_SIZE,
-};
+/**
+ * FACQ_CHUNK_ALIGNMENT:
+ *
+ * The alignment, in bytes, of the data area of each #FacqChunk.
+ */
 
-struct _FacqChunkPrivate {
-	GError *construct_error;
-	gsize chunk_size;
-	gsize used_bytes;
+struct _FacqChunkSlab {
+	gpointer mem;
+	gsize size;
+	FacqChunkSlabFlags flags;
+	guint n_chunks;
+	FacqChunk *chunks;
 };
 
-/*****--- GObject magic ---*****/
-static void facq_chunk_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
-{
-	FacqChunk *chunk = FACQ_CHUNK(self);
-
-	switch(property_id){
-	case PROP_CHUNK_SIZE: g_value_set_uint(value,chunk->priv->chunk_size);
-	break;
-	default:
-	G_OBJECT_WARN_INVALID_PROPERTY_ID (chunk, property_id, pspec);
-	}
-}
-
-static void facq_chunk_set_property(GObject *self,guint property_id,const GValue *value,GParamSpec *pspec)
-{
-	FacqChunk *chunk = FACQ_CHUNK(self);
-
-	switch(property_id){
-	case PROP_CHUNK_SIZE: chunk->priv->chunk_size = g_value_get_uint(value);
-	break;
-	default:
-	G_OBJECT_WARN_INVALID_PROPERTY_ID (chunk, property_id, pspec);
-	}
-}
-
-static void facq_chunk_finalize(GObject *self)
-{
-	FacqChunk *chunk = FACQ_CHUNK(self);
-
-	if(chunk->data)
-		g_free(chunk->data);
-
-	if(G_OBJECT_CLASS(facq_chunk_parent_class)->finalize)
-    		(*G_OBJECT_CLASS(facq_chunk_parent_class)->finalize)(self);
-}
-
-static void facq_chunk_constructed(GObject *self)
+GQuark facq_chunk_error_quark(void)
 {
-	FacqChunk *chunk = FACQ_CHUNK(self);
-
-	g_clear_error(&chunk->priv->construct_error);
-
-	if(!chunk->data)
-		chunk->data = g_try_malloc0(chunk->priv->chunk_size);
-	if(!chunk->data)
-		g_set_error_literal(&chunk->priv->construct_error,
-			FACQ_CHUNK_ERROR,FACQ_CHUNK_ERROR_FAILED,
-			_("Can't allocate the memory area"));
-	chunk->len = chunk->priv->chunk_size;
-	chunk->priv->used_bytes = 0;
+        return g_quark_from_static_string("facq-chunk-error-quark");
 }
 
-static void facq_chunk_class_init(FacqChunkClass *klass)
-{
-	GObjectClass *object_class = G_OBJECT_CLASS(klass);
-
-	g_type_class_add_private(klass,sizeof(FacqChunkPrivate));
-
-	object_class->set_property = facq_chunk_set_property;
-	object_class->get_property = facq_chunk_get_property;
-	object_class->finalize = facq_chunk_finalize;
-	object_class->constructed = facq_chunk_constructed;
-
-	g_object_class_install_property(object_class,PROP_CHUNK_SIZE,
-					g_param_spec_uint("chunk-size",
-							"Chunk size",
-							"The size of a chunk",
-							1,
-							G_MAXUINT,
-							FACQ_CHUNK_DEF_SIZE,
-							G_PARAM_READWRITE |
-							G_PARAM_CONSTRUCT_ONLY |
-							G_PARAM_STATIC_STRINGS));
-}
+/* number of rows and columns of the tiles copied by facq_chunk_transpose(),
+ * a tile of the source and one of the destination fit in the L1 cache */
+#define FACQ_CHUNK_TRANSPOSE_TILE 32
 
-static void facq_chunk_init(FacqChunk *chunk)
+/* Private methods */
+static gsize facq_chunk_align(gsize size)
 {
-	chunk->priv = G_TYPE_INSTANCE_GET_PRIVATE(chunk,FACQ_TYPE_CHUNK,FacqChunkPrivate);
-	chunk->priv->construct_error = NULL;
-	chunk->data = NULL;
-	chunk->priv->chunk_size = 0;
-	chunk->len = 0;
+	return (size + FACQ_CHUNK_ALIGNMENT - 1) & ~((gsize)FACQ_CHUNK_ALIGNMENT - 1);
 }
 
-/*****--- GInitable interface ---*****/
-static void facq_chunk_initable_iface_init(GInitableIface *iface)
+/*
+ * facq_chunk_slab_alloc_locked:
+ *
+ * Maps the memory of the slab, asking for huge pages, prefaults it and locks
+ * it. Only the mapping is mandatory, returns %FALSE if it fails.
+ */
+static gboolean facq_chunk_slab_alloc_locked(FacqChunkSlab *slab)
 {
-	iface->init = facq_chunk_initable_init;
+#if HAVE_SYS_MMAN_H
+	volatile gchar *mem = NULL;
+	glong page_size = 0;
+	gsize i = 0;
+
+#ifdef MAP_ANONYMOUS
+	slab->mem = mmap(NULL,slab->size,PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS,-1,0);
+#else
+	slab->mem = mmap(NULL,slab->size,PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANON,-1,0);
+#endif
+	if(slab->mem == MAP_FAILED){
+		slab->mem = NULL;
+		return FALSE;
+	}
+	slab->flags |= FACQ_CHUNK_SLAB_MAPPED;
+#ifdef MADV_HUGEPAGE
+	if(madvise(slab->mem,slab->size,MADV_HUGEPAGE) == 0)
+		slab->flags |= FACQ_CHUNK_SLAB_HUGE_PAGES;
+#endif
+	page_size = sysconf(_SC_PAGESIZE);
+	if(page_size <= 0)
+		page_size = 4096;
+	mem = slab->mem;
+	for(i = 0;i < slab->size;i += page_size)
+		mem[i] = 0;
+	slab->flags |= FACQ_CHUNK_SLAB_PREFAULTED;
+	if(mlock(slab->mem,slab->size) == 0)
+		slab->flags |= FACQ_CHUNK_SLAB_LOCKED;
+	return TRUE;
+#else
+	return FALSE;
+#endif
 }
 
-static gboolean facq_chunk_initable_init(GInitable *initable,GCancellable *cancellable,GError  **error)
+static void facq_chunk_init(FacqChunk *chunk,gchar *data,gsize chunk_size,gpointer mem)
 {
-	FacqChunk *chunk;
-	
-	g_return_val_if_fail(FACQ_IS_CHUNK(initable),FALSE);
-	chunk = FACQ_CHUNK(initable);
-	if(cancellable != NULL){
-		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
-                           "Cancellable initialization not supported");
-      		return FALSE;
-    	}
-	if(chunk->priv->construct_error){
-      		if(error)
-        		*error = g_error_copy(chunk->priv->construct_error);
-      		return FALSE;
-    	}
-  	return TRUE;
+	chunk->data = data;
+	chunk->len = chunk_size;
+	chunk->used_bytes = 0;
+	chunk->users = 0;
+	chunk->sequence = 0;
+	chunk->timestamp = 0;
+	chunk->layout = FACQ_CHUNK_LAYOUT_INTERLEAVED;
+	chunk->mem = mem;
 }
 
 /* Public methods */
@@ -220,33 +238,43 @@ static gboolean facq_chunk_initable_init(GInitable *initable,GCancellable *cance
  */
 FacqChunk *facq_chunk_new(gsize chunk_size,GError **err)
 {
-	FacqChunk *chunk = FACQ_CHUNK(
-			 g_initable_new(FACQ_TYPE_CHUNK,
-				       	NULL,err,
-				       "chunk-size",chunk_size,
-					NULL)
-			 ); 
+	FacqChunk *chunk = NULL;
+	gpointer mem = NULL;
+	gsize offset = 0;
+
+	g_return_val_if_fail(chunk_size > 0,NULL);
+
+	/* the descriptor goes first, followed by the aligned data area */
+	offset = facq_chunk_align(sizeof(FacqChunk));
+	mem = g_try_malloc0(offset + chunk_size + FACQ_CHUNK_ALIGNMENT);
+	if(!mem){
+		g_set_error_literal(err,FACQ_CHUNK_ERROR,FACQ_CHUNK_ERROR_FAILED,
+				_("Can't allocate the memory area"));
+		return NULL;
+	}
+	chunk = (FacqChunk *)facq_chunk_align((gsize)mem);
+	facq_chunk_init(chunk,(gchar *)chunk + offset,chunk_size,mem);
 	return chunk;
 }
 
 void facq_chunk_add_used_bytes(FacqChunk *chunk,gsize used_bytes)
 {
-	chunk->priv->used_bytes += used_bytes;
+	chunk->used_bytes += used_bytes;
 }
 
 gsize facq_chunk_get_free_bytes(const FacqChunk *chunk)
 {
-	return chunk->priv->chunk_size-chunk->priv->used_bytes;
+	return chunk->len-chunk->used_bytes;
 }
 
 gsize facq_chunk_get_total_slices(const FacqChunk *chunk,gsize bps,guint n_channels)
 {
-	return chunk->priv->used_bytes/(bps*n_channels);
+	return chunk->used_bytes/(bps*n_channels);
 }
 
 inline gpointer facq_chunk_get_n_slice(const FacqChunk *chunk,gsize bps,guint n_channels,guint n)
 {
-	if( (n*bps*n_channels) < chunk->priv->used_bytes){
+	if( (n*bps*n_channels) < chunk->used_bytes){
 		return &chunk->data[n*bps*n_channels];
 	}
 	else return NULL;
@@ -254,7 +282,53 @@ inline gpointer facq_chunk_get_n_slice(const FacqChunk *chunk,gsize bps,guint n_
 
 gsize facq_chunk_get_used_bytes(const FacqChunk *chunk)
 {
-	return chunk->priv->used_bytes;
+	return chunk->used_bytes;
+}
+
+/**
+ * facq_chunk_set_sequence:
+ * @chunk: A #FacqChunk object.
+ * @sequence: The position of the chunk in the stream.
+ *
+ * Sets the sequence number of the chunk, see the description above.
+ */
+void facq_chunk_set_sequence(FacqChunk *chunk,guint64 sequence)
+{
+	chunk->sequence = sequence;
+}
+
+/**
+ * facq_chunk_get_sequence:
+ * @chunk: A #FacqChunk object.
+ *
+ * Returns: The sequence number of the chunk.
+ */
+guint64 facq_chunk_get_sequence(const FacqChunk *chunk)
+{
+	return chunk->sequence;
+}
+
+/**
+ * facq_chunk_set_timestamp:
+ * @chunk: A #FacqChunk object.
+ * @timestamp: The acquisition time of the data, in microseconds.
+ *
+ * Sets the timestamp of the chunk, see the description above.
+ */
+void facq_chunk_set_timestamp(FacqChunk *chunk,gint64 timestamp)
+{
+	chunk->timestamp = timestamp;
+}
+
+/**
+ * facq_chunk_get_timestamp:
+ * @chunk: A #FacqChunk object.
+ *
+ * Returns: The timestamp of the chunk, in microseconds.
+ */
+gint64 facq_chunk_get_timestamp(const FacqChunk *chunk)
+{
+	return chunk->timestamp;
 }
 
 /**
@@ -265,10 +339,7 @@ gsize facq_chunk_get_used_bytes(const FacqChunk *chunk)
  */
 gchar *facq_chunk_write_pos(const FacqChunk *chunk)
 {
-#if ENABLE_DEBUG
-	g_return_val_if_fail(FACQ_IS_CHUNK(chunk),NULL);
-#endif
-	return &chunk->data[chunk->priv->used_bytes];
+	return &chunk->data[chunk->used_bytes];
 }
 
 /**
@@ -281,7 +352,7 @@ gchar *facq_chunk_write_pos(const FacqChunk *chunk)
  */
 gsize facq_chunk_get_chunk_size(const FacqChunk *chunk)
 {
-	return chunk->priv->chunk_size;
+	return chunk->len;
 }
 
 /**
@@ -293,17 +364,12 @@ gsize facq_chunk_get_chunk_size(const FacqChunk *chunk)
  */
 void facq_chunk_data_double_to_be(FacqChunk *chunk)
 {
-	gdouble *data = NULL;
-	guint i = 0;
-
 #if ENABLE_DEBUG
-	g_return_if_fail(FACQ_IS_CHUNK(chunk));
+	g_return_if_fail(chunk != NULL);
 #endif
 
-	data = (gdouble *)chunk->data;
-	for(i = 0;i < (chunk->priv->used_bytes/sizeof(gdouble));i++)
-		data[i] = GDOUBLE_TO_BE(data[i]);
-	return;
+	gdouble_array_to_be((gdouble *)chunk->data,
+			    chunk->used_bytes/sizeof(gdouble));
 }
 
 void facq_chunk_data_double_print(FacqChunk *chunk)
@@ -312,12 +378,12 @@ void facq_chunk_data_double_print(FacqChunk *chunk)
 	gdouble *data = NULL;
 
 #if ENABLE_DEBUG
-	g_return_if_fail(FACQ_IS_CHUNK(chunk));
+	g_return_if_fail(chunk != NULL);
 #endif
 
 	data = (gdouble *)chunk->data;
 	g_print("\n");
-	for(i = 0;i < (chunk->priv->used_bytes/sizeof(gdouble));i++)
+	for(i = 0;i < (chunk->used_bytes/sizeof(gdouble));i++)
 		g_print("%.9g ",data[i]);
 	g_print("%u samples printed\n",i);
 	g_print("\n");
@@ -325,20 +391,260 @@ void facq_chunk_data_double_print(FacqChunk *chunk)
 
 void facq_chunk_clear(FacqChunk *chunk)
 {
-#if ENABLE_DEBUG
-	g_return_if_fail(FACQ_IS_CHUNK(chunk));
-#endif
-	chunk->priv->used_bytes = 0;
+	chunk->used_bytes = 0;
+	chunk->layout = FACQ_CHUNK_LAYOUT_INTERLEAVED;
+}
+
+/**
+ * facq_chunk_get_layout:
+ * @chunk: A #FacqChunk object.
+ *
+ * Returns: The #FacqChunkLayout of the samples in the @chunk.
+ */
+FacqChunkLayout facq_chunk_get_layout(const FacqChunk *chunk)
+{
+	return chunk->layout;
+}
+
+/**
+ * facq_chunk_set_layout:
+ * @chunk: A #FacqChunk object, containing #gdouble samples.
+ * @layout: The new #FacqChunkLayout.
+ * @n_channels: The number of channels of the stream.
+ * @scratch: (allow-none): A #FacqChunk with room for the used bytes of
+ * @chunk, or %NULL.
+ *
+ * Changes the layout of the samples in the @chunk, transposing them trough
+ * the @scratch chunk if the layout is different. If @scratch is %NULL the
+ * samples aren't moved, only the layout is set, this is useful when the
+ * @chunk has just been filled in the new @layout.
+ */
+void facq_chunk_set_layout(FacqChunk *chunk,FacqChunkLayout layout,guint n_channels,FacqChunk *scratch)
+{
+	gsize slices = 0;
+
+	g_return_if_fail(n_channels > 0);
+
+	if(chunk->layout == layout)
+		return;
+	if(scratch && n_channels > 1){
+		g_return_if_fail(scratch->len >= chunk->used_bytes);
+		slices = chunk->used_bytes/(sizeof(gdouble)*n_channels);
+		if(layout == FACQ_CHUNK_LAYOUT_PLANAR)
+			facq_chunk_transpose((gdouble *)chunk->data,
+					     (gdouble *)scratch->data,
+					     slices,n_channels);
+		else
+			facq_chunk_transpose((gdouble *)chunk->data,
+					     (gdouble *)scratch->data,
+					     n_channels,slices);
+		memcpy(chunk->data,scratch->data,chunk->used_bytes);
+	}
+	chunk->layout = layout;
+}
+
+/**
+ * facq_chunk_get_plane:
+ * @chunk: A #FacqChunk object in planar layout.
+ * @n_channels: The number of channels of the stream.
+ * @chan: The channel index, starting at 0.
+ *
+ * Returns: A pointer to the first #gdouble sample of the channel @chan, the
+ * rest of samples of the channel follow it. The number of samples is
+ * facq_chunk_get_total_slices().
+ */
+gdouble *facq_chunk_get_plane(const FacqChunk *chunk,guint n_channels,guint chan)
+{
+	gsize slices = 0;
+
+	g_return_val_if_fail(chunk->layout == FACQ_CHUNK_LAYOUT_PLANAR,NULL);
+	g_return_val_if_fail(chan < n_channels,NULL);
+
+	slices = chunk->used_bytes/(sizeof(gdouble)*n_channels);
+	return (gdouble *)chunk->data + chan*slices;
+}
+
+/**
+ * facq_chunk_transpose:
+ * @src: A matrix of #gdouble, stored row by row.
+ * @dst: Room for the transposed matrix, it can't overlap @src.
+ * @rows: The number of rows of @src.
+ * @cols: The number of columns of @src.
+ *
+ * Transposes the @rows x @cols matrix @src to @dst, so @dst has @cols rows
+ * of @rows values. An interleaved chunk is a matrix with a row per slice, and
+ * a planar one a matrix with a row per channel. The matrix is copied in
+ * small tiles, so both the reads and the writes stay in the cache.
+ */
+void facq_chunk_transpose(const gdouble *src,gdouble *dst,gsize rows,gsize cols)
+{
+	gsize i = 0, j = 0, ti = 0, tj = 0, i_end = 0, j_end = 0;
+
+	if(rows == 1 || cols == 1){
+		memcpy(dst,src,rows*cols*sizeof(gdouble));
+		return;
+	}
+	for(ti = 0;ti < rows;ti += FACQ_CHUNK_TRANSPOSE_TILE){
+		i_end = MIN(ti + FACQ_CHUNK_TRANSPOSE_TILE,rows);
+		for(tj = 0;tj < cols;tj += FACQ_CHUNK_TRANSPOSE_TILE){
+			j_end = MIN(tj + FACQ_CHUNK_TRANSPOSE_TILE,cols);
+			for(i = ti;i < i_end;i++)
+				for(j = tj;j < j_end;j++)
+					dst[j*rows+i] = src[i*cols+j];
+		}
+	}
+}
+
+/**
+ * facq_chunk_set_users:
+ * @chunk: A #FacqChunk object.
+ * @users: The number of threads that are going to use the chunk.
+ *
+ * Sets the number of users of the @chunk, it must be called before sharing
+ * the @chunk with the other threads.
+ */
+void facq_chunk_set_users(FacqChunk *chunk,guint users)
+{
+	g_atomic_int_set(&chunk->users,users);
+}
+
+/**
+ * facq_chunk_release:
+ * @chunk: A #FacqChunk object.
+ *
+ * Decreases the number of users of the @chunk, see facq_chunk_set_users().
+ * This function is thread safe.
+ *
+ * Returns: %TRUE if the caller was the last user of the @chunk, %FALSE in
+ * other case.
+ */
+gboolean facq_chunk_release(FacqChunk *chunk)
+{
+	return g_atomic_int_dec_and_test(&chunk->users);
 }
 
 /**
  * facq_chunk_free:
  * @chunk: A #FacqChunk object.
  *
- * Destroys the #FacqChunk, @chunk. 
+ * Destroys the #FacqChunk, @chunk. If the chunk belongs to a #FacqChunkSlab
+ * nothing is done, the chunk will be destroyed with the slab.
  */
 void facq_chunk_free(FacqChunk *chunk)
 {
-	g_return_if_fail(FACQ_IS_CHUNK(chunk));
-	g_object_unref(G_OBJECT(chunk));
+	g_return_if_fail(chunk != NULL);
+
+	if(chunk->mem)
+		g_free(chunk->mem);
+}
+
+/**
+ * facq_chunk_slab_new:
+ * @n_chunks: The number of chunks.
+ * @chunk_size: The size of each chunk.
+ * @locked: %TRUE to try to use locked memory, see the description above.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Allocates @n_chunks chunks of @chunk_size bytes in a single memory block.
+ * The chunks are placed first, followed by the data areas, each one aligned
+ * to %FACQ_CHUNK_ALIGNMENT bytes. Use facq_chunk_slab_get_chunk() to get
+ * each chunk. The data areas aren't zeroed.
+ *
+ * Returns: A new #FacqChunkSlab or %NULL on error.
+ */
+FacqChunkSlab *facq_chunk_slab_new(guint n_chunks,gsize chunk_size,gboolean locked,GError **err)
+{
+	FacqChunkSlab *slab = NULL;
+	gsize offset = 0, stride = 0;
+	gchar *start = NULL;
+	guint i = 0;
+
+	g_return_val_if_fail(n_chunks > 0 && chunk_size > 0,NULL);
+
+	offset = facq_chunk_align(n_chunks*sizeof(FacqChunk));
+	stride = facq_chunk_align(chunk_size);
+	if(stride > (G_MAXSIZE - offset - FACQ_CHUNK_ALIGNMENT)/n_chunks){
+		g_set_error_literal(err,FACQ_CHUNK_ERROR,FACQ_CHUNK_ERROR_FAILED,
+				_("Can't allocate the memory area"));
+		return NULL;
+	}
+
+	slab = g_new0(FacqChunkSlab,1);
+	slab->size = offset + n_chunks*stride + FACQ_CHUNK_ALIGNMENT;
+	if(!locked || !facq_chunk_slab_alloc_locked(slab))
+		slab->mem = g_try_malloc(slab->size);
+	if(!slab->mem){
+		g_free(slab);
+		g_set_error_literal(err,FACQ_CHUNK_ERROR,FACQ_CHUNK_ERROR_FAILED,
+				_("Can't allocate the memory area"));
+		return NULL;
+	}
+	slab->n_chunks = n_chunks;
+	start = (gchar *)facq_chunk_align((gsize)slab->mem);
+	slab->chunks = (FacqChunk *)start;
+	for(i = 0;i < n_chunks;i++)
+		facq_chunk_init(&slab->chunks[i],start + offset + i*stride,chunk_size,NULL);
+
+	return slab;
+}
+
+/**
+ * facq_chunk_slab_get_n_chunks:
+ * @slab: A #FacqChunkSlab.
+ *
+ * Returns: The number of chunks in the @slab.
+ */
+guint facq_chunk_slab_get_n_chunks(const FacqChunkSlab *slab)
+{
+	g_return_val_if_fail(slab != NULL,0);
+	return slab->n_chunks;
+}
+
+/**
+ * facq_chunk_slab_get_flags:
+ * @slab: A #FacqChunkSlab.
+ *
+ * Returns: The #FacqChunkSlabFlags describing the memory of the @slab, 0 if
+ * it was allocated with g_malloc().
+ */
+FacqChunkSlabFlags facq_chunk_slab_get_flags(const FacqChunkSlab *slab)
+{
+	g_return_val_if_fail(slab != NULL,0);
+	return slab->flags;
+}
+
+/**
+ * facq_chunk_slab_get_chunk:
+ * @slab: A #FacqChunkSlab.
+ * @n: The index of the chunk, less than facq_chunk_slab_get_n_chunks().
+ *
+ * Returns: The @n chunk of the @slab, don't call facq_chunk_free() on it.
+ */
+FacqChunk *facq_chunk_slab_get_chunk(FacqChunkSlab *slab,guint n)
+{
+	g_return_val_if_fail(slab != NULL && n < slab->n_chunks,NULL);
+	return &slab->chunks[n];
+}
+
+/**
+ * facq_chunk_slab_free:
+ * @slab: A #FacqChunkSlab.
+ *
+ * Destroys the @slab and all its chunks, no other thread should be using
+ * them.
+ */
+void facq_chunk_slab_free(FacqChunkSlab *slab)
+{
+	g_return_if_fail(slab != NULL);
+
+#if HAVE_SYS_MMAN_H
+	if(slab->flags & FACQ_CHUNK_SLAB_MAPPED){
+		if(slab->flags & FACQ_CHUNK_SLAB_LOCKED)
+			munlock(slab->mem,slab->size);
+		munmap(slab->mem,slab->size);
+	}
+	else
+#endif
+		g_free(slab->mem);
+	g_free(slab);
 }
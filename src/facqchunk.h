@@ -24,37 +24,40 @@ G_BEGIN_DECLS
 
 #define FACQ_CHUNK_ERROR facq_chunk_error_quark()
 
-#define FACQ_TYPE_CHUNK (facq_chunk_get_type ())
-#define FACQ_CHUNK(inst) (G_TYPE_CHECK_INSTANCE_CAST ((inst),FACQ_TYPE_CHUNK, FacqChunk))
-#define FACQ_CHUNK_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass),FACQ_TYPE_CHUNK, FacqChunkClass))
-#define FACQ_IS_CHUNK(inst) (G_TYPE_CHECK_INSTANCE_TYPE ((inst),FACQ_TYPE_CHUNK))
-#define FACQ_IS_CHUNK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_CHUNK))
-#define FACQ_CHUNK_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_CHUNK, FacqChunkClass))
+#define FACQ_CHUNK_ALIGNMENT 64
 
 typedef struct _FacqChunk FacqChunk;
-typedef struct _FacqChunkClass FacqChunkClass;
-typedef struct _FacqChunkPrivate FacqChunkPrivate;
+typedef struct _FacqChunkSlab FacqChunkSlab;
 
 typedef enum {
 	FACQ_CHUNK_ERROR_FAILED
 } FacqChunkError;
 
+typedef enum {
+	FACQ_CHUNK_SLAB_MAPPED = 1 << 0,
+	FACQ_CHUNK_SLAB_HUGE_PAGES = 1 << 1,
+	FACQ_CHUNK_SLAB_PREFAULTED = 1 << 2,
+	FACQ_CHUNK_SLAB_LOCKED = 1 << 3
+} FacqChunkSlabFlags;
+
+typedef enum {
+	FACQ_CHUNK_LAYOUT_INTERLEAVED,
+	FACQ_CHUNK_LAYOUT_PLANAR
+} FacqChunkLayout;
+
 struct _FacqChunk {
-	/*< private >*/
-	GObject parent_instance;
-	FacqChunkPrivate *priv;
 	/*< public >*/
 	gchar *data;
 	gsize len;
-};
-
-struct _FacqChunkClass {
 	/*< private >*/
-	GObjectClass parent_class;
+	gsize used_bytes;
+	volatile gint users;
+	guint64 sequence;
+	gint64 timestamp;
+	FacqChunkLayout layout;
+	gpointer mem;
 };
 
-GType facq_chunk_get_type(void) G_GNUC_CONST;
-
 FacqChunk *facq_chunk_new(gsize chunk_size,GError **err);
 gsize facq_chunk_get_used_bytes(const FacqChunk *chunk);
 gchar *facq_chunk_write_pos(const FacqChunk *chunk);
@@ -63,12 +66,27 @@ gpointer facq_chunk_get_n_slice(const FacqChunk *chunk,gsize bps,guint n_channel
 void facq_chunk_add_used_bytes(FacqChunk *chunk,gsize used_bytes);
 gsize facq_chunk_get_free_bytes(const FacqChunk *chunk);
 gsize facq_chunk_get_chunk_size(const FacqChunk *chunk);
+void facq_chunk_set_sequence(FacqChunk *chunk,guint64 sequence);
+guint64 facq_chunk_get_sequence(const FacqChunk *chunk);
+void facq_chunk_set_timestamp(FacqChunk *chunk,gint64 timestamp);
+gint64 facq_chunk_get_timestamp(const FacqChunk *chunk);
 void facq_chunk_data_double_to_be(FacqChunk *chunk);
 void facq_chunk_data_double_print(FacqChunk *chunk);
 void facq_chunk_clear(FacqChunk *chunk);
+FacqChunkLayout facq_chunk_get_layout(const FacqChunk *chunk);
+void facq_chunk_set_layout(FacqChunk *chunk,FacqChunkLayout layout,guint n_channels,FacqChunk *scratch);
+gdouble *facq_chunk_get_plane(const FacqChunk *chunk,guint n_channels,guint chan);
+void facq_chunk_transpose(const gdouble *src,gdouble *dst,gsize rows,gsize cols);
+void facq_chunk_set_users(FacqChunk *chunk,guint users);
+gboolean facq_chunk_release(FacqChunk *chunk);
 void facq_chunk_free(FacqChunk *chunk);
 
+FacqChunkSlab *facq_chunk_slab_new(guint n_chunks,gsize chunk_size,gboolean locked,GError **err);
+guint facq_chunk_slab_get_n_chunks(const FacqChunkSlab *slab);
+FacqChunkSlabFlags facq_chunk_slab_get_flags(const FacqChunkSlab *slab);
+FacqChunk *facq_chunk_slab_get_chunk(FacqChunkSlab *slab,guint n);
+void facq_chunk_slab_free(FacqChunkSlab *slab);
+
 G_END_DECLS
 
 #endif
-
@@ -0,0 +1,252 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#include <glib.h>
+#include <gio/gio.h>
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include "facqunits.h"
+#include "facqchanlist.h"
+#include "facqcomedimisc.h"
+
+/* Checks the kernels of FacqComediMiscConv against comedi_to_physical() and
+ * comedi_to_phys() with synthetic raw buffers, and measures the time taken by
+ * both. An optional argument sets the number of slices used in the timing
+ * loop. */
+
+#define N_CHANNELS 3
+#define N_SLICES 4096
+#define BENCH_SLICES 1000000
+#define BENCH_ROUNDS 10
+#define MAX_REL_ERROR 1e-12
+
+typedef struct _ConvCase {
+	const gchar *name;
+	guint bps;
+	lsampl_t maxdata[N_CHANNELS];
+	gboolean poly;
+} ConvCase;
+
+/* The first two cases fit in 16 bits, so they use the tables, in the other two
+ * a channel is wider than 16 bits, so they use the polynomials, even for
+ * sampl_t samples. */
+static const ConvCase cases[] = {
+	{ "lut sampl_t", sizeof(sampl_t), { 4095, 65535, 4095 }, FALSE },
+	{ "lut lsampl_t", sizeof(lsampl_t), { 65535, 255, 65535 }, FALSE },
+	{ "poly sampl_t", sizeof(sampl_t), { 65535, 0x3FFFF, 4095 }, TRUE },
+	{ "poly lsampl_t", sizeof(lsampl_t), { 0xFFFFFF, 0x3FFFF, 0xFFFFFF }, TRUE },
+};
+
+static void fill_polynomials(comedi_polynomial_t *p,const lsampl_t *maxdata)
+{
+	guint i = 0, k = 0;
+
+	/* a different order for each channel, like the calibration of a
+	 * real device, with the expansion origin in the middle of the range */
+	for(i = 0;i < N_CHANNELS;i++){
+		p[i].order = i+1;
+		p[i].expansion_origin = maxdata[i]/2.0;
+		p[i].coefficients[0] = 0.01*i - 0.005;
+		p[i].coefficients[1] = 20.0/maxdata[i];
+		for(k = 2;k <= p[i].order;k++)
+			p[i].coefficients[k] = 1e-3*pow(1.0/maxdata[i],k);
+	}
+}
+
+static void fill_ranges(comedi_range *rng)
+{
+	guint i = 0;
+
+	for(i = 0;i < N_CHANNELS;i++){
+		rng[i].min = -10.0/(i+1);
+		rng[i].max = 10.0/(i+1);
+		rng[i].unit = UNIT_volt;
+	}
+}
+
+/* Raw samples in [0,maxdata], the first slices get 0 and maxdata so the
+ * limits are always checked */
+static gpointer raw_new(const ConvCase *c,GRand *rand,gsize n_slices)
+{
+	gpointer raw = NULL;
+	lsampl_t v = 0;
+	gsize j = 0;
+	guint i = 0;
+
+	raw = g_malloc0(n_slices*N_CHANNELS*c->bps);
+	for(j = 0;j < n_slices;j++){
+		for(i = 0;i < N_CHANNELS;i++){
+			if(j == 0)
+				v = 0;
+			else if(j == 1)
+				v = c->maxdata[i];
+			else
+				v = g_rand_int_range(rand,0,MIN(c->maxdata[i],0xFFFFFF)+1);
+			if(c->bps == sizeof(sampl_t))
+				((sampl_t *)raw)[j*N_CHANNELS+i] = MIN(v,0xFFFF);
+			else
+				((lsampl_t *)raw)[j*N_CHANNELS+i] = v;
+		}
+	}
+	return raw;
+}
+
+static lsampl_t raw_get(const ConvCase *c,gconstpointer raw,gsize n)
+{
+	if(c->bps == sizeof(sampl_t))
+		return ((const sampl_t *)raw)[n];
+	return ((const lsampl_t *)raw)[n];
+}
+
+/* Converts the samples one by one, like the source did before
+ * FacqComediMiscConv */
+static void reference_do(const ConvCase *c,const comedi_polynomial_t *p,comedi_range *rng,gconstpointer raw,gdouble *dst,gsize samples)
+{
+	gsize j = 0;
+	guint i = 0;
+
+	for(j = 0;j < samples;j++){
+		i = j % N_CHANNELS;
+		if(p)
+			dst[j] = comedi_to_physical(raw_get(c,raw,j),&p[i]);
+		else
+			dst[j] = comedi_to_phys(raw_get(c,raw,j),&rng[i],c->maxdata[i]);
+	}
+}
+
+static gboolean check_case(const ConvCase *c,GRand *rand,gboolean with_poly)
+{
+	comedi_polynomial_t p[N_CHANNELS];
+	comedi_range rng[N_CHANNELS];
+	FacqComediMiscConv *conv = NULL;
+	gpointer raw = NULL;
+	gdouble *ref = NULL, *dst = NULL, err = 0, max_err = 0;
+	gsize j = 0, samples = N_SLICES*N_CHANNELS, bad = 0;
+
+	memset(p,0,sizeof(p));
+	fill_polynomials(p,c->maxdata);
+	fill_ranges(rng);
+
+	raw = raw_new(c,rand,N_SLICES);
+	ref = g_new0(gdouble,samples);
+	dst = g_new0(gdouble,samples);
+	conv = facq_comedi_misc_conv_new(N_CHANNELS,c->bps,c->maxdata,
+						(with_poly) ? p : NULL,rng);
+
+	reference_do(c,(with_poly) ? p : NULL,rng,raw,ref,samples);
+	facq_comedi_misc_conv_do(conv,raw,dst,samples);
+
+	/* the tables are filled by comedi, so they must be exact, the
+	 * polynomials are evaluated in a different order */
+	for(j = 0;j < samples;j++){
+		err = fabs(dst[j] - ref[j]);
+		if(c->poly)
+			err /= MAX(fabs(ref[j]),1.0);
+		max_err = MAX(max_err,err);
+		if((c->poly && err > MAX_REL_ERROR) || (!c->poly && err != 0)){
+			if(!bad)
+				g_print("  sample %"G_GSIZE_FORMAT" raw %u: got %.17g expected %.17g\n",
+						j,raw_get(c,raw,j),dst[j],ref[j]);
+			bad++;
+		}
+	}
+	g_print("%-14s %-13s max error %g, %s\n",
+			c->name,(with_poly) ? "polynomial" : "range",
+				max_err,(bad) ? "FAILED" : "ok");
+
+	facq_comedi_misc_conv_free(conv);
+	g_free(dst);
+	g_free(ref);
+	g_free(raw);
+	return (bad == 0);
+}
+
+static void bench_case(const ConvCase *c,GRand *rand,gsize n_slices)
+{
+	comedi_polynomial_t p[N_CHANNELS];
+	comedi_range rng[N_CHANNELS];
+	FacqComediMiscConv *conv = NULL;
+	gpointer raw = NULL;
+	gdouble *dst = NULL, t_conv = 0, t_ref = 0;
+	gsize samples = n_slices*N_CHANNELS;
+	GTimer *timer = NULL;
+	guint r = 0;
+
+	memset(p,0,sizeof(p));
+	fill_polynomials(p,c->maxdata);
+	fill_ranges(rng);
+
+	raw = raw_new(c,rand,n_slices);
+	dst = g_new0(gdouble,samples);
+	conv = facq_comedi_misc_conv_new(N_CHANNELS,c->bps,c->maxdata,p,rng);
+	timer = g_timer_new();
+
+	g_timer_start(timer);
+	for(r = 0;r < BENCH_ROUNDS;r++)
+		facq_comedi_misc_conv_do(conv,raw,dst,samples);
+	t_conv = g_timer_elapsed(timer,NULL);
+
+	g_timer_start(timer);
+	for(r = 0;r < BENCH_ROUNDS;r++)
+		reference_do(c,p,rng,raw,dst,samples);
+	t_ref = g_timer_elapsed(timer,NULL);
+
+	g_print("%-14s conv %8.2f Msamples/s, comedi %8.2f Msamples/s, x%.1f\n",
+			c->name,
+			samples*BENCH_ROUNDS/t_conv/1e6,
+			samples*BENCH_ROUNDS/t_ref/1e6,
+			t_ref/t_conv);
+
+	g_timer_destroy(timer);
+	facq_comedi_misc_conv_free(conv);
+	g_free(dst);
+	g_free(raw);
+}
+
+int main(int argc,char **argv)
+{
+	GRand *rand = NULL;
+	gsize bench_slices = BENCH_SLICES;
+	gboolean ok = TRUE;
+	guint i = 0;
+
+	if(argc > 1)
+		bench_slices = MAX(1,g_ascii_strtoull(argv[1],NULL,10));
+
+	/* the same behavior used by the comedi sources */
+	comedi_set_global_oor_behavior(COMEDI_OOR_NUMBER);
+	rand = g_rand_new_with_seed(0xFACC);
+
+	g_print("Checking the conversion kernels\n");
+	for(i = 0;i < G_N_ELEMENTS(cases);i++){
+		ok = check_case(&cases[i],rand,TRUE) && ok;
+		ok = check_case(&cases[i],rand,FALSE) && ok;
+	}
+
+	g_print("Timing %"G_GSIZE_FORMAT" slices of %u channels, %u rounds\n",
+			bench_slices,N_CHANNELS,BENCH_ROUNDS);
+	for(i = 0;i < G_N_ELEMENTS(cases);i++)
+		bench_case(&cases[i],rand,bench_slices);
+
+	g_rand_free(rand);
+	return (ok) ? 0 : 1;
+}
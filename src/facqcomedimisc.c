@@ -23,6 +23,7 @@
 #if USE_COMEDI
 #include <glib.h>
 #include <gio/gio.h>
+#include <string.h>
 #include "facqunits.h"
 #include "facqchanlist.h"
 #include "facqcomedimisc.h"
@@ -38,6 +39,24 @@
  * Much of the functionality provided by this module could be providad
  * by the comedi library, so maybe we can evaluate if we can put some
  * of this functions in the comedi library source later.
+ *
+ * A #FacqComediMiscConv converts the raw samples of a subdevice to real
+ * values, giving the same results than comedi_to_physical() or
+ * comedi_to_phys() without calling them for each sample. When the maxdata of
+ * all the channels fits in 16 bits, each channel gets a table with the real
+ * value of each raw value, shared by the channels with the same conversion.
+ * For wider samples the polynomials are evaluated with the Horner method over
+ * blocks of samples, in loops the compiler can vectorize. There is a kernel
+ * for each sample size, see facq_comedi_misc_get_bps(). The conversion only
+ * needs the maxdata, and the polynomials or the ranges, so it can be checked
+ * with synthetic raw samples, without a device.
+ */
+
+/**
+ * FacqComediMiscConv:
+ *
+ * Contains the tables or the polynomials used to convert the raw samples of
+ * each channel, see facq_comedi_misc_conv_new().
  */
 
 /**
@@ -903,6 +922,87 @@ gdouble *facq_comedi_misc_get_min(comedi_t *dev,guint subindex,const FacqChanlis
 	return NULL;
 }
 
+/**
+ * facq_comedi_misc_get_scale_offset:
+ * @dev: A comedi_t device.
+ * @subindex: The subdevice index.
+ * @chanlist: A #FacqChanlist object.
+ * @p: (allow-none): The polynomial array used for the conversion, see
+ * facq_comedi_misc_get_polynomial(), or %NULL if comedi_to_phys() is used.
+ * @scale: (out): The scale of each I/O channel.
+ * @offset: (out): The offset of each I/O channel.
+ * @err: A #GError.
+ *
+ * Computes the scale and offset that convert the samples of each I/O channel
+ * to real values, see facq_stream_data_set_format(). This is only possible
+ * if the conversion is linear, it is always linear with comedi_to_phys() and
+ * the global oor behavior set to %COMEDI_OOR_NUMBER, but not with polynomials
+ * of order bigger than 1.
+ *
+ * Returns: %TRUE if successful, free the arrays with g_free(). %FALSE if the
+ * conversion isn't linear or in case of error, in this last case @err is set.
+ */
+gboolean facq_comedi_misc_get_scale_offset(comedi_t *dev,guint subindex,const FacqChanlist *chanlist,const comedi_polynomial_t *p,gdouble **scale,gdouble **offset,GError **err)
+{
+	guint iochans_n = 0, i = 0, chanspec = 0, chan = 0, range = 0;
+	GError *local_err = NULL;
+	gdouble *s = NULL, *o = NULL;
+	comedi_range *rng = NULL;
+	lsampl_t maxdata = 0;
+
+	g_return_val_if_fail(FACQ_IS_CHANLIST(chanlist),FALSE);
+
+	iochans_n = facq_chanlist_get_io_chans_n(chanlist);
+	if(!iochans_n){
+		g_set_error_literal(&local_err,
+			FACQ_COMEDI_MISC_ERROR,
+				FACQ_COMEDI_MISC_ERROR_FAILED,
+					"The chanlist is empty");
+		goto error;
+	}
+	if(p){
+		for(i = 0;i < iochans_n;i++)
+			if(p[i].order > 1)
+				return FALSE;
+	}
+	s = g_new0(gdouble,iochans_n);
+	o = g_new0(gdouble,iochans_n);
+	for(i = 0;i < iochans_n;i++){
+		//the device is calibrated, c0 + c1*(sample - origin)
+		if(p){
+			s[i] = (p[i].order) ? p[i].coefficients[1] : 0;
+			o[i] = p[i].coefficients[0] - s[i]*p[i].expansion_origin;
+			continue;
+		}
+		chanspec = facq_chanlist_get_io_chanspec(chanlist,i);
+		facq_chanlist_chanspec_to_src_values(chanspec,&chan,
+						     &range,NULL,NULL);
+		rng = comedi_get_range(dev,subindex,chan,range);
+		maxdata = comedi_get_maxdata(dev,subindex,chan);
+		if(!rng || !maxdata){
+			g_set_error_literal(&local_err,
+				FACQ_COMEDI_MISC_ERROR,
+					FACQ_COMEDI_MISC_ERROR_FAILED,
+						comedi_strerror(comedi_errno()));
+			goto error;
+		}
+		s[i] = (rng->max - rng->min)/maxdata;
+		o[i] = rng->min;
+	}
+	*scale = s;
+	*offset = o;
+	return TRUE;
+
+	error:
+	if(s)
+		g_free(s);
+	if(o)
+		g_free(o);
+	if(local_err)
+		g_propagate_error(err,local_err);
+	return FALSE;
+}
+
 /**
  * facq_comedi_misc_get_bps:
  * @dev:A comedi_t device.
@@ -964,4 +1064,222 @@ gboolean facq_comedi_misc_can_poll(comedi_t *dev,GError **err)
 
 	return TRUE;
 }
+
+/* Raw values over this one are converted with polynomials, the tables would
+ * be too big */
+#define FACQ_COMEDI_MISC_CONV_LUT_MAX 0xFFFF
+/* Approximate number of samples evaluated at the same time with polynomials */
+#define FACQ_COMEDI_MISC_CONV_BLOCK 256
+
+typedef void (*FacqComediMiscConvFunc)(FacqComediMiscConv *conv,gconstpointer ori,gdouble *dst,gsize samples);
+
+struct _FacqComediMiscConv {
+	guint n_channels;
+	FacqComediMiscConvFunc fun;
+	/* tables */
+	lsampl_t *maxdata;
+	gdouble **lut;
+	GPtrArray *tables;
+	/* polynomials, one value per sample in a block */
+	gsize block;
+	guint order;
+	gdouble *origin;
+	gdouble *coef;
+	gdouble *x;
+};
+
+/* The kernels convert whole slices, the raw value of each sample is in the
+ * native byte order, like in the comedi buffer. */
+#define FACQ_COMEDI_MISC_CONV_LUT(name,type) \
+static void name(FacqComediMiscConv *conv,gconstpointer ori,gdouble *dst,gsize samples) \
+{ \
+	const type *in = ori; \
+	guint i = 0, n_channels = conv->n_channels; \
+	gsize j = 0; \
+ \
+	for(j = 0;j < samples;j += n_channels) \
+		for(i = 0;i < n_channels;i++) \
+			dst[j+i] = conv->lut[i][MIN(in[j+i],conv->maxdata[i])]; \
+}
+
+#define FACQ_COMEDI_MISC_CONV_POLY(name,type) \
+static void name(FacqComediMiscConv *conv,gconstpointer ori,gdouble *dst,gsize samples) \
+{ \
+	const type *in = ori; \
+	const gdouble *c = NULL; \
+	gdouble *x = conv->x, *out = NULL; \
+	gsize i = 0, j = 0, len = 0; \
+	guint k = 0; \
+ \
+	for(j = 0;j < samples;j += len){ \
+		len = MIN(conv->block,samples - j); \
+		out = dst + j; \
+		c = conv->coef + conv->order*conv->block; \
+		for(i = 0;i < len;i++){ \
+			x[i] = in[j+i] - conv->origin[i]; \
+			out[i] = c[i]; \
+		} \
+		for(k = conv->order;k-- > 0;){ \
+			c = conv->coef + k*conv->block; \
+			for(i = 0;i < len;i++) \
+				out[i] = out[i]*x[i] + c[i]; \
+		} \
+	} \
+}
+
+FACQ_COMEDI_MISC_CONV_LUT(facq_comedi_misc_conv_lut_16,sampl_t)
+FACQ_COMEDI_MISC_CONV_LUT(facq_comedi_misc_conv_lut_32,lsampl_t)
+FACQ_COMEDI_MISC_CONV_POLY(facq_comedi_misc_conv_poly_16,sampl_t)
+FACQ_COMEDI_MISC_CONV_POLY(facq_comedi_misc_conv_poly_32,lsampl_t)
+
+/* Checks if channels @i and @j are converted in the same way */
+static gboolean facq_comedi_misc_conv_equal(const lsampl_t *maxdata,const comedi_polynomial_t *p,const comedi_range *rng,guint i,guint j)
+{
+	if(maxdata[i] != maxdata[j])
+		return FALSE;
+	if(p)
+		return memcmp(&p[i],&p[j],sizeof(comedi_polynomial_t)) == 0;
+	return rng[i].min == rng[j].min && rng[i].max == rng[j].max;
+}
+
+static void facq_comedi_misc_conv_new_lut(FacqComediMiscConv *conv,const lsampl_t *maxdata,const comedi_polynomial_t *p,const comedi_range *rng)
+{
+	guint i = 0, j = 0;
+	lsampl_t v = 0;
+	gdouble *table = NULL;
+
+	conv->maxdata = g_memdup(maxdata,conv->n_channels*sizeof(lsampl_t));
+	conv->lut = g_new0(gdouble *,conv->n_channels);
+	conv->tables = g_ptr_array_new_with_free_func(g_free);
+	for(i = 0;i < conv->n_channels;i++){
+		for(j = 0;j < i;j++)
+			if(facq_comedi_misc_conv_equal(maxdata,p,rng,i,j))
+				break;
+		if(j < i){
+			conv->lut[i] = conv->lut[j];
+			continue;
+		}
+		table = g_new(gdouble,(gsize)maxdata[i]+1);
+		for(v = 0;v <= maxdata[i];v++){
+			if(p)
+				table[v] = comedi_to_physical(v,&p[i]);
+			else
+				table[v] = comedi_to_phys(v,&rng[i],maxdata[i]);
+		}
+		g_ptr_array_add(conv->tables,table);
+		conv->lut[i] = table;
+	}
+}
+
+static void facq_comedi_misc_conv_new_poly(FacqComediMiscConv *conv,const lsampl_t *maxdata,const comedi_polynomial_t *p,const comedi_range *rng)
+{
+	guint i = 0, k = 0;
+	gsize b = 0;
+
+	conv->block = conv->n_channels*
+		MAX(1,FACQ_COMEDI_MISC_CONV_BLOCK/conv->n_channels);
+	/* comedi_to_phys() is a polynomial of order 1, the higher
+	 * coefficients of the lower order polynomials are 0 */
+	conv->order = 1;
+	if(p)
+		for(i = 0;i < conv->n_channels;i++)
+			conv->order = MAX(conv->order,p[i].order);
+	conv->origin = g_new0(gdouble,conv->block);
+	conv->coef = g_new0(gdouble,(conv->order+1)*conv->block);
+	conv->x = g_new0(gdouble,conv->block);
+	for(b = 0;b < conv->block;b++){
+		i = b % conv->n_channels;
+		if(p){
+			conv->origin[b] = p[i].expansion_origin;
+			for(k = 0;k <= p[i].order;k++)
+				conv->coef[k*conv->block+b] = p[i].coefficients[k];
+		}
+		else {
+			conv->coef[b] = rng[i].min;
+			conv->coef[conv->block+b] =
+				(rng[i].max - rng[i].min)/maxdata[i];
+		}
+	}
+}
+
+/**
+ * facq_comedi_misc_conv_new:
+ * @n_channels: The number of channels in each slice.
+ * @bps: The bytes per sample, sizeof(sampl_t) or sizeof(lsampl_t).
+ * @maxdata: An array with the maxdata of each channel.
+ * @p: An array with the polynomial of each channel, or %NULL.
+ * @rng: An array with the comedi_range of each channel, used when @p is
+ * %NULL.
+ *
+ * Creates a new #FacqComediMiscConv, that converts the samples of each
+ * channel like comedi_to_physical(), when @p is not %NULL, or like
+ * comedi_to_phys(), with the out of range behavior set to %COMEDI_OOR_NUMBER.
+ *
+ * Returns: A new #FacqComediMiscConv, free it with
+ * facq_comedi_misc_conv_free().
+ */
+FacqComediMiscConv *facq_comedi_misc_conv_new(guint n_channels,guint bps,const lsampl_t *maxdata,const comedi_polynomial_t *p,const comedi_range *rng)
+{
+	FacqComediMiscConv *conv = NULL;
+	gboolean lut = TRUE;
+	guint i = 0;
+
+	g_return_val_if_fail(n_channels > 0,NULL);
+	g_return_val_if_fail(bps == sizeof(sampl_t) || bps == sizeof(lsampl_t),NULL);
+	g_return_val_if_fail(p || rng,NULL);
+
+	conv = g_new0(FacqComediMiscConv,1);
+	conv->n_channels = n_channels;
+	for(i = 0;i < n_channels;i++)
+		if(maxdata[i] > FACQ_COMEDI_MISC_CONV_LUT_MAX)
+			lut = FALSE;
+	if(lut){
+		facq_comedi_misc_conv_new_lut(conv,maxdata,p,rng);
+		conv->fun = (bps == sizeof(sampl_t)) ?
+			facq_comedi_misc_conv_lut_16 :
+				facq_comedi_misc_conv_lut_32;
+	}
+	else {
+		facq_comedi_misc_conv_new_poly(conv,maxdata,p,rng);
+		conv->fun = (bps == sizeof(sampl_t)) ?
+			facq_comedi_misc_conv_poly_16 :
+				facq_comedi_misc_conv_poly_32;
+	}
+	return conv;
+}
+
+/**
+ * facq_comedi_misc_conv_do:
+ * @conv: A #FacqComediMiscConv.
+ * @ori: The raw samples, in slices.
+ * @dst: The place where the real samples are stored.
+ * @samples: The number of samples to convert, only complete slices are
+ * converted.
+ *
+ * Converts the raw samples in @ori to real values in @dst. @ori and @dst
+ * must be different areas, and the function must not be called at the same
+ * time from different threads with the same @conv.
+ */
+void facq_comedi_misc_conv_do(FacqComediMiscConv *conv,gconstpointer ori,gdouble *dst,gsize samples)
+{
+	conv->fun(conv,ori,dst,samples - (samples % conv->n_channels));
+}
+
+/**
+ * facq_comedi_misc_conv_free:
+ * @conv: A #FacqComediMiscConv.
+ *
+ * Destroys the #FacqComediMiscConv.
+ */
+void facq_comedi_misc_conv_free(FacqComediMiscConv *conv)
+{
+	if(conv->tables)
+		g_ptr_array_free(conv->tables,TRUE);
+	g_free(conv->lut);
+	g_free(conv->maxdata);
+	g_free(conv->origin);
+	g_free(conv->coef);
+	g_free(conv->x);
+	g_free(conv);
+}
 #endif //USE_COMEDI
@@ -29,6 +29,8 @@ typedef enum {
 	FACQ_COMEDI_MISC_ERROR_FAILED
 } FacqComediMiscError;
 
+typedef struct _FacqComediMiscConv FacqComediMiscConv;
+
 gboolean facq_comedi_misc_test_aref(guint subd_flags,guint aref);
 gboolean facq_comedi_misc_test_channel_flags(guint subd_flags,guint flags);
 comedi_cmd *facq_comedi_misc_cmd_new(guint subindex);
@@ -42,8 +44,12 @@ comedi_polynomial_t *facq_comedi_misc_get_polynomial(comedi_t *dev,guint subinde
 FacqUnits *facq_comedi_misc_get_units(comedi_t *dev,guint subindex,const FacqChanlist *chanlist,GError **err);
 gdouble *facq_comedi_misc_get_max(comedi_t *dev,guint subindex,const FacqChanlist *chanlist,GError **err);
 gdouble *facq_comedi_misc_get_min(comedi_t *dev,guint subindex,const FacqChanlist *chanlist,GError **err);
+gboolean facq_comedi_misc_get_scale_offset(comedi_t *dev,guint subindex,const FacqChanlist *chanlist,const comedi_polynomial_t *p,gdouble **scale,gdouble **offset,GError **err);
 guint facq_comedi_misc_get_bps(comedi_t *dev,guint subindex,GError **err);
 gboolean facq_comedi_misc_can_poll(comedi_t *dev,GError **err);
+FacqComediMiscConv *facq_comedi_misc_conv_new(guint n_channels,guint bps,const lsampl_t *maxdata,const comedi_polynomial_t *p,const comedi_range *rng);
+void facq_comedi_misc_conv_do(FacqComediMiscConv *conv,gconstpointer ori,gdouble *dst,gsize samples);
+void facq_comedi_misc_conv_free(FacqComediMiscConv *conv);
 G_END_DECLS
 
 #endif
@@ -0,0 +1,281 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <glib.h>
+#include <gio/gio.h>
+#include <string.h>
+#include "facqcompress.h"
+
+/**
+ * SECTION:facqcompress
+ * @short_description: Lossless compression of blocks of samples.
+ * @title:FacqCompress
+ * @include:facqcompress.h
+ *
+ * This module compresses the blocks of samples of the compressed version 2
+ * #FacqFile files, see <link linkend="facqfile-v2">Version 2</link>. Each
+ * block is compressed on its own, so any block can be decompressed without
+ * reading the previous ones.
+ *
+ * The samples of an acquisition change slowly, and they come from a converter
+ * with a few bits of resolution, so consecutive samples of a channel share
+ * most of their bits. Before compressing, each sample is replaced by the XOR
+ * of the sample and the previous sample of the same channel, and the bytes
+ * of the samples are grouped by position, first the first byte of all the
+ * samples, then the second byte... The result has long runs of zeros that
+ * are compressed with deflate, using a #GZlibCompressor.
+ *
+ * Both steps work on the bytes of the samples, so the result is the same
+ * whatever the byte order of the machine. If the compressed block is not
+ * smaller than the original, the original block is stored, and this is known
+ * when reading because both have the same length.
+ *
+ * Create a #FacqCompress with facq_compress_new(), one per thread, compress
+ * with facq_compress_block() and decompress with facq_compress_unblock().
+ * Compression needs GLib 2.24 or newer.
+ */
+
+/**
+ * FacqCompress:
+ *
+ * An opaque structure with the state of the compressor, see
+ * facq_compress_new().
+ */
+
+/**
+ * FacqCompressError:
+ * @FACQ_COMPRESS_ERROR_FAILED: Some error happened compressing or
+ * decompressing a block.
+ *
+ * Enum values for errors in #FacqCompress.
+ */
+
+/* the fastest level, the samples are already prepared for compressing */
+#define FACQ_COMPRESS_LEVEL 1
+
+struct _FacqCompress {
+	guint n_channels;
+#if GLIB_MINOR_VERSION >= 24
+	GConverter *compressor;
+	GConverter *decompressor;
+#endif
+	guint8 *tmp;
+	gsize tmp_size;
+};
+
+GQuark facq_compress_error_quark(void)
+{
+	return g_quark_from_static_string("facq-compress-error-quark");
+}
+
+static guint8 *facq_compress_get_tmp(FacqCompress *z,gsize len)
+{
+	if(z->tmp_size < len){
+		z->tmp = g_realloc(z->tmp,len);
+		z->tmp_size = len;
+	}
+	return z->tmp;
+}
+
+#if GLIB_MINOR_VERSION >= 24
+/* Converts all of src with conv, returns the number of bytes written to dst
+ * or 0 if they don't fit in less than dst_len bytes. */
+static gsize facq_compress_convert(GConverter *conv,const guint8 *src,gsize src_len,guint8 *dst,gsize dst_len,GError **err)
+{
+	GConverterResult res = G_CONVERTER_ERROR;
+	GError *local_err = NULL;
+	gsize rd = 0, wr = 0, r = 0, w = 0;
+
+	g_converter_reset(conv);
+	do {
+		if(wr == dst_len)
+			return 0;
+		res = g_converter_convert(conv,src + rd,src_len - rd,
+					dst + wr,dst_len - wr,
+					G_CONVERTER_INPUT_AT_END,&r,&w,&local_err);
+		if(res == G_CONVERTER_ERROR){
+			if(g_error_matches(local_err,G_IO_ERROR,G_IO_ERROR_NO_SPACE)){
+				g_error_free(local_err);
+				return 0;
+			}
+			g_propagate_error(err,local_err);
+			return 0;
+		}
+		rd += r;
+		wr += w;
+	} while(res != G_CONVERTER_FINISHED);
+
+	return wr;
+}
+#endif
+
+/**
+ * facq_compress_new:
+ * @n_channels: The number of channels of the samples.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Returns: A new #FacqCompress, free it with facq_compress_free(), or %NULL
+ * if compression is not supported.
+ */
+FacqCompress *facq_compress_new(guint n_channels,GError **err)
+{
+	FacqCompress *z = NULL;
+
+	g_return_val_if_fail(n_channels > 0,NULL);
+
+#if GLIB_MINOR_VERSION >= 24
+	z = g_new0(FacqCompress,1);
+	z->n_channels = n_channels;
+	z->compressor = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW,
+							FACQ_COMPRESS_LEVEL));
+	z->decompressor = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_RAW));
+#else
+	g_set_error_literal(err,FACQ_COMPRESS_ERROR,FACQ_COMPRESS_ERROR_FAILED,
+				"Compression needs GLib 2.24 or newer");
+#endif
+	return z;
+}
+
+/**
+ * facq_compress_block:
+ * @z: A #FacqCompress.
+ * @src: A block of samples, @len must be a multiple of 8.
+ * @len: The length of the block in bytes.
+ * @dst: A buffer with space for @len bytes.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Compresses the block @src to @dst, the first sample of the block must be
+ * the sample of the first channel or of any other channel, but the block must
+ * contain whole samples. If the block can't be compressed it's copied as is.
+ *
+ * Returns: The number of bytes written to @dst, @len if the block has been
+ * copied, or 0 in case of error.
+ */
+gsize facq_compress_block(FacqCompress *z,const guint8 *src,gsize len,guint8 *dst,GError **err)
+{
+	gsize n = len/sizeof(gdouble), stride = 0, i = 0, ret = 0;
+	GError *local_err = NULL;
+	guint8 *tmp = NULL;
+	guint j = 0;
+
+	g_return_val_if_fail(z != NULL,0);
+	g_return_val_if_fail(len % sizeof(gdouble) == 0,0);
+
+	tmp = facq_compress_get_tmp(z,len);
+	stride = z->n_channels*sizeof(gdouble);
+	for(i = 0;i < n;i++){
+		for(j = 0;j < sizeof(gdouble);j++){
+			if(i < z->n_channels)
+				tmp[j*n + i] = src[i*sizeof(gdouble) + j];
+			else
+				tmp[j*n + i] = src[i*sizeof(gdouble) + j] ^
+						src[i*sizeof(gdouble) + j - stride];
+		}
+	}
+#if GLIB_MINOR_VERSION >= 24
+	ret = facq_compress_convert(z->compressor,tmp,len,dst,len,&local_err);
+	if(local_err){
+		g_propagate_error(err,local_err);
+		return 0;
+	}
+#endif
+	if(!ret || ret >= len){
+		memcpy(dst,src,len);
+		ret = len;
+	}
+	return ret;
+}
+
+/**
+ * facq_compress_unblock:
+ * @z: A #FacqCompress.
+ * @src: A block compressed with facq_compress_block().
+ * @src_len: The length of the compressed block in bytes.
+ * @dst: A buffer with space for @len bytes.
+ * @len: The length of the original block in bytes.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Decompresses the block @src to @dst.
+ *
+ * Returns: %TRUE if successful, %FALSE if the block is corrupt.
+ */
+gboolean facq_compress_unblock(FacqCompress *z,const guint8 *src,gsize src_len,guint8 *dst,gsize len,GError **err)
+{
+	gsize n = len/sizeof(gdouble), stride = 0, i = 0;
+	guint8 *tmp = NULL;
+	guint j = 0;
+
+	g_return_val_if_fail(z != NULL,FALSE);
+	g_return_val_if_fail(len % sizeof(gdouble) == 0,FALSE);
+
+	if(src_len == len){
+		memcpy(dst,src,len);
+		return TRUE;
+	}
+	if(src_len > len)
+		goto error;
+
+	/* one more byte, so the end of the stream fits after the samples */
+	tmp = facq_compress_get_tmp(z,len + 1);
+#if GLIB_MINOR_VERSION >= 24
+	if(facq_compress_convert(z->decompressor,src,src_len,tmp,len + 1,err) != len)
+		goto error;
+#else
+	goto error;
+#endif
+	stride = z->n_channels*sizeof(gdouble);
+	for(i = 0;i < n;i++){
+		for(j = 0;j < sizeof(gdouble);j++){
+			if(i < z->n_channels)
+				dst[i*sizeof(gdouble) + j] = tmp[j*n + i];
+			else
+				dst[i*sizeof(gdouble) + j] = tmp[j*n + i] ^
+						dst[i*sizeof(gdouble) + j - stride];
+		}
+	}
+	return TRUE;
+
+	error:
+	if(err && !*err)
+		g_set_error_literal(err,FACQ_COMPRESS_ERROR,
+				FACQ_COMPRESS_ERROR_FAILED,
+					"The compressed block is corrupt");
+	return FALSE;
+}
+
+/**
+ * facq_compress_free:
+ * @z: A #FacqCompress.
+ *
+ * Destroys the #FacqCompress, @z.
+ */
+void facq_compress_free(FacqCompress *z)
+{
+	g_return_if_fail(z != NULL);
+
+#if GLIB_MINOR_VERSION >= 24
+	g_object_unref(z->compressor);
+	g_object_unref(z->decompressor);
+#endif
+	g_free(z->tmp);
+	g_free(z);
+}
@@ -0,0 +1,40 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#ifndef _FREEACQ_COMPRESS_H_
+#define _FREEACQ_COMPRESS_H_
+
+G_BEGIN_DECLS
+
+#define FACQ_COMPRESS_ERROR facq_compress_error_quark()
+
+typedef enum {
+	FACQ_COMPRESS_ERROR_FAILED
+} FacqCompressError;
+
+typedef struct _FacqCompress FacqCompress;
+
+FacqCompress *facq_compress_new(guint n_channels,GError **err);
+gsize facq_compress_block(FacqCompress *z,const guint8 *src,gsize len,guint8 *dst,GError **err);
+gboolean facq_compress_unblock(FacqCompress *z,const guint8 *src,gsize src_len,guint8 *dst,gsize len,GError **err);
+void facq_compress_free(FacqCompress *z);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,156 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <glib.h>
+#if HAVE_X86_CPU_DISPATCH
+#include <immintrin.h>
+#endif
+#include "facqcrc.h"
+
+/**
+ * SECTION:facqcrc
+ * @short_description: CRC32C checksums.
+ * @title:FacqCRC
+ * @include:facqcrc.h
+ *
+ * This module computes CRC32C (Castagnoli) checksums, they are used to check
+ * each block of samples in the version 2 of the #FacqFile format.
+ *
+ * On x86 CPUs with SSE4.2 the checksum is computed with the crc32
+ * instruction, in other case a table driven implementation that processes 8
+ * bytes per iteration is used. The implementation is chosen the first time
+ * facq_crc32c() is called.
+ */
+
+/* reversed Castagnoli polynomial */
+#define FACQ_CRC32C_POLY 0x82F63B78
+
+static guint32 facq_crc_table[8][256];
+
+static void facq_crc_table_init(void)
+{
+	guint32 i = 0, j = 0, crc = 0;
+
+	for(i = 0;i < 256;i++){
+		crc = i;
+		for(j = 0;j < 8;j++)
+			crc = (crc & 1) ? (crc >> 1) ^ FACQ_CRC32C_POLY : crc >> 1;
+		facq_crc_table[0][i] = crc;
+	}
+	for(i = 0;i < 256;i++){
+		crc = facq_crc_table[0][i];
+		for(j = 1;j < 8;j++){
+			crc = facq_crc_table[0][crc & 0xFF] ^ (crc >> 8);
+			facq_crc_table[j][i] = crc;
+		}
+	}
+}
+
+/* slicing by 8, the bytes are read one by one so it works with any
+ * alignment and byte order */
+static guint32 facq_crc32c_table(guint32 crc,const guint8 *p,gsize len)
+{
+	while(len >= 8){
+		crc ^= (guint32)p[0] | ((guint32)p[1] << 8) |
+			((guint32)p[2] << 16) | ((guint32)p[3] << 24);
+		crc = facq_crc_table[7][crc & 0xFF] ^
+		      facq_crc_table[6][(crc >> 8) & 0xFF] ^
+		      facq_crc_table[5][(crc >> 16) & 0xFF] ^
+		      facq_crc_table[4][crc >> 24] ^
+		      facq_crc_table[3][p[4]] ^
+		      facq_crc_table[2][p[5]] ^
+		      facq_crc_table[1][p[6]] ^
+		      facq_crc_table[0][p[7]];
+		p += 8;
+		len -= 8;
+	}
+	while(len--)
+		crc = facq_crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+#if HAVE_X86_CPU_DISPATCH
+__attribute__((target("sse4.2")))
+static guint32 facq_crc32c_sse42(guint32 crc,const guint8 *p,gsize len)
+{
+	while(len && ((gsize)p & 7)){
+		crc = _mm_crc32_u8(crc,*p++);
+		len--;
+	}
+#if defined(__x86_64__)
+	{
+		guint64 crc64 = crc;
+
+		while(len >= 8){
+			crc64 = _mm_crc32_u64(crc64,*(const guint64 *)p);
+			p += 8;
+			len -= 8;
+		}
+		crc = (guint32)crc64;
+	}
+#endif
+	while(len >= 4){
+		crc = _mm_crc32_u32(crc,*(const guint32 *)p);
+		p += 4;
+		len -= 4;
+	}
+	while(len--)
+		crc = _mm_crc32_u8(crc,*p++);
+	return crc;
+}
+#endif
+
+typedef guint32 (*FacqCRCFunc)(guint32 crc,const guint8 *p,gsize len);
+
+static FacqCRCFunc facq_crc_get_func(void)
+{
+	static gsize func = 0;
+	FacqCRCFunc tmp = facq_crc32c_table;
+
+	if(g_once_init_enter(&func)){
+#if HAVE_X86_CPU_DISPATCH
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("sse4.2"))
+			tmp = facq_crc32c_sse42;
+#endif
+		if(tmp == facq_crc32c_table)
+			facq_crc_table_init();
+		g_once_init_leave(&func,(gsize)tmp);
+	}
+	return (FacqCRCFunc)func;
+}
+
+/**
+ * facq_crc32c:
+ * @crc: The checksum of the previous data, or 0 for the first block.
+ * @data: The data.
+ * @len: The length of @data in bytes.
+ *
+ * Computes the CRC32C checksum of @data, continuing the checksum @crc, so the
+ * checksum of some data can be computed in several steps.
+ *
+ * Returns: The updated checksum.
+ */
+guint32 facq_crc32c(guint32 crc,gconstpointer data,gsize len)
+{
+	return ~facq_crc_get_func()(~crc,data,len);
+}
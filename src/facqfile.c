@@ -36,12 +36,19 @@
 #include "gdouble.h"
 #include "facqunits.h"
 #include "facqchunk.h"
+#include "facqcrc.h"
+#include "facqcompress.h"
 #include "facqchanlist.h"
 #include "facqstreamdata.h"
 #include "facqfile.h"
+#include "facqfilereader.h"
 
 #define FIRST_LINE "Sampling period %.9g seconds\n"
 #define SECOND_LINE_ATOM "channel %u (%s)\t"
+/* blocks waiting to be compressed, see facq_file_z_write() */
+#define FACQ_FILE_Z_BLOCKS 4
+/* slices converted at a time by facq_file_to_human() */
+#define FACQ_FILE_TXT_SLICES 4096
 
 /**
  * SECTION:facqfile
@@ -66,6 +73,12 @@
  * To convert a binary file to human readable format, so it can be processed
  * with other software, use facq_file_to_human().
  *
+ * There are two versions of the format. New files are written in version 2,
+ * where the samples are split in blocks and each block has its own CRC32C
+ * checksum, see <link linkend="facqfile-v2">Version 2</link>, use
+ * facq_file_set_version() to write version 1 files. Both versions can be read
+ * and verified.
+ *
  * <sect1 id="facqfile-steps">
  *  <title>Steps to create a FacqFile</title>
  *   <para>
@@ -233,6 +246,46 @@
  *   </orderedlist>
  *   </para>
  *  </sect2>
+ *  <sect2 id="facqfile-v2">
+ *  <title>Version 2</title>
+ *   <para>
+ *   Version 2 files start with the magic number #MAGIC_NUMBER_V2 instead of
+ *   #MAGIC_NUMBER, the header and the samples are stored in the same way.
+ *   The samples area is split in blocks of #FACQ_FILE_BLOCK_SIZE bytes, the last
+ *   one can be smaller, and the following fields are stored between the
+ *   samples and the tail:
+ *   <orderedlist>
+ *    <listitem>
+ *     <para>
+ *     <emphasis>block checksums</emphasis> &mdash; The CRC32C checksum of
+ *     each block, in order (4 bytes per block in guint32 format).
+ *     </para>
+ *    </listitem>
+ *    <listitem>
+ *     <para>
+ *     <emphasis>block size</emphasis> &mdash; The size of the blocks in bytes.
+ *     (4 bytes in guint32 format).
+ *     </para>
+ *    </listitem>
+ *   </orderedlist>
+ *   The digest in the tail is computed over the header, the block checksums,
+ *   the block size and the number of samples, but not over the samples. This
+ *   way each block can be checked on its own, and in parallel, see
+ *   facq_file_reader_verify(), while the digest still protects the whole file.
+ *   </para>
+ *   <para>
+ *   Version 2 files can also be compressed, see facq_file_set_compressed(),
+ *   in this case the file starts with #MAGIC_NUMBER_V2Z. Each block is
+ *   compressed on its own, see #FacqCompress, and the compressed blocks are
+ *   stored one after the other in the samples area. The table after the
+ *   samples has two entries per block, the CRC32C checksum of the compressed
+ *   block and the length of the compressed block in bytes (4 bytes each in
+ *   guint32 format), followed by the block size. A block with the same length
+ *   as the original block is stored without compression. The position of any
+ *   block can be computed from the table, so the samples can still be read in
+ *   any order, see #FacqFileReader.
+ *   </para>
+ *  </sect2>
  * </sect1>
  */
 
@@ -279,8 +332,30 @@ struct _FacqFilePrivate {
 	guint64 written_samples;
 	guint8 digest[32];
 	GChecksum *sum;
+	gdouble *scratch;
+	gsize scratch_size;
+	guint version;
+	GArray *blocks;
+	guint32 block_crc;
+	gsize block_fill;
+	gboolean compressed;
+	FacqCompress *codec;
+	GThread *zthread;
+	GAsyncQueue *zfull;
+	GAsyncQueue *zfree;
+	struct _FacqFileZBlock *zblock;
+	guint8 *zout;
+	gint zfailed;
+	GError *zerr;
 };
 
+typedef struct _FacqFileZBlock {
+	guint8 *data;
+	gsize len;
+} FacqFileZBlock;
+
+static void facq_file_z_free(FacqFile *file);
+
 /* GObject magic */
 static void facq_file_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
 {
@@ -334,6 +409,14 @@ static void facq_file_finalize(GObject *self)
 	if(file->priv->sum)
 		g_checksum_free(file->priv->sum);
 
+	if(file->priv->scratch)
+		g_free(file->priv->scratch);
+
+	facq_file_z_free(file);
+
+	if(file->priv->blocks)
+		g_array_free(file->priv->blocks,TRUE);
+
 	G_OBJECT_CLASS (facq_file_parent_class)->finalize (self);
 }
 
@@ -347,6 +430,7 @@ static void facq_file_constructed(GObject *self)
 	file->priv->pfd->events = G_IO_OUT | G_IO_ERR;
 	file->priv->sum = g_checksum_new(G_CHECKSUM_SHA256);
 	g_assert(file->priv->sum);
+	file->priv->blocks = g_array_new(FALSE,FALSE,sizeof(guint32));
 }
 
 static void facq_file_class_init(FacqFileClass *klass)
@@ -381,6 +465,21 @@ static void facq_file_init(FacqFile *file)
 	file->priv->written_samples = 0;
 	memset(file->priv->digest,0,32);
 	file->priv->sum = NULL;
+	file->priv->scratch = NULL;
+	file->priv->scratch_size = 0;
+	file->priv->version = 2;
+	file->priv->blocks = NULL;
+	file->priv->block_crc = 0;
+	file->priv->block_fill = 0;
+	file->priv->compressed = FALSE;
+	file->priv->codec = NULL;
+	file->priv->zthread = NULL;
+	file->priv->zfull = NULL;
+	file->priv->zfree = NULL;
+	file->priv->zblock = NULL;
+	file->priv->zout = NULL;
+	file->priv->zfailed = 0;
+	file->priv->zerr = NULL;
 }
 
 /* GInitable interface */
@@ -408,14 +507,13 @@ static gboolean facq_file_initable_init(GInitable *initable,GCancellable *cancel
         return TRUE;
 }
 /* private write procedures */
-static void facq_file_write_magic(GIOChannel *channel,GError **err)
+static void facq_file_write_magic(GIOChannel *channel,guint32 magic,GError **err)
 {
 	guint32 tmp = 0;
 	gsize bytes_written = 0;
 	GError *local_error = NULL;
 
-	tmp = MAGIC_NUMBER;
-	tmp = GUINT32_TO_BE(tmp);
+	tmp = GUINT32_TO_BE(magic);
 	g_io_channel_write_chars(channel,(const gchar *)&tmp,sizeof(guint32),&bytes_written,&local_error);
         if(local_error || bytes_written != sizeof(guint32)){
                 if(local_error){
@@ -556,6 +654,240 @@ static void facq_file_write_written_samples(GIOChannel *channel,guint64 written_
 
 }
 
+/* Adds the samples, already in big endian, to the checksums of the blocks,
+ * closing a block each time FACQ_FILE_BLOCK_SIZE bytes are added. */
+static void facq_file_update_blocks(FacqFile *file,const guint8 *data,gsize len)
+{
+	gsize n = 0;
+
+	while(len){
+		n = MIN(len,FACQ_FILE_BLOCK_SIZE - file->priv->block_fill);
+		file->priv->block_crc = facq_crc32c(file->priv->block_crc,data,n);
+		file->priv->block_fill += n;
+		data += n;
+		len -= n;
+		if(file->priv->block_fill == FACQ_FILE_BLOCK_SIZE){
+			g_array_append_val(file->priv->blocks,file->priv->block_crc);
+			file->priv->block_crc = 0;
+			file->priv->block_fill = 0;
+		}
+	}
+}
+
+static void facq_file_write_blocks(FacqFile *file,GError **err)
+{
+	GError *local_error = NULL;
+	gsize bytes_written = 0, len = 0;
+	guint32 *crc = NULL, block_size = 0;
+	guint i = 0;
+
+	if(file->priv->block_fill){
+		g_array_append_val(file->priv->blocks,file->priv->block_crc);
+		file->priv->block_crc = 0;
+		file->priv->block_fill = 0;
+	}
+	block_size = FACQ_FILE_BLOCK_SIZE;
+	g_array_append_val(file->priv->blocks,block_size);
+	crc = (guint32 *)file->priv->blocks->data;
+	for(i = 0;i < file->priv->blocks->len;i++)
+		crc[i] = GUINT32_TO_BE(crc[i]);
+
+	len = file->priv->blocks->len*sizeof(guint32);
+	g_checksum_update(file->priv->sum,(guchar *)crc,len);
+	g_io_channel_write_chars(file->priv->channel,(const gchar *)crc,len,&bytes_written,&local_error);
+	if(local_error || bytes_written != len){
+		if(local_error){
+			g_propagate_error(err,local_error);
+			return;
+		}
+		g_set_error_literal(err,FACQ_FILE_ERROR,
+				FACQ_FILE_ERROR_FAILED,"Error when writting block checksums");
+		return;
+	}
+}
+
+static gboolean facq_file_write_all(GIOChannel *channel,const guint8 *data,gsize len,GError **err)
+{
+	GError *local_err = NULL;
+	gsize bytes_written = 0, n = 0;
+
+	while(bytes_written < len){
+		g_io_channel_write_chars(channel,(const gchar *)data + bytes_written,
+					len - bytes_written,&n,&local_err);
+		if(local_err){
+			g_propagate_error(err,local_err);
+			return FALSE;
+		}
+		if(!n)
+			break;
+		bytes_written += n;
+	}
+	if(bytes_written != len){
+		g_set_error_literal(err,FACQ_FILE_ERROR,
+				FACQ_FILE_ERROR_FAILED,"Can't write all bytes to file");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Compresses and writes the blocks filled by facq_file_z_write(), in order,
+ * adding the checksum and the length of each one to the table, until an empty
+ * block arrives. After an error the blocks are only given back. */
+static gpointer facq_file_z_fun(gpointer data)
+{
+	FacqFile *file = FACQ_FILE(data);
+	FacqFileZBlock *block = NULL;
+	GError *local_err = NULL;
+	guint32 entry[2];
+	gsize len = 0;
+
+	for(;;){
+		block = g_async_queue_pop(file->priv->zfull);
+		if(!block->len){
+			g_async_queue_push(file->priv->zfree,block);
+			break;
+		}
+		if(!g_atomic_int_get(&file->priv->zfailed)){
+			len = facq_compress_block(file->priv->codec,block->data,
+						block->len,file->priv->zout,&local_err);
+			if(!local_err)
+				facq_file_write_all(file->priv->channel,
+						file->priv->zout,len,&local_err);
+			if(local_err){
+				file->priv->zerr = local_err;
+				local_err = NULL;
+				g_atomic_int_set(&file->priv->zfailed,1);
+			}
+			else {
+				entry[0] = facq_crc32c(0,file->priv->zout,len);
+				entry[1] = len;
+				g_array_append_vals(file->priv->blocks,entry,2);
+			}
+		}
+		block->len = 0;
+		g_async_queue_push(file->priv->zfree,block);
+	}
+	return NULL;
+}
+
+static gboolean facq_file_z_start(FacqFile *file,guint n_channels,GError **err)
+{
+	FacqFileZBlock *block = NULL;
+	guint i = 0;
+
+	facq_file_z_free(file);
+	file->priv->codec = facq_compress_new(n_channels,err);
+	if(!file->priv->codec)
+		return FALSE;
+	file->priv->zfull = g_async_queue_new();
+	file->priv->zfree = g_async_queue_new();
+	for(i = 0;i < FACQ_FILE_Z_BLOCKS;i++){
+		block = g_new0(FacqFileZBlock,1);
+		block->data = g_malloc(FACQ_FILE_BLOCK_SIZE);
+		g_async_queue_push(file->priv->zfree,block);
+	}
+	file->priv->zblock = g_async_queue_pop(file->priv->zfree);
+	file->priv->zout = g_malloc(FACQ_FILE_BLOCK_SIZE);
+	file->priv->zfailed = 0;
+	file->priv->zthread = g_thread_try_new("compress",facq_file_z_fun,file,err);
+	return file->priv->zthread != NULL;
+}
+
+/* Sends an empty block to the worker and waits for it */
+static void facq_file_z_stop(FacqFile *file)
+{
+	FacqFileZBlock *block = NULL;
+
+	if(!file->priv->zthread)
+		return;
+	block = g_async_queue_pop(file->priv->zfree);
+	block->len = 0;
+	g_async_queue_push(file->priv->zfull,block);
+	g_thread_join(file->priv->zthread);
+	file->priv->zthread = NULL;
+}
+
+static void facq_file_z_free(FacqFile *file)
+{
+	FacqFileZBlock *block = NULL;
+
+	facq_file_z_stop(file);
+	if(file->priv->zblock){
+		g_free(file->priv->zblock->data);
+		g_free(file->priv->zblock);
+		file->priv->zblock = NULL;
+	}
+	if(file->priv->zfree){
+		while((block = g_async_queue_try_pop(file->priv->zfree))){
+			g_free(block->data);
+			g_free(block);
+		}
+		g_async_queue_unref(file->priv->zfree);
+		file->priv->zfree = NULL;
+	}
+	if(file->priv->zfull){
+		g_async_queue_unref(file->priv->zfull);
+		file->priv->zfull = NULL;
+	}
+	if(file->priv->zout){
+		g_free(file->priv->zout);
+		file->priv->zout = NULL;
+	}
+	if(file->priv->codec){
+		facq_compress_free(file->priv->codec);
+		file->priv->codec = NULL;
+	}
+	g_clear_error(&file->priv->zerr);
+}
+
+/* Copies the samples, already in big endian, to the block being filled,
+ * passing each full block to the worker thread, so the calling thread
+ * never waits for the compression, unless all the blocks are waiting. */
+static GIOStatus facq_file_z_write(FacqFile *file,const guint8 *data,gsize len,GError **err)
+{
+	FacqFileZBlock *block = NULL;
+	gsize n = 0;
+
+	if(g_atomic_int_get(&file->priv->zfailed)){
+		g_set_error(err,FACQ_FILE_ERROR,FACQ_FILE_ERROR_FAILED,
+				"Error compressing the samples: %s",
+					file->priv->zerr->message);
+		return G_IO_STATUS_ERROR;
+	}
+	while(len){
+		block = file->priv->zblock;
+		n = MIN(len,FACQ_FILE_BLOCK_SIZE - block->len);
+		memcpy(block->data + block->len,data,n);
+		block->len += n;
+		data += n;
+		len -= n;
+		file->priv->written_samples += n/sizeof(gdouble);
+		if(block->len == FACQ_FILE_BLOCK_SIZE){
+			g_async_queue_push(file->priv->zfull,block);
+			file->priv->zblock = g_async_queue_pop(file->priv->zfree);
+		}
+	}
+	return G_IO_STATUS_NORMAL;
+}
+
+/* Passes the last block to the worker and waits until all the blocks are
+ * written */
+static gboolean facq_file_z_finish(FacqFile *file,GError **err)
+{
+	if(file->priv->zblock->len){
+		g_async_queue_push(file->priv->zfull,file->priv->zblock);
+		file->priv->zblock = NULL;
+	}
+	facq_file_z_stop(file);
+	if(file->priv->zerr){
+		g_set_error(err,FACQ_FILE_ERROR,FACQ_FILE_ERROR_FAILED,
+				"Error compressing the samples: %s",
+					file->priv->zerr->message);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 static void facq_file_write_digest(GIOChannel *channel,const guint8 *digest,GError **err)
 {
 	GError *local_error = NULL;
@@ -1085,32 +1417,35 @@ static gboolean facq_file_txt_write_header(GIOChannel *channel,const FacqStreamD
 	return FALSE;
 }
 
-static gboolean facq_file_txt_write_samples(GIOChannel *src,GIOChannel *dst,guint32 n_channels,guint64 written_samples,GError **err)
+static gboolean facq_file_txt_write_samples(FacqFileReader *src,GIOChannel *dst,guint32 n_channels,GError **err)
 {
 	GError *local_err = NULL;
 	guint32 j = 0;
-	guint64 i = 0;
-	gdouble sample = 0;
+	guint64 i = 0, n_slices = 0, start = 0, n = 0;
+	gdouble *samples = NULL, sample = 0;
 	gchar *text = NULL;
 	gsize bytes = 0;
 
-	facq_file_goto_area(src,n_channels,FIRST_SAMPLE,&local_err);
-	if(local_err)
-		goto error;
-
-	for(i = 0;i < written_samples;){
+	/* the samples are read with a FacqFileReader, so compressed files
+	 * can be converted too */
+	n_slices = facq_file_reader_get_n_slices(src);
+	samples = g_new(gdouble,FACQ_FILE_TXT_SLICES*n_channels);
+	for(i = 0;i < n_slices*n_channels;){
+		if(i == start*n_channels){
+			n = MIN(n_slices - start,FACQ_FILE_TXT_SLICES);
+			if(!facq_file_reader_read(src,start,n,samples,&local_err))
+				goto error;
+			start += n;
+		}
 		for(j = 0;j < n_channels;j++){
-			if( g_io_channel_read_chars(src,(gchar *)&sample,
-				sizeof(gdouble),&bytes,&local_err)
-					!= G_IO_STATUS_NORMAL)
-						goto error;
-			sample = GDOUBLE_TO_BE(sample);
+			sample = samples[i % (FACQ_FILE_TXT_SLICES*n_channels)];
 			text = g_strdup_printf("%.6g    ",sample);
 			if( g_io_channel_write_chars(dst,text,-1,
 				&bytes,&local_err)
 					!= G_IO_STATUS_NORMAL )
 						goto error;
 			g_free(text);
+			text = NULL;
 			if(j == (n_channels-1)){
 				text = g_strdup_printf("\n");
 				if( g_io_channel_write_chars(dst,text,-1,
@@ -1118,14 +1453,17 @@ static gboolean facq_file_txt_write_samples(GIOChannel *src,GIOChannel *dst,guin
 						!= G_IO_STATUS_NORMAL )
 							goto error;
 				g_free(text);
+				text = NULL;
 			}
 			i++;
 		}
 	}
 
+	g_free(samples);
 	return TRUE;
 
 	error:
+	g_free(samples);
 	if(text)
 		g_free(text);
 	if(local_err)
@@ -1154,6 +1492,74 @@ FacqFile *facq_file_new(const gchar *filename,GError **err)
 			);
 }
 
+/**
+ * facq_file_set_version:
+ * @file: A #FacqFile object.
+ * @version: The version of the format, 1 or 2.
+ *
+ * Sets the version of the format used when writing the file, by default 2.
+ * Call it before facq_file_write_header(). Use version 1 only if the files
+ * must be read by older versions of the software.
+ */
+void facq_file_set_version(FacqFile *file,guint version)
+{
+	g_return_if_fail(FACQ_IS_FILE(file));
+	g_return_if_fail(version == 1 || version == 2);
+
+	file->priv->version = version;
+}
+
+/**
+ * facq_file_get_version:
+ * @file: A #FacqFile object.
+ *
+ * Gets the version of the format. For files opened with facq_file_open() the
+ * version is read from the magic number.
+ *
+ * Returns: 1 or 2.
+ */
+guint facq_file_get_version(const FacqFile *file)
+{
+	g_return_val_if_fail(FACQ_IS_FILE(file),0);
+
+	return file->priv->version;
+}
+
+/**
+ * facq_file_set_compressed:
+ * @file: A #FacqFile object.
+ * @compressed: %TRUE to compress the samples.
+ *
+ * Enables or disables the compression of the samples, by default disabled.
+ * Only version 2 files can be compressed, see
+ * <link linkend="facqfile-v2">Version 2</link>. The samples are compressed in
+ * a separate thread while the file is written, so the compression doesn't
+ * slow down facq_file_write_samples(). Call it before
+ * facq_file_write_header().
+ */
+void facq_file_set_compressed(FacqFile *file,gboolean compressed)
+{
+	g_return_if_fail(FACQ_IS_FILE(file));
+
+	file->priv->compressed = compressed;
+}
+
+/**
+ * facq_file_get_compressed:
+ * @file: A #FacqFile object.
+ *
+ * For files opened with facq_file_open() the value is read from the magic
+ * number.
+ *
+ * Returns: %TRUE if the samples are compressed, %FALSE in other case.
+ */
+gboolean facq_file_get_compressed(const FacqFile *file)
+{
+	g_return_val_if_fail(FACQ_IS_FILE(file),FALSE);
+
+	return file->priv->compressed;
+}
+
 /**
  * facq_file_reset:
  * @file: a #FacqFile object.
@@ -1169,8 +1575,12 @@ void facq_file_reset(FacqFile *file,GError **err)
 	gint fd = -1;
 	GError *local_err = NULL;
 
+	facq_file_z_free(file);
 	file->priv->written_samples = 0;
 	g_checksum_reset(file->priv->sum);
+	g_array_set_size(file->priv->blocks,0);
+	file->priv->block_crc = 0;
+	file->priv->block_fill = 0;
 	memset(file->priv->digest,0,32);
 	if(file->priv->tmp_filename){
 		g_free(file->priv->tmp_filename);
@@ -1236,12 +1646,16 @@ gboolean facq_file_write_header(FacqFile *file,const FacqStreamData *stmd,GError
 	GError *local_err = NULL;
 	guint *channels = NULL;
 	GIOChannel *channel = NULL;
-	guint32 magic = MAGIC_NUMBER;
+	guint32 magic = 0;
 	
 	g_return_val_if_fail(FACQ_IS_FILE(file),FALSE);
 	channel = file->priv->channel;
+	if(file->priv->version == 1)
+		magic = MAGIC_NUMBER;
+	else
+		magic = (file->priv->compressed) ? MAGIC_NUMBER_V2Z : MAGIC_NUMBER_V2;
 
-	facq_file_write_magic(channel,&local_err);
+	facq_file_write_magic(channel,magic,&local_err);
 	if(local_err)
 		goto error;
 	facq_file_write_period(channel,stmd->period,&local_err);
@@ -1269,6 +1683,14 @@ gboolean facq_file_write_header(FacqFile *file,const FacqStreamData *stmd,GError
         if(local_err)
 		goto error;
 
+	/* the samples are written in big blocks, so skip the buffer of the
+	 * channel, this way each block is passed to the file with one write */
+	g_io_channel_set_buffered(channel,FALSE);
+
+	if(magic == MAGIC_NUMBER_V2Z &&
+		!facq_file_z_start(file,stmd->n_channels,&local_err))
+		goto error;
+
 	magic = GUINT32_TO_BE(magic);
 	g_checksum_update(file->priv->sum,
 			(guchar *)&magic,sizeof(guint32));
@@ -1317,40 +1739,95 @@ gint facq_file_poll(FacqFile *file)
  * @err: (allow-none): A #GError, it will be set in case of error if not %NULL.
  *
  * Writes the samples contained in the #FacqChunk, @chunk, to the #FacqFile @file,
- * in big endian format, updating the checksum and increasing the internal
- * counter of written samples.
+ * in big endian format, updating the checksum, or the checksums of the blocks
+ * in version 2 files, and increasing the internal counter of written samples.
+ *
+ * The data area of @chunk is not modified, the samples are converted in a
+ * private area of @file, so the same #FacqChunk can be shared with other
+ * threads while it's written.
  *
  * Returns: A #GIOStatus value as returned by g_io_channel_write_chars().
  */
 GIOStatus facq_file_write_samples(FacqFile *file,FacqChunk *chunk,GError **err)
+{
+#if ENABLE_DEBUG
+	g_return_val_if_fail(chunk != NULL,G_IO_STATUS_ERROR);
+#endif
+	return facq_file_write_samples_v(file,&chunk,1,err);
+}
+
+/**
+ * facq_file_write_samples_v:
+ * @file: A #FacqFile object.
+ * @chunks: An array of #FacqChunk objects containing the samples to write.
+ * @n_chunks: The number of chunks in @chunks.
+ * @err: (allow-none): A #GError, it will be set in case of error if not %NULL.
+ *
+ * Like facq_file_write_samples() but writes the samples of @n_chunks chunks,
+ * in order. The samples of all the chunks are converted to the same private
+ * area, so the checksum is updated and the file is written only once.
+ *
+ * In compressed files the samples are only copied to the block being filled,
+ * the full blocks are compressed and written by other thread.
+ *
+ * Returns: A #GIOStatus value as returned by g_io_channel_write_chars().
+ */
+GIOStatus facq_file_write_samples_v(FacqFile *file,FacqChunk **chunks,guint n_chunks,GError **err)
 {
 	GIOStatus ret = 0;
 	GError *local_err = NULL;
-	gsize bytes_written = 0;
-	gsize used_bytes = 0;
+	gsize bytes_written = 0, len = 0;
+	gsize used_bytes = 0, offset = 0, n_samples = 0;
+	guint c = 0;
 
 #if ENABLE_DEBUG
 	g_return_val_if_fail(FACQ_IS_FILE(file),G_IO_STATUS_ERROR);
-	g_return_val_if_fail(FACQ_IS_CHUNK(chunk),G_IO_STATUS_ERROR);
+	g_return_val_if_fail(chunks != NULL,G_IO_STATUS_ERROR);
 #endif
 
-	used_bytes = facq_chunk_get_used_bytes(chunk);
-	facq_chunk_data_double_to_be(chunk);
-	g_checksum_update(file->priv->sum,
-		(guchar *)chunk->data,used_bytes);
-
-	ret = g_io_channel_write_chars(file->priv->channel,
-				       chunk->data,
-				       used_bytes,
-				       &bytes_written,
-				       &local_err);
-	if(local_err){
-		g_propagate_error(err,local_err);
-		return ret;
+	for(c = 0;c < n_chunks;c++)
+		used_bytes += facq_chunk_get_used_bytes(chunks[c]);
+	if(file->priv->scratch_size < used_bytes){
+		file->priv->scratch = g_realloc(file->priv->scratch,used_bytes);
+		file->priv->scratch_size = used_bytes;
+	}
+	for(c = 0;c < n_chunks;c++){
+		n_samples = facq_chunk_get_used_bytes(chunks[c])/sizeof(gdouble);
+		gdouble_array_copy_to_be(file->priv->scratch + offset,
+					 (const gdouble *)chunks[c]->data,n_samples);
+		offset += n_samples;
+	}
+	if(file->priv->codec)
+		return facq_file_z_write(file,(const guint8 *)file->priv->scratch,
+							used_bytes,err);
+	if(file->priv->version == 1)
+		g_checksum_update(file->priv->sum,
+			(guchar *)file->priv->scratch,used_bytes);
+	else
+		facq_file_update_blocks(file,(const guint8 *)file->priv->scratch,used_bytes);
+
+	/* the channel is not buffered, see facq_file_write_header(), so a
+	 * short write is only possible when the disk is full */
+	while(bytes_written < used_bytes){
+		ret = g_io_channel_write_chars(file->priv->channel,
+					       (gchar *)file->priv->scratch + bytes_written,
+					       used_bytes - bytes_written,
+					       &len,
+					       &local_err);
+		bytes_written += len;
+		if(local_err){
+			file->priv->written_samples += (bytes_written/sizeof(gdouble));
+			g_propagate_error(err,local_err);
+			return ret;
+		}
+		if(!len)
+			break;
 	}
 	if(bytes_written != used_bytes){
 		g_set_error_literal(&local_err,FACQ_FILE_ERROR,
 					       FACQ_FILE_ERROR_FAILED,"Can't write all bytes to file");
+		g_propagate_error(err,local_err);
+		ret = G_IO_STATUS_ERROR;
 	}
 	file->priv->written_samples += (bytes_written/sizeof(gdouble));
 
@@ -1364,6 +1841,9 @@ GIOStatus facq_file_write_samples(FacqFile *file,FacqChunk *chunk,GError **err)
  *
  * Writes the tail information to the file (The footer). To see what information
  * is contained in the tail see <link linkend="facqfile-tail">Tail information</link>.
+ * In version 2 files the checksums of the blocks and the block size are written
+ * first, see <link linkend="facqfile-v2">Version 2</link>. In compressed files
+ * this function waits until all the blocks are compressed and written.
  *
  * Returns: %TRUE if successful, %FALSE in other case.
  */
@@ -1380,6 +1860,14 @@ gboolean facq_file_write_tail(FacqFile *file,GError **err)
 	written_samples = file->priv->written_samples;
 	digest = file->priv->digest;
 
+	if(file->priv->codec && !facq_file_z_finish(file,&local_err))
+		goto error;
+	if(file->priv->version != 1){
+		facq_file_write_blocks(file,&local_err);
+		if(local_err)
+			goto error;
+	}
+
 	written_samples = GUINT64_TO_BE(written_samples);
 	g_checksum_update(file->priv->sum,
 			  (guchar *)&written_samples,
@@ -1601,7 +2089,9 @@ guint8 *facq_file_read_tail(FacqFile *file,guint64 *written_samples,GError **err
  * @err: (allow-none): A #GError, it will be set in case of error if not %NULL.
  *
  * Checks if the first 4 bytes, of the #FacqFile @file, equals to the magic
- * number in big endian.
+ * number in big endian, #MAGIC_NUMBER, #MAGIC_NUMBER_V2 or #MAGIC_NUMBER_V2Z.
+ * The version of the file is updated according to the magic number, see
+ * facq_file_get_version() and facq_file_get_compressed().
  *
  * Returns: %TRUE if successful, %FALSE in other case.
  */
@@ -1619,7 +2109,16 @@ gboolean facq_file_check_magic(FacqFile *file,GError **err)
 		g_propagate_error(err,local_err);
 		return FALSE;
 	}
-	if(magic != MAGIC_NUMBER){
+	file->priv->compressed = FALSE;
+	switch(magic){
+	case MAGIC_NUMBER: file->priv->version = 1;
+	break;
+	case MAGIC_NUMBER_V2: file->priv->version = 2;
+	break;
+	case MAGIC_NUMBER_V2Z: file->priv->version = 2;
+		file->priv->compressed = TRUE;
+	break;
+	default:
 		g_set_error_literal(err,
 			FACQ_FILE_ERROR,FACQ_FILE_ERROR_FAILED,
 				"Wrong magic");
@@ -1645,12 +2144,10 @@ gboolean facq_file_to_human(const gchar *binfilename,const gchar *txtfilename,GE
 {
 	GIOChannel *dst = NULL;
 	GError *local_err = NULL;
-	FacqStreamData *stmd = NULL;
-	guint64 written_samples = 0;
-	guint8 *digest = NULL;
-	FacqFile *srcfile = NULL;
+	const FacqStreamData *stmd = NULL;
+	FacqFileReader *src = NULL;
 
-	srcfile = facq_file_open(binfilename,&local_err);
+	src = facq_file_reader_new(binfilename,&local_err);
 	if(local_err)
 		goto error;
 
@@ -1658,25 +2155,17 @@ gboolean facq_file_to_human(const gchar *binfilename,const gchar *txtfilename,GE
 	if(local_err)
 		goto error;
 
-	stmd = facq_file_read_header(srcfile,&local_err);
-	if(local_err)
-		goto error;
-
-	digest = facq_file_read_tail(srcfile,&written_samples,&local_err);
-	if(local_err)
-		goto error;
-	
+	stmd = facq_file_reader_get_stream_data(src);
 	facq_file_txt_write_header(dst,stmd,&local_err);
 	if(local_err)
 		goto error;
 
-	facq_file_txt_write_samples(srcfile->priv->channel,
-				    dst,stmd->n_channels,written_samples,
-				    &local_err);
+	facq_file_txt_write_samples(src,dst,stmd->n_channels,&local_err);
 	if(local_err)
 		goto error;
 
-	facq_file_free(srcfile);
+	facq_file_reader_free(src);
+	src = NULL;
 
 	g_io_channel_shutdown(dst,TRUE,&local_err);
 	if(local_err)
@@ -1684,17 +2173,11 @@ gboolean facq_file_to_human(const gchar *binfilename,const gchar *txtfilename,GE
 	
 	g_io_channel_unref(dst);
 
-	g_free(digest);
-	facq_stream_data_free(stmd);
 	return TRUE;
 
 	error:
-	if(srcfile)
-		facq_file_free(srcfile);
-	if(digest)
-		g_free(digest);
-	if(stmd)
-		facq_stream_data_free(stmd);
+	if(src)
+		facq_file_reader_free(src);
 	if(local_err)
 		g_propagate_error(err,local_err);
 	return FALSE;
@@ -1713,6 +2196,9 @@ gboolean facq_file_to_human(const gchar *binfilename,const gchar *txtfilename,GE
  * in the tail, and should be a multiple of n_channels in the header.
  * Finally the checksum should equal the checksum in the tail.
  *
+ * Version 2 files are verified with facq_file_reader_verify(), checking the
+ * blocks with a thread per processor and stopping at the first corrupt block.
+ *
  * Returns: %TRUE if the file can be verified, %FALSE in other case.
  */
 gboolean facq_file_verify(const gchar *filename,GError **err)
@@ -1725,14 +2211,28 @@ gboolean facq_file_verify(const gchar *filename,GError **err)
 	GChecksum *sum = NULL;
 	FacqStreamData *stmd_header = NULL;
 	GError *local_err = NULL;
+	FacqFileReader *reader = NULL;
 	gdouble sample = 0;
 	gsize bytes = 0;
+	gboolean ret = FALSE;
 
 	file = facq_file_open(filename,&local_err);
 	if(local_err){
 		g_propagate_error(err,local_err);
 		return FALSE;
 	}
+
+	if(file->priv->version != 1){
+		facq_file_free(file);
+		reader = facq_file_reader_new(filename,&local_err);
+		if(local_err){
+			g_propagate_error(err,local_err);
+			return FALSE;
+		}
+		ret = facq_file_reader_verify(reader,0,TRUE,NULL,err);
+		facq_file_reader_free(reader);
+		return ret;
+	}
 	
 	stmd_header = facq_file_read_header(file,&local_err);
 	if(local_err)
@@ -1861,6 +2361,11 @@ gboolean facq_file_chunk_iterator(FacqFile *file,guint64 start,guint64 chunks,Fa
 
 	g_return_val_if_fail(FACQ_IS_FILE(file),FALSE);
 
+	if(file->priv->compressed){
+		g_set_error_literal(&local_err,FACQ_FILE_ERROR,
+					       FACQ_FILE_ERROR_FAILED,"Iterator: Compressed files must be read with a FacqFileReader");
+		goto error;
+	}
 	if(chunks == 0 || itercb == NULL){
 		g_set_error_literal(&local_err,FACQ_FILE_ERROR,
 					       FACQ_FILE_ERROR_FAILED,"Iterator: Invalid input parameters");
@@ -1935,8 +2440,7 @@ gboolean facq_file_chunk_iterator(FacqFile *file,guint64 start,guint64 chunks,Fa
 			goto error;
 		if(rret != G_IO_STATUS_NORMAL)
 			goto error;
-		for(j = 0;j < n_channels;j++)
-			chunk[j] = GDOUBLE_TO_BE(chunk[j]);
+		gdouble_array_to_be(chunk,n_channels);
 		itercb(data,chunk);
 	}
 
@@ -23,6 +23,9 @@
 G_BEGIN_DECLS
 
 #define MAGIC_NUMBER 123581321
+#define MAGIC_NUMBER_V2 345589144
+#define MAGIC_NUMBER_V2Z 345589145
+#define FACQ_FILE_BLOCK_SIZE (1024*1024)
 #define FACQ_FILE_ERROR facq_file_error_quark()
 
 #define FACQ_TYPE_FILE (facq_file_get_type ())
@@ -60,9 +63,14 @@ GType facq_file_get_type(void) G_GNUC_CONST;
 
 FacqFile *facq_file_new(const gchar *filename,GError **err);
 void facq_file_reset(FacqFile *file,GError **err);
+void facq_file_set_version(FacqFile *file,guint version);
+guint facq_file_get_version(const FacqFile *file);
+void facq_file_set_compressed(FacqFile *file,gboolean compressed);
+gboolean facq_file_get_compressed(const FacqFile *file);
 gboolean facq_file_write_header(FacqFile *file,const FacqStreamData *stmd,GError **err);
 gint facq_file_poll(FacqFile *file);
 GIOStatus facq_file_write_samples(FacqFile *file,FacqChunk *chunk,GError **err);
+GIOStatus facq_file_write_samples_v(FacqFile *file,FacqChunk **chunks,guint n_chunks,GError **err);
 gboolean facq_file_write_tail(FacqFile *file,GError **err);
 gboolean facq_file_stop(FacqFile *file,GError **err);
 
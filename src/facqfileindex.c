@@ -0,0 +1,956 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <glib.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "gdouble.h"
+#include "facqunits.h"
+#include "facqchanlist.h"
+#include "facqstreamdata.h"
+#include "facqfilereader.h"
+#include "facqfileindex.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* magic, number of channels, decimation, number of levels and slices */
+#define FACQ_FILE_INDEX_HEADER_LEN 24
+/* more levels than needed by any file */
+#define FACQ_FILE_INDEX_MAX_LEVELS 56
+/* bins kept in memory by the writer before writing them to the file */
+#define FACQ_FILE_INDEX_BUFFER 1024
+/* slices read with each call by facq_file_index_build() */
+#define FACQ_FILE_INDEX_BUILD_SLICES (FACQ_FILE_INDEX_DECIMATION*256)
+
+/**
+ * SECTION:facqfileindex
+ * @short_description: Multi-resolution summary of a #FacqFile.
+ * @include:facqfileindex.h
+ * @see_also: #FacqFile, #FacqFileReader
+ *
+ * A #FacqFileIndex stores a summary of the samples of a binary acquisition
+ * file (BAF), so a zoomed out view of a long recording can be drawn without
+ * reading all the samples of the file.
+ *
+ * The summary is a pyramid of levels, in the level 0 each group of
+ * #FACQ_FILE_INDEX_DECIMATION slices is reduced to a bin with the minimum,
+ * the maximum and the mean value of each channel, see #FacqFileIndexBin, and
+ * each level halves the number of bins of the previous one, until there is a
+ * single bin for the whole file. This way a view of any length can be drawn
+ * reading about two bins per pixel, see facq_file_index_query().
+ *
+ * The index is stored in a separate file, next to the BAF file, with the
+ * same name ended in "idx", see facq_file_index_get_filename(), so the format
+ * of the BAF files doesn't change and files of any version can be indexed.
+ * The index file starts with a header with the magic number
+ * #FACQ_FILE_INDEX_MAGIC, the number of channels, the decimation of the level
+ * 0, the number of levels and the number of slices (In guint32 format
+ * except the number of slices that is in guint64 format), followed by the bins
+ * of each level in order. Each bin contains the minimum, the maximum and
+ * the mean of each channel in big endian gdouble format.
+ *
+ * The index is written with a #FacqFileIndexWriter while the file is being
+ * recorded, #FacqSinkFile does it, or later with facq_file_index_build(), for
+ * files that have been recorded without an index. The writer writes the bins
+ * of the level 0 while the samples arrive, and the rest of the levels are
+ * computed from the level 0 when facq_file_index_writer_finish() is called.
+ * The magic number is written at the end, so an unfinished index is never
+ * taken as valid.
+ *
+ * To use an index create a #FacqFileIndex with facq_file_index_new(), the
+ * file is mapped in memory. Check that the number of slices returned by
+ * facq_file_index_get_n_slices() matches the BAF file, and destroy it with
+ * facq_file_index_free() when no longer needed.
+ */
+
+/**
+ * FacqFileIndex:
+ *
+ * Contains the private details of the #FacqFileIndex.
+ */
+
+/**
+ * FacqFileIndexClass:
+ *
+ * Class for the #FacqFileIndex objects.
+ */
+
+/**
+ * FacqFileIndexError:
+ * @FACQ_FILE_INDEX_ERROR_FAILED: Some error happened in the #FacqFileIndex.
+ *
+ * Enum values for errors in #FacqFileIndex.
+ */
+
+/**
+ * FacqFileIndexBin:
+ * @min: The minimum value of the samples of a channel in the bin.
+ * @max: The maximum value of the samples of a channel in the bin.
+ * @mean: The mean value of the samples of a channel in the bin.
+ *
+ * The summary of the samples of a channel in a range of slices.
+ */
+
+/**
+ * FacqFileIndexWriter:
+ *
+ * An opaque structure used to write a new index file, see
+ * facq_file_index_writer_new().
+ */
+
+struct _FacqFileIndexWriter {
+	gchar *filename;
+	gint fd;
+	guint n_channels;
+	guint chan;
+	guint64 n_slices;
+	guint count;
+	gdouble *slice;
+	FacqFileIndexBin *acc;
+	FacqFileIndexBin *in;
+	gdouble *buf;
+	guint buf_bins;
+	guint64 offset;
+	gboolean finished;
+};
+
+static void facq_file_index_initable_iface_init(GInitableIface  *iface);
+static gboolean facq_file_index_initable_init(GInitable *initable,GCancellable *cancellable,GError **error);
+
+G_DEFINE_TYPE_WITH_CODE(FacqFileIndex,facq_file_index,G_TYPE_OBJECT,G_IMPLEMENT_INTERFACE(G_TYPE_INITABLE,facq_file_index_initable_iface_init));
+
+GQuark facq_file_index_error_quark(void)
+{
+	return g_quark_from_static_string("facq-file-index-error-quark");
+}
+
+enum {
+	PROP_0,
+	PROP_FILENAME
+};
+
+struct _FacqFileIndexPrivate {
+	GError *construct_error;
+	gchar *filename;
+	GMappedFile *map;
+	const guint8 *data;
+	guint n_channels;
+	guint decimation;
+	guint n_levels;
+	guint64 n_slices;
+	guint64 n_bins[FACQ_FILE_INDEX_MAX_LEVELS];
+	guint64 offset[FACQ_FILE_INDEX_MAX_LEVELS];
+};
+
+/* Private methods */
+static guint64 facq_file_index_count(guint64 n_slices,guint decimation,guint level,guint64 bin)
+{
+	guint64 size = (guint64)decimation << level;
+
+	return MIN(size,n_slices - bin*size);
+}
+
+static gboolean facq_file_index_pwrite(gint fd,guint64 offset,gconstpointer data,gsize len,GError **err)
+{
+	const gchar *pos = (const gchar *)data;
+	gssize ret = -1;
+
+#ifndef G_OS_UNIX
+	if(lseek(fd,offset,SEEK_SET) < 0)
+		goto error;
+#endif
+	while(len){
+#ifdef G_OS_UNIX
+		ret = pwrite(fd,pos,len,offset);
+#else
+		ret = write(fd,pos,len);
+#endif
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			goto error;
+		pos += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return TRUE;
+
+	error:
+	g_set_error(err,FACQ_FILE_INDEX_ERROR,FACQ_FILE_INDEX_ERROR_FAILED,
+			"Error writing the index: %s",
+			(ret == 0) ? "Can't write all bytes to file" : g_strerror(errno));
+	return FALSE;
+}
+
+static gboolean facq_file_index_pread(gint fd,guint64 offset,gpointer data,gsize len,GError **err)
+{
+	gchar *pos = (gchar *)data;
+	gssize ret = -1;
+
+#ifndef G_OS_UNIX
+	if(lseek(fd,offset,SEEK_SET) < 0)
+		goto error;
+#endif
+	while(len){
+#ifdef G_OS_UNIX
+		ret = pread(fd,pos,len,offset);
+#else
+		ret = read(fd,pos,len);
+#endif
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			goto error;
+		pos += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return TRUE;
+
+	error:
+	g_set_error(err,FACQ_FILE_INDEX_ERROR,FACQ_FILE_INDEX_ERROR_FAILED,
+			"Error reading the index: %s",
+			(ret == 0) ? "Unexpected end of file" : g_strerror(errno));
+	return FALSE;
+}
+
+static gboolean facq_file_index_writer_flush(FacqFileIndexWriter *writer,GError **err)
+{
+	gsize len = writer->buf_bins*writer->n_channels*sizeof(FacqFileIndexBin);
+
+	if(!len)
+		return TRUE;
+	if(!facq_file_index_pwrite(writer->fd,writer->offset,writer->buf,len,err))
+		return FALSE;
+	writer->offset += len;
+	writer->buf_bins = 0;
+	return TRUE;
+}
+
+/* Appends a bin, n_channels elements, converted to big endian to the output
+ * buffer, writing the buffer to the file when it's full. */
+static gboolean facq_file_index_writer_put(FacqFileIndexWriter *writer,const FacqFileIndexBin *bin,GError **err)
+{
+	gsize n = writer->n_channels*sizeof(FacqFileIndexBin)/sizeof(gdouble);
+
+	gdouble_array_copy_to_be(writer->buf + writer->buf_bins*n,
+					(const gdouble *)bin,n);
+	writer->buf_bins++;
+	if(writer->buf_bins == FACQ_FILE_INDEX_BUFFER)
+		return facq_file_index_writer_flush(writer,err);
+	return TRUE;
+}
+
+/* The mean of the bin being computed holds the sum of the samples until the
+ * bin is complete. */
+static gboolean facq_file_index_writer_emit(FacqFileIndexWriter *writer,GError **err)
+{
+	guint c = 0;
+
+	for(c = 0;c < writer->n_channels;c++)
+		writer->acc[c].mean /= writer->count;
+	writer->count = 0;
+	return facq_file_index_writer_put(writer,writer->acc,err);
+}
+
+/* Reads the n_bins bins of a level, stored at offset, and appends the bins of
+ * the next level to the file, each one made of two bins of the level. */
+static gboolean facq_file_index_writer_build_level(FacqFileIndexWriter *writer,guint level,guint64 offset,guint64 n_bins,GError **err)
+{
+	guint n_channels = writer->n_channels, c = 0;
+	gsize bin_len = n_channels*sizeof(FacqFileIndexBin);
+	guint64 first = 0, n = 0, k = 0, w0 = 0, w1 = 0;
+	FacqFileIndexBin *a = NULL, *b = NULL;
+
+	for(first = 0;first < n_bins;first += n){
+		n = MIN(n_bins - first,2*FACQ_FILE_INDEX_BUFFER);
+		if(!facq_file_index_pread(writer->fd,offset + first*bin_len,
+						writer->in,n*bin_len,err))
+			return FALSE;
+		gdouble_array_to_be((gdouble *)writer->in,n*bin_len/sizeof(gdouble));
+		for(k = 0;k < n;k += 2){
+			a = &writer->in[k*n_channels];
+			if(k + 1 == n){
+				if(!facq_file_index_writer_put(writer,a,err))
+					return FALSE;
+				continue;
+			}
+			b = &writer->in[(k + 1)*n_channels];
+			w0 = facq_file_index_count(writer->n_slices,
+					FACQ_FILE_INDEX_DECIMATION,level,first + k);
+			w1 = facq_file_index_count(writer->n_slices,
+					FACQ_FILE_INDEX_DECIMATION,level,first + k + 1);
+			for(c = 0;c < n_channels;c++){
+				writer->acc[c].min = MIN(a[c].min,b[c].min);
+				writer->acc[c].max = MAX(a[c].max,b[c].max);
+				writer->acc[c].mean = (a[c].mean*w0 + b[c].mean*w1)/(w0 + w1);
+			}
+			if(!facq_file_index_writer_put(writer,writer->acc,err))
+				return FALSE;
+		}
+	}
+	return facq_file_index_writer_flush(writer,err);
+}
+
+static gboolean facq_file_index_writer_write_header(FacqFileIndexWriter *writer,guint32 magic,guint32 n_levels,GError **err)
+{
+	guint8 header[FACQ_FILE_INDEX_HEADER_LEN];
+	guint32 u32 = 0;
+	guint64 u64 = 0;
+
+	u32 = GUINT32_TO_BE(magic);
+	memcpy(header,&u32,4);
+	u32 = GUINT32_TO_BE(writer->n_channels);
+	memcpy(header+4,&u32,4);
+	u32 = GUINT32_TO_BE(FACQ_FILE_INDEX_DECIMATION);
+	memcpy(header+8,&u32,4);
+	u32 = GUINT32_TO_BE(n_levels);
+	memcpy(header+12,&u32,4);
+	u64 = GUINT64_TO_BE(writer->n_slices);
+	memcpy(header+16,&u64,8);
+
+	return facq_file_index_pwrite(writer->fd,0,header,FACQ_FILE_INDEX_HEADER_LEN,err);
+}
+
+/* GObject magic */
+static void facq_file_index_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
+{
+	FacqFileIndex *index = FACQ_FILE_INDEX(self);
+
+	switch(property_id){
+	case PROP_FILENAME: g_value_set_string(value,index->priv->filename);
+	break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(index,property_id,pspec);
+	}
+}
+
+static void facq_file_index_set_property(GObject *self,guint property_id,const GValue *value,GParamSpec *pspec)
+{
+	FacqFileIndex *index = FACQ_FILE_INDEX(self);
+
+	switch(property_id){
+	case PROP_FILENAME: index->priv->filename = g_value_dup_string(value);
+	break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(index,property_id,pspec);
+	}
+}
+
+static void facq_file_index_finalize(GObject *self)
+{
+	FacqFileIndex *index = FACQ_FILE_INDEX(self);
+
+	g_clear_error(&index->priv->construct_error);
+
+	if(index->priv->map)
+		g_mapped_file_unref(index->priv->map);
+	if(index->priv->filename)
+		g_free(index->priv->filename);
+
+	if(G_OBJECT_CLASS(facq_file_index_parent_class)->finalize)
+    		(*G_OBJECT_CLASS(facq_file_index_parent_class)->finalize)(self);
+}
+
+static void facq_file_index_constructed(GObject *self)
+{
+	FacqFileIndex *index = FACQ_FILE_INDEX(self);
+	GError *local_err = NULL;
+	guint32 u32[4];
+	guint64 u64 = 0, size = 0, n_bins = 0;
+	gsize bin_len = 0;
+	guint level = 0;
+
+	index->priv->map = g_mapped_file_new(index->priv->filename,FALSE,&local_err);
+	if(local_err)
+		goto error;
+	index->priv->data = (const guint8 *)g_mapped_file_get_contents(index->priv->map);
+	size = g_mapped_file_get_length(index->priv->map);
+	if(size < FACQ_FILE_INDEX_HEADER_LEN)
+		goto invalid;
+
+	memcpy(u32,index->priv->data,16);
+	memcpy(&u64,index->priv->data+16,8);
+	if(GUINT32_FROM_BE(u32[0]) != FACQ_FILE_INDEX_MAGIC)
+		goto invalid;
+	index->priv->n_channels = GUINT32_FROM_BE(u32[1]);
+	index->priv->decimation = GUINT32_FROM_BE(u32[2]);
+	index->priv->n_levels = GUINT32_FROM_BE(u32[3]);
+	index->priv->n_slices = GUINT64_FROM_BE(u64);
+	if(!index->priv->n_channels || !index->priv->decimation ||
+		index->priv->n_levels > FACQ_FILE_INDEX_MAX_LEVELS)
+		goto invalid;
+
+	/* the levels go on until a single bin covers the whole file, the size
+	 * of the file must match the number of bins of all the levels */
+	bin_len = index->priv->n_channels*sizeof(FacqFileIndexBin);
+	n_bins = (index->priv->n_slices + index->priv->decimation - 1)/
+							index->priv->decimation;
+	u64 = FACQ_FILE_INDEX_HEADER_LEN;
+	while(n_bins && level < FACQ_FILE_INDEX_MAX_LEVELS){
+		if(n_bins > (size - u64)/bin_len)
+			goto invalid;
+		index->priv->n_bins[level] = n_bins;
+		index->priv->offset[level] = u64;
+		u64 += n_bins*bin_len;
+		level++;
+		n_bins = (n_bins == 1) ? 0 : (n_bins + 1)/2;
+	}
+	if(level != index->priv->n_levels || u64 != size)
+		goto invalid;
+	return;
+
+	invalid:
+	g_set_error_literal(&local_err,FACQ_FILE_INDEX_ERROR,
+			FACQ_FILE_INDEX_ERROR_FAILED,
+				"The index file isn't valid");
+	error:
+	if(local_err)
+		g_propagate_error(&index->priv->construct_error,local_err);
+}
+
+static void facq_file_index_class_init(FacqFileIndexClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	g_type_class_add_private(klass,sizeof(FacqFileIndexPrivate));
+
+	object_class->set_property = facq_file_index_set_property;
+	object_class->get_property = facq_file_index_get_property;
+	object_class->constructed = facq_file_index_constructed;
+	object_class->finalize = facq_file_index_finalize;
+
+	g_object_class_install_property(object_class,PROP_FILENAME,
+					g_param_spec_string("filename",
+							    "Filename",
+							    "The filename of the index",
+							    "Unknown",
+							    G_PARAM_READWRITE |
+							    G_PARAM_CONSTRUCT_ONLY |
+							    G_PARAM_STATIC_STRINGS));
+}
+
+static void facq_file_index_init(FacqFileIndex *index)
+{
+	index->priv = G_TYPE_INSTANCE_GET_PRIVATE(index,FACQ_TYPE_FILE_INDEX,FacqFileIndexPrivate);
+	index->priv->construct_error = NULL;
+	index->priv->filename = NULL;
+	index->priv->map = NULL;
+	index->priv->data = NULL;
+	index->priv->n_channels = 0;
+	index->priv->decimation = 0;
+	index->priv->n_levels = 0;
+	index->priv->n_slices = 0;
+}
+
+/* GInitable interface */
+static void facq_file_index_initable_iface_init(GInitableIface *iface)
+{
+	iface->init = facq_file_index_initable_init;
+}
+
+static gboolean facq_file_index_initable_init(GInitable *initable,GCancellable *cancellable,GError  **error)
+{
+	FacqFileIndex *index;
+
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(initable),FALSE);
+	index = FACQ_FILE_INDEX(initable);
+	if(cancellable != NULL){
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			"Cancellable initialization not supported");
+		return FALSE;
+	}
+	if(index->priv->construct_error){
+		if(error)
+			*error = g_error_copy(index->priv->construct_error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Public methods */
+
+/**
+ * facq_file_index_get_filename:
+ * @filename: The filename of a #FacqFile.
+ *
+ * Returns: The filename of the index of the file @filename, in the same
+ * encoding, free it with g_free().
+ */
+gchar *facq_file_index_get_filename(const gchar *filename)
+{
+	g_return_val_if_fail(filename != NULL,NULL);
+
+	return g_strconcat(filename,"idx",NULL);
+}
+
+/**
+ * facq_file_index_new:
+ * @filename: The filename of the index, in the filesystem encoding, see
+ * facq_file_index_get_filename().
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Opens the index @filename, mapping it in memory, and checks that the size
+ * of the file matches the header.
+ *
+ * Returns: A new #FacqFileIndex or %NULL in case of error.
+ */
+FacqFileIndex *facq_file_index_new(const gchar *filename,GError **err)
+{
+	return g_initable_new(FACQ_TYPE_FILE_INDEX,NULL,err,
+					"filename",filename,
+					NULL);
+}
+
+/**
+ * facq_file_index_get_n_slices:
+ * @index: A #FacqFileIndex object.
+ *
+ * Returns: The number of slices of the indexed file.
+ */
+guint64 facq_file_index_get_n_slices(const FacqFileIndex *index)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),0);
+
+	return index->priv->n_slices;
+}
+
+/**
+ * facq_file_index_get_n_channels:
+ * @index: A #FacqFileIndex object.
+ *
+ * Returns: The number of channels of the indexed file.
+ */
+guint facq_file_index_get_n_channels(const FacqFileIndex *index)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),0);
+
+	return index->priv->n_channels;
+}
+
+/**
+ * facq_file_index_get_n_levels:
+ * @index: A #FacqFileIndex object.
+ *
+ * Returns: The number of levels in the index, 0 if the file is empty.
+ */
+guint facq_file_index_get_n_levels(const FacqFileIndex *index)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),0);
+
+	return index->priv->n_levels;
+}
+
+/**
+ * facq_file_index_get_n_bins:
+ * @index: A #FacqFileIndex object.
+ * @level: A level of the index.
+ *
+ * Each bin of the level @level covers the decimation of the index multiplied
+ * by 2 raised to @level slices, except the last one that can cover less.
+ *
+ * Returns: The number of bins of the level @level, or 0 if the level doesn't
+ * exist.
+ */
+guint64 facq_file_index_get_n_bins(const FacqFileIndex *index,guint level)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),0);
+
+	if(level >= index->priv->n_levels)
+		return 0;
+	return index->priv->n_bins[level];
+}
+
+/**
+ * facq_file_index_get_bins:
+ * @index: A #FacqFileIndex object.
+ * @level: A level of the index.
+ * @first: The first bin.
+ * @n_bins: The number of bins.
+ * @dst: A #FacqFileIndexBin array with space for @n_bins*n_channels elements.
+ *
+ * Copies the bins from @first to @first+@n_bins-1 of the level @level to
+ * @dst, the values of the channels of each bin are consecutive.
+ *
+ * Returns: %TRUE if successful, %FALSE if the bins are out of range.
+ */
+gboolean facq_file_index_get_bins(const FacqFileIndex *index,guint level,guint64 first,guint64 n_bins,FacqFileIndexBin *dst)
+{
+	gsize n = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),FALSE);
+	g_return_val_if_fail(dst != NULL,FALSE);
+
+	if(level >= index->priv->n_levels || first >= index->priv->n_bins[level] ||
+		n_bins > index->priv->n_bins[level] - first)
+		return FALSE;
+
+	n = index->priv->n_channels*sizeof(FacqFileIndexBin)/sizeof(gdouble);
+	gdouble_array_copy_to_be((gdouble *)dst,
+			(const gdouble *)(index->priv->data + index->priv->offset[level]) +
+								first*n,n_bins*n);
+	return TRUE;
+}
+
+/**
+ * facq_file_index_query:
+ * @index: A #FacqFileIndex object.
+ * @start: The first slice of the view.
+ * @n_slices: The number of slices of the view.
+ * @n_pixels: The number of pixels, or columns, of the view.
+ * @dst: A #FacqFileIndexBin array with space for @n_pixels*n_channels
+ * elements.
+ *
+ * Computes the minimum, maximum and mean values of each channel for each of
+ * the @n_pixels columns of a view of @n_slices slices, starting at @start.
+ * The coarsest level with bins no bigger than a column is used, so each
+ * column is made of one or two bins, and the cost depends on @n_pixels, not
+ * on @n_slices.
+ *
+ * When a column is smaller than the bins of the level 0, the columns are
+ * made of the bins that contain them, so the view will look blocky, in this
+ * case it's better to read the samples with facq_file_reader_read().
+ *
+ * Returns: %TRUE if successful, %FALSE if @start is out of range or there are
+ * no pixels. The slices beyond the end of the file are ignored.
+ */
+gboolean facq_file_index_query(const FacqFileIndex *index,guint64 start,guint64 n_slices,guint n_pixels,FacqFileIndexBin *dst)
+{
+	const gdouble *bins = NULL, *bin = NULL;
+	guint64 size = 0, s0 = 0, s1 = 0, b = 0, b1 = 0, w = 0, total = 0;
+	guint n_channels = 0, level = 0, p = 0, c = 0;
+	FacqFileIndexBin *col = NULL;
+	gdouble spp = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_INDEX(index),FALSE);
+	g_return_val_if_fail(dst != NULL,FALSE);
+
+	if(!n_pixels || !n_slices || start >= index->priv->n_slices)
+		return FALSE;
+	n_slices = MIN(n_slices,index->priv->n_slices - start);
+	n_channels = index->priv->n_channels;
+
+	spp = (gdouble)n_slices/n_pixels;
+	while(level + 1 < index->priv->n_levels &&
+		(gdouble)((guint64)index->priv->decimation << (level + 1)) <= spp)
+		level++;
+	size = (guint64)index->priv->decimation << level;
+	bins = (const gdouble *)(index->priv->data + index->priv->offset[level]);
+
+	for(p = 0;p < n_pixels;p++){
+		s0 = start + (guint64)(spp*p);
+		s1 = start + (guint64)(spp*(p + 1));
+		if(s1 <= s0)
+			s1 = s0 + 1;
+		b1 = MIN((s1 - 1)/size,index->priv->n_bins[level] - 1);
+		col = &dst[p*n_channels];
+		total = 0;
+		for(b = s0/size;b <= b1;b++){
+			bin = bins + b*n_channels*3;
+			w = facq_file_index_count(index->priv->n_slices,
+					index->priv->decimation,level,b);
+			for(c = 0;c < n_channels;c++){
+				if(!total){
+					col[c].min = GDOUBLE_TO_BE(bin[c*3]);
+					col[c].max = GDOUBLE_TO_BE(bin[c*3+1]);
+					col[c].mean = 0;
+				}
+				else {
+					col[c].min = MIN(col[c].min,GDOUBLE_TO_BE(bin[c*3]));
+					col[c].max = MAX(col[c].max,GDOUBLE_TO_BE(bin[c*3+1]));
+				}
+				col[c].mean += GDOUBLE_TO_BE(bin[c*3+2])*w;
+			}
+			total += w;
+		}
+		for(c = 0;c < n_channels;c++)
+			col[c].mean /= total;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_file_index_free:
+ * @index: A #FacqFileIndex object.
+ *
+ * Destroys the #FacqFileIndex, @index, unmapping the file.
+ */
+void facq_file_index_free(FacqFileIndex *index)
+{
+	g_return_if_fail(FACQ_IS_FILE_INDEX(index));
+	g_object_unref(G_OBJECT(index));
+}
+
+/**
+ * facq_file_index_writer_new:
+ * @filename: The filename of the index, in the filesystem encoding, see
+ * facq_file_index_get_filename().
+ * @n_channels: The number of channels of the file.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Creates a new index file, @filename, replacing any previous file with the
+ * same name. Give the samples of the file to the writer with
+ * facq_file_index_writer_push(), and call facq_file_index_writer_finish() when
+ * all the samples have been pushed.
+ *
+ * Returns: A new #FacqFileIndexWriter or %NULL in case of error.
+ */
+FacqFileIndexWriter *facq_file_index_writer_new(const gchar *filename,guint n_channels,GError **err)
+{
+	FacqFileIndexWriter *writer = NULL;
+	GError *local_err = NULL;
+	gint fd = -1;
+
+	g_return_val_if_fail(filename != NULL,NULL);
+	g_return_val_if_fail(n_channels > 0,NULL);
+
+	fd = g_open(filename,O_RDWR | O_CREAT | O_TRUNC | O_BINARY,0666);
+	if(fd < 0){
+		g_set_error(err,FACQ_FILE_INDEX_ERROR,
+				FACQ_FILE_INDEX_ERROR_FAILED,
+					"Error creating the index: %s",g_strerror(errno));
+		return NULL;
+	}
+	writer = g_new0(FacqFileIndexWriter,1);
+	writer->filename = g_strdup(filename);
+	writer->n_channels = n_channels;
+	writer->fd = fd;
+	writer->slice = g_new0(gdouble,n_channels);
+	writer->acc = g_new0(FacqFileIndexBin,n_channels);
+	writer->in = g_new(FacqFileIndexBin,2*FACQ_FILE_INDEX_BUFFER*n_channels);
+	writer->buf = g_malloc(FACQ_FILE_INDEX_BUFFER*n_channels*sizeof(FacqFileIndexBin));
+	writer->offset = FACQ_FILE_INDEX_HEADER_LEN;
+
+	/* the magic number is written by facq_file_index_writer_finish() */
+	if(!facq_file_index_writer_write_header(writer,0,0,&local_err))
+		goto error;
+
+	return writer;
+
+	error:
+	facq_file_index_writer_free(writer);
+	if(local_err)
+		g_propagate_error(err,local_err);
+	return NULL;
+}
+
+/**
+ * facq_file_index_writer_push:
+ * @writer: A #FacqFileIndexWriter.
+ * @samples: The samples, in the native format, with the channels interleaved
+ * like in a #FacqChunk.
+ * @n_samples: The number of samples, it doesn't need to be a multiple of the
+ * number of channels.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Adds the samples to the bin of the level 0 being computed, each time a bin
+ * is completed it's appended to the index. The samples of an incomplete slice
+ * are kept apart until the rest of the slice is pushed.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_file_index_writer_push(FacqFileIndexWriter *writer,const gdouble *samples,gsize n_samples,GError **err)
+{
+	FacqFileIndexBin *acc = NULL;
+	gsize i = 0;
+	guint c = 0;
+
+	g_return_val_if_fail(writer != NULL,FALSE);
+	g_return_val_if_fail(!writer->finished,FALSE);
+
+	for(i = 0;i < n_samples;i++){
+		writer->slice[writer->chan] = samples[i];
+		writer->chan++;
+		if(writer->chan < writer->n_channels)
+			continue;
+		writer->chan = 0;
+		/* the slice is complete, add it to the bin */
+		for(c = 0;c < writer->n_channels;c++){
+			acc = &writer->acc[c];
+			if(!writer->count){
+				acc->min = acc->max = acc->mean = writer->slice[c];
+			}
+			else {
+				acc->min = MIN(acc->min,writer->slice[c]);
+				acc->max = MAX(acc->max,writer->slice[c]);
+				acc->mean += writer->slice[c];
+			}
+		}
+		writer->n_slices++;
+		writer->count++;
+		if(writer->count == FACQ_FILE_INDEX_DECIMATION &&
+			!facq_file_index_writer_emit(writer,err))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_file_index_writer_finish:
+ * @writer: A #FacqFileIndexWriter.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Writes the last bin of the level 0, computes the rest of the levels from
+ * the level 0, and writes the header, closing the file. A trailing incomplete
+ * slice is ignored, like in the #FacqFile. After calling this
+ * function the writer can only be freed.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_file_index_writer_finish(FacqFileIndexWriter *writer,GError **err)
+{
+	gsize bin_len = 0;
+	guint64 n_bins = 0, offset = FACQ_FILE_INDEX_HEADER_LEN;
+	guint n_levels = 0;
+
+	g_return_val_if_fail(writer != NULL,FALSE);
+	g_return_val_if_fail(!writer->finished,FALSE);
+
+	if(writer->count && !facq_file_index_writer_emit(writer,err))
+		return FALSE;
+	if(!facq_file_index_writer_flush(writer,err))
+		return FALSE;
+
+	bin_len = writer->n_channels*sizeof(FacqFileIndexBin);
+	n_bins = (writer->n_slices + FACQ_FILE_INDEX_DECIMATION - 1)/
+						FACQ_FILE_INDEX_DECIMATION;
+	if(n_bins)
+		n_levels = 1;
+	while(n_bins > 1){
+		if(!facq_file_index_writer_build_level(writer,n_levels - 1,
+						offset,n_bins,err))
+			return FALSE;
+		offset += n_bins*bin_len;
+		n_bins = (n_bins + 1)/2;
+		n_levels++;
+	}
+
+	if(!facq_file_index_writer_write_header(writer,FACQ_FILE_INDEX_MAGIC,
+							n_levels,err))
+		return FALSE;
+	if(close(writer->fd) != 0){
+		writer->fd = -1;
+		g_set_error(err,FACQ_FILE_INDEX_ERROR,FACQ_FILE_INDEX_ERROR_FAILED,
+				"Error closing the index: %s",g_strerror(errno));
+		return FALSE;
+	}
+	writer->fd = -1;
+	writer->finished = TRUE;
+	return TRUE;
+}
+
+/**
+ * facq_file_index_writer_free:
+ * @writer: A #FacqFileIndexWriter.
+ *
+ * Destroys the @writer, if facq_file_index_writer_finish() hasn't been called
+ * or it failed the index file is removed.
+ */
+void facq_file_index_writer_free(FacqFileIndexWriter *writer)
+{
+	g_return_if_fail(writer != NULL);
+
+	if(writer->fd >= 0)
+		close(writer->fd);
+	if(!writer->finished)
+		g_remove(writer->filename);
+	g_free(writer->filename);
+	g_free(writer->slice);
+	g_free(writer->acc);
+	g_free(writer->in);
+	g_free(writer->buf);
+	g_free(writer);
+}
+
+/**
+ * facq_file_index_build:
+ * @filename: The filename of a #FacqFile, in the filesystem encoding.
+ * @cancellable: (allow-none): A #GCancellable or %NULL.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Reads all the samples of the file @filename, of any version, and writes
+ * its index, see facq_file_index_get_filename(). Use it for files recorded
+ * without an index, it can take some time in big files, so it can be called
+ * from a thread and stopped with g_cancellable_cancel(), in this case the
+ * index isn't written and @err is set to %G_IO_ERROR_CANCELLED.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_file_index_build(const gchar *filename,GCancellable *cancellable,GError **err)
+{
+	FacqFileReader *reader = NULL;
+	FacqFileIndexWriter *writer = NULL;
+	const FacqStreamData *stmd = NULL;
+	GError *local_err = NULL;
+	gchar *index_filename = NULL;
+	gdouble *buf = NULL;
+	guint64 n_slices = 0, start = 0, n = 0;
+
+	g_return_val_if_fail(filename != NULL,FALSE);
+
+	reader = facq_file_reader_new(filename,&local_err);
+	if(local_err)
+		goto error;
+	stmd = facq_file_reader_get_stream_data(reader);
+	n_slices = facq_file_reader_get_n_slices(reader);
+
+	index_filename = facq_file_index_get_filename(filename);
+	writer = facq_file_index_writer_new(index_filename,stmd->n_channels,&local_err);
+	g_free(index_filename);
+	if(local_err)
+		goto error;
+
+	buf = g_new(gdouble,(gsize)FACQ_FILE_INDEX_BUILD_SLICES*stmd->n_channels);
+	for(start = 0;start < n_slices;start += n){
+		if(g_cancellable_set_error_if_cancelled(cancellable,&local_err))
+			goto error;
+		n = MIN(n_slices - start,FACQ_FILE_INDEX_BUILD_SLICES);
+		if(!facq_file_reader_read(reader,start,n,buf,&local_err))
+			goto error;
+		if(!facq_file_index_writer_push(writer,buf,n*stmd->n_channels,&local_err))
+			goto error;
+	}
+	if(!facq_file_index_writer_finish(writer,&local_err))
+		goto error;
+
+	g_free(buf);
+	facq_file_index_writer_free(writer);
+	facq_file_reader_free(reader);
+	return TRUE;
+
+	error:
+	if(buf)
+		g_free(buf);
+	if(writer)
+		facq_file_index_writer_free(writer);
+	if(reader)
+		facq_file_reader_free(reader);
+	if(local_err)
+		g_propagate_error(err,local_err);
+	return FALSE;
+}
@@ -0,0 +1,84 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef _FREEACQ_FILE_INDEX_H_
+#define _FREEACQ_FILE_INDEX_H_
+
+G_BEGIN_DECLS
+
+#define FACQ_FILE_INDEX_ERROR facq_file_index_error_quark()
+
+#define FACQ_FILE_INDEX_MAGIC 345589160
+#define FACQ_FILE_INDEX_DECIMATION 256
+
+#define FACQ_TYPE_FILE_INDEX (facq_file_index_get_type ())
+#define FACQ_FILE_INDEX(inst) (G_TYPE_CHECK_INSTANCE_CAST ((inst),FACQ_TYPE_FILE_INDEX, FacqFileIndex))
+#define FACQ_FILE_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass),FACQ_TYPE_FILE_INDEX, FacqFileIndexClass))
+#define FACQ_IS_FILE_INDEX(inst) (G_TYPE_CHECK_INSTANCE_TYPE ((inst),FACQ_TYPE_FILE_INDEX))
+#define FACQ_IS_FILE_INDEX_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_FILE_INDEX))
+#define FACQ_FILE_INDEX_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_FILE_INDEX, FacqFileIndexClass))
+
+typedef struct _FacqFileIndex FacqFileIndex;
+typedef struct _FacqFileIndexClass FacqFileIndexClass;
+typedef struct _FacqFileIndexPrivate FacqFileIndexPrivate;
+typedef struct _FacqFileIndexWriter FacqFileIndexWriter;
+
+typedef enum {
+	FACQ_FILE_INDEX_ERROR_FAILED
+} FacqFileIndexError;
+
+typedef struct _FacqFileIndexBin {
+	gdouble min;
+	gdouble max;
+	gdouble mean;
+} FacqFileIndexBin;
+
+struct _FacqFileIndex {
+	/*< private >*/
+	GObject parent_instance;
+	FacqFileIndexPrivate *priv;
+};
+
+struct _FacqFileIndexClass {
+	/*< private >*/
+	GObjectClass parent_class;
+};
+
+GType facq_file_index_get_type(void) G_GNUC_CONST;
+
+gchar *facq_file_index_get_filename(const gchar *filename);
+FacqFileIndex *facq_file_index_new(const gchar *filename,GError **err);
+guint64 facq_file_index_get_n_slices(const FacqFileIndex *index);
+guint facq_file_index_get_n_channels(const FacqFileIndex *index);
+guint facq_file_index_get_n_levels(const FacqFileIndex *index);
+guint64 facq_file_index_get_n_bins(const FacqFileIndex *index,guint level);
+gboolean facq_file_index_get_bins(const FacqFileIndex *index,guint level,guint64 first,guint64 n_bins,FacqFileIndexBin *dst);
+gboolean facq_file_index_query(const FacqFileIndex *index,guint64 start,guint64 n_slices,guint n_pixels,FacqFileIndexBin *dst);
+void facq_file_index_free(FacqFileIndex *index);
+
+FacqFileIndexWriter *facq_file_index_writer_new(const gchar *filename,guint n_channels,GError **err);
+gboolean facq_file_index_writer_push(FacqFileIndexWriter *writer,const gdouble *samples,gsize n_samples,GError **err);
+gboolean facq_file_index_writer_finish(FacqFileIndexWriter *writer,GError **err);
+void facq_file_index_writer_free(FacqFileIndexWriter *writer);
+
+gboolean facq_file_index_build(const gchar *filename,GCancellable *cancellable,GError **err);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1083 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <glib.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#if HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#include "facqglibcompat.h"
+#include "gdouble.h"
+#include "facqunits.h"
+#include "facqchanlist.h"
+#include "facqstreamdata.h"
+#include "facqchunk.h"
+#include "facqcrc.h"
+#include "facqcompress.h"
+#include "facqfile.h"
+#include "facqfilereader.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* written samples and digest */
+#define FACQ_FILE_READER_TAIL_LEN 40
+/* bytes read with each system call when the file is not mapped */
+#define FACQ_FILE_READER_BLOCK (4*1024*1024)
+/* maximum number of threads used by facq_file_reader_verify() */
+#define FACQ_FILE_READER_MAX_THREADS 64
+
+/**
+ * SECTION:facqfilereader
+ * @short_description: Random access to the samples of a #FacqFile.
+ * @include:facqfilereader.h
+ * @see_also: #FacqFile
+ *
+ * A #FacqFileReader provides fast random access to the samples stored in a
+ * #FacqFile, the binary acquisition files (BAF). While
+ * facq_file_chunk_iterator() reads the file a slice at a time, a
+ * #FacqFileReader maps the whole file in memory, so any range of slices can be
+ * reached without seeking and read without copying the data to intermediate
+ * buffers.
+ *
+ * Create a new #FacqFileReader with facq_file_reader_new(), the header and the
+ * tail of the file are read and checked, the #FacqStreamData can be retrieved
+ * with facq_file_reader_get_stream_data() and the number of slices in the file
+ * with facq_file_reader_get_n_slices(). To find the first slice of a time
+ * window use facq_file_reader_get_slice_at().
+ *
+ * facq_file_reader_peek() returns a pointer to the slices inside the mapped
+ * file, the samples are in big endian format like in the file.
+ * facq_file_reader_read() copies the slices to a buffer provided by the caller
+ * converting them to the native format at the same time.
+ *
+ * If the file can't be mapped, because the system doesn't support it or
+ * because there is not enough address space, facq_file_reader_read() reads
+ * the samples with large reads directly to the caller buffer, and
+ * facq_file_reader_peek() always returns %NULL. You can check if the file is
+ * mapped with facq_file_reader_is_mapped().
+ *
+ * In compressed files the position of each block is taken from the table of
+ * blocks, and facq_file_reader_read() decompresses only the blocks that
+ * contain the requested slices, the last decompressed block is kept, so
+ * reading consecutive ranges decompresses each block once.
+ * facq_file_reader_peek() always returns %NULL for compressed files.
+ *
+ * facq_file_reader_verify() checks the integrity of the file. In version 2
+ * files, see <link linkend="facqfile-v2">Version 2</link>, the blocks are
+ * checked in parallel by several threads, and the time ranges of the corrupt
+ * blocks are reported, see #FacqFileReaderRange. The verification can take
+ * some time in big files, so it's usually done in a separate thread, the
+ * progress can be followed with facq_file_reader_get_progress() and it can be
+ * interrupted with facq_file_reader_cancel().
+ *
+ * A #FacqFileReader is not thread safe, use a #FacqFileReader per thread, the
+ * only exceptions are facq_file_reader_get_progress() and
+ * facq_file_reader_cancel().
+ * Destroy it with facq_file_reader_free() when no longer needed.
+ */
+
+/**
+ * FacqFileReader:
+ *
+ * Contains the private details of the #FacqFileReader.
+ */
+
+/**
+ * FacqFileReaderClass:
+ *
+ * Class for the #FacqFileReader objects.
+ */
+
+/**
+ * FacqFileReaderError:
+ * @FACQ_FILE_READER_ERROR_FAILED: Some error happened in the #FacqFileReader.
+ * @FACQ_FILE_READER_ERROR_CORRUPT: The file is corrupt.
+ * @FACQ_FILE_READER_ERROR_CANCELLED: The verification has been cancelled.
+ *
+ * Enum values for errors in #FacqFileReader.
+ */
+
+/**
+ * FacqFileReaderRange:
+ * @start: The start of the range, in seconds since the start of the
+ * acquisition.
+ * @end: The end of the range, in seconds since the start of the acquisition.
+ *
+ * A time range in the file, it's used by facq_file_reader_verify() to report
+ * the corrupt parts of the file.
+ */
+
+static void facq_file_reader_initable_iface_init(GInitableIface  *iface);
+static gboolean facq_file_reader_initable_init(GInitable *initable,GCancellable *cancellable,GError **error);
+
+G_DEFINE_TYPE_WITH_CODE(FacqFileReader,facq_file_reader,G_TYPE_OBJECT,G_IMPLEMENT_INTERFACE(G_TYPE_INITABLE,facq_file_reader_initable_iface_init));
+
+GQuark facq_file_reader_error_quark(void)
+{
+	return g_quark_from_static_string("facq-file-reader-error-quark");
+}
+
+enum {
+	PROP_0,
+	PROP_FILENAME
+};
+
+struct _FacqFileReaderPrivate {
+	GError *construct_error;
+	gchar *filename;
+	FacqStreamData *stmd;
+	guint64 n_slices;
+	gint fd;
+	guint64 size;
+	guint64 data_offset;
+	guint8 *map;
+	guint version;
+	guint8 digest[32];
+	guint32 block_size;
+	guint32 n_blocks;
+	guint32 *table;
+	gboolean compressed;
+	guint64 *offsets;
+	FacqCompress *codec;
+	guint8 *zblock;
+	guint8 *zin;
+	gint64 zcached;
+	gint cancelled;
+	gint done;
+	guint total;
+};
+
+typedef struct _FacqFileReaderVerify {
+	FacqFileReader *reader;
+	guint first;
+	guint step;
+	gboolean stop;
+	gint *failed;
+	gboolean cancelled;
+	guint8 *bad;
+	GError *err;
+} FacqFileReaderVerify;
+
+/* Private methods */
+static gboolean facq_file_reader_pread(FacqFileReader *reader,guint64 offset,gpointer data,gsize len,GError **err)
+{
+	gchar *pos = (gchar *)data;
+	gssize ret = -1;
+
+#ifndef G_OS_UNIX
+	if(lseek(reader->priv->fd,offset,SEEK_SET) < 0)
+		goto error;
+#endif
+	while(len){
+#ifdef G_OS_UNIX
+		ret = pread(reader->priv->fd,pos,len,offset);
+#else
+		ret = read(reader->priv->fd,pos,len);
+#endif
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			goto error;
+		pos += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return TRUE;
+
+	error:
+	g_set_error(err,FACQ_FILE_READER_ERROR,FACQ_FILE_READER_ERROR_FAILED,
+			"Error reading the file: %s",
+			(ret == 0) ? "Unexpected end of file" : g_strerror(errno));
+	return FALSE;
+}
+
+static void facq_file_reader_map(FacqFileReader *reader)
+{
+#if HAVE_SYS_MMAN_H
+	gpointer map = NULL;
+
+	if(reader->priv->size > G_MAXSIZE)
+		return;
+	map = mmap(NULL,reader->priv->size,PROT_READ,MAP_SHARED,reader->priv->fd,0);
+	if(map == MAP_FAILED)
+		return;
+	reader->priv->map = map;
+#endif
+}
+
+static guint64 facq_file_reader_get_data_size(const FacqFileReader *reader)
+{
+	return reader->priv->n_slices*reader->priv->stmd->n_channels*sizeof(gdouble);
+}
+
+/* The number of bytes of the original block b */
+static gsize facq_file_reader_get_block_len(const FacqFileReader *reader,guint b)
+{
+	return MIN(reader->priv->block_size,
+		facq_file_reader_get_data_size(reader) - (guint64)b*reader->priv->block_size);
+}
+
+/* Entries in the table of blocks, the checksum of each block, plus the length
+ * of each block in compressed files, and the block size */
+static guint64 facq_file_reader_get_table_len(const FacqFileReader *reader)
+{
+	return ((reader->priv->compressed) ? 2 : 1)*(guint64)reader->priv->n_blocks + 1;
+}
+
+/* Reads the block size and the checksum of each block, stored after the
+ * samples in version 2 files, the table is kept in big endian so the digest
+ * can be computed over it. In compressed files the position of each block is
+ * computed from the lengths in the table. */
+static gboolean facq_file_reader_read_table(FacqFileReader *reader,GError **err)
+{
+	guint64 data_size = 0, table_offset = 0, table_len = 0, len = 0;
+	guint32 block_size = 0;
+	guint b = 0;
+
+	data_size = facq_file_reader_get_data_size(reader);
+	if(!facq_file_reader_pread(reader,
+			reader->priv->size - FACQ_FILE_READER_TAIL_LEN - sizeof(guint32),
+				&block_size,sizeof(guint32),err))
+		return FALSE;
+	block_size = GUINT32_FROM_BE(block_size);
+	if(!block_size || block_size % sizeof(gdouble))
+		goto error;
+	reader->priv->block_size = block_size;
+	reader->priv->n_blocks = (data_size + block_size - 1)/block_size;
+	table_len = facq_file_reader_get_table_len(reader)*sizeof(guint32);
+	if(reader->priv->size < reader->priv->data_offset + table_len +
+					FACQ_FILE_READER_TAIL_LEN)
+		goto error;
+	table_offset = reader->priv->size - FACQ_FILE_READER_TAIL_LEN - table_len;
+	if(!reader->priv->compressed &&
+		table_offset != reader->priv->data_offset + data_size)
+		goto error;
+
+	reader->priv->table = g_malloc(table_len);
+	if(!facq_file_reader_pread(reader,table_offset,reader->priv->table,
+							table_len,err))
+		return FALSE;
+	if(!reader->priv->compressed)
+		return TRUE;
+
+	reader->priv->offsets = g_new(guint64,reader->priv->n_blocks+1);
+	reader->priv->offsets[0] = reader->priv->data_offset;
+	for(b = 0;b < reader->priv->n_blocks;b++){
+		len = GUINT32_FROM_BE(reader->priv->table[2*b+1]);
+		if(!len || len > facq_file_reader_get_block_len(reader,b))
+			goto error;
+		reader->priv->offsets[b+1] = reader->priv->offsets[b] + len;
+	}
+	if(reader->priv->offsets[reader->priv->n_blocks] != table_offset)
+		goto error;
+	return TRUE;
+
+	error:
+	g_set_error_literal(err,FACQ_FILE_READER_ERROR,
+			FACQ_FILE_READER_ERROR_CORRUPT,
+				"The table of blocks is corrupt");
+	return FALSE;
+}
+
+/* Adds the time range of the bytes from start to end of the samples area to
+ * corrupt, joining it with the previous range if they are contiguous */
+static void facq_file_reader_add_range(FacqFileReader *reader,GArray *corrupt,guint64 start,guint64 end)
+{
+	FacqFileReaderRange range, *last = NULL;
+	guint64 slice_size = reader->priv->stmd->n_channels*sizeof(gdouble);
+
+	range.start = (start/slice_size)*reader->priv->stmd->period;
+	range.end = ((end + slice_size - 1)/slice_size)*reader->priv->stmd->period;
+	if(corrupt->len){
+		last = &g_array_index(corrupt,FacqFileReaderRange,corrupt->len-1);
+		if(last->end >= range.start){
+			last->end = range.end;
+			return;
+		}
+	}
+	g_array_append_val(corrupt,range);
+}
+
+/* Computes the digest over the header, the samples (only in version 1) or the
+ * table of blocks (version 2), and the number of samples, and compares it
+ * with the digest in the tail. */
+static gboolean facq_file_reader_check_digest(FacqFileReader *reader,GError **err)
+{
+	GChecksum *sum = NULL;
+	guint32 magic = 0;
+	guint64 written_samples = 0, offset = 0, len = 0;
+	gsize block = 0, digest_len = 32;
+	guint8 digest[32], *buf = NULL;
+	gboolean ret = FALSE;
+
+	sum = g_checksum_new(G_CHECKSUM_SHA256);
+	if(reader->priv->version == 1)
+		magic = MAGIC_NUMBER;
+	else
+		magic = (reader->priv->compressed) ? MAGIC_NUMBER_V2Z : MAGIC_NUMBER_V2;
+	magic = GUINT32_TO_BE(magic);
+	g_checksum_update(sum,(guchar *)&magic,sizeof(guint32));
+	facq_stream_data_to_checksum(reader->priv->stmd,sum);
+
+	if(reader->priv->version == 1){
+		offset = reader->priv->data_offset;
+		len = facq_file_reader_get_data_size(reader);
+		if(!reader->priv->map)
+			buf = g_malloc(FACQ_FILE_READER_BLOCK);
+		while(len){
+			if(g_atomic_int_get(&reader->priv->cancelled)){
+				g_set_error_literal(err,FACQ_FILE_READER_ERROR,
+						FACQ_FILE_READER_ERROR_CANCELLED,
+							"Verification cancelled");
+				goto exit;
+			}
+			block = MIN(len,FACQ_FILE_READER_BLOCK);
+			if(reader->priv->map)
+				g_checksum_update(sum,reader->priv->map + offset,block);
+			else {
+				if(!facq_file_reader_pread(reader,offset,buf,block,err))
+					goto exit;
+				g_checksum_update(sum,buf,block);
+			}
+			g_atomic_int_add(&reader->priv->done,1);
+			offset += block;
+			len -= block;
+		}
+	}
+	else
+		g_checksum_update(sum,(guchar *)reader->priv->table,
+				facq_file_reader_get_table_len(reader)*sizeof(guint32));
+
+	written_samples = reader->priv->n_slices*reader->priv->stmd->n_channels;
+	written_samples = GUINT64_TO_BE(written_samples);
+	g_checksum_update(sum,(guchar *)&written_samples,sizeof(guint64));
+	g_checksum_get_digest(sum,digest,&digest_len);
+
+	if(memcmp(digest,reader->priv->digest,32) != 0){
+		g_set_error_literal(err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_CORRUPT,"digest differs");
+		goto exit;
+	}
+	ret = TRUE;
+
+	exit:
+	if(buf)
+		g_free(buf);
+	g_checksum_free(sum);
+	return ret;
+}
+
+static gpointer facq_file_reader_verify_fun(gpointer data)
+{
+	FacqFileReaderVerify *v = (FacqFileReaderVerify *)data;
+	FacqFileReader *reader = v->reader;
+	guint64 offset = 0;
+	const guint8 *block = NULL;
+	guint8 *buf = NULL;
+	guint32 crc = 0, expected = 0;
+	gsize len = 0;
+	guint b = 0;
+
+	if(!reader->priv->map)
+		buf = g_malloc(reader->priv->block_size);
+
+	for(b = v->first;b < reader->priv->n_blocks;b += v->step){
+		if(v->stop && g_atomic_int_get(v->failed))
+			break;
+		if(g_atomic_int_get(&reader->priv->cancelled)){
+			v->cancelled = TRUE;
+			break;
+		}
+		/* in compressed files the checksum is of the compressed block */
+		if(reader->priv->compressed){
+			offset = reader->priv->offsets[b];
+			len = GUINT32_FROM_BE(reader->priv->table[2*b+1]);
+			expected = GUINT32_FROM_BE(reader->priv->table[2*b]);
+		}
+		else {
+			offset = reader->priv->data_offset + (guint64)b*reader->priv->block_size;
+			len = facq_file_reader_get_block_len(reader,b);
+			expected = GUINT32_FROM_BE(reader->priv->table[b]);
+		}
+		if(reader->priv->map)
+			block = reader->priv->map + offset;
+		else {
+			if(!facq_file_reader_pread(reader,offset,buf,len,&v->err)){
+				g_atomic_int_set(v->failed,1);
+				break;
+			}
+			block = buf;
+		}
+		crc = facq_crc32c(0,block,len);
+		if(crc != expected){
+			v->bad[b] = 1;
+			g_atomic_int_set(v->failed,1);
+		}
+		g_atomic_int_add(&reader->priv->done,1);
+	}
+
+	if(buf)
+		g_free(buf);
+	return NULL;
+}
+
+/* Decompresses the block b of a compressed file, unless it's the last
+ * decompressed block */
+static gboolean facq_file_reader_load_block(FacqFileReader *reader,guint b,GError **err)
+{
+	GError *local_err = NULL;
+	const guint8 *src = NULL;
+	gsize len = 0;
+
+	if(reader->priv->zcached == b)
+		return TRUE;
+	if(!reader->priv->codec){
+		reader->priv->codec =
+			facq_compress_new(reader->priv->stmd->n_channels,err);
+		if(!reader->priv->codec)
+			return FALSE;
+		reader->priv->zblock = g_malloc(reader->priv->block_size);
+	}
+	reader->priv->zcached = -1;
+
+	len = GUINT32_FROM_BE(reader->priv->table[2*b+1]);
+	if(reader->priv->map)
+		src = reader->priv->map + reader->priv->offsets[b];
+	else {
+		if(!reader->priv->zin)
+			reader->priv->zin = g_malloc(reader->priv->block_size);
+		if(!facq_file_reader_pread(reader,reader->priv->offsets[b],
+						reader->priv->zin,len,err))
+			return FALSE;
+		src = reader->priv->zin;
+	}
+	if(!facq_compress_unblock(reader->priv->codec,src,len,reader->priv->zblock,
+				facq_file_reader_get_block_len(reader,b),&local_err)){
+		g_set_error(err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_CORRUPT,
+					"Block %u: %s",b,local_err->message);
+		g_error_free(local_err);
+		return FALSE;
+	}
+	reader->priv->zcached = b;
+	return TRUE;
+}
+
+/* Reads n_samples samples starting at the byte offset of the samples area,
+ * in the original file, decompressing each block in the range */
+static gboolean facq_file_reader_read_compressed(FacqFileReader *reader,guint64 offset,guint64 n_samples,gdouble *dst,GError **err)
+{
+	guint64 n = 0, pos = 0;
+	guint b = 0;
+
+	while(n_samples){
+		b = offset/reader->priv->block_size;
+		if(!facq_file_reader_load_block(reader,b,err))
+			return FALSE;
+		pos = offset - (guint64)b*reader->priv->block_size;
+		n = MIN(n_samples,(facq_file_reader_get_block_len(reader,b) - pos)/sizeof(gdouble));
+		gdouble_array_copy_to_be(dst,
+				(const gdouble *)(reader->priv->zblock + pos),n);
+		dst += n;
+		n_samples -= n;
+		offset += n*sizeof(gdouble);
+	}
+	return TRUE;
+}
+
+/* GObject magic */
+static void facq_file_reader_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
+{
+	FacqFileReader *reader = FACQ_FILE_READER(self);
+
+	switch(property_id){
+	case PROP_FILENAME: g_value_set_string(value,reader->priv->filename);
+	break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(reader,property_id,pspec);
+	}
+}
+
+static void facq_file_reader_set_property(GObject *self,guint property_id,const GValue *value,GParamSpec *pspec)
+{
+	FacqFileReader *reader = FACQ_FILE_READER(self);
+
+	switch(property_id){
+	case PROP_FILENAME: reader->priv->filename = g_value_dup_string(value);
+	break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(reader,property_id,pspec);
+	}
+}
+
+static void facq_file_reader_finalize(GObject *self)
+{
+	FacqFileReader *reader = FACQ_FILE_READER(self);
+
+	g_clear_error(&reader->priv->construct_error);
+
+#if HAVE_SYS_MMAN_H
+	if(reader->priv->map)
+		munmap(reader->priv->map,reader->priv->size);
+#endif
+	if(reader->priv->fd >= 0)
+		close(reader->priv->fd);
+	if(reader->priv->stmd)
+		facq_stream_data_free(reader->priv->stmd);
+	if(reader->priv->filename)
+		g_free(reader->priv->filename);
+	if(reader->priv->table)
+		g_free(reader->priv->table);
+	if(reader->priv->offsets)
+		g_free(reader->priv->offsets);
+	if(reader->priv->codec)
+		facq_compress_free(reader->priv->codec);
+	if(reader->priv->zblock)
+		g_free(reader->priv->zblock);
+	if(reader->priv->zin)
+		g_free(reader->priv->zin);
+
+	if(G_OBJECT_CLASS(facq_file_reader_parent_class)->finalize)
+    		(*G_OBJECT_CLASS(facq_file_reader_parent_class)->finalize)(self);
+}
+
+static void facq_file_reader_constructed(GObject *self)
+{
+	FacqFileReader *reader = FACQ_FILE_READER(self);
+	FacqFile *file = NULL;
+	GError *local_err = NULL;
+	guint64 written_samples = 0, data_size = 0;
+	guint8 *digest = NULL;
+	gint64 size = 0;
+
+	/* the header and the tail are read with the #FacqFile functions */
+	file = facq_file_open(reader->priv->filename,&local_err);
+	if(local_err)
+		goto error;
+	reader->priv->stmd = facq_file_read_header(file,&local_err);
+	if(local_err)
+		goto error;
+	digest = facq_file_read_tail(file,&written_samples,&local_err);
+	if(local_err)
+		goto error;
+	memcpy(reader->priv->digest,digest,32);
+	g_free(digest);
+	reader->priv->version = facq_file_get_version(file);
+	reader->priv->compressed = facq_file_get_compressed(file);
+	facq_file_free(file);
+	file = NULL;
+
+	if(!reader->priv->stmd->n_channels){
+		g_set_error_literal(&local_err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_FAILED,
+					"The file has no channels");
+		goto error;
+	}
+	reader->priv->n_slices = written_samples/reader->priv->stmd->n_channels;
+	reader->priv->data_offset = 16 + 6*reader->priv->stmd->n_channels*sizeof(guint32);
+	data_size = reader->priv->n_slices*reader->priv->stmd->n_channels*sizeof(gdouble);
+
+	reader->priv->fd = g_open(reader->priv->filename,O_RDONLY | O_BINARY,0);
+	if(reader->priv->fd < 0){
+		g_set_error(&local_err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_FAILED,
+					"Error opening the file: %s",g_strerror(errno));
+		goto error;
+	}
+	size = lseek(reader->priv->fd,0,SEEK_END);
+	if(size < 0 || (!reader->priv->compressed &&
+		(guint64)size < reader->priv->data_offset +
+					data_size + FACQ_FILE_READER_TAIL_LEN)){
+		g_set_error_literal(&local_err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_FAILED,
+					"The file is shorter than the number of written samples");
+		goto error;
+	}
+	reader->priv->size = size;
+
+	if(reader->priv->version != 1 &&
+		!facq_file_reader_read_table(reader,&local_err))
+		goto error;
+
+	facq_file_reader_map(reader);
+	return;
+
+	error:
+	if(file)
+		facq_file_free(file);
+	if(local_err)
+		g_propagate_error(&reader->priv->construct_error,local_err);
+}
+
+static void facq_file_reader_class_init(FacqFileReaderClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	g_type_class_add_private(klass,sizeof(FacqFileReaderPrivate));
+
+	object_class->set_property = facq_file_reader_set_property;
+	object_class->get_property = facq_file_reader_get_property;
+	object_class->constructed = facq_file_reader_constructed;
+	object_class->finalize = facq_file_reader_finalize;
+
+	g_object_class_install_property(object_class,PROP_FILENAME,
+					g_param_spec_string("filename",
+							    "Filename",
+							    "The filename",
+							    "Unknown",
+							    G_PARAM_READWRITE |
+							    G_PARAM_CONSTRUCT_ONLY |
+							    G_PARAM_STATIC_STRINGS));
+}
+
+static void facq_file_reader_init(FacqFileReader *reader)
+{
+	reader->priv = G_TYPE_INSTANCE_GET_PRIVATE(reader,FACQ_TYPE_FILE_READER,FacqFileReaderPrivate);
+	reader->priv->construct_error = NULL;
+	reader->priv->filename = NULL;
+	reader->priv->stmd = NULL;
+	reader->priv->n_slices = 0;
+	reader->priv->fd = -1;
+	reader->priv->size = 0;
+	reader->priv->data_offset = 0;
+	reader->priv->map = NULL;
+	reader->priv->version = 1;
+	memset(reader->priv->digest,0,32);
+	reader->priv->block_size = 0;
+	reader->priv->n_blocks = 0;
+	reader->priv->table = NULL;
+	reader->priv->compressed = FALSE;
+	reader->priv->offsets = NULL;
+	reader->priv->codec = NULL;
+	reader->priv->zblock = NULL;
+	reader->priv->zin = NULL;
+	reader->priv->zcached = -1;
+	reader->priv->cancelled = 0;
+	reader->priv->done = 0;
+	reader->priv->total = 0;
+}
+
+/* GInitable interface */
+static void facq_file_reader_initable_iface_init(GInitableIface *iface)
+{
+	iface->init = facq_file_reader_initable_init;
+}
+
+static gboolean facq_file_reader_initable_init(GInitable *initable,GCancellable *cancellable,GError  **error)
+{
+	FacqFileReader *reader;
+
+	g_return_val_if_fail(FACQ_IS_FILE_READER(initable),FALSE);
+	reader = FACQ_FILE_READER(initable);
+	if(cancellable != NULL){
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			"Cancellable initialization not supported");
+		return FALSE;
+	}
+	if(reader->priv->construct_error){
+		if(error)
+			*error = g_error_copy(reader->priv->construct_error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Public methods */
+
+/**
+ * facq_file_reader_new:
+ * @filename: The filename of a #FacqFile, in the filesystem encoding.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Creates a new #FacqFileReader for the file @filename, reading the header and
+ * the tail of the file, and mapping the file in memory if possible.
+ * The digest of the file is not checked, use facq_file_verify() for this.
+ *
+ * Returns: A new #FacqFileReader or %NULL in case of error.
+ */
+FacqFileReader *facq_file_reader_new(const gchar *filename,GError **err)
+{
+	return g_initable_new(FACQ_TYPE_FILE_READER,NULL,err,
+					"filename",filename,
+					NULL);
+}
+
+/**
+ * facq_file_reader_get_stream_data:
+ * @reader: A #FacqFileReader object.
+ *
+ * Returns: The #FacqStreamData read from the header of the file, it's owned
+ * by the @reader so don't free it.
+ */
+const FacqStreamData *facq_file_reader_get_stream_data(const FacqFileReader *reader)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),NULL);
+
+	return reader->priv->stmd;
+}
+
+/**
+ * facq_file_reader_get_n_slices:
+ * @reader: A #FacqFileReader object.
+ *
+ * Returns: The number of slices stored in the file, that is, the number of
+ * written samples divided by the number of channels.
+ */
+guint64 facq_file_reader_get_n_slices(const FacqFileReader *reader)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),0);
+
+	return reader->priv->n_slices;
+}
+
+/**
+ * facq_file_reader_is_mapped:
+ * @reader: A #FacqFileReader object.
+ *
+ * Returns: %TRUE if the file is mapped in memory, %FALSE if the samples are
+ * read with system calls.
+ */
+gboolean facq_file_reader_is_mapped(const FacqFileReader *reader)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),FALSE);
+
+	return (reader->priv->map != NULL);
+}
+
+/**
+ * facq_file_reader_get_version:
+ * @reader: A #FacqFileReader object.
+ *
+ * Returns: The version of the file format, 1 or 2.
+ */
+guint facq_file_reader_get_version(const FacqFileReader *reader)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),0);
+
+	return reader->priv->version;
+}
+
+/**
+ * facq_file_reader_get_slice_at:
+ * @reader: A #FacqFileReader object.
+ * @time: The time in seconds since the start of the acquisition.
+ *
+ * Finds the slice that was acquired at @time, using the sampling period of the
+ * file, so any time window can be reached in constant time.
+ *
+ * Returns: The index of the slice, clamped to the number of slices in the
+ * file.
+ */
+guint64 facq_file_reader_get_slice_at(const FacqFileReader *reader,gdouble time)
+{
+	gdouble slice = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),0);
+
+	if(time <= 0)
+		return 0;
+	slice = floor(time/reader->priv->stmd->period);
+	if(slice >= reader->priv->n_slices)
+		return reader->priv->n_slices;
+	return (guint64)slice;
+}
+
+/**
+ * facq_file_reader_peek:
+ * @reader: A #FacqFileReader object.
+ * @start: The first slice, from 0 to the number of slices minus one.
+ * @n_slices: The number of slices.
+ *
+ * Gives direct access to the slices from @start to @start+@n_slices-1, inside
+ * the mapped file. The samples are in big endian format, see
+ * facq_file_reader_read() for getting them in native format.
+ * The pointer is valid until the @reader is destroyed.
+ *
+ * Returns: A pointer to the first sample of @start, or %NULL if the file is
+ * not mapped, it's compressed or the range is not valid.
+ */
+gconstpointer facq_file_reader_peek(const FacqFileReader *reader,guint64 start,guint64 n_slices)
+{
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),NULL);
+
+	if(!reader->priv->map || reader->priv->compressed)
+		return NULL;
+	if(start >= reader->priv->n_slices || n_slices > reader->priv->n_slices - start)
+		return NULL;
+	return reader->priv->map + reader->priv->data_offset +
+			start*reader->priv->stmd->n_channels*sizeof(gdouble);
+}
+
+/**
+ * facq_file_reader_read:
+ * @reader: A #FacqFileReader object.
+ * @start: The first slice, from 0 to the number of slices minus one.
+ * @n_slices: The number of slices to read.
+ * @dst: A buffer with space for @n_slices*n_channels samples.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Reads the slices from @start to @start+@n_slices-1 to @dst, converting the
+ * samples to the native format. If the file is mapped the samples are copied
+ * and converted in a single pass, in other case they are read directly to @dst
+ * in large blocks and converted after each block. In compressed files the
+ * blocks that contain the slices are decompressed first.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_file_reader_read(FacqFileReader *reader,guint64 start,guint64 n_slices,gdouble *dst,GError **err)
+{
+	gconstpointer src = NULL;
+	guint64 offset = 0, n_samples = 0, block = 0;
+	guint n_channels = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),FALSE);
+	g_return_val_if_fail(dst != NULL,FALSE);
+
+	if(start >= reader->priv->n_slices || n_slices > reader->priv->n_slices - start){
+		g_set_error_literal(err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_FAILED,
+					"The slices are out of range");
+		return FALSE;
+	}
+	n_channels = reader->priv->stmd->n_channels;
+	n_samples = n_slices*n_channels;
+
+	if(reader->priv->compressed)
+		return facq_file_reader_read_compressed(reader,
+				start*n_channels*sizeof(gdouble),n_samples,dst,err);
+
+	src = facq_file_reader_peek(reader,start,n_slices);
+	if(src){
+		gdouble_array_copy_to_be(dst,src,n_samples);
+		return TRUE;
+	}
+
+	offset = reader->priv->data_offset + start*n_channels*sizeof(gdouble);
+	while(n_samples){
+		block = MIN(n_samples,FACQ_FILE_READER_BLOCK/sizeof(gdouble));
+		if(!facq_file_reader_pread(reader,offset,dst,block*sizeof(gdouble),err))
+			return FALSE;
+		gdouble_array_to_be(dst,block);
+		offset += block*sizeof(gdouble);
+		dst += block;
+		n_samples -= block;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_file_reader_verify:
+ * @reader: A #FacqFileReader object.
+ * @n_threads: The number of threads, or 0 to use a thread per processor.
+ * @stop: If %TRUE the verification stops as soon as a corrupt block is found.
+ * @corrupt: (allow-none): A #GArray of #FacqFileReaderRange, where the time
+ * ranges of the corrupt blocks are appended, in order, or %NULL.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Verifies the integrity of the file.
+ *
+ * In version 2 files the digest is checked first, it protects the header and
+ * the checksums of the blocks, and then the checksum of each block is
+ * checked, using @n_threads threads. Each thread checks one of each @n_threads
+ * blocks from the start of the file, so when @stop is %TRUE a corrupt block is
+ * found soon wherever it is. When @stop is %FALSE all the blocks are checked
+ * and all the corrupt ranges are reported.
+ *
+ * In version 1 files there is a single digest for the whole file, it's
+ * computed in the calling thread and if it differs the whole file is reported
+ * as corrupt.
+ *
+ * The verification can be interrupted from other thread with
+ * facq_file_reader_cancel().
+ *
+ * Returns: %TRUE if the file is valid, %FALSE if it's corrupt, with
+ * #FACQ_FILE_READER_ERROR_CORRUPT, if it has been cancelled, with
+ * #FACQ_FILE_READER_ERROR_CANCELLED, or if it can't be read.
+ */
+gboolean facq_file_reader_verify(FacqFileReader *reader,guint n_threads,gboolean stop,GArray *corrupt,GError **err)
+{
+	FacqFileReaderVerify *v = NULL;
+	GThread **threads = NULL;
+	GError *local_err = NULL;
+	guint8 *bad = NULL;
+	guint64 data_size = 0;
+	gint failed = 0;
+	gboolean cancelled = FALSE;
+	guint i = 0, n_bad = 0, first_bad = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),FALSE);
+
+	data_size = facq_file_reader_get_data_size(reader);
+	if(reader->priv->version == 1)
+		reader->priv->total = (data_size + FACQ_FILE_READER_BLOCK - 1)/FACQ_FILE_READER_BLOCK;
+	else
+		reader->priv->total = reader->priv->n_blocks;
+	g_atomic_int_set(&reader->priv->done,0);
+
+	if(!facq_file_reader_check_digest(reader,&local_err)){
+		if(corrupt && local_err->code == FACQ_FILE_READER_ERROR_CORRUPT)
+			facq_file_reader_add_range(reader,corrupt,0,data_size);
+		g_propagate_error(err,local_err);
+		return FALSE;
+	}
+	if(reader->priv->version == 1 || !reader->priv->n_blocks)
+		return TRUE;
+
+	if(!n_threads){
+#if GLIB_MINOR_VERSION >= 36
+		n_threads = g_get_num_processors();
+#else
+		n_threads = 1;
+#endif
+	}
+#ifndef G_OS_UNIX
+	/* without pread the threads can't share the file descriptor */
+	if(!reader->priv->map)
+		n_threads = 1;
+#endif
+	n_threads = CLAMP(n_threads,1,MIN(reader->priv->n_blocks,FACQ_FILE_READER_MAX_THREADS));
+
+	bad = g_new0(guint8,reader->priv->n_blocks);
+	v = g_new0(FacqFileReaderVerify,n_threads);
+	threads = g_new0(GThread *,n_threads);
+	for(i = 0;i < n_threads;i++){
+		v[i].reader = reader;
+		v[i].first = i;
+		v[i].step = n_threads;
+		v[i].stop = stop;
+		v[i].failed = &failed;
+		v[i].cancelled = FALSE;
+		v[i].bad = bad;
+		v[i].err = NULL;
+	}
+
+	/* the calling thread checks its own share of blocks, if a thread
+	 * can't be created its blocks are checked later by the calling thread */
+	for(i = 1;i < n_threads;i++)
+		threads[i] = g_thread_try_new("verify",
+					facq_file_reader_verify_fun,&v[i],NULL);
+	facq_file_reader_verify_fun(&v[0]);
+	for(i = 1;i < n_threads;i++){
+		if(threads[i])
+			g_thread_join(threads[i]);
+		else
+			facq_file_reader_verify_fun(&v[i]);
+	}
+
+	for(i = 0;i < n_threads;i++){
+		cancelled |= v[i].cancelled;
+		if(v[i].err){
+			if(!local_err)
+				local_err = v[i].err;
+			else
+				g_error_free(v[i].err);
+		}
+	}
+	for(i = 0;i < reader->priv->n_blocks;i++){
+		if(!bad[i])
+			continue;
+		if(!n_bad)
+			first_bad = i;
+		n_bad++;
+		if(corrupt)
+			facq_file_reader_add_range(reader,corrupt,
+				(guint64)i*reader->priv->block_size,
+				MIN((guint64)(i+1)*reader->priv->block_size,data_size));
+	}
+	if(!local_err && !n_bad && cancelled)
+		g_set_error_literal(&local_err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_CANCELLED,
+					"Verification cancelled");
+	if(!local_err && n_bad)
+		g_set_error(&local_err,FACQ_FILE_READER_ERROR,
+				FACQ_FILE_READER_ERROR_CORRUPT,
+					"%u corrupt blocks, the first one starts at %g seconds",
+						n_bad,((guint64)first_bad*reader->priv->block_size/
+							(reader->priv->stmd->n_channels*sizeof(gdouble)))*
+								reader->priv->stmd->period);
+
+	g_free(threads);
+	g_free(v);
+	g_free(bad);
+	if(local_err){
+		g_propagate_error(err,local_err);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_file_reader_cancel:
+ * @reader: A #FacqFileReader object.
+ *
+ * Cancels the verification of the file, see facq_file_reader_verify(), the
+ * verification will stop after checking the current block. This function
+ * can be called from any thread, once called the @reader can't be verified
+ * again.
+ */
+void facq_file_reader_cancel(FacqFileReader *reader)
+{
+	g_return_if_fail(FACQ_IS_FILE_READER(reader));
+
+	g_atomic_int_set(&reader->priv->cancelled,1);
+}
+
+/**
+ * facq_file_reader_get_progress:
+ * @reader: A #FacqFileReader object.
+ *
+ * Gets the progress of the verification of the file, see
+ * facq_file_reader_verify(). This function can be called from any thread.
+ *
+ * Returns: The fraction of the file that has been verified, between 0 and 1.
+ */
+gdouble facq_file_reader_get_progress(FacqFileReader *reader)
+{
+	guint total = 0;
+
+	g_return_val_if_fail(FACQ_IS_FILE_READER(reader),0);
+
+	total = reader->priv->total;
+	if(!total)
+		return 0;
+	return MIN(1.0,(gdouble)g_atomic_int_get(&reader->priv->done)/total);
+}
+
+/**
+ * facq_file_reader_free:
+ * @reader: A #FacqFileReader object.
+ *
+ * Destroys the #FacqFileReader, @reader, unmapping and closing the file.
+ */
+void facq_file_reader_free(FacqFileReader *reader)
+{
+	g_return_if_fail(FACQ_IS_FILE_READER(reader));
+	g_object_unref(G_OBJECT(reader));
+}
@@ -0,0 +1,77 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ *
+ */
+#ifndef _FREEACQ_FILE_READER_H_
+#define _FREEACQ_FILE_READER_H_
+
+G_BEGIN_DECLS
+
+#define FACQ_FILE_READER_ERROR facq_file_reader_error_quark()
+
+#define FACQ_TYPE_FILE_READER (facq_file_reader_get_type ())
+#define FACQ_FILE_READER(inst) (G_TYPE_CHECK_INSTANCE_CAST ((inst),FACQ_TYPE_FILE_READER, FacqFileReader))
+#define FACQ_FILE_READER_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass),FACQ_TYPE_FILE_READER, FacqFileReaderClass))
+#define FACQ_IS_FILE_READER(inst) (G_TYPE_CHECK_INSTANCE_TYPE ((inst),FACQ_TYPE_FILE_READER))
+#define FACQ_IS_FILE_READER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_FILE_READER))
+#define FACQ_FILE_READER_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_FILE_READER, FacqFileReaderClass))
+
+typedef struct _FacqFileReader FacqFileReader;
+typedef struct _FacqFileReaderClass FacqFileReaderClass;
+typedef struct _FacqFileReaderPrivate FacqFileReaderPrivate;
+
+typedef enum {
+	FACQ_FILE_READER_ERROR_FAILED,
+	FACQ_FILE_READER_ERROR_CORRUPT,
+	FACQ_FILE_READER_ERROR_CANCELLED
+} FacqFileReaderError;
+
+typedef struct _FacqFileReaderRange {
+	gdouble start;
+	gdouble end;
+} FacqFileReaderRange;
+
+struct _FacqFileReader {
+	/*< private >*/
+	GObject parent_instance;
+	FacqFileReaderPrivate *priv;
+};
+
+struct _FacqFileReaderClass {
+	/*< private >*/
+	GObjectClass parent_class;
+};
+
+GType facq_file_reader_get_type(void) G_GNUC_CONST;
+
+FacqFileReader *facq_file_reader_new(const gchar *filename,GError **err);
+const FacqStreamData *facq_file_reader_get_stream_data(const FacqFileReader *reader);
+guint64 facq_file_reader_get_n_slices(const FacqFileReader *reader);
+gboolean facq_file_reader_is_mapped(const FacqFileReader *reader);
+guint facq_file_reader_get_version(const FacqFileReader *reader);
+guint64 facq_file_reader_get_slice_at(const FacqFileReader *reader,gdouble time);
+gconstpointer facq_file_reader_peek(const FacqFileReader *reader,guint64 start,guint64 n_slices);
+gboolean facq_file_reader_read(FacqFileReader *reader,guint64 start,guint64 n_slices,gdouble *dst,GError **err);
+gboolean facq_file_reader_verify(FacqFileReader *reader,guint n_threads,gboolean stop,GArray *corrupt,GError **err);
+void facq_file_reader_cancel(FacqFileReader *reader);
+gdouble facq_file_reader_get_progress(FacqFileReader *reader);
+void facq_file_reader_free(FacqFileReader *reader);
+
+G_END_DECLS
+
+#endif
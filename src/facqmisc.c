@@ -21,6 +21,8 @@
 #include <math.h>
 #include "facqmisc.h"
 
+#define FACQ_MISC_MIN_RING_CHUNKS 2
+
 /**
  * SECTION:facqmisc
  * @title:FacqMisc
@@ -68,3 +70,74 @@ gsize facq_misc_period_to_chunk_size(gdouble period,guint bps,guint n_channels)
 		}
 	}
 }
+
+/**
+ * facq_misc_latency_to_chunk_size:
+ * @period: The period between samples in seconds.
+ * @latency: The desired time, in seconds, that each chunk should cover.
+ * @bps: The number of bytes per sample.
+ * @n_channels: The number of channels.
+ *
+ * Returns a number of bytes divisible by bps*n_channels product, that
+ * corresponds to the number of slices that are acquired in @latency seconds.
+ * At least one slice is always returned, so if @period is bigger than
+ * @latency the chunk will contain a single slice.
+ * Use this function instead of facq_misc_period_to_chunk_size() when you
+ * want smaller (or bigger) chunks than one second of data.
+ *
+ * Returns: The number of bytes per chunk corresponding to @latency.
+ */
+gsize facq_misc_latency_to_chunk_size(gdouble period,gdouble latency,guint bps,guint n_channels)
+{
+	gsize slice_size = bps*n_channels;
+	gdouble n_slices = 1;
+
+	if(period > 0 && latency > period)
+		n_slices = round(latency/period);
+
+	if(n_slices > (G_MAXUINT/slice_size))
+		n_slices = G_MAXUINT/slice_size;
+
+	return ((gsize)n_slices)*slice_size;
+}
+
+/**
+ * facq_misc_budget_to_ring_chunks:
+ * @budget: The maximum number of bytes that the ring can use, or 0 for no
+ * limit.
+ * @max_chunks: The maximum number of chunks desired in the ring.
+ * @chunk_size: (inout): A pointer to the chunk size in bytes.
+ * @slice_size: The size of a slice in bytes, bps*n_channels.
+ *
+ * Calculates the number of chunks that can be stored in a ring buffer without
+ * using more than @budget bytes. The returned value is never bigger than
+ * @max_chunks. If not even two chunks of @chunk_size bytes fit in @budget,
+ * @chunk_size is reduced to the biggest multiple of @slice_size that allows
+ * two chunks in the ring (With a minimum of one slice per chunk).
+ *
+ * Returns: The number of chunks for the ring buffer.
+ */
+guint facq_misc_budget_to_ring_chunks(gsize budget,guint max_chunks,gsize *chunk_size,guint slice_size)
+{
+	gsize n_chunks = 0, n_slices = 0;
+
+	g_return_val_if_fail(chunk_size && *chunk_size && slice_size,max_chunks);
+
+	if(!budget)
+		return max_chunks;
+
+	n_chunks = budget / *chunk_size;
+	if(n_chunks >= max_chunks)
+		return max_chunks;
+	if(n_chunks >= FACQ_MISC_MIN_RING_CHUNKS)
+		return n_chunks;
+
+	/* not even the minimum ring fits in the budget, make the chunks
+	 * smaller */
+	n_slices = (budget / FACQ_MISC_MIN_RING_CHUNKS) / slice_size;
+	if(!n_slices)
+		n_slices = 1;
+	*chunk_size = n_slices*slice_size;
+
+	return MIN(max_chunks,FACQ_MISC_MIN_RING_CHUNKS);
+}
@@ -23,6 +23,8 @@
 G_BEGIN_DECLS
 
 gsize facq_misc_period_to_chunk_size(gdouble period,guint bps,guint n_channels);
+gsize facq_misc_latency_to_chunk_size(gdouble period,gdouble latency,guint bps,guint n_channels);
+guint facq_misc_budget_to_ring_chunks(gsize budget,guint max_chunks,gsize *chunk_size,guint slice_size);
 
 G_END_DECLS
 
@@ -23,6 +23,7 @@
 #include <glib.h>
 #include <gio/gio.h>
 #include "facqlog.h"
+#include "facqglibcompat.h"
 #include "facqnet.h"
 
 /**
@@ -34,8 +35,14 @@
  * This module contains functions related with the network functions, for
  * example for sending and receiving data.
  *
- * Only two functions are provided for the moment facq_net_send() and 
- * facq_net_receive(), check the description of each function for more details.
+ * facq_net_send() and facq_net_receive() send and receive data, check the
+ * description of each function for more details.
+ *
+ * facq_net_handshake_connect() and facq_net_handshake_accept() are used by
+ * #FacqOperationPlug and #FacqPlug before anything else is sent. Each side
+ * sends %FACQ_NET_PLUG_MAGIC and %FACQ_NET_PLUG_VERSION as two big endian
+ * #guint32 values and checks the values of the other side, so peers with a
+ * different stream format fail with an error instead of misreading the data.
  *
  */
 static gboolean check_values(GSocket *skt,gchar *buf,gsize size)
@@ -217,3 +224,134 @@ gssize facq_net_receive(GSocket *skt,gchar *buf,gsize size,guint retry,GError **
 
 	return total;
 }
+
+static gboolean handshake_check(const guint32 *hello,GError **err)
+{
+	if(GUINT32_FROM_BE(hello[0]) != FACQ_NET_PLUG_MAGIC){
+		g_set_error_literal(err,G_IO_ERROR,G_IO_ERROR_FAILED,
+				"The other side doesn't use the freeacq stream protocol, maybe it's an older version");
+		return FALSE;
+	}
+	if(GUINT32_FROM_BE(hello[1]) != FACQ_NET_PLUG_VERSION){
+		g_set_error(err,G_IO_ERROR,G_IO_ERROR_FAILED,
+				"Stream protocol version mismatch, the other side uses %u and this side %u",
+				GUINT32_FROM_BE(hello[1]),FACQ_NET_PLUG_VERSION);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean handshake_send(GSocket *skt,GError **err)
+{
+	guint32 hello[2];
+
+	hello[0] = GUINT32_TO_BE(FACQ_NET_PLUG_MAGIC);
+	hello[1] = GUINT32_TO_BE(FACQ_NET_PLUG_VERSION);
+	return (facq_net_send(skt,(gchar *)hello,sizeof(hello),3,err) == sizeof(hello));
+}
+
+static gboolean handshake_receive(GSocket *skt,guint32 *hello,GError **err)
+{
+	if(facq_net_receive(skt,(gchar *)hello,2*sizeof(guint32),3,err) != 2*sizeof(guint32)){
+		if(err != NULL && *err == NULL)
+			g_set_error_literal(err,G_IO_ERROR,G_IO_ERROR_FAILED,
+					"Connection closed during the handshake");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_net_handshake_connect:
+ * @skt: A connected #GSocket object.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Does the client side of the handshake, sending the magic number and the
+ * protocol version and waiting, at most %FACQ_NET_HANDSHAKE_TIMEOUT
+ * microseconds, for the ones of the server. Older servers never answer, so
+ * the timeout turns them into an error.
+ *
+ * Returns: %TRUE if both sides use the same protocol, %FALSE in other case.
+ */
+gboolean facq_net_handshake_connect(GSocket *skt,GError **err)
+{
+	guint32 hello[2];
+	GError *local_err = NULL;
+
+	if(!handshake_send(skt,&local_err))
+		goto error;
+
+#ifdef G_OS_UNIX
+	if(!g_socket_condition_timed_wait(skt,
+					  G_IO_IN | G_IO_ERR | G_IO_HUP,
+					  FACQ_NET_HANDSHAKE_TIMEOUT,
+					  NULL,
+					  &local_err))
+		goto error;
+#endif
+
+	if(!handshake_receive(skt,hello,&local_err))
+		goto error;
+
+	if(!handshake_check(hello,&local_err))
+		goto error;
+
+	return TRUE;
+
+	error:
+	if(local_err){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+				"Handshake failed: %s",local_err->message);
+		if(err != NULL)
+			g_propagate_error(err,local_err);
+		else
+			g_clear_error(&local_err);
+	}
+	else if(err != NULL)
+		g_set_error_literal(err,G_IO_ERROR,
+				G_IO_ERROR_FAILED,"Unknown error in the handshake");
+	return FALSE;
+}
+
+/**
+ * facq_net_handshake_accept:
+ * @skt: A connected #GSocket object.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Does the server side of the handshake, receiving the magic number and the
+ * protocol version of the client and answering with the ones of the server.
+ * The answer is sent even if the values don't match, so the client can
+ * report the mismatch too.
+ *
+ * Returns: %TRUE if both sides use the same protocol, %FALSE in other case.
+ */
+gboolean facq_net_handshake_accept(GSocket *skt,GError **err)
+{
+	guint32 hello[2];
+	GError *local_err = NULL;
+
+	if(!handshake_receive(skt,hello,&local_err))
+		goto error;
+
+	if(!handshake_send(skt,&local_err))
+		goto error;
+
+	if(!handshake_check(hello,&local_err))
+		goto error;
+
+	return TRUE;
+
+	error:
+	if(local_err){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+				"Handshake failed: %s",local_err->message);
+		if(err != NULL)
+			g_propagate_error(err,local_err);
+		else
+			g_clear_error(&local_err);
+	}
+	else if(err != NULL)
+		g_set_error_literal(err,G_IO_ERROR,
+				G_IO_ERROR_FAILED,"Unknown error in the handshake");
+	return FALSE;
+}
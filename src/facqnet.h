@@ -22,8 +22,14 @@
 
 G_BEGIN_DECLS
 
+#define FACQ_NET_PLUG_MAGIC 0x46514350
+#define FACQ_NET_PLUG_VERSION 2
+#define FACQ_NET_HANDSHAKE_TIMEOUT (5*G_TIME_SPAN_SECOND)
+
 gssize facq_net_send(GSocket *skt,gchar *buf,gsize size,guint retry,GError **err);
 gssize facq_net_receive(GSocket *skt,gchar *buf,gsize size,guint retry,GError **err);
+gboolean facq_net_handshake_connect(GSocket *skt,GError **err);
+gboolean facq_net_handshake_accept(GSocket *skt,GError **err);
 
 G_END_DECLS
 
@@ -42,6 +42,17 @@
  * more samples to the stream of data. An operation can work on one or more
  * channels at the same time.
  *
+ * Each operation class declares what it does with the data, setting the
+ * @opflags field of #FacqOperationClass to one of the #FacqOperationFlags,
+ * so the #FacqOperationList and the #FacqPipeline can treat it accordingly.
+ * Operations that only read the data, like #FacqOperationPlug, can be
+ * executed at the same time over the same chunks, see
+ * facq_operation_list_set_threads(). Operations that change the number of
+ * channels, the sampling period or the number of samples, like a decimator or
+ * a channel selector, write their output to a different chunk, and describe
+ * the new stream with a new #FacqStreamData, so the following operations and
+ * the sink see the stream as it's after the operation.
+ *
  * An example of operation is #FacqOperationPlug.
  */
 
@@ -51,8 +62,26 @@
  * Contains all the private details of a #FacqOperation.
  */
 
+/**
+ * FacqOperationFlags:
+ * @FACQ_OPERATION_FLAG_IN_PLACE: The operation can modify the samples in the
+ * chunk, but not their number. This is the default value.
+ * @FACQ_OPERATION_FLAG_READ_ONLY: The operation only reads the samples, so
+ * it can be executed at the same time than other read only operations.
+ * @FACQ_OPERATION_FLAG_RESIZE: The operation produces a different stream of
+ * data, with a different number of channels, sampling period or number of
+ * samples, see @opoutput and @opdoout in #FacqOperationClass.
+ * @FACQ_OPERATION_FLAG_PLANAR: The operation wants the chunks in planar
+ * layout, see #FacqChunkLayout. It can be combined with the other flags, the
+ * output of a resizing operation is planar too.
+ *
+ * Enum values describing the contract of an operation with the data.
+ */
+
 /**
  * FacqOperationClass:
+ * @opflags: The #FacqOperationFlags of the operation, set it in your class
+ * init function, if you don't set it %FACQ_OPERATION_FLAG_IN_PLACE is used.
  * @opsave: Virtual method that is called when the stream is saved to a
  * #GKeyFile, when the facq_stream_save() function is invoked.
  * To write this method use the relevant #GKeyFile functions to store the
@@ -69,6 +98,31 @@
  * #FacqChunk objects are ready to be processed. In case of error you must
  * set the #GError, and return %FALSE. Note that you are allowed to modify
  * the data in the #FacqChunk, but you shouldn't change the number of samples.
+ * @opdov: Virtual method like @opdo, but receives an array of @n_chunks
+ * #FacqChunk objects, that must be processed in order. It's optional
+ * implementing it, if you don't provide it @opdo will be called for each
+ * chunk. Implement it if your operation can save some work processing
+ * more than one chunk at a time.
+ * @opdochans: Virtual method like @opdov, but only the channels from
+ * @first_chan to @first_chan+@n_chans-1 must be processed, the other
+ * channels in the chunks must be left untouched. It's optional implementing
+ * it, provide it only if your operation is channel independent, that is, the
+ * result for a channel doesn't depend on the other channels, for example a
+ * filter or a scaling. In this case the chunks can be split in groups of
+ * channels, and each group processed at the same time by a different thread,
+ * so the method must be thread safe when called with different channel
+ * groups, see facq_operation_list_set_threads(). If the operation keeps some
+ * state it should be kept per channel.
+ * @opoutput: Virtual method that must be provided by the operations with the
+ * %FACQ_OPERATION_FLAG_RESIZE flag. It receives the #FacqStreamData of the
+ * stream at the input of the operation, and returns a new #FacqStreamData
+ * describing the stream after the operation. It's called before @opstart,
+ * and @opstart and the rest of methods receive the input #FacqStreamData.
+ * @opdoout: Virtual method that must be provided by the operations with the
+ * %FACQ_OPERATION_FLAG_RESIZE flag, instead of @opdo. It reads the samples
+ * in @src and writes the result to @dst, an empty chunk with the same size
+ * than @src, adding the used bytes with facq_chunk_add_used_bytes(). The
+ * result can't be bigger than @src. @src must not be modified.
  * @opstop: Virtual method that is called when the stream is stopped.
  * It's optional to implement this method.
  * In this method you are supposed to do whatever things you need to do not process
@@ -152,6 +206,11 @@ static void facq_operation_class_init(FacqOperationClass *klass)
 	object_class->get_property = facq_operation_get_property;
 	object_class->finalize = facq_operation_finalize;
 	operation_class->opdo = NULL;
+	operation_class->opdov = NULL;
+	operation_class->opdochans = NULL;
+	operation_class->opflags = FACQ_OPERATION_FLAG_IN_PLACE;
+	operation_class->opoutput = NULL;
+	operation_class->opdoout = NULL;
 	operation_class->opfree = NULL;
 	operation_class->opstart = NULL;
 	operation_class->opstop = NULL;
@@ -241,6 +300,20 @@ gboolean facq_operation_get_started(FacqOperation *op)
 	return op->priv->started;
 }
 
+/**
+ * facq_operation_get_flags:
+ * @op: A #FacqOperation object of any type.
+ *
+ * Gets the #FacqOperationFlags declared by the operation class.
+ *
+ * Returns: The #FacqOperationFlags of the operation.
+ */
+FacqOperationFlags facq_operation_get_flags(FacqOperation *op)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),FACQ_OPERATION_FLAG_IN_PLACE);
+	return FACQ_OPERATION_GET_CLASS(op)->opflags;
+}
+
 /**
  * facq_operation_to_file:
  * @op: A #FacqOperation object, it can be any type of operation.
@@ -307,6 +380,8 @@ gboolean facq_operation_start(FacqOperation *op,const FacqStreamData *stmd,GErro
  * of channels or other properties needed to your operation.
  * Note that an operation is allowed to do whatever the operation wants with the
  * data, but can't change the #FacqChunk, only the contained data.
+ * Operations with the %FACQ_OPERATION_FLAG_RESIZE flag must be executed with
+ * facq_operation_do_out() instead.
  *
  * Returns: %TRUE if successful, %FALSE in other case.
  */
@@ -316,6 +391,120 @@ gboolean facq_operation_do(FacqOperation *op,FacqChunk *chunk,const FacqStreamDa
 	return FACQ_OPERATION_GET_CLASS(op)->opdo(op,chunk,stmd,err);
 }
 
+/**
+ * facq_operation_dov:
+ * @op: A #FacqOperation object of any type.
+ * @chunks: An array of #FacqChunk objects containing samples.
+ * @n_chunks: The number of chunks in @chunks.
+ * @stmd: A #FacqStreamData object, containing the relevant stream information.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Like facq_operation_do() but processes @n_chunks chunks, in the order
+ * they appear in @chunks. See #FacqOperationClass for more details.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_operation_dov(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err)
+{
+	guint i = 0;
+
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),FALSE);
+	if(FACQ_OPERATION_GET_CLASS(op)->opdov)
+		return FACQ_OPERATION_GET_CLASS(op)->opdov(op,chunks,n_chunks,stmd,err);
+	for(i = 0;i < n_chunks;i++){
+		if(!FACQ_OPERATION_GET_CLASS(op)->opdo(op,chunks[i],stmd,err))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * facq_operation_get_channel_independent:
+ * @op: A #FacqOperation object of any type.
+ *
+ * Checks if the operation can process the channels of a #FacqChunk
+ * independently, see facq_operation_do_chans().
+ *
+ * Returns: %TRUE if the operation is channel independent, %FALSE in other
+ * case.
+ */
+gboolean facq_operation_get_channel_independent(FacqOperation *op)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),FALSE);
+	return (FACQ_OPERATION_GET_CLASS(op)->opdochans != NULL);
+}
+
+/**
+ * facq_operation_do_chans:
+ * @op: A channel independent #FacqOperation object.
+ * @chunks: An array of #FacqChunk objects containing samples.
+ * @n_chunks: The number of chunks in @chunks.
+ * @stmd: A #FacqStreamData object, containing the relevant stream information.
+ * @first_chan: The first channel to process.
+ * @n_chans: The number of channels to process.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Like facq_operation_dov() but only the channels from @first_chan to
+ * @first_chan+@n_chans-1 are processed. The operation must be channel
+ * independent, see facq_operation_get_channel_independent(). This function
+ * can be called at the same time from different threads for different
+ * channel groups of the same chunks.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_operation_do_chans(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,guint first_chan,guint n_chans,GError **err)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),FALSE);
+	g_return_val_if_fail(FACQ_OPERATION_GET_CLASS(op)->opdochans != NULL,FALSE);
+	g_return_val_if_fail(first_chan + n_chans <= stmd->n_channels,FALSE);
+
+	return FACQ_OPERATION_GET_CLASS(op)->opdochans(op,chunks,n_chunks,stmd,
+							first_chan,n_chans,err);
+}
+
+/**
+ * facq_operation_get_output:
+ * @op: A #FacqOperation object of any type.
+ * @stmd: The #FacqStreamData of the stream at the input of the operation.
+ *
+ * Gets the #FacqStreamData describing the stream after the operation. For
+ * operations without the %FACQ_OPERATION_FLAG_RESIZE flag the stream
+ * doesn't change, so a new reference to @stmd is returned.
+ *
+ * Returns: A #FacqStreamData, free it with facq_stream_data_free().
+ */
+FacqStreamData *facq_operation_get_output(FacqOperation *op,const FacqStreamData *stmd)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),NULL);
+	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),NULL);
+
+	if(FACQ_OPERATION_GET_CLASS(op)->opflags & FACQ_OPERATION_FLAG_RESIZE)
+		return FACQ_OPERATION_GET_CLASS(op)->opoutput(op,stmd);
+	return g_object_ref((gpointer)stmd);
+}
+
+/**
+ * facq_operation_do_out:
+ * @op: A #FacqOperation with the %FACQ_OPERATION_FLAG_RESIZE flag.
+ * @src: A #FacqChunk containing samples.
+ * @dst: An empty #FacqChunk, with the same size than @src.
+ * @stmd: A #FacqStreamData object, describing the stream at the input of the
+ * operation.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Executes the operation over the samples in @src, writing the result to
+ * @dst. See #FacqOperationClass for more details.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_operation_do_out(FacqOperation *op,const FacqChunk *src,FacqChunk *dst,const FacqStreamData *stmd,GError **err)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION(op),FALSE);
+	g_return_val_if_fail(FACQ_OPERATION_GET_CLASS(op)->opdoout != NULL,FALSE);
+
+	return FACQ_OPERATION_GET_CLASS(op)->opdoout(op,src,dst,stmd,err);
+}
+
 /**
  * facq_operation_stop:
  * @op: A #FacqOperation object.
@@ -29,6 +29,13 @@ G_BEGIN_DECLS
 #define FACQ_IS_OPERATION_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_OPERATION))
 #define FACQ_OPERATION_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_OPERATION, FacqOperationClass))
 
+typedef enum {
+	FACQ_OPERATION_FLAG_IN_PLACE = 1 << 0,
+	FACQ_OPERATION_FLAG_READ_ONLY = 1 << 1,
+	FACQ_OPERATION_FLAG_RESIZE = 1 << 2,
+	FACQ_OPERATION_FLAG_PLANAR = 1 << 3
+} FacqOperationFlags;
+
 typedef struct _FacqOperation FacqOperation;
 typedef struct _FacqOperationClass FacqOperationClass;
 typedef struct _FacqOperationPrivate FacqOperationPrivate;
@@ -43,9 +50,14 @@ struct _FacqOperationClass {
 	/*< private >*/
 	GObjectClass parent_class;
 	/*< public >*/
+	FacqOperationFlags opflags;
 	void (*opsave)(FacqOperation *op,GKeyFile *file,const gchar *group);
 	gboolean (*opstart)(FacqOperation *op,const FacqStreamData *stmd,GError **err);
 	gboolean (*opdo)(FacqOperation *op,FacqChunk *chunk,const FacqStreamData *stmd,GError **err);
+	gboolean (*opdov)(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err);
+	gboolean (*opdochans)(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,guint first_chan,guint n_chans,GError **err);
+	FacqStreamData *(*opoutput)(FacqOperation *op,const FacqStreamData *stmd);
+	gboolean (*opdoout)(FacqOperation *op,const FacqChunk *src,FacqChunk *dst,const FacqStreamData *stmd,GError **err);
 	gboolean (*opstop)(FacqOperation *op,const FacqStreamData *stmd,GError **err);
 	void (*opfree)(FacqOperation *op);
 };
@@ -55,9 +67,15 @@ GType facq_operation_get_type(void) G_GNUC_CONST;
 const gchar *facq_operation_get_name(FacqOperation *op);
 const gchar *facq_operation_get_description(FacqOperation *op);
 gboolean facq_operation_get_started(FacqOperation *op);
+FacqOperationFlags facq_operation_get_flags(FacqOperation *op);
 void facq_operation_to_file(FacqOperation *op,GKeyFile *file,const gchar *group);
 gboolean facq_operation_start(FacqOperation *op,const FacqStreamData *stmd,GError **err);
 gboolean facq_operation_do(FacqOperation *op,FacqChunk *chunk,const FacqStreamData *stmd,GError **err);
+gboolean facq_operation_dov(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err);
+gboolean facq_operation_get_channel_independent(FacqOperation *op);
+gboolean facq_operation_do_chans(FacqOperation *op,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,guint first_chan,guint n_chans,GError **err);
+FacqStreamData *facq_operation_get_output(FacqOperation *op,const FacqStreamData *stmd);
+gboolean facq_operation_do_out(FacqOperation *op,const FacqChunk *src,FacqChunk *dst,const FacqStreamData *stmd,GError **err);
 gboolean facq_operation_stop(FacqOperation *op,const FacqStreamData *stmd,GError **err);
 void facq_operation_free(FacqOperation *op);
 
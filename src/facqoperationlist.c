@@ -22,6 +22,8 @@
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <string.h>
+#include "facqglibcompat.h"
 #include "facqunits.h"
 #include "facqlog.h"
 #include "facqchanlist.h"
@@ -47,9 +49,41 @@
  * facq_operation_list_del_and_destroy(), to get an operation from the list knowing it's
  * index use facq_operation_list_get(), to start all the operations in the list
  * use facq_operation_list_start(), to execute the main functionality of each
- * operation in order use facq_operation_list_do(), to stop all the operations
+ * operation in order use facq_operation_list_do(), or
+ * facq_operation_list_dov() for more than one #FacqChunk, to stop all the operations
  * use facq_operation_list_stop(), finally to destroy the #FacqOperationList 
  * and all the operations added to it use facq_operation_list_free().
+ *
+ * Channel independent operations, see
+ * facq_operation_get_channel_independent(), can be executed by more than one
+ * thread at the same time. Use facq_operation_list_set_threads() before
+ * starting the list, and if there are more threads than one and any channel
+ * independent operation, facq_operation_list_start() creates a #GThreadPool.
+ * Then each channel independent operation splits the chunks in as many groups
+ * of consecutive channels as threads, (or channels if there are less channels
+ * than threads), the calling thread processes the first group and the threads
+ * in the pool the others. The function returns after all the groups are
+ * processed, so the next operation and the sink always see the complete
+ * chunks. Consecutive read only operations, see #FacqOperationFlags, are
+ * also executed at the same time over the same chunks, each one in its own
+ * thread. The rest of operations are executed only by the calling thread.
+ *
+ * Operations with the %FACQ_OPERATION_FLAG_RESIZE flag change the stream
+ * for the following operations. facq_operation_list_start() asks each
+ * operation for its output #FacqStreamData, see facq_operation_get_output(),
+ * and each operation is started and executed with the #FacqStreamData at
+ * its input. The #FacqStreamData at the end of the list, the one the sink
+ * must use, can be obtained with facq_operation_list_get_stream_data(). The
+ * output of these operations is written to a spare chunk, allocated the
+ * first time it's needed, and then copied back to the original chunk.
+ *
+ * Operations with the %FACQ_OPERATION_FLAG_PLANAR flag receive the chunks in
+ * planar layout, and the rest in interleaved layout, see #FacqChunkLayout.
+ * The chunks are transposed before an operation only if the previous one
+ * wanted a different layout, and after the last operation they are always
+ * left interleaved, like the sinks expect them. So a run of planar
+ * operations costs a single transposition in each direction. Read only
+ * operations are only executed at the same time if they want the same layout.
  */
 
 /**
@@ -79,8 +113,58 @@ enum {
 	PROP_0,
 };
 
+typedef struct _FacqOperationListJob FacqOperationListJob;
+
+/*
+ * FacqOperationListPart:
+ *
+ * A group of channels of a job, processed by a single thread.
+ */
+typedef struct _FacqOperationListPart {
+	FacqOperationListJob *job;
+	guint first_chan;
+	guint n_chans;
+	gboolean ret;
+	GError *err;
+} FacqOperationListPart;
+
+/*
+ * FacqOperationListJob:
+ *
+ * The execution of a channel independent, or read only, operation over some
+ * chunks. There is a job for each operation, so different threads can
+ * execute different operations at the same time, for example in staged mode.
+ * A read only operation that isn't channel independent has a single part,
+ * with all the channels, and whole set. pending counts the parts not
+ * processed yet.
+ */
+struct _FacqOperationListJob {
+	FacqOperation *op;
+	gboolean whole;
+	FacqChunk **chunks;
+	guint n_chunks;
+	const FacqStreamData *stmd;
+	guint n_parts;
+	FacqOperationListPart *parts;
+	gint pending;
+#if GLIB_MINOR_VERSION >= 32
+	GMutex mutex;
+	GCond cond;
+#else
+	GMutex *mutex;
+	GCond *cond;
+#endif
+};
+
 struct _FacqOperationListPrivate {
 	GPtrArray *list;
+	guint n_threads;
+	GThreadPool *pool;
+	FacqOperationListJob *jobs;
+	guint n_jobs;
+	FacqStreamData **stmds;
+	FacqChunk **spare;
+	guint n_stmds;
 };
 
 GQuark facq_operation_list_error_quark(void)
@@ -89,6 +173,8 @@ GQuark facq_operation_list_error_quark(void)
 }
 
 static void facq_operation_list_free_op(gpointer data);
+static void facq_operation_list_free_jobs(FacqOperationList *oplist);
+static void facq_operation_list_free_stmds(FacqOperationList *oplist);
 
 /*****--- GObject magic ---*****/
 static void facq_operation_list_constructed(GObject *self)
@@ -104,6 +190,8 @@ static void facq_operation_list_finalize(GObject *self)
 {
 	FacqOperationList *oplist = FACQ_OPERATION_LIST(self);
 
+	facq_operation_list_free_jobs(oplist);
+	facq_operation_list_free_stmds(oplist);
 	if(oplist->priv->list){
 		g_ptr_array_free(oplist->priv->list,TRUE);
 	}
@@ -125,6 +213,13 @@ static void facq_operation_list_init(FacqOperationList *oplist)
 {
 	oplist->priv = G_TYPE_INSTANCE_GET_PRIVATE(oplist,FACQ_TYPE_OPERATION_LIST,FacqOperationListPrivate);
 	oplist->priv->list = NULL;
+	oplist->priv->n_threads = 1;
+	oplist->priv->pool = NULL;
+	oplist->priv->jobs = NULL;
+	oplist->priv->n_jobs = 0;
+	oplist->priv->stmds = NULL;
+	oplist->priv->spare = NULL;
+	oplist->priv->n_stmds = 0;
 }
 /*****--- Private methods ---*****/
 static void facq_operation_list_free_op(gpointer data)
@@ -137,6 +232,325 @@ static void facq_operation_list_free_op(gpointer data)
 		facq_operation_free(op);
 }
 
+static void facq_operation_list_part_do(FacqOperationListPart *part)
+{
+	FacqOperationListJob *job = part->job;
+
+	if(job->whole)
+		part->ret = facq_operation_dov(job->op,job->chunks,job->n_chunks,
+					       job->stmd,&part->err);
+	else
+		part->ret = facq_operation_do_chans(job->op,job->chunks,
+						    job->n_chunks,job->stmd,
+						    part->first_chan,
+						    part->n_chans,&part->err);
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&job->mutex);
+	if(--job->pending == 0)
+		g_cond_signal(&job->cond);
+	g_mutex_unlock(&job->mutex);
+#else
+	g_mutex_lock(job->mutex);
+	if(--job->pending == 0)
+		g_cond_signal(job->cond);
+	g_mutex_unlock(job->mutex);
+#endif
+}
+
+/* Runs on the threads of the pool */
+static void facq_operation_list_pool_fun(gpointer data,gpointer user_data)
+{
+	facq_operation_list_part_do((FacqOperationListPart *)data);
+}
+
+/* Pushes the parts of the job, from first, to the pool */
+static void facq_operation_list_job_begin(FacqOperationList *oplist,FacqOperationListJob *job,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,guint first)
+{
+	guint i = 0;
+
+	job->chunks = chunks;
+	job->n_chunks = n_chunks;
+	job->stmd = stmd;
+	job->pending = job->n_parts;
+	for(i = first;i < job->n_parts;i++)
+		g_thread_pool_push(oplist->priv->pool,&job->parts[i],NULL);
+}
+
+/* Waits for all the parts of the job, and collects the first error */
+static gboolean facq_operation_list_job_end(FacqOperationListJob *job,GError **err)
+{
+	guint i = 0;
+	gboolean ret = TRUE;
+
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&job->mutex);
+	while(job->pending)
+		g_cond_wait(&job->cond,&job->mutex);
+	g_mutex_unlock(&job->mutex);
+#else
+	g_mutex_lock(job->mutex);
+	while(job->pending)
+		g_cond_wait(job->cond,job->mutex);
+	g_mutex_unlock(job->mutex);
+#endif
+
+	for(i = 0;i < job->n_parts;i++){
+		if(!job->parts[i].ret){
+			if(ret && job->parts[i].err)
+				g_propagate_error(err,job->parts[i].err);
+			else if(job->parts[i].err)
+				g_error_free(job->parts[i].err);
+			job->parts[i].err = NULL;
+			ret = FALSE;
+		}
+	}
+	return ret;
+}
+
+/* Splits the chunks in channel groups, one for each part. The calling thread
+ * processes the first one and waits for the pool to finish the others. */
+static gboolean facq_operation_list_job_do(FacqOperationList *oplist,FacqOperationListJob *job,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err)
+{
+	facq_operation_list_job_begin(oplist,job,chunks,n_chunks,stmd,1);
+	facq_operation_list_part_do(&job->parts[0]);
+	return facq_operation_list_job_end(job,err);
+}
+
+/* Resizing operations are never executed at the same time than others */
+static gboolean facq_operation_list_is_read_only(FacqOperationList *oplist,guint i)
+{
+	FacqOperation *op = facq_operation_list_get(oplist,i);
+	FacqOperationFlags flags = facq_operation_get_flags(op);
+
+	return (flags & FACQ_OPERATION_FLAG_READ_ONLY) &&
+			!(flags & FACQ_OPERATION_FLAG_RESIZE);
+}
+
+/* Gets the i-esim spare chunk, of the same size than the chunk */
+static FacqChunk *facq_operation_list_get_spare(FacqOperationList *oplist,guint i,const FacqChunk *chunk,GError **err)
+{
+	FacqChunk *spare = oplist->priv->spare[i];
+
+	if(spare && spare->len != chunk->len){
+		facq_chunk_free(spare);
+		spare = NULL;
+	}
+	if(!spare){
+		spare = facq_chunk_new(chunk->len,err);
+		oplist->priv->spare[i] = spare;
+	}
+	return spare;
+}
+
+static FacqChunkLayout facq_operation_list_get_layout(FacqOperationList *oplist,guint i)
+{
+	FacqOperation *op = facq_operation_list_get(oplist,i);
+
+	if(facq_operation_get_flags(op) & FACQ_OPERATION_FLAG_PLANAR)
+		return FACQ_CHUNK_LAYOUT_PLANAR;
+	return FACQ_CHUNK_LAYOUT_INTERLEAVED;
+}
+
+/* Transposes the chunks that aren't in the layout, using the i-esim spare
+ * chunk, so different threads can do it for different operations. The index
+ * after the last operation is used for the sinks. */
+static gboolean facq_operation_list_set_layout(FacqOperationList *oplist,guint i,FacqChunk **chunks,guint n_chunks,FacqChunkLayout layout,GError **err)
+{
+	FacqChunk *spare = NULL;
+	guint j = 0;
+
+	for(j = 0;j < n_chunks;j++){
+		if(facq_chunk_get_layout(chunks[j]) == layout)
+			continue;
+		spare = facq_operation_list_get_spare(oplist,i,chunks[j],err);
+		if(!spare)
+			return FALSE;
+		facq_chunk_set_layout(chunks[j],layout,
+				      oplist->priv->stmds[i]->n_channels,spare);
+	}
+	return TRUE;
+}
+
+/* Executes a resizing operation over each chunk, using a spare chunk for the
+ * output, that is copied back to the chunk. */
+static gboolean facq_operation_list_resize_do(FacqOperationList *oplist,guint i,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err)
+{
+	FacqOperation *op = facq_operation_list_get(oplist,i);
+	FacqChunk *spare = NULL;
+	guint j = 0;
+	gsize used_bytes = 0;
+
+	for(j = 0;j < n_chunks;j++){
+		spare = facq_operation_list_get_spare(oplist,i,chunks[j],err);
+		if(!spare)
+			return FALSE;
+		facq_chunk_clear(spare);
+		if(!facq_operation_do_out(op,chunks[j],spare,stmd,err))
+			return FALSE;
+		used_bytes = facq_chunk_get_used_bytes(spare);
+		memcpy(chunks[j]->data,spare->data,used_bytes);
+		facq_chunk_clear(chunks[j]);
+		facq_chunk_add_used_bytes(chunks[j],used_bytes);
+		/* the output is in the layout of the operation */
+		facq_chunk_set_layout(chunks[j],
+				      facq_operation_list_get_layout(oplist,i),
+				      oplist->priv->stmds[i+1]->n_channels,NULL);
+	}
+	return TRUE;
+}
+
+/* Creates the pool and the jobs if it's worth, in other case the operations
+ * are executed only by the calling thread. */
+static void facq_operation_list_new_jobs(FacqOperationList *oplist)
+{
+	guint i = 0, j = 0, n_parts = 0, n_channels = 0, first_chan = 0;
+	gboolean independent = FALSE, read_only = FALSE;
+	FacqOperation *op = NULL;
+	FacqOperationListJob *job = NULL;
+	GError *local_error = NULL;
+
+	if(oplist->priv->n_threads < 2)
+		return;
+	for(i = 0;i < oplist->priv->list->len;i++){
+		op = facq_operation_list_get(oplist,i);
+		if(facq_operation_get_flags(op) & FACQ_OPERATION_FLAG_RESIZE)
+			continue;
+		if(facq_operation_get_channel_independent(op) &&
+				oplist->priv->stmds[i]->n_channels > 1)
+			independent = TRUE;
+		if(i && facq_operation_list_is_read_only(oplist,i) &&
+				facq_operation_list_is_read_only(oplist,i-1))
+			read_only = TRUE;
+	}
+	if(!independent && !read_only)
+		return;
+
+	oplist->priv->pool = g_thread_pool_new(facq_operation_list_pool_fun,
+					       NULL,oplist->priv->n_threads-1,
+					       TRUE,&local_error);
+	if(!oplist->priv->pool){
+		if(local_error){
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+				"Can't create the operation threads: %s",
+						local_error->message);
+			g_clear_error(&local_error);
+		}
+		return;
+	}
+
+	oplist->priv->n_jobs = oplist->priv->list->len;
+	oplist->priv->jobs = g_new0(FacqOperationListJob,oplist->priv->n_jobs);
+	for(i = 0;i < oplist->priv->n_jobs;i++){
+		op = facq_operation_list_get(oplist,i);
+		if(facq_operation_get_flags(op) & FACQ_OPERATION_FLAG_RESIZE)
+			continue;
+		job = &oplist->priv->jobs[i];
+		n_channels = oplist->priv->stmds[i]->n_channels;
+		n_parts = MIN(oplist->priv->n_threads,n_channels);
+		if(!facq_operation_get_channel_independent(op) || n_parts < 2){
+			if(!facq_operation_list_is_read_only(oplist,i))
+				continue;
+			job->whole = TRUE;
+			n_parts = 1;
+		}
+		job->op = op;
+		job->n_parts = n_parts;
+		job->parts = g_new0(FacqOperationListPart,n_parts);
+		/* the first n_channels % n_parts groups get one channel more */
+		first_chan = 0;
+		for(j = 0;j < n_parts;j++){
+			job->parts[j].job = job;
+			job->parts[j].first_chan = first_chan;
+			job->parts[j].n_chans = n_channels/n_parts +
+					((j < n_channels % n_parts) ? 1 : 0);
+			first_chan += job->parts[j].n_chans;
+		}
+#if GLIB_MINOR_VERSION >= 32
+		g_mutex_init(&job->mutex);
+		g_cond_init(&job->cond);
+#else
+		job->mutex = g_mutex_new();
+		job->cond = g_cond_new();
+#endif
+	}
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"Operations use up to %u threads",oplist->priv->n_threads);
+}
+
+static void facq_operation_list_free_jobs(FacqOperationList *oplist)
+{
+	guint i = 0;
+	FacqOperationListJob *job = NULL;
+
+	/* wait for the threads of the pool */
+	if(oplist->priv->pool)
+		g_thread_pool_free(oplist->priv->pool,FALSE,TRUE);
+	oplist->priv->pool = NULL;
+
+	for(i = 0;i < oplist->priv->n_jobs;i++){
+		job = &oplist->priv->jobs[i];
+		if(!job->parts)
+			continue;
+		g_free(job->parts);
+#if GLIB_MINOR_VERSION >= 32
+		g_mutex_clear(&job->mutex);
+		g_cond_clear(&job->cond);
+#else
+		g_mutex_free(job->mutex);
+		g_cond_free(job->cond);
+#endif
+	}
+	if(oplist->priv->jobs)
+		g_free(oplist->priv->jobs);
+	oplist->priv->jobs = NULL;
+	oplist->priv->n_jobs = 0;
+}
+
+/* Gets the stream data at the input of each operation, and at the end of the
+ * list, stmds[0] is the stream data of the source. */
+static gboolean facq_operation_list_new_stmds(FacqOperationList *oplist,const FacqStreamData *stmd,GError **err)
+{
+	guint i = 0;
+	FacqOperation *op = NULL;
+
+	oplist->priv->n_stmds = oplist->priv->list->len + 1;
+	oplist->priv->stmds = g_new0(FacqStreamData *,oplist->priv->n_stmds);
+	oplist->priv->spare = g_new0(FacqChunk *,oplist->priv->n_stmds);
+	oplist->priv->stmds[0] = g_object_ref((gpointer)stmd);
+	for(i = 0;i < oplist->priv->list->len;i++){
+		op = facq_operation_list_get(oplist,i);
+		oplist->priv->stmds[i+1] =
+			facq_operation_get_output(op,oplist->priv->stmds[i]);
+		if(!oplist->priv->stmds[i+1]){
+			g_set_error(err,FACQ_OPERATION_LIST_ERROR,
+					FACQ_OPERATION_LIST_ERROR_FAILED,
+					"Operation %s doesn't describe its output",
+					facq_operation_get_name(op));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static void facq_operation_list_free_stmds(FacqOperationList *oplist)
+{
+	guint i = 0;
+
+	for(i = 0;i < oplist->priv->n_stmds;i++){
+		if(oplist->priv->stmds[i])
+			facq_stream_data_free(oplist->priv->stmds[i]);
+		if(oplist->priv->spare[i])
+			facq_chunk_free(oplist->priv->spare[i]);
+	}
+	if(oplist->priv->stmds)
+		g_free(oplist->priv->stmds);
+	if(oplist->priv->spare)
+		g_free(oplist->priv->spare);
+	oplist->priv->stmds = NULL;
+	oplist->priv->spare = NULL;
+	oplist->priv->n_stmds = 0;
+}
+
 /*****--- Public methods ---*****/
 /**
  * facq_operation_list_new:
@@ -227,6 +641,36 @@ guint facq_operation_list_del_and_destroy(FacqOperationList *oplist)
 	else return 0;
 }
 
+/**
+ * facq_operation_list_set_threads:
+ * @oplist: A #FacqOperationList object, not started yet.
+ * @n_threads: The number of threads, including the calling one, that will
+ * execute the channel independent operations, 1 or 0 to disable it.
+ *
+ * Sets the number of threads used to execute the channel independent
+ * operations, see the description above. The value is used the next time the
+ * list is started.
+ */
+void facq_operation_list_set_threads(FacqOperationList *oplist,guint n_threads)
+{
+	g_return_if_fail(FACQ_IS_OPERATION_LIST(oplist));
+
+	oplist->priv->n_threads = (n_threads) ? n_threads : 1;
+}
+
+/**
+ * facq_operation_list_get_threads:
+ * @oplist: A #FacqOperationList object.
+ *
+ * Returns: The number of threads set with facq_operation_list_set_threads().
+ */
+guint facq_operation_list_get_threads(const FacqOperationList *oplist)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION_LIST(oplist),1);
+
+	return oplist->priv->n_threads;
+}
+
 /**
  * facq_operation_list_start:
  * @oplist: A #FacqOperationList (It can be empty).
@@ -234,7 +678,9 @@ guint facq_operation_list_del_and_destroy(FacqOperationList *oplist)
  * @err: (allow-none): A #GError it will be set in case of error if not %NULL.
  *
  * Starts all the #FacqOperation elements in the #FacqOperationList, @oplist.
- * In case of error the started operations will be stopped again.
+ * In case of error the started operations will be stopped again. If the list
+ * uses more than one thread the #GThreadPool is created here, see
+ * facq_operation_list_set_threads().
  * Detailed errors are output trough #FacqLog.
  *
  * Returns: %TRUE if all the operations had been started without errors
@@ -250,9 +696,15 @@ gboolean facq_operation_list_start(FacqOperationList *oplist,const FacqStreamDat
 	g_return_val_if_fail(FACQ_IS_OPERATION_LIST(oplist),FALSE);
 	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),FALSE);
 
-	for(i = 0;i < oplist->priv->list->len;i++){
+	facq_operation_list_free_stmds(oplist);
+	if(!facq_operation_list_new_stmds(oplist,stmd,&local_error)){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",local_error->message);
+		g_clear_error(&local_error);
+		ret = FALSE;
+	}
+	for(i = 0;ret && i < oplist->priv->list->len;i++){
 		op = facq_operation_list_get(oplist,i);
-		if(!facq_operation_start(op,stmd,&local_error)){
+		if(!facq_operation_start(op,oplist->priv->stmds[i],&local_error)){
 			if(local_error){
 				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
 						"Error starting operation: %s",
@@ -263,12 +715,14 @@ gboolean facq_operation_list_start(FacqOperationList *oplist,const FacqStreamDat
 			break;
 		}
 	}
+	if(ret)
+		facq_operation_list_new_jobs(oplist);
 	/* stop started i operations if any */
 	if(!ret){
 		facq_log_write("Stopping previous started operations if any",FACQ_LOG_MSG_TYPE_ERROR);
 		for(j = 0;j < i;j++){
 			op = facq_operation_list_get(oplist,j);
-			if(!facq_operation_stop(op,stmd,&local_error)){
+			if(!facq_operation_stop(op,oplist->priv->stmds[j],&local_error)){
 				if(local_error){
 					facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
 								"Error stopping operation: %s",
@@ -285,10 +739,33 @@ gboolean facq_operation_list_start(FacqOperationList *oplist,const FacqStreamDat
 								"Unable to start all the operations");
 			g_propagate_error(err,local_error);
 		}
+		facq_operation_list_free_stmds(oplist);
 	}
 	return ret;
 }
 
+/**
+ * facq_operation_list_get_stream_data:
+ * @oplist: A started #FacqOperationList object.
+ *
+ * Gets the #FacqStreamData describing the stream after the last operation
+ * of the list, that is the one the sink must use. If there isn't any
+ * operation with the %FACQ_OPERATION_FLAG_RESIZE flag, it describes the same
+ * stream than the #FacqStreamData passed to facq_operation_list_start().
+ *
+ * Returns: A #FacqStreamData owned by the list, valid until
+ * facq_operation_list_stop() is called, or %NULL if the list isn't started.
+ * Use g_object_ref() if you need to keep it.
+ */
+const FacqStreamData *facq_operation_list_get_stream_data(const FacqOperationList *oplist)
+{
+	g_return_val_if_fail(FACQ_IS_OPERATION_LIST(oplist),NULL);
+
+	if(!oplist->priv->stmds)
+		return NULL;
+	return oplist->priv->stmds[oplist->priv->n_stmds-1];
+}
+
 /**
  * facq_operation_list_do:
  * @oplist: A #FacqOperationList object.
@@ -306,19 +783,125 @@ gboolean facq_operation_list_start(FacqOperationList *oplist,const FacqStreamDat
  */
 gboolean facq_operation_list_do(FacqOperationList *oplist,FacqChunk *chunk,const FacqStreamData *stmd,GError **err)
 {
-	guint i = 0;
-	FacqOperation *op = NULL;
+	return facq_operation_list_dov(oplist,&chunk,1,stmd,err);
+}
+
+/**
+ * facq_operation_list_dov:
+ * @oplist: A #FacqOperationList object.
+ * @chunks: An array of #FacqChunk objects, in stream order.
+ * @n_chunks: The number of chunks in @chunks.
+ * @stmd: A #FacqStreamData object, containing the relevant information of the
+ * stream.
+ * @err: A #GError it will be set in case of error if not %NULL.
+ *
+ * Like facq_operation_list_do() but each #FacqOperation processes all the
+ * chunks before the next one, using facq_operation_list_dov_op(), so the state
+ * of each operation stays in the cache while it's used. If the list has more
+ * than one thread, consecutive read only operations are executed at the same
+ * time, see the description above.
+ *
+ * Returns: %TRUE if all operations completed the operation successfully or
+ * %FALSE in other case.
+ */
+gboolean facq_operation_list_dov(FacqOperationList *oplist,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err)
+{
+	guint i = 0, j = 0, k = 0;
+	gboolean ret = TRUE;
 	GError *local_error = NULL;
 
-	for(i = 0;i < oplist->priv->list->len;i++){
-		op = facq_operation_list_get(oplist,i);
-		if(!facq_operation_do(op,chunk,stmd,&local_error)){
-			if(err != NULL && local_error)
-				g_propagate_error(err,local_error);
-			return FALSE;
+	for(i = 0;ret && i < oplist->priv->list->len;i = j){
+		/* find the read only operations that follow the i-esim one */
+		j = i + 1;
+		if(oplist->priv->pool && facq_operation_list_is_read_only(oplist,i))
+			while(j < oplist->priv->list->len &&
+				facq_operation_list_is_read_only(oplist,j) &&
+				facq_operation_list_get_layout(oplist,j) ==
+					facq_operation_list_get_layout(oplist,i))
+				j++;
+		/* the chunks are shared, so they must be in the layout before
+		 * starting the operations */
+		if(j > i + 1 && oplist->priv->stmds){
+			ret = facq_operation_list_set_layout(oplist,i,chunks,n_chunks,
+					facq_operation_list_get_layout(oplist,i),
+					&local_error);
+			if(!ret)
+				break;
+		}
+		/* the following ones go to the pool, the i-esim one is
+		 * executed here, errors are reported in operation order */
+		for(k = i + 1;k < j;k++)
+			facq_operation_list_job_begin(oplist,&oplist->priv->jobs[k],
+							chunks,n_chunks,
+							oplist->priv->stmds[k],0);
+		ret = facq_operation_list_dov_op(oplist,i,chunks,n_chunks,stmd,&local_error);
+		for(k = i + 1;k < j;k++){
+			if(!facq_operation_list_job_end(&oplist->priv->jobs[k],
+						(ret) ? &local_error : NULL))
+				ret = FALSE;
 		}
 	}
-	return TRUE;
+	/* the last operation could have been executed by the pool */
+	if(ret && oplist->priv->stmds)
+		ret = facq_operation_list_set_layout(oplist,oplist->priv->list->len,
+						     chunks,n_chunks,
+						     FACQ_CHUNK_LAYOUT_INTERLEAVED,
+						     &local_error);
+	if(!ret){
+		if(err != NULL && local_error)
+			g_propagate_error(err,local_error);
+		else
+			g_clear_error(&local_error);
+	}
+	return ret;
+}
+
+/**
+ * facq_operation_list_dov_op:
+ * @oplist: A started #FacqOperationList object.
+ * @i: The index of the operation in the list, starting at 0.
+ * @chunks: An array of #FacqChunk objects, in stream order.
+ * @n_chunks: The number of chunks in @chunks.
+ * @stmd: A #FacqStreamData object, containing the relevant information of the
+ * stream at the input of the list.
+ * @err: A #GError it will be set in case of error if not %NULL.
+ *
+ * Executes only the operation in the position @i of the list over the
+ * chunks, passing to it the #FacqStreamData at its input, and with the chunks
+ * in the layout it wants, if this is the last operation the chunks are left
+ * interleaved. If the operation is channel independent and the list has more than
+ * one thread, the channel groups are processed in parallel, see the
+ * description above, in other case facq_operation_dov() is used. Different
+ * operations of the list can be executed at the same time from different
+ * threads, like #FacqPipeline does in staged mode.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_operation_list_dov_op(FacqOperationList *oplist,guint i,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err)
+{
+	FacqOperation *op = NULL;
+	gboolean ret = FALSE;
+
+	op = facq_operation_list_get(oplist,i);
+	if(oplist->priv->stmds){
+		stmd = oplist->priv->stmds[i];
+		if(!facq_operation_list_set_layout(oplist,i,chunks,n_chunks,
+				facq_operation_list_get_layout(oplist,i),err))
+			return FALSE;
+	}
+	if(facq_operation_get_flags(op) & FACQ_OPERATION_FLAG_RESIZE)
+		ret = facq_operation_list_resize_do(oplist,i,chunks,n_chunks,stmd,err);
+	else if(i < oplist->priv->n_jobs && oplist->priv->jobs[i].n_parts)
+		ret = facq_operation_list_job_do(oplist,&oplist->priv->jobs[i],
+						 chunks,n_chunks,stmd,err);
+	else
+		ret = facq_operation_dov(op,chunks,n_chunks,stmd,err);
+	/* the sinks expect interleaved chunks */
+	if(ret && oplist->priv->stmds && i + 1 == oplist->priv->list->len)
+		ret = facq_operation_list_set_layout(oplist,i+1,chunks,n_chunks,
+						     FACQ_CHUNK_LAYOUT_INTERLEAVED,
+						     err);
+	return ret;
 }
 
 /**
@@ -327,7 +910,8 @@ gboolean facq_operation_list_do(FacqOperationList *oplist,FacqChunk *chunk,const
  * @stmd: A #FacqStreamData object.
  * @err: A #GError, it will be set in case of error if not %NULL.
  *
- * Stops all the #FacqOperation elements in the list. In case of error the
+ * Stops all the #FacqOperation elements in the list, destroying the
+ * #GThreadPool, if any. In case of error the
  * detailed error message for each operation is passed trough #FacqLog.
  * All the operations are stopped, even in case of error, this means that if a
  * stop function fails, the function continues with the next operation in the
@@ -345,9 +929,12 @@ gboolean facq_operation_list_stop(FacqOperationList *oplist,const FacqStreamData
 	g_return_val_if_fail(FACQ_IS_OPERATION_LIST(oplist),FALSE);
 	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),FALSE);
 
+	facq_operation_list_free_jobs(oplist);
 	for(i = 0;i < oplist->priv->list->len;i++){
 		op = facq_operation_list_get(oplist,i);
-		if(!facq_operation_stop(op,stmd,&local_error)){
+		if(!facq_operation_stop(op,
+				(oplist->priv->stmds) ? oplist->priv->stmds[i] : stmd,
+				&local_error)){
 			if(local_error){
 				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
 							"Error while stopping operation: %s",
@@ -366,6 +953,7 @@ gboolean facq_operation_list_stop(FacqOperationList *oplist,const FacqStreamData
 			g_propagate_error(err,local_error);
 		}
 	}
+	facq_operation_list_free_stmds(oplist);
 	return ret;
 }
 
@@ -57,8 +57,13 @@ guint facq_operation_list_get_length(const FacqOperationList *oplist);
 guint facq_operation_list_add(FacqOperationList *oplist,const FacqOperation *op);
 FacqOperation *facq_operation_list_get(const FacqOperationList *oplist,guint i);
 guint facq_operation_list_del_and_destroy(FacqOperationList *oplist);
+void facq_operation_list_set_threads(FacqOperationList *oplist,guint n_threads);
+guint facq_operation_list_get_threads(const FacqOperationList *oplist);
 gboolean facq_operation_list_start(FacqOperationList *oplist,const FacqStreamData *stmd,GError **err);
+const FacqStreamData *facq_operation_list_get_stream_data(const FacqOperationList *oplist);
 gboolean facq_operation_list_do(FacqOperationList *oplist,FacqChunk *chunk,const FacqStreamData *stmd,GError **err);
+gboolean facq_operation_list_dov(FacqOperationList *oplist,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err);
+gboolean facq_operation_list_dov_op(FacqOperationList *oplist,guint i,FacqChunk **chunks,guint n_chunks,const FacqStreamData *stmd,GError **err);
 gboolean facq_operation_list_stop(FacqOperationList *oplist,const FacqStreamData *stmd,GError **err);
 void facq_operation_list_free(FacqOperationList *oplist);
 
@@ -113,6 +113,14 @@
  * <para>
  * Internally a #GSocket is used to connect to the specified address and port
  * and send the #FacqStreamData and the samples to the other side.
+ * Before the #FacqStreamData both sides exchange a magic number and a protocol
+ * version, see facq_net_handshake_connect(), so a #FacqPlug using a different
+ * stream format is refused at start instead of misreading the samples.
+ * The samples of each #FacqChunk are preceded by a header of three big endian
+ * #guint64 values, the sequence number of the chunk, its timestamp and the
+ * number of bytes that follow, so the other side can detect lost chunks and
+ * align the data in time, see facq_chunk_get_sequence() and
+ * facq_chunk_get_timestamp().
  * </para>
  * </sect1>
  */
@@ -149,6 +157,8 @@ struct _FacqOperationPlugPrivate {
 	gchar *address;
 	guint16 port;
 	GSocket *socket;
+	gdouble *scratch;
+	gsize scratch_size;
 };
 
 GQuark facq_operation_plug_error_quark(void)
@@ -195,6 +205,9 @@ static void facq_operation_plug_finalize(GObject *self)
 	if(plug->priv->socket)
 		g_object_unref(G_OBJECT(plug->priv->socket));
 
+	if(plug->priv->scratch)
+		g_free(plug->priv->scratch);
+
 	if (G_OBJECT_CLASS (facq_operation_plug_parent_class)->finalize)
                 (*G_OBJECT_CLASS (facq_operation_plug_parent_class)->finalize) (self);
 }
@@ -212,6 +225,7 @@ static void facq_operation_plug_class_init(FacqOperationPlugClass *klass)
 
 	operation_class->opsave = facq_operation_plug_to_file;
 	operation_class->opstart = facq_operation_plug_start;
+	operation_class->opflags = FACQ_OPERATION_FLAG_READ_ONLY;
 	operation_class->opdo = facq_operation_plug_do;
 	operation_class->opstop = facq_operation_plug_stop;
 	operation_class->opfree = facq_operation_plug_free;
@@ -242,6 +256,8 @@ static void facq_operation_plug_init(FacqOperationPlug *plug)
 {
 	plug->priv = G_TYPE_INSTANCE_GET_PRIVATE(plug,FACQ_TYPE_OPERATION_PLUG,FacqOperationPlugPrivate);
 	plug->priv->socket = NULL;
+	plug->priv->scratch = NULL;
+	plug->priv->scratch_size = 0;
 }
 
 /*****--- Public methods ---*****/
@@ -426,6 +442,9 @@ gboolean facq_operation_plug_start(FacqOperation *op,const FacqStreamData *stmd,
 		goto error;
 	}
 
+	if(!facq_net_handshake_connect(plug->priv->socket,&local_err))
+		goto error;
+
 	if(!facq_stream_data_to_socket(stmd,plug->priv->socket,&local_err)){
 		if(local_err)
 			facq_log_write(local_err->message,FACQ_LOG_MSG_TYPE_ERROR);
@@ -460,7 +479,10 @@ gboolean facq_operation_plug_start(FacqOperation *op,const FacqStreamData *stmd,
  * @err: A #GError, it will be set in case of error if not %NULL.
  *
  * Sends the data contained in the #FacqChunk, in big endian format, to the
- * other side of the connection, using the facq_net_send() function.
+ * other side of the connection, using the facq_net_send() function. The data
+ * is preceded by the sequence number, the timestamp and the size of the chunk.
+ * The operation is read only, the samples are converted to big endian in a
+ * private buffer, so the chunk isn't modified.
  *
  * Returns: %TRUE if successful, %FALSE in other case.
  */
@@ -469,6 +491,7 @@ gboolean facq_operation_plug_do(FacqOperation *op,FacqChunk *chunk,const FacqStr
 	FacqOperationPlug *plug = FACQ_OPERATION_PLUG(op);
 	gssize ret = 0;
 	gsize used_bytes = 0;
+	guint64 header[3];
 	GError *local_err = NULL;
 
 	used_bytes = facq_chunk_get_used_bytes(chunk);
@@ -477,12 +500,28 @@ gboolean facq_operation_plug_do(FacqOperation *op,FacqChunk *chunk,const FacqStr
 	facq_chunk_data_double_print(chunk);
 #endif
 
-	facq_chunk_data_double_to_be(chunk);
+	header[0] = GUINT64_TO_BE(facq_chunk_get_sequence(chunk));
+	header[1] = GUINT64_TO_BE((guint64)facq_chunk_get_timestamp(chunk));
+	header[2] = GUINT64_TO_BE((guint64)used_bytes);
 	ret = facq_net_send(plug->priv->socket,
-			    chunk->data,
-			    used_bytes,
+			    (gchar *)header,
+			    sizeof(header),
 			    3,&local_err);
-	facq_chunk_data_double_to_be(chunk);
+	if(ret == sizeof(header) && !local_err){
+		if(plug->priv->scratch_size < used_bytes){
+			plug->priv->scratch = g_realloc(plug->priv->scratch,used_bytes);
+			plug->priv->scratch_size = used_bytes;
+		}
+		gdouble_array_copy_to_be(plug->priv->scratch,
+					 (const gdouble *)chunk->data,
+					 used_bytes/sizeof(gdouble));
+		ret = facq_net_send(plug->priv->socket,
+				    (gchar *)plug->priv->scratch,
+				    used_bytes,
+				    3,&local_err);
+	}
+	else
+		ret = -1;
 
 	/* in case of error ignore it, cause is not critial, the stream
 	 * can continue in case the VI is closed */
@@ -182,7 +182,7 @@ static gboolean data_callback(FacqChunk *chunk,gpointer _oscope)
 {
 	FacqOscope *oscope = FACQ_OSCOPE(_oscope);
 
-	g_return_val_if_fail(FACQ_IS_CHUNK(chunk),FALSE);
+	g_return_val_if_fail(chunk != NULL,FALSE);
 	g_return_val_if_fail(FACQ_IS_OSCOPE(oscope),FALSE);
 
 	/* just plot the chunk */
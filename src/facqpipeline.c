@@ -19,6 +19,7 @@
  */
 #include <glib.h>
 #include <gio/gio.h>
+#include <string.h>
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
@@ -28,6 +29,7 @@
 #include "facqunits.h"
 #include "facqchanlist.h"
 #include "facqbuffer.h"
+#include "facqspill.h"
 #include "facqstreamdata.h"
 #include "facqsource.h"
 #include "facqoperation.h"
@@ -100,8 +102,11 @@
  * contains pointers to a #FacqSource, a #FacqOperationList, a #FacqSink and
  * a #FacqPipelineMonitor.
  * Also a new #FacqBuffer is created at construction time along with a producer
- * thread and a consumer thread. This objects will provide the multithreaded
- * capabilites to the pipeline.
+ * thread and a consumer thread. Since only these two threads use the buffer
+ * it's created with facq_buffer_new_spsc(), so chunks move between them
+ * without taking any lock. This objects will provide the multithreaded
+ * capabilites to the pipeline. With facq_pipeline_set_locked_memory() the
+ * chunks are locked in RAM, avoiding page faults in the producer thread.
  * 
  * When the pipeline is started with facq_pipeline_start() the first step done
  * by the pipeline is trying to obtain the #FacqStreamData from the source, if
@@ -114,29 +119,164 @@
  * <emphasis>Producer thread</emphasis>
  *
  * This thread polls the source for new data and after filling a #FacqChunk,
- * tries to convert the data to #gdouble (If needed, see facq_source_conv() ), 
- * after this the #FacqChunk is pushed to the #FacqBuffer object. 
+ * tries to convert the data to #gdouble (If needed, see facq_source_conv(), 
+ * and the Native samples and Converter thread sections below), after this the #FacqChunk is
+ * stamped with its sequence number, starting at 0, and the current
+ * g_get_monotonic_time(), see
+ * facq_chunk_set_sequence() and facq_chunk_set_timestamp(), and pushed to the
+ * #FacqBuffer object. Dropped chunks consume a sequence number too, so the
+ * gaps can be detected after the pipeline.
  * This is repeated until facq_buffer_get_exit() returns TRUE. 
  * After this the source is stopped and the thread destroys itself.
  *
+ * When there isn't any recycled #FacqChunk in the #FacqBuffer the producer
+ * follows the #FacqPipelineOverflow policy of the pipeline, see
+ * facq_pipeline_set_overflow(). With %FACQ_PIPELINE_OVERFLOW_BLOCK, the
+ * default, it waits for a recycled chunk, so the source isn't read in the
+ * meantime and the hardware buffers could overflow. With the other policies
+ * the producer never waits, the data is read to a spare chunk, and:
+ * - %FACQ_PIPELINE_OVERFLOW_DROP_NEWEST discards the data in the spare chunk.
+ * - %FACQ_PIPELINE_OVERFLOW_DROP_OLDEST takes back the oldest chunk in the
+ *   #FacqBuffer discarding its data, if the #FacqBuffer is empty, because all
+ *   the chunks are in the stages or in the branches, the spare chunk is
+ *   discarded instead.
+ * - %FACQ_PIPELINE_OVERFLOW_SPILL writes the data to a temporary file, see
+ *   #FacqSpill, and as soon as there are recycled chunks the data is read back
+ *   and pushed to the #FacqBuffer, before any new data. If the data can't be
+ *   written to the file it's discarded.
+ *
+ * The number of discarded chunks is added to the #FacqPipelineMonitor
+ * with facq_pipeline_monitor_add_dropped(), and a
+ * %FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW message is pushed when the overflow
+ * starts and when it ends.
+ *
  *
  * <emphasis>Consumer thread</emphasis>
  *
  * This thread pops the data from the #FacqBuffer, this data is obtained in form
- * of #FacqChunk. The thread checks for a new #FacqChunk in each iteration and
- * after receiving it the chunk is dispatched. In case of error the loop is
+ * of #FacqChunk. The thread waits for a new #FacqChunk in each iteration and
+ * then takes all the chunks that are waiting in the buffer, up to 64, with
+ * facq_buffer_pop_batch(), dispatching them together. In case of error the loop is
  * interrupted, the sink is stopped, and the facq_buffer_exit() function is
  * called.
  * When facq_buffer_get_exit() returns TRUE, the thread pops all the remaining 
  * chunks in the #FacqBuffer dispatching them, stopping the sink when finished, 
  * and destroying itself.
  *
- * The process of dispatching a #FacqChunk involves the following steps:
- * - If the operation list is not empty, execute each operation in order. The
- *   data in the chunk can be used in each operation.
- * - The sink is polled, the thread will wait until the sink is ready.
- * - The data is written to the sink.
- * - The array is recycled.
+ * The process of dispatching the chunks involves the following steps:
+ * - If the operation list is not empty, execute each operation in order, over
+ *   all the chunks, see facq_operation_list_dov(). The
+ *   data in the chunks can be used in each operation. Operations that change
+ *   the stream, see #FacqOperationFlags, leave their output in the same
+ *   chunks, and the sinks are started with the #FacqStreamData after the
+ *   last operation, see facq_operation_list_get_stream_data(). Channel independent
+ *   operations can use more threads, see facq_pipeline_set_op_threads().
+ *   Operations can ask for planar chunks, but the chunks always reach the
+ *   sinks interleaved, see %FACQ_OPERATION_FLAG_PLANAR.
+ * - The sink is polled once, the thread will wait until the sink is ready.
+ * - The data of all the chunks is written to the sink with
+ *   facq_sink_writev(), that needs a single system call for the file and null
+ *   sinks.
+ * - The chunks are recycled.
+ *
+ *
+ * <emphasis>Staged mode</emphasis>
+ *
+ * If the pipeline is staged, see facq_pipeline_set_staged(), each
+ * #FacqOperation in the #FacqOperationList gets its own thread, and the
+ * stages are connected with bounded queues created with
+ * facq_buffer_new_queue(). The first stage pops the chunks from the
+ * #FacqBuffer, executes its operation and pushes the chunk to the next stage,
+ * the consumer thread pops the chunks from the last stage and only writes them
+ * to the sink. This way a slow operation, for example one sending the data
+ * over a network, doesn't stop the sink and the rest of operations. When a
+ * stage finds facq_buffer_get_exit() in its input queue it dispatches the
+ * remaining chunks and calls facq_buffer_exit() in its output queue, so
+ * the exit condition flows along the stages in order. If an operation fails the
+ * following chunks are cleared and passed along so they reach the consumer
+ * and can be recycled, without being written to the sink.
+ *
+ * The number of chunks waiting in the input queue of each stage (Including the
+ * consumer, that is always the last stage) is published trough
+ * facq_pipeline_monitor_set_stage_depth().
+ *
+ *
+ * <emphasis>Channel parallel operations</emphasis>
+ *
+ * With facq_pipeline_set_op_threads() each channel independent operation, see
+ * facq_operation_get_channel_independent(), splits the chunks in groups of
+ * channels that are processed at the same time by a pool of threads, see
+ * facq_operation_list_set_threads(). The consumer thread (or the stage thread
+ * in staged mode) processes one of the groups and waits for the others, so
+ * the chunks are complete before reaching the next operation or the sink.
+ * This way the operations on streams with many channels aren't limited to a
+ * single core.
+ *
+ *
+ * <emphasis>Native samples</emphasis>
+ *
+ * With facq_pipeline_set_native_samples(), if the source describes its
+ * samples with a #FacqSampleFormat, see facq_stream_data_set_format(), the
+ * producer thread doesn't convert the data, and the chunks carry the samples
+ * as they were read, for example 2 or 4 bytes per sample for a comedi device
+ * instead of 8. The chunks are converted in place with
+ * facq_stream_data_to_double() when they leave the #FacqBuffer, by the
+ * consumer thread or by the first stage in staged mode, so the operations and
+ * the sinks always receive #gdouble samples. This way the producer thread
+ * only reads from the source, and the data written to the chunks, moved
+ * between the threads, and spilled to disk with
+ * %FACQ_PIPELINE_OVERFLOW_SPILL, is 2 to 4 times smaller. The time converting
+ * the chunks is added to the time of the operations in #FacqPipelineStats.
+ *
+ *
+ * <emphasis>Converter thread</emphasis>
+ *
+ * Converting the samples in the producer thread delays the next read from the
+ * source, and with fast sources the driver buffer, for example the comedi or
+ * the NIDAQ one, can overflow. With facq_pipeline_set_conv_thread() the
+ * producer thread pushes the raw chunks to the #FacqBuffer, like with native
+ * samples, and a converter thread pops them, converts them with
+ * facq_source_conv() and pushes them to a queue created with
+ * facq_buffer_new_queue(), that is the input of the first stage or the
+ * consumer thread. The exit condition reaches the converter thread trough the
+ * #FacqBuffer, and is passed to its queue after converting the remaining
+ * chunks, like in staged mode. The converter thread isn't used with native
+ * samples, because they are converted by the first stage or the consumer. The
+ * time converting the chunks is added to the time of the operations in
+ * #FacqPipelineStats.
+ *
+ *
+ * <emphasis>Fan-out</emphasis>
+ *
+ * More sinks can be added to the pipeline with facq_pipeline_add_sink(). In
+ * this case each #FacqSink, including the one passed to facq_pipeline_new(),
+ * gets its own branch thread and input queue, and the consumer thread, after
+ * executing the operations, pushes the same #FacqChunk to every branch
+ * instead of writing it to the sink. The chunks aren't copied, the number of
+ * users of the chunk is set with facq_chunk_set_users() and the branch that
+ * calls facq_chunk_release() the last time recycles it. Because the chunks
+ * are recycled from more than one thread, the #FacqBuffer is created with
+ * facq_buffer_new() in this mode.
+ *
+ * The #FacqPipelineOverflow policy of each branch decides what happens when
+ * its queue is full, with %FACQ_PIPELINE_OVERFLOW_BLOCK the consumer waits
+ * for the branch, with %FACQ_PIPELINE_OVERFLOW_DROP_NEWEST the chunk is
+ * not written to the sink of the branch, and with
+ * %FACQ_PIPELINE_OVERFLOW_DROP_OLDEST the oldest chunk in the queue is
+ * discarded to make room for it, so a slow branch can't stall the others.
+ * Dropped chunks are reported like in the producer thread.
+ * %FACQ_PIPELINE_OVERFLOW_SPILL is not supported by the branches. The sink
+ * passed to facq_pipeline_new() always uses %FACQ_PIPELINE_OVERFLOW_BLOCK.
+ *
+ *
+ * <emphasis>Statistics</emphasis>
+ *
+ * While the pipeline is running the threads keep some counters, updated once
+ * per #FacqChunk, that can be read at any moment with
+ * facq_pipeline_get_stats(), see #FacqPipelineStats. Comparing the time
+ * needed to process a chunk with the time the source needs to fill it, or
+ * looking at the number of chunks waiting in the #FacqBuffer, tells if the
+ * pipeline is close to be overrun.
  * 
  */
 
@@ -150,6 +290,45 @@
  * Contains all the private data needed by the pipeline.
  */
 
+/**
+ * FacqPipelineOverflow:
+ * @FACQ_PIPELINE_OVERFLOW_BLOCK: Wait until there is room in the queue.
+ * @FACQ_PIPELINE_OVERFLOW_DROP_NEWEST: Discard the chunk that doesn't fit in
+ * the queue.
+ * @FACQ_PIPELINE_OVERFLOW_DROP_OLDEST: Discard the oldest chunk in the queue
+ * to make room for the new one.
+ * @FACQ_PIPELINE_OVERFLOW_SPILL: Store the data that doesn't fit in a
+ * temporary file, until there is room again.
+ *
+ * Enum values for the policies used when a queue of the pipeline is full.
+ */
+
+/**
+ * FacqPipelineStats:
+ * @bytes_in: Bytes read from the source.
+ * @chunks_in: Chunks filled by the producer thread.
+ * @bytes_out: Bytes that reached the sink, or the branches in fan-out mode.
+ * @chunks_out: Chunks that reached the sink, or the branches in fan-out mode.
+ * @ring_length: Chunks waiting in the #FacqBuffer right now.
+ * @ring_size: The number of chunks of the #FacqBuffer.
+ * @ring_high_water: The maximum value of @ring_length since the start.
+ * @read_time: Average time, in seconds, reading and converting the data of
+ * a chunk, not including the time waiting for the source.
+ * @operation_time: Average time, in seconds, executing the operations on a
+ * chunk. In staged mode the time of all the stages is added.
+ * @write_time: Average time, in seconds, polling and writing a chunk to the
+ * sink. In fan-out mode the time of all the sinks is added.
+ * @latency: Average time, in seconds, since a chunk is filled by the producer
+ * thread until it's written to the sink, or passed to the branches in
+ * fan-out mode. See facq_chunk_get_timestamp().
+ * @elapsed: Seconds since the pipeline was started, or until it was stopped.
+ * @stop_latency: Seconds needed by facq_pipeline_stop() to stop all the
+ * threads, or 0 if the pipeline hasn't been stopped.
+ *
+ * A snapshot of the counters of a #FacqPipeline, see
+ * facq_pipeline_get_stats().
+ */
+
 #define EOF_READING_SOURCE   "End of file in source"
 #define EOF_WRITING_SINK     "End of file in sink"
 #define ERROR_POLLING_SOURCE "Error while polling the source"
@@ -158,6 +337,14 @@
 #define ERROR_WRITING_SINK   "Error while writing to the sink"
 #define ERROR_OPERATION_DO   "Error in operation"
 #define ERROR_PIPELINE_START "Error starting the pipeline"
+#define OVERFLOW_RING_BUFFER "ring buffer"
+
+/* maximum number of chunks dispatched by the consumer (or a branch) after
+ * one wake up */
+#define FACQ_PIPELINE_BATCH_MAX 64
+
+/* maximum number of threads executing a channel independent operation */
+#define FACQ_PIPELINE_OP_THREADS_MAX 64
 
 static void facq_pipeline_initable_iface_init(GInitableIface  *iface);
 static gboolean facq_pipeline_initable_init(GInitable *initable,GCancellable *cancellable,GError **error);
@@ -171,9 +358,79 @@ enum {
 	PROP_MONITOR,
 	PROP_SOURCE,
 	PROP_OPERATION_LIST,
-	PROP_SINK
+	PROP_SINK,
+	PROP_STAGED,
+	PROP_OVERFLOW,
+	PROP_LOCKED_MEMORY,
+	PROP_OP_THREADS,
+	PROP_NATIVE_SAMPLES,
+	PROP_CONV_THREAD
 };
 
+/*
+ * FacqPipelineOverflowState:
+ *
+ * Tracks an overflow in a queue, from the first chunk that doesn't fit until
+ * there is room again, so only two messages are sent to the monitor in each
+ * overflow. Only used by the thread pushing to the queue.
+ */
+typedef struct _FacqPipelineOverflowState {
+	gboolean active;
+	guint dropped;
+	guint spilled;
+} FacqPipelineOverflowState;
+
+/*
+ * FacqPipelineCounters:
+ *
+ * The values accumulated by the threads for facq_pipeline_get_stats(), times
+ * are in microseconds. Protected by the stats mutex.
+ */
+typedef struct _FacqPipelineCounters {
+	guint64 bytes_in;
+	guint64 chunks_in;
+	guint64 bytes_out;
+	guint64 chunks_out;
+	guint high_water;
+	gint64 read_time;
+	gint64 operation_time;
+	gint64 write_time;
+	gint64 latency;
+	gint64 start_time;
+	gint64 stop_time;
+	gint64 stop_latency;
+} FacqPipelineCounters;
+
+/*
+ * FacqPipelineStage:
+ *
+ * A thread executing a single operation in staged mode. Chunks are popped
+ * from in, and after executing the operation, pushed to out.
+ */
+typedef struct _FacqPipelineStage {
+	FacqPipeline *p;
+	guint index;
+	FacqOperation *op;
+	FacqBuffer *in;
+	FacqBuffer *out;
+	GThread *thread;
+} FacqPipelineStage;
+
+/*
+ * FacqPipelineBranch:
+ *
+ * A thread writing the chunks to a single sink in fan-out mode. Chunks are
+ * popped from in, written to the sink and released.
+ */
+typedef struct _FacqPipelineBranch {
+	FacqPipeline *p;
+	FacqSink *sink;
+	FacqPipelineOverflow overflow;
+	FacqBuffer *in;
+	GThread *thread;
+	FacqPipelineOverflowState ovf;
+} FacqPipelineBranch;
+
 struct _FacqPipelinePrivate {
 	GError *construct_error;
 	guint ring_chunks;
@@ -185,6 +442,32 @@ struct _FacqPipelinePrivate {
 	FacqSource *src;
 	FacqOperationList *oplist;
 	FacqSink *sink;
+	FacqStreamData *sink_stmd;
+	gboolean staged;
+	gboolean locked_memory;
+	guint op_threads;
+	gboolean native_samples;
+	gboolean native;
+	gboolean conv_thread;
+	gboolean converting;
+	GThread *converter;
+	FacqBuffer *conv_out;
+	FacqChunk *conv_raw;
+	guint n_stages;
+	FacqPipelineStage *stages;
+	FacqBuffer *sink_in;
+	guint n_branches;
+	FacqPipelineBranch *branches;
+	FacqPipelineOverflow overflow;
+	FacqPipelineOverflowState ovf;
+	FacqChunk *spare;
+	FacqSpill *spill;
+	FacqPipelineCounters counters;
+#if GLIB_MINOR_VERSION >= 32
+	GMutex stats_mutex;
+#else
+	GMutex *stats_mutex;
+#endif
 };
 
 GQuark facq_pipeline_error_quark(void)
@@ -209,6 +492,352 @@ static void facq_pipeline_stop_condition(FacqPipeline *p,const gchar *info)
 	facq_pipeline_monitor_push(p->priv->mon,msg);
 }
 
+static void facq_pipeline_overflow_begin(FacqPipeline *p,FacqPipelineOverflowState *ovf,const gchar *name)
+{
+	FacqPipelineMessage *msg = NULL;
+	gchar *info = NULL;
+
+	if(ovf->active)
+		return;
+	ovf->active = TRUE;
+	ovf->dropped = ovf->spilled = 0;
+	info = g_strdup_printf("Overflow in %s, the data can't be processed in time",name);
+	msg = facq_pipeline_message_new(FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW,info);
+	facq_pipeline_monitor_push(p->priv->mon,msg);
+	g_free(info);
+}
+
+static void facq_pipeline_overflow_end(FacqPipeline *p,FacqPipelineOverflowState *ovf,const gchar *name)
+{
+	FacqPipelineMessage *msg = NULL;
+	gchar *info = NULL;
+
+	if(!ovf->active)
+		return;
+	ovf->active = FALSE;
+	info = g_strdup_printf("Overflow in %s finished, %u chunks dropped, %u chunks spilled to disk",
+				name,ovf->dropped,ovf->spilled);
+	msg = facq_pipeline_message_new(FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW,info);
+	facq_pipeline_monitor_push(p->priv->mon,msg);
+	g_free(info);
+}
+
+static void facq_pipeline_overflow_drop(FacqPipeline *p,FacqPipelineOverflowState *ovf,guint n_chunks)
+{
+	ovf->dropped += n_chunks;
+	facq_pipeline_monitor_add_dropped(p->priv->mon,n_chunks);
+}
+
+static void facq_pipeline_stats_lock(FacqPipeline *p)
+{
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&p->priv->stats_mutex);
+#else
+	g_mutex_lock(p->priv->stats_mutex);
+#endif
+}
+
+static void facq_pipeline_stats_unlock(FacqPipeline *p)
+{
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_unlock(&p->priv->stats_mutex);
+#else
+	g_mutex_unlock(p->priv->stats_mutex);
+#endif
+}
+
+static void facq_pipeline_stats_reset(FacqPipeline *p)
+{
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.bytes_in = p->priv->counters.chunks_in = 0;
+	p->priv->counters.bytes_out = p->priv->counters.chunks_out = 0;
+	p->priv->counters.high_water = 0;
+	p->priv->counters.read_time = 0;
+	p->priv->counters.operation_time = 0;
+	p->priv->counters.write_time = 0;
+	p->priv->counters.latency = 0;
+	p->priv->counters.start_time = g_get_monotonic_time();
+	p->priv->counters.stop_time = 0;
+	p->priv->counters.stop_latency = 0;
+	facq_pipeline_stats_unlock(p);
+}
+
+/* Called by the producer after pushing a chunk to the #FacqBuffer */
+static void facq_pipeline_stats_chunk_in(FacqPipeline *p,gsize bytes,gint64 read_time)
+{
+	guint len = 0;
+
+	len = facq_buffer_get_length(p->priv->buf);
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.bytes_in += bytes;
+	p->priv->counters.chunks_in++;
+	p->priv->counters.read_time += read_time;
+	if(len > p->priv->counters.high_water)
+		p->priv->counters.high_water = len;
+	facq_pipeline_stats_unlock(p);
+}
+
+static void facq_pipeline_stats_operation(FacqPipeline *p,gint64 operation_time)
+{
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.operation_time += operation_time;
+	facq_pipeline_stats_unlock(p);
+}
+
+static void facq_pipeline_stats_write(FacqPipeline *p,gint64 write_time)
+{
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.write_time += write_time;
+	facq_pipeline_stats_unlock(p);
+}
+
+static void facq_pipeline_stats_chunks_out(FacqPipeline *p,FacqChunk **chunks,guint n_chunks)
+{
+	gint64 now = 0, latency = 0;
+	gsize bytes = 0;
+	guint i = 0;
+
+	now = g_get_monotonic_time();
+	for(i = 0;i < n_chunks;i++){
+		bytes += facq_chunk_get_used_bytes(chunks[i]);
+		latency += now - facq_chunk_get_timestamp(chunks[i]);
+	}
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.bytes_out += bytes;
+	p->priv->counters.chunks_out += n_chunks;
+	p->priv->counters.latency += latency;
+	facq_pipeline_stats_unlock(p);
+}
+
+/* Returns the number of seconds that the consumer and the stages wait for
+ * a chunk before checking the exit condition again */
+static gdouble facq_pipeline_pop_timeout(const FacqStreamData *stmd)
+{
+	if(stmd->period > 1)
+		return stmd->period;
+	return 1;
+}
+
+/* Returns the #FacqBuffer where the chunks with #gdouble samples, or native
+ * samples, are waiting for the operations */
+static FacqBuffer *facq_pipeline_get_ops_in(FacqPipeline *p)
+{
+	if(p->priv->conv_out)
+		return p->priv->conv_out;
+	return p->priv->buf;
+}
+
+static void facq_pipeline_stages_free(FacqPipeline *p)
+{
+	guint i = 0;
+
+	for(i = 0;i < p->priv->n_stages;i++){
+		if(p->priv->stages[i].out)
+			facq_buffer_free(p->priv->stages[i].out);
+	}
+	if(p->priv->stages)
+		g_free(p->priv->stages);
+	p->priv->stages = NULL;
+	p->priv->n_stages = 0;
+	p->priv->sink_in = facq_pipeline_get_ops_in(p);
+}
+
+/*
+ * facq_pipeline_stages_new:
+ *
+ * In staged mode, creates a stage for each operation, chaining the queues so
+ * the input of each stage is the output of the previous one. The input of the
+ * consumer is the output of the last stage, or the #FacqBuffer (Or the output
+ * of the converter thread) if the pipeline is not staged or the operation
+ * list is empty.
+ * Also tells the monitor the number of stages, including the consumer.
+ */
+static gboolean facq_pipeline_stages_new(FacqPipeline *p,GError **err)
+{
+	FacqPipelineStage *stage = NULL;
+	FacqBuffer *in = NULL;
+	guint i = 0, n_ops = 0;
+
+	facq_pipeline_stages_free(p);
+
+	n_ops = facq_operation_list_get_length(p->priv->oplist);
+	if(p->priv->staged && n_ops){
+		p->priv->stages = g_new0(FacqPipelineStage,n_ops);
+		in = facq_pipeline_get_ops_in(p);
+		for(i = 0;i < n_ops;i++){
+			stage = &p->priv->stages[i];
+			stage->p = p;
+			stage->index = i;
+			stage->op = facq_operation_list_get(p->priv->oplist,i);
+			stage->in = in;
+			stage->out = facq_buffer_new_queue(p->priv->ring_chunks,err);
+			if(!stage->out)
+				return FALSE;
+			p->priv->n_stages++;
+			in = stage->out;
+		}
+		p->priv->sink_in = in;
+	}
+	facq_pipeline_monitor_set_n_stages(p->priv->mon,p->priv->n_stages+1);
+	return TRUE;
+}
+
+static void facq_pipeline_converter_free(FacqPipeline *p)
+{
+	if(p->priv->sink_in == p->priv->conv_out)
+		p->priv->sink_in = p->priv->buf;
+	if(p->priv->conv_out)
+		facq_buffer_free(p->priv->conv_out);
+	p->priv->conv_out = NULL;
+	if(p->priv->conv_raw)
+		facq_chunk_free(p->priv->conv_raw);
+	p->priv->conv_raw = NULL;
+	p->priv->converting = FALSE;
+}
+
+/*
+ * facq_pipeline_converter_new:
+ *
+ * If the converter thread has been requested and the samples must be
+ * converted in the pipeline, creates the queue between the converter thread
+ * and the operations, and the chunk where the raw samples are copied before
+ * the conversion. Must be called before facq_pipeline_stages_new().
+ */
+static gboolean facq_pipeline_converter_new(FacqPipeline *p,GError **err)
+{
+	const FacqStreamData *stmd = NULL;
+	gsize raw_len = 0;
+
+	facq_pipeline_converter_free(p);
+	if(!p->priv->conv_thread || p->priv->native ||
+			!facq_source_needs_conv(p->priv->src))
+		return TRUE;
+
+	stmd = facq_source_get_stream_data(p->priv->src);
+	raw_len = stmd->bps*(p->priv->chunk_size/sizeof(gdouble));
+	p->priv->conv_raw = facq_chunk_new(raw_len,err);
+	if(!p->priv->conv_raw)
+		return FALSE;
+	p->priv->conv_out = facq_buffer_new_queue(p->priv->ring_chunks,err);
+	if(!p->priv->conv_out)
+		return FALSE;
+	p->priv->sink_in = p->priv->conv_out;
+	p->priv->converting = TRUE;
+	return TRUE;
+}
+
+static void facq_pipeline_branches_free(FacqPipeline *p)
+{
+	guint i = 0;
+
+	for(i = 0;i < p->priv->n_branches;i++){
+		if(p->priv->branches[i].in)
+			facq_buffer_free(p->priv->branches[i].in);
+		p->priv->branches[i].in = NULL;
+	}
+}
+
+/*
+ * facq_pipeline_buffer_new:
+ *
+ * Replaces the #FacqBuffer created at construction time if it doesn't fit
+ * the pipeline settings. In fan-out mode the branch threads recycle the
+ * chunks, so a single producer single consumer #FacqBuffer can't be used,
+ * and the chunks must be allocated again if locked memory has been
+ * requested.
+ */
+static gboolean facq_pipeline_buffer_new(FacqPipeline *p,GError **err)
+{
+	FacqBuffer *buf = NULL;
+	gboolean spsc = FALSE, locked_memory = FALSE;
+
+	g_object_get(G_OBJECT(p->priv->buf),
+			"spsc",&spsc,
+			"locked-memory",&locked_memory,
+			NULL);
+	if(spsc == !p->priv->n_branches && locked_memory == p->priv->locked_memory)
+		return TRUE;
+
+	buf = facq_buffer_new_full(p->priv->ring_chunks,
+				   p->priv->chunk_size,
+				   !p->priv->n_branches,
+				   p->priv->locked_memory,
+				   err);
+	if(!buf)
+		return FALSE;
+	facq_buffer_free(p->priv->buf);
+	p->priv->buf = buf;
+	p->priv->sink_in = buf;
+	return TRUE;
+}
+
+/*
+ * facq_pipeline_branches_new:
+ *
+ * In fan-out mode, creates the input queue of each branch, the first branch
+ * writes to the sink passed to facq_pipeline_new().
+ */
+static gboolean facq_pipeline_branches_new(FacqPipeline *p,GError **err)
+{
+	guint i = 0;
+
+	facq_pipeline_branches_free(p);
+	if(!p->priv->n_branches)
+		return TRUE;
+
+	p->priv->branches[0].sink = p->priv->sink;
+	p->priv->branches[0].overflow = FACQ_PIPELINE_OVERFLOW_BLOCK;
+	for(i = 0;i < p->priv->n_branches;i++){
+		p->priv->branches[i].p = p;
+		p->priv->branches[i].in = 
+			facq_buffer_new_queue(p->priv->ring_chunks,err);
+		if(!p->priv->branches[i].in)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void facq_pipeline_overflow_free(FacqPipeline *p)
+{
+	if(p->priv->spare)
+		facq_chunk_free(p->priv->spare);
+	p->priv->spare = NULL;
+	if(p->priv->spill)
+		facq_spill_free(p->priv->spill);
+	p->priv->spill = NULL;
+	p->priv->ovf.active = FALSE;
+}
+
+/*
+ * facq_pipeline_overflow_new:
+ *
+ * Creates the spare chunk used by the producer when there aren't recycled
+ * chunks, and the #FacqSpill, if the overflow policy needs them.
+ */
+static gboolean facq_pipeline_overflow_new(FacqPipeline *p,GError **err)
+{
+	facq_pipeline_overflow_free(p);
+	if(p->priv->overflow == FACQ_PIPELINE_OVERFLOW_BLOCK)
+		return TRUE;
+
+	p->priv->spare = facq_chunk_new(p->priv->chunk_size,err);
+	if(!p->priv->spare)
+		return FALSE;
+	if(p->priv->overflow == FACQ_PIPELINE_OVERFLOW_SPILL){
+		p->priv->spill = facq_spill_new(err);
+		if(!p->priv->spill)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/* Releases a chunk shared by the branches, recycling it if needed */
+static void facq_pipeline_release_chunk(FacqPipeline *p,FacqChunk *chunk)
+{
+	if(facq_chunk_release(chunk))
+		facq_buffer_recycle(p->priv->buf,chunk);
+}
+
 /* facq_pipeline_start_cleanup:
  *
  * @p: A #FacqPipeline Object.
@@ -221,7 +850,11 @@ static void facq_pipeline_stop_condition(FacqPipeline *p,const gchar *info)
  */
 static void facq_pipeline_start_cleanup(FacqPipeline *p,const FacqStreamData *stmd)
 {
+	const FacqStreamData *sink_stmd = NULL;
 	GError *local_err = NULL;
+	guint i = 0;
+
+	sink_stmd = (p->priv->sink_stmd) ? p->priv->sink_stmd : stmd;
 
 #if ENABLE_DEBUG
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,"%s","Pipeline cleanup started");
@@ -238,7 +871,7 @@ static void facq_pipeline_start_cleanup(FacqPipeline *p,const FacqStreamData *st
 		}
 	}
 	
-	if(!facq_sink_stop(p->priv->sink,stmd,&local_err)){
+	if(!facq_sink_stop(p->priv->sink,sink_stmd,&local_err)){
 		if(local_err){
 			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",local_err->message);
 			g_clear_error(&local_err);
@@ -249,6 +882,19 @@ static void facq_pipeline_start_cleanup(FacqPipeline *p,const FacqStreamData *st
 		}
 	}
 
+	for(i = 1;i < p->priv->n_branches;i++){
+		if(!facq_sink_stop(p->priv->branches[i].sink,sink_stmd,&local_err)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",local_err->message);
+				g_clear_error(&local_err);
+			}
+			else {
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",
+						"Unknown error stopping sink");
+			}
+		}
+	}
+
 	if(!facq_operation_list_stop(p->priv->oplist,stmd,&local_err)){
 		if(local_err){
 			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",local_err->message);
@@ -261,13 +907,13 @@ static void facq_pipeline_start_cleanup(FacqPipeline *p,const FacqStreamData *st
 	}
 }
 
-static gboolean producer_read_fun(FacqPipeline *p,FacqSource *src,FacqChunk *src_chunk,gsize *bytes_read)
+static gboolean producer_read_fun(FacqPipeline *p,FacqSource *src,FacqChunk *src_chunk,gsize read_len,gsize *bytes_read)
 {
 	GError *local_err = NULL;
 	gsize count = 0;
 	gchar *buf = NULL;
 
-	count = facq_chunk_get_free_bytes(src_chunk);
+	count = read_len - facq_chunk_get_used_bytes(src_chunk);
 	buf = facq_chunk_write_pos(src_chunk);
 
 	switch(facq_source_read(src,buf,count,bytes_read,&local_err)){
@@ -304,6 +950,97 @@ static gboolean producer_read_fun(FacqPipeline *p,FacqSource *src,FacqChunk *src
 	}
 }
 
+/*
+ * producer_push_chunk:
+ *
+ * Pushes the chunk to the #FacqBuffer. If the chunk is the spare one, there
+ * wasn't room for it, so the data is spilled to disk or discarded.
+ */
+static void producer_push_chunk(FacqPipeline *p,FacqChunk *chunk)
+{
+	GError *err = NULL;
+
+	if(chunk != p->priv->spare){
+		facq_buffer_push(p->priv->buf,chunk);
+		return;
+	}
+	if(p->priv->spill){
+		if(facq_spill_push(p->priv->spill,chunk,&err))
+			p->priv->ovf.spilled++;
+		else {
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",err->message);
+			g_clear_error(&err);
+			facq_pipeline_overflow_drop(p,&p->priv->ovf,1);
+		}
+	}
+	else
+		facq_pipeline_overflow_drop(p,&p->priv->ovf,1);
+	facq_chunk_clear(chunk);
+}
+
+/*
+ * producer_unspill:
+ *
+ * Moves the spilled data to the #FacqBuffer while there are recycled chunks.
+ * Returns %TRUE if all the spilled data has been moved.
+ */
+static gboolean producer_unspill(FacqPipeline *p)
+{
+	FacqChunk *chunk = NULL;
+	GError *err = NULL;
+
+	while(facq_spill_get_length(p->priv->spill)){
+		chunk = facq_buffer_try_get_recycled(p->priv->buf);
+		if(!chunk)
+			return FALSE;
+		if(!facq_spill_pop(p->priv->spill,chunk,&err)){
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",err->message);
+			g_clear_error(&err);
+			facq_pipeline_overflow_drop(p,&p->priv->ovf,
+					facq_spill_get_length(p->priv->spill));
+			facq_spill_clear(p->priv->spill);
+			facq_buffer_recycle(p->priv->buf,chunk);
+			return TRUE;
+		}
+		facq_buffer_push(p->priv->buf,chunk);
+	}
+	return TRUE;
+}
+
+/*
+ * producer_next_chunk:
+ *
+ * Gets the chunk where the next data will be read, following the overflow
+ * policy of the pipeline if there isn't any recycled chunk.
+ */
+static FacqChunk *producer_next_chunk(FacqPipeline *p)
+{
+	FacqChunk *chunk = NULL;
+
+	if(p->priv->overflow == FACQ_PIPELINE_OVERFLOW_BLOCK)
+		return facq_buffer_get_recycled(p->priv->buf);
+
+	/* the spilled data goes first, meanwhile the new data is spilled too */
+	if(p->priv->spill && !producer_unspill(p))
+		return p->priv->spare;
+
+	chunk = facq_buffer_try_get_recycled(p->priv->buf);
+	if(chunk){
+		facq_pipeline_overflow_end(p,&p->priv->ovf,OVERFLOW_RING_BUFFER);
+		return chunk;
+	}
+	facq_pipeline_overflow_begin(p,&p->priv->ovf,OVERFLOW_RING_BUFFER);
+	if(p->priv->overflow == FACQ_PIPELINE_OVERFLOW_DROP_OLDEST){
+		chunk = facq_buffer_try_pop(p->priv->buf);
+		if(chunk){
+			facq_pipeline_overflow_drop(p,&p->priv->ovf,1);
+			facq_chunk_clear(chunk);
+			return chunk;
+		}
+	}
+	return p->priv->spare;
+}
+
 static gpointer producer_fun(gpointer pipeline)
 {
 	FacqPipeline *p = FACQ_PIPELINE(pipeline);
@@ -314,23 +1051,40 @@ static gpointer producer_fun(gpointer pipeline)
 	gint ret = 0;
 	GError *src_stop_err = NULL;
 	gsize absolute_bytes_read = 0, total_bytes_read = 0, bytes_read = 0;
+	gsize read_len = 0;
 	GTimer *timer = NULL;
 	gdouble total_seconds = 0;
+	gint64 t0 = 0, read_time = 0, acq_time = 0;
+	guint64 sequence = 0;
 
 	g_return_val_if_fail(FACQ_IS_PIPELINE(p),NULL);
 
 	timer = g_timer_new();
 	stmd = facq_source_get_stream_data(src);
-	conv = facq_source_needs_conv(src);
+	/* with native samples, or with the converter thread, the conversion
+	 * is done after the ring buffer, the chunks only carry the bytes read
+	 * from the source */
+	conv = !p->priv->native && !p->priv->converting &&
+		facq_source_needs_conv(src);
 	dst_chunk = facq_buffer_get_recycled(p->priv->buf);
+	if(!dst_chunk)
+		goto exit;
 
+	if(conv || p->priv->native || p->priv->converting)
+		read_len = stmd->bps*(p->priv->chunk_size/sizeof(gdouble));
+	else
+		read_len = p->priv->chunk_size;
 	if(conv)
-		src_chunk = facq_chunk_new(stmd->bps*(p->priv->chunk_size/sizeof(gdouble)),NULL);
+		src_chunk = facq_chunk_new(read_len,NULL);
 	else
 		src_chunk = dst_chunk;
 
 	while(!facq_buffer_get_exit(p->priv->buf)){
-		while(total_bytes_read != src_chunk->len){
+		while(total_bytes_read != read_len){
+			/* facq_pipeline_stop() interrupts the source, the
+			 * partial chunk is discarded */
+			if(facq_buffer_get_exit(p->priv->buf))
+				goto exit;
 #if ENABLE_DEBUG
 			facq_log_write("Producer: Polling source",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
@@ -344,8 +1098,13 @@ static gpointer producer_fun(gpointer pipeline)
 			}
 			else if(ret > 0){
 				bytes_read = 0;
-				if(!producer_read_fun(p,src,src_chunk,&bytes_read))
+				t0 = g_get_monotonic_time();
+				if(!producer_read_fun(p,src,src_chunk,read_len,&bytes_read))
 					goto exit;
+				/* the chunk is stamped when its last bytes are
+				 * read, before any conversion */
+				acq_time = g_get_monotonic_time();
+				read_time += acq_time - t0;
 #if ENABLE_DEBUG
 				facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,"Producer: read ""%"G_GSIZE_FORMAT" bytes",bytes_read);
 #endif
@@ -355,20 +1114,29 @@ static gpointer producer_fun(gpointer pipeline)
 			else continue;
 		}
 		if(conv){
+			t0 = g_get_monotonic_time();
 			facq_source_conv(src,
 					 src_chunk->data,
 					 (gdouble *)dst_chunk->data,
 					 dst_chunk->len/sizeof(gdouble));
 			facq_chunk_add_used_bytes(dst_chunk,dst_chunk->len);
+			read_time += g_get_monotonic_time() - t0;
 		}
-		facq_buffer_push(p->priv->buf,dst_chunk);
+		facq_chunk_set_sequence(dst_chunk,sequence++);
+		facq_chunk_set_timestamp(dst_chunk,acq_time);
+		producer_push_chunk(p,dst_chunk);
+		facq_pipeline_stats_chunk_in(p,total_bytes_read,read_time);
+		read_time = 0;
 #if ENABLE_DEBUG
 		facq_log_write("Producer: going to sleep",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
-		dst_chunk = facq_buffer_get_recycled(p->priv->buf);
+		dst_chunk = producer_next_chunk(p);
 #if ENABLE_DEBUG
 		facq_log_write("Producer: waking up again",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
+		/* the pipeline is being stopped while waiting for a chunk */
+		if(!dst_chunk)
+			break;
 		total_bytes_read = bytes_read = 0;
 		if(!conv)
 			src_chunk = dst_chunk;
@@ -401,6 +1169,10 @@ static gpointer producer_fun(gpointer pipeline)
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
 			"Average data input equals %f samples per second",
 			(absolute_bytes_read/stmd->bps)/total_seconds);
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"Nominal data input equals %f samples per second, %"G_GUINT64_FORMAT" missed deadlines",
+			stmd->n_channels/stmd->period,
+			facq_source_get_overruns(src));
 	g_timer_destroy(timer);
 
 #if ENABLE_DEBUG
@@ -412,11 +1184,166 @@ static gpointer producer_fun(gpointer pipeline)
 	return NULL;
 }
 
-static gboolean consumer_write_fun(FacqPipeline *p,FacqSink *sink,const FacqStreamData *stmd,FacqChunk *chunk)
+/*
+ * facq_pipeline_native_to_double:
+ *
+ * With native samples, converts the chunks popped from the #FacqBuffer to
+ * #gdouble in place, before the operations or the sinks use them. The chunks
+ * of the #FacqBuffer have room for the #gdouble samples. The time is added to
+ * the time of the operations.
+ */
+static void facq_pipeline_native_to_double(FacqPipeline *p,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks)
+{
+	gint64 t0 = 0;
+	gsize samples = 0;
+	guint i = 0;
+
+	t0 = g_get_monotonic_time();
+	for(i = 0;i < n_chunks;i++){
+		samples = facq_chunk_get_used_bytes(chunks[i])/stmd->bps;
+		facq_stream_data_to_double(stmd,chunks[i]->data,
+					   (gdouble *)chunks[i]->data,samples);
+		facq_chunk_clear(chunks[i]);
+		facq_chunk_add_used_bytes(chunks[i],samples*sizeof(gdouble));
+	}
+	facq_pipeline_stats_operation(p,g_get_monotonic_time() - t0);
+}
+
+/*
+ * converter_dispatch_chunk:
+ *
+ * Converts a chunk read by the producer to #gdouble and pushes it to the
+ * operations. facq_source_conv() can't work in place, so the raw samples are
+ * copied first. The time is added to the time of the operations.
+ */
+static void converter_dispatch_chunk(FacqPipeline *p,FacqChunk *chunk)
+{
+	gsize used_bytes = 0;
+	gint64 t0 = 0;
+
+	used_bytes = facq_chunk_get_used_bytes(chunk);
+	if(used_bytes){
+		t0 = g_get_monotonic_time();
+		memcpy(p->priv->conv_raw->data,chunk->data,
+		       MIN(used_bytes,p->priv->conv_raw->len));
+		facq_source_conv(p->priv->src,
+				 p->priv->conv_raw->data,
+				 (gdouble *)chunk->data,
+				 chunk->len/sizeof(gdouble));
+		facq_chunk_clear(chunk);
+		facq_chunk_add_used_bytes(chunk,chunk->len);
+		facq_pipeline_stats_operation(p,g_get_monotonic_time() - t0);
+	}
+	facq_buffer_push(p->priv->conv_out,chunk);
+}
+
+static gpointer converter_fun(gpointer pipeline)
+{
+	FacqPipeline *p = FACQ_PIPELINE(pipeline);
+	const FacqStreamData *stmd = NULL;
+	FacqChunk *chunk = NULL;
+	gdouble timeout = 0;
+
+	stmd = facq_source_get_stream_data(p->priv->src);
+	timeout = facq_pipeline_pop_timeout(stmd);
+
+	while(!facq_buffer_get_exit(p->priv->buf)){
+		chunk = facq_buffer_timeout_pop(p->priv->buf,timeout);
+		if(chunk)
+			converter_dispatch_chunk(p,chunk);
+	}
+#if ENABLE_DEBUG
+	facq_log_write("Converter: processing remaining data...",FACQ_LOG_MSG_TYPE_DEBUG);
+#endif
+	while( (chunk = facq_buffer_try_pop(p->priv->buf)) != NULL)
+		converter_dispatch_chunk(p,chunk);
+
+	/* the first stage (or the consumer) will exit after dispatching the
+	 * chunks that we have pushed */
+	facq_buffer_exit(p->priv->conv_out);
+#if ENABLE_DEBUG
+	facq_log_write("Converter: exit",FACQ_LOG_MSG_TYPE_DEBUG);
+#endif
+	return NULL;
+}
+
+static void stage_dispatch_chunk(FacqPipelineStage *stage,const FacqStreamData *stmd,FacqChunk *chunk,gboolean *failed)
+{
+	FacqPipeline *p = stage->p;
+	GError *err = NULL;
+	gint64 t0 = 0;
+
+	facq_pipeline_monitor_set_stage_depth(p->priv->mon,
+					      stage->index,
+					      facq_buffer_get_length(stage->in));
+
+	if(!*failed && facq_chunk_get_used_bytes(chunk)){
+		/* the first stage is the first one using the samples */
+		if(!stage->index && p->priv->native)
+			facq_pipeline_native_to_double(p,stmd,&chunk,1);
+		t0 = g_get_monotonic_time();
+		if(!facq_operation_list_dov_op(p->priv->oplist,stage->index,
+						&chunk,1,stmd,&err)){
+			if(err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						 "Operation error: %s",
+						 err->message);
+				g_clear_error(&err);
+			}
+			else {
+				facq_log_write("Unknown error in operation",
+						FACQ_LOG_MSG_TYPE_ERROR);
+			}
+			facq_pipeline_error_condition(p,ERROR_OPERATION_DO);
+			facq_buffer_exit(p->priv->buf);
+			*failed = TRUE;
+		}
+		facq_pipeline_stats_operation(p,g_get_monotonic_time() - t0);
+	}
+	/* after an error the chunks are cleared, they still go trough the rest
+	 * of stages to the consumer, that will recycle them */
+	if(*failed)
+		facq_chunk_clear(chunk);
+	facq_buffer_push(stage->out,chunk);
+}
+
+static gpointer stage_fun(gpointer data)
+{
+	FacqPipelineStage *stage = (FacqPipelineStage *)data;
+	const FacqStreamData *stmd = NULL;
+	FacqChunk *chunk = NULL;
+	gboolean failed = FALSE;
+	gdouble timeout = 0;
+
+	stmd = facq_source_get_stream_data(stage->p->priv->src);
+	timeout = facq_pipeline_pop_timeout(stmd);
+
+	while(!facq_buffer_get_exit(stage->in)){
+		chunk = facq_buffer_timeout_pop(stage->in,timeout);
+		if(chunk)
+			stage_dispatch_chunk(stage,stmd,chunk,&failed);
+	}
+#if ENABLE_DEBUG
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
+			"Stage %u: processing remaining data...",stage->index);
+#endif
+	while( (chunk = facq_buffer_try_pop(stage->in)) != NULL)
+		stage_dispatch_chunk(stage,stmd,chunk,&failed);
+
+	/* the next stage (or the consumer) will exit after dispatching the
+	 * chunks that we have pushed */
+	facq_buffer_exit(stage->out);
+#if ENABLE_DEBUG
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,"Stage %u: exit",stage->index);
+#endif
+	return NULL;
+}
+
+static gboolean consumer_write_fun(FacqPipeline *p,FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks)
 {
 	GError *err = NULL;
 
-	switch(facq_sink_write(sink,stmd,chunk,&err)){
+	switch(facq_sink_writev(sink,stmd,chunks,n_chunks,&err)){
 	case G_IO_STATUS_NORMAL: 
 #if ENABLE_DEBUG
 		facq_log_write("C G_IO_STATUS_NORMAL",FACQ_LOG_MSG_TYPE_DEBUG);
@@ -452,11 +1379,16 @@ static gboolean consumer_write_fun(FacqPipeline *p,FacqSink *sink,const FacqStre
 	}
 }
 
-static gboolean consumer_oplist_do_fun(FacqPipeline *p,const FacqStreamData *stmd,FacqChunk *chunk,FacqOperationList *oplist)
+static gboolean consumer_oplist_do_fun(FacqPipeline *p,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,FacqOperationList *oplist)
 {
 	GError *err = NULL;
+	gint64 t0 = 0;
+	gboolean ret = FALSE;
 
-	if(!facq_operation_list_do(oplist,chunk,stmd,&err)){
+	t0 = g_get_monotonic_time();
+	ret = facq_operation_list_dov(oplist,chunks,n_chunks,stmd,&err);
+	facq_pipeline_stats_operation(p,g_get_monotonic_time() - t0);
+	if(!ret){
 		if(err){
 			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
 					 "Operation error: %s",
@@ -473,16 +1405,21 @@ static gboolean consumer_oplist_do_fun(FacqPipeline *p,const FacqStreamData *stm
         return TRUE;
 }
 
-static gboolean consumer_dispatch_chunk(FacqPipeline *p,const FacqStreamData *stmd,FacqOperationList *oplist,FacqSink *sink,FacqChunk *chunk,gsize *absolute_bytes_written)
+/*
+ * sink_write_chunks:
+ *
+ * Polls the sink until it's ready and writes the chunks to it, with a single
+ * call to facq_sink_writev(). In case of error the error or stop condition is
+ * sent to the monitor and %FALSE is returned.
+ */
+static gboolean sink_write_chunks(FacqPipeline *p,const FacqStreamData *stmd,FacqSink *sink,FacqChunk **chunks,guint n_chunks)
 {
 	gint poll_ret = 0;
 	guint poll_retries = 0;
+	gint64 t0 = 0;
+
+	t0 = g_get_monotonic_time();
 
-#if ENABLE_DEBUG
-	facq_log_write("Consumer: processing chunk",FACQ_LOG_MSG_TYPE_DEBUG);
-#endif
-	if(!consumer_oplist_do_fun(p,stmd,chunk,oplist))
-		return TRUE;
 #if ENABLE_DEBUG
 	facq_log_write("Consumer: polling the sink",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
@@ -496,25 +1433,20 @@ static gboolean consumer_dispatch_chunk(FacqPipeline *p,const FacqStreamData *st
 			facq_log_write("Consumer: error polling the sink",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
 			facq_pipeline_error_condition(p,ERROR_POLLING_SINK);
-			return TRUE;
+			return FALSE;
 		}
 		else if(poll_ret > 0){
 #if ENABLE_DEBUG
 			facq_log_write("Consumer: sink ready",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
-			if(!consumer_write_fun(p,sink,stmd,chunk)){
+			if(!consumer_write_fun(p,sink,stmd,chunks,n_chunks)){
 #if ENABLE_DEBUG
 				facq_log_write("Consumer: error writing data",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
-				facq_chunk_free(chunk);
-				return TRUE;
+				return FALSE;
 			}
-#if ENABLE_DEBUG
-			facq_log_write("Consumer: recycling chunk",FACQ_LOG_MSG_TYPE_DEBUG);
-#endif
-			*absolute_bytes_written += facq_chunk_get_used_bytes(chunk);
-			facq_buffer_recycle(p->priv->buf,chunk);
-			return FALSE;
+			facq_pipeline_stats_write(p,g_get_monotonic_time() - t0);
+			return TRUE;
 		}
 		else {
 #if ENABLE_DEBUG
@@ -524,38 +1456,159 @@ static gboolean consumer_dispatch_chunk(FacqPipeline *p,const FacqStreamData *st
 			poll_retries++;
 		}
 	}
-	if(poll_retries == 3){
-		facq_pipeline_error_condition(p,ERROR_POLLING_SINK);
-		facq_log_write("Error max retries reached while polling sink",FACQ_LOG_MSG_TYPE_ERROR);
+	facq_pipeline_error_condition(p,ERROR_POLLING_SINK);
+	facq_log_write("Error max retries reached while polling sink",FACQ_LOG_MSG_TYPE_ERROR);
+	return FALSE;
+}
+
+/*
+ * consumer_tee_chunk:
+ *
+ * Shares the chunk with all the branches in fan-out mode, following the
+ * overflow policy of each branch.
+ */
+static void consumer_tee_chunk(FacqPipeline *p,FacqChunk *chunk)
+{
+	FacqPipelineBranch *branch = NULL;
+	FacqChunk *oldest = NULL;
+	guint i = 0;
+
+	facq_chunk_set_users(chunk,p->priv->n_branches);
+	for(i = 0;i < p->priv->n_branches;i++){
+		branch = &p->priv->branches[i];
+		if(branch->overflow == FACQ_PIPELINE_OVERFLOW_BLOCK){
+			facq_buffer_push(branch->in,chunk);
+			continue;
+		}
+		if(facq_buffer_try_push(branch->in,chunk)){
+			facq_pipeline_overflow_end(p,&branch->ovf,
+					facq_sink_get_name(branch->sink));
+			continue;
+		}
+		facq_pipeline_overflow_begin(p,&branch->ovf,
+				facq_sink_get_name(branch->sink));
+		facq_pipeline_overflow_drop(p,&branch->ovf,1);
+		if(branch->overflow == FACQ_PIPELINE_OVERFLOW_DROP_OLDEST){
+			oldest = facq_buffer_try_pop(branch->in);
+			if(oldest){
+				facq_pipeline_release_chunk(p,oldest);
+				if(facq_buffer_try_push(branch->in,chunk))
+					continue;
+			}
+		}
+		facq_pipeline_release_chunk(p,chunk);
+	}
+}
+
+static void consumer_recycle_chunks(FacqPipeline *p,FacqChunk **chunks,guint n_chunks)
+{
+	guint i = 0;
+
+	for(i = 0;i < n_chunks;i++)
+		facq_buffer_recycle(p->priv->buf,chunks[i]);
+}
+
+/*
+ * consumer_dispatch_batch:
+ *
+ * Processes all the chunks popped in one wake up, the operations and the
+ * sink are called only once for the whole batch. Returns %TRUE in case of
+ * error.
+ */
+static gboolean consumer_dispatch_batch(FacqPipeline *p,const FacqStreamData *stmd,FacqOperationList *oplist,FacqSink *sink,FacqChunk **chunks,guint n_chunks,gsize *absolute_bytes_written)
+{
+	guint i = 0, n_used = 0;
+
+#if ENABLE_DEBUG
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,"Consumer: processing %u chunks",n_chunks);
+#endif
+	facq_pipeline_monitor_set_stage_depth(p->priv->mon,
+					      p->priv->n_stages,
+					      facq_buffer_get_length(p->priv->sink_in));
+	/* empty chunks come from a failed stage, just recycle them */
+	for(i = 0;i < n_chunks;i++){
+		if(facq_chunk_get_used_bytes(chunks[i]))
+			chunks[n_used++] = chunks[i];
+		else
+			facq_buffer_recycle(p->priv->buf,chunks[i]);
+	}
+	if(!n_used)
+		return FALSE;
+	if(!p->priv->n_stages && p->priv->native)
+		facq_pipeline_native_to_double(p,stmd,chunks,n_used);
+	/* in staged mode the operations have been executed by the stages */
+	if(!p->priv->n_stages && !consumer_oplist_do_fun(p,stmd,chunks,n_used,oplist)){
+		consumer_recycle_chunks(p,chunks,n_used);
 		return TRUE;
 	}
-	return TRUE;
+	for(i = 0;i < n_used;i++)
+		*absolute_bytes_written += facq_chunk_get_used_bytes(chunks[i]);
+	/* in fan-out mode the branches write the chunks to the sinks */
+	if(p->priv->n_branches){
+		facq_pipeline_stats_chunks_out(p,chunks,n_used);
+		for(i = 0;i < n_used;i++)
+			consumer_tee_chunk(p,chunks[i]);
+		return FALSE;
+	}
+	if(!sink_write_chunks(p,p->priv->sink_stmd,sink,chunks,n_used)){
+		consumer_recycle_chunks(p,chunks,n_used);
+		return TRUE;
+	}
+#if ENABLE_DEBUG
+	facq_log_write("Consumer: recycling chunks",FACQ_LOG_MSG_TYPE_DEBUG);
+#endif
+	facq_pipeline_stats_chunks_out(p,chunks,n_used);
+	consumer_recycle_chunks(p,chunks,n_used);
+	return FALSE;
 }
 
 static void consumer_end_fun(FacqPipeline *p,const FacqStreamData *stmd,FacqOperationList *oplist,FacqSink *sink,gsize *absolute_bytes_written)
 {
-	FacqChunk *chunk = NULL;
+	FacqChunk *batch[FACQ_PIPELINE_BATCH_MAX];
+	guint n_chunks = 0;
 	gboolean err = FALSE;
 
-	while( (chunk = facq_buffer_try_pop(p->priv->buf)) != NULL){
-		err = consumer_dispatch_chunk(p,stmd,oplist,sink,chunk,absolute_bytes_written);
+	while( (n_chunks = facq_buffer_pop_batch(p->priv->sink_in,batch,FACQ_PIPELINE_BATCH_MAX,0)) > 0){
+		err = consumer_dispatch_batch(p,stmd,oplist,sink,batch,n_chunks,absolute_bytes_written);
 		if(err)
 			return;
 	}
 }
 
+/*
+ * consumer_discard_fun:
+ *
+ * Used in staged mode after an error in the consumer. The stages could be still
+ * using the operations, so before stopping the operation list we wait for them
+ * to finish, recycling the chunks without writing them to the sink.
+ */
+static void consumer_discard_fun(FacqPipeline *p,gdouble timeout)
+{
+	FacqChunk *chunk = NULL;
+
+	facq_buffer_exit(p->priv->buf);
+	while(!facq_buffer_get_exit(p->priv->sink_in)){
+		chunk = facq_buffer_timeout_pop(p->priv->sink_in,timeout);
+		if(chunk)
+			facq_buffer_recycle(p->priv->buf,chunk);
+	}
+	while( (chunk = facq_buffer_try_pop(p->priv->sink_in)) != NULL)
+		facq_buffer_recycle(p->priv->buf,chunk);
+}
+
 static gpointer consumer_fun(gpointer pipeline)
 {
 	FacqPipeline *p = FACQ_PIPELINE(pipeline);
 	const FacqStreamData *stmd = NULL;
 	FacqOperationList *oplist = NULL;
 	FacqSink *sink = NULL;
-	FacqChunk *chunk = NULL;
+	FacqChunk *batch[FACQ_PIPELINE_BATCH_MAX];
 	gboolean err = FALSE;
 	GError *local_err = NULL;
 	GTimer *timer = NULL;
 	gsize absolute_bytes_written = 0;
 	gdouble total_seconds = 0, timeout = 0;
+	guint i = 0, n_chunks = 0;
 
 	g_return_val_if_fail(FACQ_IS_PIPELINE(p),NULL);
 
@@ -564,20 +1617,16 @@ static gpointer consumer_fun(gpointer pipeline)
 	sink = p->priv->sink;
 	oplist = p->priv->oplist;
 
-	if(stmd->period > 1){
-		timeout = stmd->period;
-	}
-	else
-		timeout = 1;
+	timeout = facq_pipeline_pop_timeout(stmd);
 
-	while(!facq_buffer_get_exit(p->priv->buf)){
-		chunk = facq_buffer_timeout_pop(p->priv->buf,timeout);
-		if(chunk){
+	/* each wake up drains all the chunks waiting in the buffer */
+	while(!facq_buffer_get_exit(p->priv->sink_in)){
+		n_chunks = facq_buffer_pop_batch(p->priv->sink_in,batch,FACQ_PIPELINE_BATCH_MAX,timeout);
+		if(n_chunks){
 #if ENABLE_DEBUG
-			facq_log_write("Consumer: Chunk received, processing...",FACQ_LOG_MSG_TYPE_DEBUG);
+			facq_log_write("Consumer: Chunks received, processing...",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
-			err = consumer_dispatch_chunk(p,stmd,oplist,sink,chunk,&absolute_bytes_written);
-			chunk = NULL;
+			err = consumer_dispatch_batch(p,stmd,oplist,sink,batch,n_chunks,&absolute_bytes_written);
 			if(err)
 				break;
 		}
@@ -588,10 +1637,17 @@ static gpointer consumer_fun(gpointer pipeline)
 #endif
 		consumer_end_fun(p,stmd,oplist,sink,&absolute_bytes_written);
 	}
+	else if(p->priv->n_stages)
+		consumer_discard_fun(p,timeout);
 
 	g_timer_stop(timer);
 	facq_buffer_exit(p->priv->buf);
 
+	/* in fan-out mode each branch stops its sink, after writing the chunks
+	 * that are still in its queue */
+	for(i = 0;i < p->priv->n_branches;i++)
+		facq_buffer_exit(p->priv->branches[i].in);
+
 #if ENABLE_DEBUG
 	facq_log_write("Consumer: Stopping operation list",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
@@ -606,20 +1662,22 @@ static gpointer consumer_fun(gpointer pipeline)
 								FACQ_LOG_MSG_TYPE_ERROR);
 	}
 
+	if(!p->priv->n_branches){
 #if ENABLE_DEBUG
-	facq_log_write("Consumer: Stopping sink",FACQ_LOG_MSG_TYPE_DEBUG);
+		facq_log_write("Consumer: Stopping sink",FACQ_LOG_MSG_TYPE_DEBUG);
 #endif
-	if(!facq_sink_stop(sink,stmd,&local_err)){
-		if(local_err){
-			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
-						"Error while stopping the sink: %s",
-							local_err->message);
-			g_clear_error(&local_err);
+		if(!facq_sink_stop(sink,p->priv->sink_stmd,&local_err)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+							"Error while stopping the sink: %s",
+								local_err->message);
+				g_clear_error(&local_err);
+			}
+			else
+				facq_log_write("Unknown error while stopping the sink",
+							FACQ_LOG_MSG_TYPE_ERROR);
 		}
-		else
-			facq_log_write("Unknown error while stopping the sink",
-						FACQ_LOG_MSG_TYPE_ERROR);
-        }
+	}
 
 	total_seconds = g_timer_elapsed(timer,NULL);
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
@@ -636,6 +1694,71 @@ static gpointer consumer_fun(gpointer pipeline)
 	return NULL;
 }
 
+static void branch_dispatch_batch(FacqPipelineBranch *branch,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,gboolean *failed,gsize *absolute_bytes_written)
+{
+	FacqPipeline *p = branch->p;
+	guint i = 0;
+
+	/* after an error the chunks are only released, the pipeline is going
+	 * to stop */
+	if(!*failed){
+		if(sink_write_chunks(p,stmd,branch->sink,chunks,n_chunks)){
+			for(i = 0;i < n_chunks;i++)
+				*absolute_bytes_written += facq_chunk_get_used_bytes(chunks[i]);
+		}
+		else {
+			facq_buffer_exit(p->priv->buf);
+			*failed = TRUE;
+		}
+	}
+	for(i = 0;i < n_chunks;i++)
+		facq_pipeline_release_chunk(p,chunks[i]);
+}
+
+static gpointer branch_fun(gpointer data)
+{
+	FacqPipelineBranch *branch = (FacqPipelineBranch *)data;
+	const FacqStreamData *stmd = NULL;
+	FacqChunk *batch[FACQ_PIPELINE_BATCH_MAX];
+	gboolean failed = FALSE;
+	GError *local_err = NULL;
+	gsize absolute_bytes_written = 0;
+	gdouble timeout = 0;
+	guint n_chunks = 0;
+
+	/* the stream after the operations */
+	stmd = branch->p->priv->sink_stmd;
+	timeout = facq_pipeline_pop_timeout(stmd);
+
+	while(!facq_buffer_get_exit(branch->in)){
+		n_chunks = facq_buffer_pop_batch(branch->in,batch,FACQ_PIPELINE_BATCH_MAX,timeout);
+		if(n_chunks)
+			branch_dispatch_batch(branch,stmd,batch,n_chunks,&failed,&absolute_bytes_written);
+	}
+	while( (n_chunks = facq_buffer_pop_batch(branch->in,batch,FACQ_PIPELINE_BATCH_MAX,0)) > 0)
+		branch_dispatch_batch(branch,stmd,batch,n_chunks,&failed,&absolute_bytes_written);
+
+#if ENABLE_DEBUG
+	facq_log_write("Branch: Stopping sink",FACQ_LOG_MSG_TYPE_DEBUG);
+#endif
+	if(!facq_sink_stop(branch->sink,stmd,&local_err)){
+		if(local_err){
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						"Error while stopping the sink: %s",
+							local_err->message);
+			g_clear_error(&local_err);
+		}
+		else
+			facq_log_write("Unknown error while stopping the sink",
+						FACQ_LOG_MSG_TYPE_ERROR);
+	}
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"Wrote ""%"G_GSIZE_FORMAT" bytes to %s sink",
+			absolute_bytes_written,
+			facq_sink_get_name(branch->sink));
+	return NULL;
+}
+
 /*****---- GObject magic ----*****/
 static void facq_pipeline_get_property(GObject *self,guint property_id,GValue *value,GParamSpec *pspec)
 {
@@ -654,6 +1777,18 @@ static void facq_pipeline_get_property(GObject *self,guint property_id,GValue *v
 	break;
 	case PROP_SINK: g_value_set_pointer(value,p->priv->sink);
 	break;
+	case PROP_STAGED: g_value_set_boolean(value,p->priv->staged);
+	break;
+	case PROP_OVERFLOW: g_value_set_uint(value,p->priv->overflow);
+	break;
+	case PROP_LOCKED_MEMORY: g_value_set_boolean(value,p->priv->locked_memory);
+	break;
+	case PROP_OP_THREADS: g_value_set_uint(value,p->priv->op_threads);
+	break;
+	case PROP_NATIVE_SAMPLES: g_value_set_boolean(value,p->priv->native_samples);
+	break;
+	case PROP_CONV_THREAD: g_value_set_boolean(value,p->priv->conv_thread);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (p, property_id, pspec);
 	}
@@ -676,6 +1811,18 @@ static void facq_pipeline_set_property(GObject *self,guint property_id,const GVa
 	break;
 	case PROP_SINK: p->priv->sink = g_value_get_pointer(value);
 	break;
+	case PROP_STAGED: p->priv->staged = g_value_get_boolean(value);
+	break;
+	case PROP_OVERFLOW: p->priv->overflow = g_value_get_uint(value);
+	break;
+	case PROP_LOCKED_MEMORY: p->priv->locked_memory = g_value_get_boolean(value);
+	break;
+	case PROP_OP_THREADS: p->priv->op_threads = g_value_get_uint(value);
+	break;
+	case PROP_NATIVE_SAMPLES: p->priv->native_samples = g_value_get_boolean(value);
+	break;
+	case PROP_CONV_THREAD: p->priv->conv_thread = g_value_get_boolean(value);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (p, property_id, pspec);
 	}
@@ -685,7 +1832,20 @@ static void facq_pipeline_finalize(GObject *self)
 {
 	FacqPipeline *p = FACQ_PIPELINE(self);
 
+	facq_pipeline_stages_free(p);
+	facq_pipeline_converter_free(p);
+	facq_pipeline_branches_free(p);
+	facq_pipeline_overflow_free(p);
+	if(p->priv->branches)
+		g_free(p->priv->branches);
 	facq_buffer_free(p->priv->buf);
+	if(p->priv->sink_stmd)
+		facq_stream_data_free(p->priv->sink_stmd);
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_clear(&p->priv->stats_mutex);
+#else
+	g_mutex_free(p->priv->stats_mutex);
+#endif
 
 	G_OBJECT_CLASS(facq_pipeline_parent_class)->finalize(self);
 }
@@ -697,9 +1857,10 @@ static void facq_pipeline_constructed(GObject *self)
 	g_clear_error(&p->priv->construct_error);
 
 	p->priv->buf = 
-		facq_buffer_new(p->priv->ring_chunks,
+		facq_buffer_new_spsc(p->priv->ring_chunks,
 				p->priv->chunk_size,
 				&p->priv->construct_error);
+	p->priv->sink_in = p->priv->buf;
 }
 
 static void facq_pipeline_class_init(FacqPipelineClass *klass)
@@ -766,6 +1927,64 @@ static void facq_pipeline_class_init(FacqPipelineClass *klass)
 							     G_PARAM_READWRITE |
 							     G_PARAM_CONSTRUCT |
 							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_STAGED,
+					g_param_spec_boolean("staged",
+							     "Staged",
+							     "Run each operation in its own thread",
+							     FALSE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_CONSTRUCT |
+							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_LOCKED_MEMORY,
+					g_param_spec_boolean("locked-memory",
+							     "Locked memory",
+							     "Use prefaulted memory locked in RAM for the ring buffer",
+							     FALSE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_CONSTRUCT |
+							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_OP_THREADS,
+					g_param_spec_uint("op-threads",
+							  "Operation threads",
+							  "Threads executing the channel independent operations",
+							  1,
+							  FACQ_PIPELINE_OP_THREADS_MAX,
+							  1,
+							  G_PARAM_READWRITE |
+							  G_PARAM_CONSTRUCT |
+							  G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_NATIVE_SAMPLES,
+					g_param_spec_boolean("native-samples",
+							     "Native samples",
+							     "Keep the samples in the source format until they leave the ring buffer",
+							     FALSE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_CONSTRUCT |
+							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_CONV_THREAD,
+					g_param_spec_boolean("conv-thread",
+							     "Converter thread",
+							     "Convert the samples in their own thread, after the ring buffer",
+							     FALSE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_CONSTRUCT |
+							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_OVERFLOW,
+					g_param_spec_uint("overflow",
+							  "Overflow",
+							  "The policy used when the ring buffer is full",
+							  FACQ_PIPELINE_OVERFLOW_BLOCK,
+							  FACQ_PIPELINE_OVERFLOW_SPILL,
+							  FACQ_PIPELINE_OVERFLOW_BLOCK,
+							  G_PARAM_READWRITE |
+							  G_PARAM_CONSTRUCT |
+							  G_PARAM_STATIC_STRINGS));
 }
 
 static void facq_pipeline_init(FacqPipeline *p)
@@ -780,6 +1999,32 @@ static void facq_pipeline_init(FacqPipeline *p)
 	p->priv->src = NULL;
 	p->priv->oplist = NULL;
 	p->priv->sink = NULL;
+	p->priv->sink_stmd = NULL;
+	p->priv->staged = FALSE;
+	p->priv->locked_memory = FALSE;
+	p->priv->op_threads = 1;
+	p->priv->native_samples = FALSE;
+	p->priv->native = FALSE;
+	p->priv->conv_thread = FALSE;
+	p->priv->converting = FALSE;
+	p->priv->converter = NULL;
+	p->priv->conv_out = NULL;
+	p->priv->conv_raw = NULL;
+	p->priv->n_stages = 0;
+	p->priv->stages = NULL;
+	p->priv->sink_in = NULL;
+	p->priv->n_branches = 0;
+	p->priv->branches = NULL;
+	p->priv->overflow = FACQ_PIPELINE_OVERFLOW_BLOCK;
+	p->priv->ovf.active = FALSE;
+	p->priv->spare = NULL;
+	p->priv->spill = NULL;
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_init(&p->priv->stats_mutex);
+#else
+	p->priv->stats_mutex = g_mutex_new();
+#endif
+	facq_pipeline_stats_reset(p);
 }
 
 static void facq_pipeline_initable_iface_init(GInitableIface *iface)
@@ -854,6 +2099,7 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
 {
 	GError *local_err = NULL;
 	const FacqStreamData *stmd;
+	guint i = 0;
 
 	g_return_val_if_fail(FACQ_IS_PIPELINE(p),FALSE);
 
@@ -875,17 +2121,59 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
 			stmd->bps,stmd->period,stmd->n_channels);
 #endif
 
+	facq_pipeline_stats_reset(p);
+
+	p->priv->native = p->priv->native_samples &&
+		facq_stream_data_get_format(stmd) != FACQ_SAMPLE_FORMAT_DOUBLE;
+	if(p->priv->native)
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"Using native samples, %u bytes per sample in the ring buffer",
+			stmd->bps);
+
+	if(!facq_pipeline_buffer_new(p,&local_err) ||
+			!facq_pipeline_branches_new(p,&local_err) ||
+			!facq_pipeline_converter_new(p,&local_err) ||
+			!facq_pipeline_stages_new(p,&local_err) ||
+			!facq_pipeline_overflow_new(p,&local_err)){
+		facq_log_write("Error creating the pipeline queues",
+					FACQ_LOG_MSG_TYPE_ERROR);
+		facq_pipeline_stages_free(p);
+		facq_pipeline_converter_free(p);
+		facq_pipeline_branches_free(p);
+		facq_pipeline_overflow_free(p);
+		if(!local_err)
+			g_set_error_literal(&local_err,FACQ_PIPELINE_ERROR,
+				FACQ_PIPELINE_ERROR_FAILED,"Error creating the pipeline queues");
+		if(err)
+			g_propagate_error(err,local_err);
+		else
+			g_clear_error(&local_err);
+		return FALSE;
+	}
+
 	/* If a operation fails in the start operation, the process will be
 	 * interrupted and the previous operations started, if any, will be
 	 * stopped by this function */
 	facq_log_write("Starting the operation list",FACQ_LOG_MSG_TYPE_INFO);
+	facq_operation_list_set_threads(p->priv->oplist,p->priv->op_threads);
 	if(!facq_operation_list_start(p->priv->oplist,stmd,&local_err))
 		goto error;
+	/* the operations can change the stream, the sinks receive the stream
+	 * after the last operation, drop the one from the previous start */
+	if(p->priv->sink_stmd)
+		facq_stream_data_free(p->priv->sink_stmd);
+	p->priv->sink_stmd = g_object_ref((gpointer)
+			facq_operation_list_get_stream_data(p->priv->oplist));
+	if(p->priv->sink_stmd->n_channels != stmd->n_channels ||
+			p->priv->sink_stmd->period != stmd->period)
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"The operations change the stream to %u channels, period %f",
+			p->priv->sink_stmd->n_channels,p->priv->sink_stmd->period);
 
 	/* Start the sink, if the start fails we have to stop the other
 	 * operations */
 	facq_log_write("Starting the sink",FACQ_LOG_MSG_TYPE_INFO);
-	if(!facq_sink_start(p->priv->sink,stmd,&local_err)){
+	if(!facq_sink_start(p->priv->sink,p->priv->sink_stmd,&local_err)){
 		if(local_err){
 			facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
 						"Error starting the sink: %s",
@@ -900,6 +2188,25 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
 		goto error;
 	}
 
+	for(i = 1;i < p->priv->n_branches;i++){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"Starting the %s sink",
+				facq_sink_get_name(p->priv->branches[i].sink));
+		if(!facq_sink_start(p->priv->branches[i].sink,p->priv->sink_stmd,&local_err)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+							"Error starting the sink: %s",
+									local_err->message);
+			}
+			else {
+				facq_log_write("Unknown error starting the sink",
+								FACQ_LOG_MSG_TYPE_ERROR);
+				g_set_error_literal(&local_err,FACQ_PIPELINE_ERROR,
+						FACQ_PIPELINE_ERROR_FAILED,"Unknown error starting the sink");
+			}
+			goto error;
+		}
+	}
+
 	facq_log_write("Starting the source",FACQ_LOG_MSG_TYPE_INFO);
 	if(!facq_source_start(p->priv->src,&local_err)){
 		if(local_err){
@@ -935,6 +2242,28 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
 		goto error;
 	}
 
+	if(p->priv->converting){
+		facq_log_write("Launching converter thread",FACQ_LOG_MSG_TYPE_INFO);
+		p->priv->converter = g_thread_try_new("conv",
+						      (GThreadFunc)converter_fun,
+						      (gpointer)p,
+						      &local_err);
+		if(!(p->priv->converter)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						"Error starting the converter thread: %s",
+							local_err->message);
+			}
+			else {
+				facq_log_write("Unknown error starting the converter thread",
+							FACQ_LOG_MSG_TYPE_ERROR);
+				g_set_error_literal(&local_err,FACQ_PIPELINE_ERROR,
+						FACQ_PIPELINE_ERROR_FAILED,"Unknown error starting thread");
+			}
+			goto error;
+		}
+	}
+
 	facq_log_write("Launching consumer thread",FACQ_LOG_MSG_TYPE_INFO);
 	p->priv->consumer = g_thread_try_new("cons",
 					     (GThreadFunc)consumer_fun,
@@ -954,6 +2283,54 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
 		}	
 		goto error;
 	}
+
+	for(i = 0;i < p->priv->n_stages;i++){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+				"Launching stage thread for %s",
+				facq_operation_get_name(p->priv->stages[i].op));
+		p->priv->stages[i].thread = g_thread_try_new("stage",
+							     (GThreadFunc)stage_fun,
+							     (gpointer)&p->priv->stages[i],
+							     &local_err);
+		if(!(p->priv->stages[i].thread)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						"Error starting the stage thread: %s",
+							local_err->message);
+			}
+			else {
+				facq_log_write("Unknown error starting the stage thread",
+							FACQ_LOG_MSG_TYPE_ERROR);
+				g_set_error_literal(&local_err,FACQ_PIPELINE_ERROR,
+						FACQ_PIPELINE_ERROR_FAILED,"Unknown error starting thread");
+			}
+			goto error;
+		}
+	}
+
+	for(i = 0;i < p->priv->n_branches;i++){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+				"Launching branch thread for %s",
+				facq_sink_get_name(p->priv->branches[i].sink));
+		p->priv->branches[i].thread = g_thread_try_new("branch",
+							       (GThreadFunc)branch_fun,
+							       (gpointer)&p->priv->branches[i],
+							       &local_err);
+		if(!(p->priv->branches[i].thread)){
+			if(local_err){
+				facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+						"Error starting the branch thread: %s",
+							local_err->message);
+			}
+			else {
+				facq_log_write("Unknown error starting the branch thread",
+							FACQ_LOG_MSG_TYPE_ERROR);
+				g_set_error_literal(&local_err,FACQ_PIPELINE_ERROR,
+						FACQ_PIPELINE_ERROR_FAILED,"Unknown error starting thread");
+			}
+			goto error;
+		}
+	}
 	return TRUE;
 
 	error:
@@ -984,29 +2361,257 @@ gboolean facq_pipeline_start(FacqPipeline *p,GError **err)
  *
  * Stops the pipeline running threads.
  * The function doesn't return the control until all the threads are
- * stopped, so it can take some time to return the control to the caller.
+ * stopped. The threads don't poll for the exit condition, the #FacqBuffer
+ * objects wake up the threads waiting on them and facq_source_interrupt()
+ * wakes up the producer thread while waiting for the source, so the time
+ * needed is bounded by the longest single read from the source plus the time
+ * needed to write the chunks that are still in the buffers. The time is
+ * written to the log and stored in the @stop_latency field of
+ * #FacqPipelineStats.
  *
  * Before exiting the consumer thread will stop the #FacqSource and the consumer
- * thread will stop the #FacqOperationList and the #FacqSink.
+ * thread will stop the #FacqOperationList and the #FacqSink. In fan-out mode
+ * each #FacqSink is stopped by its branch thread.
  */
 void facq_pipeline_stop(FacqPipeline *p)
 {
 	GThread *this_thread = NULL;
+	gint64 begin_time = 0, end_time = 0;
+	guint i = 0;
 
 	g_return_if_fail(FACQ_IS_PIPELINE(p));
 
-	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s",
-			"Stopping pipeline this could take a while");
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s","Stopping pipeline");
 
 	this_thread = g_thread_self();
+	begin_time = g_get_monotonic_time();
 
 	facq_buffer_exit(p->priv->buf);
+	facq_source_interrupt(p->priv->src);
 	if(p->priv->producer && p->priv->producer != this_thread)
 		g_thread_join(p->priv->producer);
+	if(p->priv->converting){
+		/* if it wasn't launched it can't tell the next stage to exit */
+		if(!p->priv->converter)
+			facq_buffer_exit(p->priv->conv_out);
+		else if(p->priv->converter != this_thread)
+			g_thread_join(p->priv->converter);
+		p->priv->converter = NULL;
+	}
+	for(i = 0;i < p->priv->n_stages;i++){
+		/* a stage that wasn't launched can't tell the next one to exit */
+		if(!p->priv->stages[i].thread)
+			facq_buffer_exit(p->priv->stages[i].out);
+		else if(p->priv->stages[i].thread != this_thread)
+			g_thread_join(p->priv->stages[i].thread);
+		p->priv->stages[i].thread = NULL;
+	}
 	if(p->priv->consumer && p->priv->consumer != this_thread)
 		g_thread_join(p->priv->consumer);
+	for(i = 0;i < p->priv->n_branches;i++){
+		if(p->priv->branches[i].thread && p->priv->branches[i].thread != this_thread)
+			g_thread_join(p->priv->branches[i].thread);
+		p->priv->branches[i].thread = NULL;
+	}
+
+	end_time = g_get_monotonic_time();
+	facq_pipeline_stats_lock(p);
+	p->priv->counters.stop_time = end_time;
+	p->priv->counters.stop_latency = end_time - begin_time;
+	facq_pipeline_stats_unlock(p);
+
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"Pipeline stopped in %f seconds",
+			(end_time - begin_time)/1e6);
+}
+
+/**
+ * facq_pipeline_get_stats:
+ * @p: A #FacqPipeline object.
+ * @stats: (out caller-allocates): A #FacqPipelineStats where the values
+ * will be stored.
+ *
+ * Takes a snapshot of the counters of the pipeline, see the Statistics
+ * section above. The function only takes a short lock, so it can be called
+ * from the main loop, for example from a g_timeout_add() callback, while the
+ * pipeline is running.
+ */
+void facq_pipeline_get_stats(FacqPipeline *p,FacqPipelineStats *stats)
+{
+	FacqPipelineCounters c;
+	gint64 end_time = 0;
+
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+	g_return_if_fail(stats != NULL);
+
+	facq_pipeline_stats_lock(p);
+	c = p->priv->counters;
+	facq_pipeline_stats_unlock(p);
+
+	stats->bytes_in = c.bytes_in;
+	stats->chunks_in = c.chunks_in;
+	stats->bytes_out = c.bytes_out;
+	stats->chunks_out = c.chunks_out;
+	stats->ring_length = facq_buffer_get_length(p->priv->buf);
+	stats->ring_size = p->priv->ring_chunks;
+	stats->ring_high_water = c.high_water;
+	stats->read_time = (c.chunks_in) ?
+		(c.read_time/1e6)/c.chunks_in : 0;
+	stats->operation_time = (c.chunks_out) ?
+		(c.operation_time/1e6)/c.chunks_out : 0;
+	stats->write_time = (c.chunks_out) ?
+		(c.write_time/1e6)/c.chunks_out : 0;
+	stats->latency = (c.chunks_out) ?
+		(c.latency/1e6)/c.chunks_out : 0;
+	end_time = (c.stop_time) ? c.stop_time : g_get_monotonic_time();
+	stats->elapsed = (end_time - c.start_time)/1e6;
+	stats->stop_latency = c.stop_latency/1e6;
+}
+
+/**
+ * facq_pipeline_set_staged:
+ * @p: A #FacqPipeline object, not started yet.
+ * @staged: %TRUE to run each operation in its own thread.
+ *
+ * Enables or disables the staged mode of the pipeline, see the Staged mode
+ * section above. The change only has effect if it's done before calling
+ * facq_pipeline_start().
+ */
+void facq_pipeline_set_staged(FacqPipeline *p,gboolean staged)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+
+	p->priv->staged = staged;
+}
+
+/**
+ * facq_pipeline_set_locked_memory:
+ * @p: A #FacqPipeline object, not started yet.
+ * @locked_memory: %TRUE to use locked memory for the ring buffer.
+ *
+ * Allocates the chunks of the ring buffer in memory backed by huge pages,
+ * prefaulted and locked in RAM, when the system allows it, so the producer
+ * thread never waits for a page fault or for the swap, see
+ * facq_buffer_new_full(). The memory really used is written to the log. The
+ * change only has effect if it's done before calling facq_pipeline_start().
+ */
+void facq_pipeline_set_locked_memory(FacqPipeline *p,gboolean locked_memory)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+
+	p->priv->locked_memory = locked_memory;
+}
+
+/**
+ * facq_pipeline_set_op_threads:
+ * @p: A #FacqPipeline object, not started yet.
+ * @n_threads: The number of threads, between 1 and 64.
+ *
+ * Sets the number of threads executing each channel independent operation,
+ * see the Channel parallel operations section above. With 1, the default,
+ * the operations are executed only by the consumer thread, or by the stage
+ * threads. The change only has effect if it's done before calling
+ * facq_pipeline_start().
+ */
+void facq_pipeline_set_op_threads(FacqPipeline *p,guint n_threads)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+	g_return_if_fail(n_threads >= 1 && n_threads <= FACQ_PIPELINE_OP_THREADS_MAX);
+
+	p->priv->op_threads = n_threads;
+}
 
-	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s","Pipeline stopped");
+/**
+ * facq_pipeline_set_native_samples:
+ * @p: A #FacqPipeline object, not started yet.
+ * @native_samples: %TRUE to keep the samples in the source format until they
+ * leave the ring buffer.
+ *
+ * Defers the conversion of the samples to #gdouble, see the Native samples
+ * section above. It has no effect if the source can't describe its samples,
+ * see facq_stream_data_get_format(). The change only has effect if it's done
+ * before calling facq_pipeline_start().
+ */
+void facq_pipeline_set_native_samples(FacqPipeline *p,gboolean native_samples)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+
+	p->priv->native_samples = native_samples;
+}
+
+/**
+ * facq_pipeline_set_conv_thread:
+ * @p: A #FacqPipeline object, not started yet.
+ * @conv_thread: %TRUE to convert the samples in their own thread.
+ *
+ * Moves the conversion of the samples out of the producer thread, see the
+ * Converter thread section above. It has no effect if the source doesn't
+ * need conversion, or if native samples are used, see
+ * facq_pipeline_set_native_samples(). The change only has effect if it's done
+ * before calling facq_pipeline_start().
+ */
+void facq_pipeline_set_conv_thread(FacqPipeline *p,gboolean conv_thread)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+
+	p->priv->conv_thread = conv_thread;
+}
+
+/**
+ * facq_pipeline_set_overflow:
+ * @p: A #FacqPipeline object, not started yet.
+ * @overflow: The #FacqPipelineOverflow policy.
+ *
+ * Sets the policy followed by the producer thread when the ring buffer is
+ * full, see the Producer thread section above. The change only has effect if
+ * it's done before calling facq_pipeline_start().
+ */
+void facq_pipeline_set_overflow(FacqPipeline *p,FacqPipelineOverflow overflow)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+	g_return_if_fail(overflow <= FACQ_PIPELINE_OVERFLOW_SPILL);
+
+	p->priv->overflow = overflow;
+}
+
+/**
+ * facq_pipeline_add_sink:
+ * @p: A #FacqPipeline object, not started yet.
+ * @sink: A #FacqSink object.
+ * @overflow: The #FacqPipelineOverflow policy used when the @sink can't
+ * keep up with the data, %FACQ_PIPELINE_OVERFLOW_SPILL is not supported.
+ *
+ * Adds another #FacqSink to the pipeline, so the data is written to more than
+ * one sink, see the Fan-out section above. The @sink is started and stopped by
+ * the pipeline, but it's not destroyed with it.
+ */
+void facq_pipeline_add_sink(FacqPipeline *p,FacqSink *sink,FacqPipelineOverflow overflow)
+{
+	FacqPipelineBranch *branch = NULL;
+	guint i = 0;
+
+	g_return_if_fail(FACQ_IS_PIPELINE(p));
+	g_return_if_fail(FACQ_IS_SINK(sink));
+	g_return_if_fail(overflow != FACQ_PIPELINE_OVERFLOW_SPILL);
+
+	/* the first branch is reserved for the sink of the pipeline */
+	i = p->priv->n_branches;
+	if(!p->priv->n_branches)
+		p->priv->n_branches = 1;
+	p->priv->n_branches++;
+	p->priv->branches = g_renew(FacqPipelineBranch,
+				    p->priv->branches,
+				    p->priv->n_branches);
+	for(;i < p->priv->n_branches;i++){
+		branch = &p->priv->branches[i];
+		branch->p = p;
+		branch->sink = NULL;
+		branch->overflow = FACQ_PIPELINE_OVERFLOW_BLOCK;
+		branch->in = NULL;
+		branch->thread = NULL;
+		branch->ovf.active = FALSE;
+	}
+	branch->sink = sink;
+	branch->overflow = overflow;
 }
 
 /**
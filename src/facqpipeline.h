@@ -35,6 +35,29 @@ typedef enum {
 	FACQ_PIPELINE_ERROR_FAILED
 } FacqPipelineError;
 
+typedef enum {
+	FACQ_PIPELINE_OVERFLOW_BLOCK,
+	FACQ_PIPELINE_OVERFLOW_DROP_NEWEST,
+	FACQ_PIPELINE_OVERFLOW_DROP_OLDEST,
+	FACQ_PIPELINE_OVERFLOW_SPILL
+} FacqPipelineOverflow;
+
+typedef struct _FacqPipelineStats {
+	guint64 bytes_in;
+	guint64 chunks_in;
+	guint64 bytes_out;
+	guint64 chunks_out;
+	guint ring_length;
+	guint ring_size;
+	guint ring_high_water;
+	gdouble read_time;
+	gdouble operation_time;
+	gdouble write_time;
+	gdouble latency;
+	gdouble elapsed;
+	gdouble stop_latency;
+} FacqPipelineStats;
+
 typedef struct _FacqPipeline FacqPipeline;
 typedef struct _FacqPipelineClass FacqPipelineClass;
 typedef struct _FacqPipelinePrivate FacqPipelinePrivate;
@@ -55,6 +78,14 @@ GType facq_pipeline_get_type(void) G_GNUC_CONST;
 FacqPipeline *facq_pipeline_new(guint chunk_size,guint ring_chunks,FacqSource *src,FacqOperationList *oplist,FacqSink *sink,FacqPipelineMonitor *mon,GError **err);
 gboolean facq_pipeline_start(FacqPipeline *p,GError **err);
 void facq_pipeline_stop(FacqPipeline *p);
+void facq_pipeline_get_stats(FacqPipeline *p,FacqPipelineStats *stats);
+void facq_pipeline_set_staged(FacqPipeline *p,gboolean staged);
+void facq_pipeline_set_locked_memory(FacqPipeline *p,gboolean locked_memory);
+void facq_pipeline_set_op_threads(FacqPipeline *p,guint n_threads);
+void facq_pipeline_set_native_samples(FacqPipeline *p,gboolean native_samples);
+void facq_pipeline_set_conv_thread(FacqPipeline *p,gboolean conv_thread);
+void facq_pipeline_set_overflow(FacqPipeline *p,FacqPipelineOverflow overflow);
+void facq_pipeline_add_sink(FacqPipeline *p,FacqSink *sink,FacqPipelineOverflow overflow);
 void facq_pipeline_free(FacqPipeline *p);
 
 G_END_DECLS
@@ -58,6 +58,8 @@
   * condition.
   * @FACQ_PIPELINE_MESSAGE_TYPE_STOP: The pipeline stopped due to an stop
   * condition for example, there isn't any more data on the source.
+  * @FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW: A queue in the pipeline is full and
+  * data is being dropped or spilled to disk, the pipeline is still running.
   *
   * Enum values for types of pipeline messages.
   */
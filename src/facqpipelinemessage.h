@@ -25,6 +25,7 @@ G_BEGIN_DECLS
 typedef enum _FacqPipelineMessageType {
 	FACQ_PIPELINE_MESSAGE_TYPE_ERROR,
 	FACQ_PIPELINE_MESSAGE_TYPE_STOP,
+	FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW,
 	/*< private >*/
 	FACQ_PIPELINE_MESSAGE_TYPE_N
 } FacqPipelineMessageType;
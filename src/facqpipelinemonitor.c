@@ -19,6 +19,7 @@
  */
 #include <glib.h>
 #include <gio/gio.h>
+#include "facqlog.h"
 #include "facqpipelinemessage.h"
 #include "facqpipelinemonitor.h"
 
@@ -48,6 +49,21 @@
  * facq_pipeline_monitor_dettach() shouldn't be used directly by the user,
  * so you can ignore them (#FacqStream is the user of this functions).
  *
+ * The #FacqPipeline also publishes the number of chunks waiting in the
+ * input queue of each one of its stages, so the user can see which part of the
+ * pipeline is falling behind. Use facq_pipeline_monitor_get_n_stages() and
+ * facq_pipeline_monitor_get_stage_depth() to read these values from the main
+ * thread. The pipeline sets them with facq_pipeline_monitor_set_n_stages() and
+ * facq_pipeline_monitor_set_stage_depth().
+ *
+ * When a queue of the pipeline overflows, and the #FacqPipelineOverflow policy
+ * doesn't block, the pipeline pushes a %FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW
+ * message when the overflow starts and another one when it ends. These
+ * messages are written to the log and don't stop the pipeline, so no callback
+ * function is called. The total number of chunks dropped can be read with
+ * facq_pipeline_monitor_get_dropped(), the pipeline adds them with
+ * facq_pipeline_monitor_add_dropped().
+ *
  * Note that this object, is not intended for public usage, but anyway is
  * documented here for reference purposes. It's used by #FacqStream in a
  * transparent manner to the user.
@@ -55,10 +71,12 @@
  * <sect1 id="internal-details">
  * <title>Internal details</title>
  * <para>
- * #FacqPipelineMonitor internals are simple. It's basically a timeout #GSource
- * that it's dispatched each second. In the callback function, the main thread
- * checks for the presence of new #FacqPipelineMessage objects, if any the
- * callback checks the type of the message and calls one of the callback
+ * #FacqPipelineMonitor internals are simple. It's basically a custom #GSource
+ * that it's ready when there is some #FacqPipelineMessage in the queue, so it
+ * doesn't poll. facq_pipeline_monitor_push() wakes up the main loop after
+ * pushing the message, so the message is dispatched immediately. In the
+ * callback function, the main thread pops the new #FacqPipelineMessage,
+ * checks the type of the message and calls one of the callback
  * function allowing the user to react to the message. Because the processing is
  * done on the main thread, your callback function can manipulate the Gtk GUI of
  * your program without the need of calling deprecated gdk_lock functions.
@@ -91,26 +109,73 @@ struct _FacqPipelineMonitorPrivate {
 	FacqPipelineMonitorCb error_cb;
 	FacqPipelineMonitorCb stop_cb;
 	gpointer data;
+	guint n_stages;
+	volatile gint *stage_depth;
+	volatile gint dropped;
 };
 
+/* The GSource attached to the main loop, it's ready when the queue isn't
+ * empty */
+typedef struct _FacqPipelineMonitorSource {
+	GSource source;
+	GAsyncQueue *q;
+} FacqPipelineMonitorSource;
+
 /* Private methods */
 
-/* This function runs on the main thread. It will be called each second.
- * It's purpose it's to check for the presence of a new FacqPipelineMessage
+static gboolean facq_pipeline_monitor_source_prepare(GSource *source,gint *timeout)
+{
+	FacqPipelineMonitorSource *msrc = (FacqPipelineMonitorSource *)source;
+
+	*timeout = -1;
+	return (g_async_queue_length(msrc->q) > 0);
+}
+
+static gboolean facq_pipeline_monitor_source_check(GSource *source)
+{
+	FacqPipelineMonitorSource *msrc = (FacqPipelineMonitorSource *)source;
+
+	return (g_async_queue_length(msrc->q) > 0);
+}
+
+static gboolean facq_pipeline_monitor_source_dispatch(GSource *source,GSourceFunc callback,gpointer data)
+{
+	if(!callback)
+		return FALSE;
+	return callback(data);
+}
+
+static GSourceFuncs facq_pipeline_monitor_source_funcs = {
+	facq_pipeline_monitor_source_prepare,
+	facq_pipeline_monitor_source_check,
+	facq_pipeline_monitor_source_dispatch,
+	NULL
+};
+
+/* This function runs on the main thread. It will be called each time that
+ * the queue has a message. Its purpose is to check for a new FacqPipelineMessage
  * coming from the Producer/Consumer thread. Worker threads will push
  * a message to the Queue in case of error, or if stop condition is reach.
  * This function checks the type of the message and calls the corresponding
  * function to the type, that will ran on the main thread, so in case of error
  * or stop condition the pipeline could be stopped from the main thread.
+ * Overflow messages are only logged, and the function keeps being called.
  */
-static gboolean facq_pipeline_monitor_timeout_func(gpointer monitor)
+static gboolean facq_pipeline_monitor_source_func(gpointer monitor)
 {
 	FacqPipelineMonitor *mon = FACQ_PIPELINE_MONITOR(monitor);
 	FacqPipelineMessage *msg = NULL;
+	gchar *info = NULL;
 
 	msg = g_async_queue_try_pop(mon->priv->q);
 	if(msg){
 		switch(facq_pipeline_message_get_msg_type(msg)){
+		case FACQ_PIPELINE_MESSAGE_TYPE_OVERFLOW:
+			info = facq_pipeline_message_get_info(msg);
+			facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,"%s",info);
+			g_free(info);
+			facq_pipeline_message_free(msg);
+			return TRUE;
 		case FACQ_PIPELINE_MESSAGE_TYPE_N:
 		case FACQ_PIPELINE_MESSAGE_TYPE_ERROR:
 			mon->priv->error_cb(msg,mon->priv->data);
@@ -120,6 +185,7 @@ static gboolean facq_pipeline_monitor_timeout_func(gpointer monitor)
 		break;
 		}
 		facq_pipeline_message_free(msg);
+		mon->priv->source_id = 0;
 		return FALSE;
 	}
 	return TRUE;
@@ -163,6 +229,11 @@ static void facq_pipeline_monitor_finalize(GObject *self)
 	FacqPipelineMonitor *mon = FACQ_PIPELINE_MONITOR(self);
 
 	g_async_queue_unref(mon->priv->q);
+	if(mon->priv->stage_depth)
+		g_free((gpointer)mon->priv->stage_depth);
+
+	if(G_OBJECT_CLASS(facq_pipeline_monitor_parent_class)->finalize)
+		(*G_OBJECT_CLASS(facq_pipeline_monitor_parent_class)->finalize)(self);
 }
 
 static void facq_pipeline_monitor_constructed(GObject *self)
@@ -213,6 +284,9 @@ static void facq_pipeline_monitor_init(FacqPipelineMonitor *mon)
 	mon->priv = G_TYPE_INSTANCE_GET_PRIVATE(mon,FACQ_TYPE_PIPELINE_MONITOR,FacqPipelineMonitorPrivate);
 	mon->priv->q = NULL;
 	mon->priv->source_id = 0;
+	mon->priv->n_stages = 0;
+	mon->priv->stage_depth = NULL;
+	mon->priv->dropped = 0;
 }
 
 /* Public methods */
@@ -240,12 +314,14 @@ FacqPipelineMonitor *facq_pipeline_monitor_new(FacqPipelineMonitorCb error_cb,Fa
  * @mon: A #FacqPipelineMonitor object.
  * @msg: A #FacqPipelineMessage object.
  *
- * Pushes the #FacqPipelineMessage, @msg, into the #FacqPipelineMonitor, @mon.
+ * Pushes the #FacqPipelineMessage, @msg, into the #FacqPipelineMonitor, @mon,
+ * and wakes up the main loop, so the message is dispatched without delay.
  * You don't have to use this function, it's called in #FacqPipeline when needed.
  */
 void facq_pipeline_monitor_push(FacqPipelineMonitor *mon,FacqPipelineMessage *msg)
 {
 	g_async_queue_push(mon->priv->q,msg);
+	g_main_context_wakeup(NULL);
 }
 
 /**
@@ -253,7 +329,7 @@ void facq_pipeline_monitor_push(FacqPipelineMonitor *mon,FacqPipelineMessage *ms
  * @mon: A #FacqPipelineMonitor object.
  *
  * Pops a #FacqPipelineMessage from the #FacqPipelineMonitor, @mon.
- * You don't have to use this function, it's called in the timeout callback
+ * You don't have to use this function, it's called in the source callback
  * function.
  */
 FacqPipelineMessage *facq_pipeline_monitor_pop(FacqPipelineMonitor *mon)
@@ -265,57 +341,167 @@ FacqPipelineMessage *facq_pipeline_monitor_pop(FacqPipelineMonitor *mon)
  * facq_pipeline_monitor_clear:
  * @mon: A #FacqPipelineMonitor object.
  *
- * Clears any pending message in the #FacqPipelineMonitor, @mon.
+ * Clears any pending message in the #FacqPipelineMonitor, @mon, and resets
+ * the number of dropped chunks.
  * You don't have to use this function, it's called in #FacqStream.
  * <note>
  * <para>
- * This function should be called before facq_pipeline_start()
- * cause length value won't be precise in other case. See
- * g_async_queue_length() for more details.
+ * This function should be called before facq_pipeline_start(), else new
+ * messages could be discarded.
  * </para>
  * </note>
  */
 void facq_pipeline_monitor_clear(FacqPipelineMonitor *mon)
 {
-	gint length = 0;
 	FacqPipelineMessage *msg = NULL;
 
 	g_return_if_fail(FACQ_IS_PIPELINE_MONITOR(mon));
-	length = g_async_queue_length(mon->priv->q);
-	while(length){
-		msg = facq_pipeline_monitor_pop(mon);
+	while( (msg = g_async_queue_try_pop(mon->priv->q)) != NULL)
 		facq_pipeline_message_free(msg);
-	}
+	g_atomic_int_set(&mon->priv->dropped,0);
+}
+
+/**
+ * facq_pipeline_monitor_set_n_stages:
+ * @mon: A #FacqPipelineMonitor object.
+ * @n_stages: The number of stages in the pipeline.
+ *
+ * Sets the number of stages of the pipeline that will be monitored, and
+ * resets all the stage depths to 0.
+ * You don't have to use this function, it's called in facq_pipeline_start()
+ * before creating any thread.
+ */
+void facq_pipeline_monitor_set_n_stages(FacqPipelineMonitor *mon,guint n_stages)
+{
+	g_return_if_fail(FACQ_IS_PIPELINE_MONITOR(mon));
+
+	if(mon->priv->stage_depth)
+		g_free((gpointer)mon->priv->stage_depth);
+	mon->priv->stage_depth = NULL;
+	mon->priv->n_stages = n_stages;
+	if(n_stages)
+		mon->priv->stage_depth = g_new0(gint,n_stages);
+}
+
+/**
+ * facq_pipeline_monitor_get_n_stages:
+ * @mon: A #FacqPipelineMonitor object.
+ *
+ * Gets the number of stages of the monitored pipeline. The last stage is
+ * always the one writing to the sink, the previous ones, if any, are the
+ * operation stages (See #FacqPipeline:staged).
+ *
+ * Returns: The number of stages.
+ */
+guint facq_pipeline_monitor_get_n_stages(const FacqPipelineMonitor *mon)
+{
+	g_return_val_if_fail(FACQ_IS_PIPELINE_MONITOR(mon),0);
+
+	return mon->priv->n_stages;
+}
+
+/**
+ * facq_pipeline_monitor_set_stage_depth:
+ * @mon: A #FacqPipelineMonitor object.
+ * @stage: The stage index.
+ * @depth: The number of chunks waiting in the input queue of the stage.
+ *
+ * Updates the depth of the @stage input queue. This function can be called
+ * from any thread, it doesn't take any lock.
+ * You don't have to use this function, it's called in #FacqPipeline.
+ */
+void facq_pipeline_monitor_set_stage_depth(FacqPipelineMonitor *mon,guint stage,guint depth)
+{
+	if(stage < mon->priv->n_stages)
+		g_atomic_int_set(&mon->priv->stage_depth[stage],(gint)depth);
+}
+
+/**
+ * facq_pipeline_monitor_get_stage_depth:
+ * @mon: A #FacqPipelineMonitor object.
+ * @stage: The stage index, see facq_pipeline_monitor_get_n_stages().
+ *
+ * Gets the last known number of chunks waiting in the input queue of @stage.
+ * A stage with a growing depth is slower than the rest of the pipeline.
+ *
+ * Returns: The number of chunks waiting in the @stage input queue.
+ */
+guint facq_pipeline_monitor_get_stage_depth(const FacqPipelineMonitor *mon,guint stage)
+{
+	g_return_val_if_fail(FACQ_IS_PIPELINE_MONITOR(mon),0);
+	g_return_val_if_fail(stage < mon->priv->n_stages,0);
+
+	return (guint)g_atomic_int_get(&mon->priv->stage_depth[stage]);
+}
+
+/**
+ * facq_pipeline_monitor_add_dropped:
+ * @mon: A #FacqPipelineMonitor object.
+ * @n_chunks: The number of chunks dropped.
+ *
+ * Adds @n_chunks to the number of chunks dropped by the pipeline. This
+ * function can be called from any thread, it doesn't take any lock.
+ * You don't have to use this function, it's called in #FacqPipeline.
+ */
+void facq_pipeline_monitor_add_dropped(FacqPipelineMonitor *mon,guint n_chunks)
+{
+	g_atomic_int_add(&mon->priv->dropped,(gint)n_chunks);
+}
+
+/**
+ * facq_pipeline_monitor_get_dropped:
+ * @mon: A #FacqPipelineMonitor object.
+ *
+ * Gets the number of chunks dropped by the pipeline, since the last call to
+ * facq_pipeline_monitor_clear().
+ *
+ * Returns: The number of dropped chunks.
+ */
+guint facq_pipeline_monitor_get_dropped(const FacqPipelineMonitor *mon)
+{
+	g_return_val_if_fail(FACQ_IS_PIPELINE_MONITOR(mon),0);
+
+	return (guint)g_atomic_int_get(&mon->priv->dropped);
 }
 
 /**
  * facq_pipeline_monitor_attach:
  * @mon: A #FacqPipelineMonitor object.
  *
- * Attaches the timeout source to the main thread, so the internal callback
- * function can start to check for new messages, in the #FacqPipelineMonitor
- * object.
+ * Attaches the source to the main thread, so the internal callback
+ * function is called as soon as a new message is pushed to the
+ * #FacqPipelineMonitor object.
  * You don't need to call this function, this function is called in #FacqStream.
  */
 void facq_pipeline_monitor_attach(FacqPipelineMonitor *mon)
 {
+	GSource *source = NULL;
+
 	g_return_if_fail(FACQ_IS_PIPELINE_MONITOR(mon));
-	mon->priv->source_id = 
-		g_timeout_add_seconds(1,facq_pipeline_monitor_timeout_func,mon);
+
+	source = g_source_new(&facq_pipeline_monitor_source_funcs,
+					sizeof(FacqPipelineMonitorSource));
+	((FacqPipelineMonitorSource *)source)->q = mon->priv->q;
+	g_source_set_callback(source,facq_pipeline_monitor_source_func,mon,NULL);
+	mon->priv->source_id = g_source_attach(source,NULL);
+	g_source_unref(source);
 }
 
 /**
  * facq_pipeline_monitor_dettach:
  * @mon: A #FacqPipelineMonitor object.
  *
- * Detaches the timeout source from the main thread, stopping the execution of
+ * Detaches the source from the main thread, stopping the execution of
  * the callback function.
  * You don't need to call this function, this function is called in #FacqStream.
  */ 
 void facq_pipeline_monitor_dettach(FacqPipelineMonitor *mon)
 {
 	g_return_if_fail(FACQ_IS_PIPELINE_MONITOR(mon));
-	g_source_remove(mon->priv->source_id);
+	/* the source is removed after dispatching an error or stop message */
+	if(mon->priv->source_id)
+		g_source_remove(mon->priv->source_id);
+	mon->priv->source_id = 0;
 }
 
 /**
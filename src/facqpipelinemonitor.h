@@ -51,6 +51,12 @@ FacqPipelineMonitor *facq_pipeline_monitor_new(FacqPipelineMonitorCb error_cb,Fa
 void facq_pipeline_monitor_push(FacqPipelineMonitor *mon,FacqPipelineMessage *msg);
 FacqPipelineMessage *facq_pipeline_monitor_pop(FacqPipelineMonitor *mon);
 void facq_pipeline_monitor_clear(FacqPipelineMonitor *mon);
+void facq_pipeline_monitor_set_n_stages(FacqPipelineMonitor *mon,guint n_stages);
+guint facq_pipeline_monitor_get_n_stages(const FacqPipelineMonitor *mon);
+void facq_pipeline_monitor_set_stage_depth(FacqPipelineMonitor *mon,guint stage,guint depth);
+guint facq_pipeline_monitor_get_stage_depth(const FacqPipelineMonitor *mon,guint stage);
+void facq_pipeline_monitor_add_dropped(FacqPipelineMonitor *mon,guint n_chunks);
+guint facq_pipeline_monitor_get_dropped(const FacqPipelineMonitor *mon);
 void facq_pipeline_monitor_attach(FacqPipelineMonitor *mon);
 void facq_pipeline_monitor_dettach(FacqPipelineMonitor *mon);
 void facq_pipeline_monitor_free(FacqPipelineMonitor *mon);
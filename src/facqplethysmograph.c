@@ -211,7 +211,7 @@ static gboolean data_callback(FacqChunk *chunk,gpointer _plethysmograph)
 	FacqPlethysmograph *plethysmograph = FACQ_PLETHYSMOGRAPH(_plethysmograph);
 	const gdouble *bpm = NULL;
 
-	g_return_val_if_fail(FACQ_IS_CHUNK(chunk),FALSE);
+	g_return_val_if_fail(chunk != NULL,FALSE);
 	g_return_val_if_fail(FACQ_IS_PLETHYSMOGRAPH(plethysmograph),FALSE);
 
 #if ENABLE_DEBUG
@@ -145,6 +145,22 @@
  *    can send messages to this thread, for example if the user wants to stop
  *    the process.
  *
+ *    Before the #FacqStreamData the client and the server exchange a magic
+ *    number and a protocol version, see facq_net_handshake_accept(), clients
+ *    using a different protocol are refused.
+ *
+ *    Each chunk sent by the client is preceded by its sequence number,
+ *    timestamp and size, see #FacqOperationPlug. The producer thread reads
+ *    the data of as many sent chunks as needed to fill each #FacqChunk, so
+ *    the user function always receives full chunks whatever the chunk size
+ *    of the client. The sequence number and the timestamp of the first sent
+ *    chunk that contributes to a #FacqChunk are copied to it, so the user
+ *    function can get them with facq_chunk_get_sequence() and
+ *    facq_chunk_get_timestamp(). A jump in the sequence number, because the
+ *    client has dropped chunks, is logged as a warning. The timestamp comes
+ *    from the monotonic clock of the client, so only the differences between
+ *    chunks are meaningful.
+ *
  *    The main thread will try (When not busy with other things 
  *    like drawing the GUI) to get new chunks of data from the #FacqBuffer 
  *    or new message from the producer thread, (for example, if the client
@@ -407,13 +423,50 @@ static void facq_plug_bind_and_listen(FacqPlug *plug,GError **err)
 	return;
 }
 
+/*
+ * prod_check_received:
+ *
+ * Checks the value returned by facq_net_receive() in the producer thread,
+ * telling the main thread if the client has disconnected.
+ * Returns %FALSE if the producer should stop.
+ */
+static gboolean prod_check_received(FacqPlug *plug,gssize received)
+{
+	FacqPlugMessage *msg = NULL;
+
+	switch(received){
+	case -3:
+		/* error in receive parameters */
+		facq_log_write("Error in receive parameters",FACQ_LOG_MSG_TYPE_ERROR);
+		return FALSE;
+	case -2:
+		/* timeout */
+		facq_log_write("Timeout receiving data",FACQ_LOG_MSG_TYPE_ERROR);
+		return FALSE;
+	case -1:
+		/* error receiving data */
+		facq_log_write("Error receiving data",FACQ_LOG_MSG_TYPE_ERROR);
+		return FALSE;
+	case 0:
+		/* client disconnected */
+		msg = facq_plug_message_new(FACQ_PLUG_MESSAGE_TYPE_DISCONNECT,NULL);
+		g_async_queue_push(plug->priv->ptom,msg);
+		return FALSE;
+	default:
+		return TRUE;
+	}
+}
+
 static gpointer prod_fun(gpointer data)
 {
 	FacqPlug *plug = FACQ_PLUG(data);
 	FacqPlugMessage *msg = NULL;
 	FacqChunk *chunk = NULL;
-	gboolean retctw = FALSE;
+	gboolean retctw = FALSE, started = FALSE;
 	gssize received = 0;
+	guint64 header[3];
+	guint64 sequence = 0, expected = 0, remaining = 0;
+	gint64 timestamp = 0;
 	GError *err = NULL;
 
 	chunk = facq_buffer_get_recycled(plug->priv->buf);
@@ -469,43 +522,53 @@ static gpointer prod_fun(gpointer data)
 			if(!err && retctw){
 				retctw = FALSE;
 
-				/* try to read a full chunk */
-				facq_log_write("calling facq_net_receive",FACQ_LOG_MSG_TYPE_DEBUG);
-				received = facq_net_receive(plug->priv->clt_skt,
-							   chunk->data,
-							   chunk->len,
-							   0,
-							   &err);
-				facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
-						"facq_net_receive returned %"G_GSSIZE_FORMAT,
-						received);
-				switch(received){
-				case -3:
-					/* error in receive parameters */
-					facq_log_write("Error in receive parameters",FACQ_LOG_MSG_TYPE_ERROR);
-					goto error;
-				break;
-				case -2:
-					/* timeout */
-					facq_log_write("Timeout receiving data",FACQ_LOG_MSG_TYPE_ERROR);
-					goto error;
-				break;
-				case -1:
-					/* error receiving data */
-					facq_log_write("Error receiving data",FACQ_LOG_MSG_TYPE_ERROR);
-					goto error;
-				break;
-				case 0:
-					/* client disconnected */
-					msg = facq_plug_message_new(
-								FACQ_PLUG_MESSAGE_TYPE_DISCONNECT,
-												NULL);
-					g_async_queue_push(plug->priv->ptom,msg);
-					goto error;
-				break;
-				default:
-					/* chunk should be full here */
+				/* each chunk sent by the other side starts with
+				 * a header, a sent chunk can fill more than one of
+				 * our chunks and one of our chunks can hold the
+				 * data of more than one sent chunk */
+				if(!remaining){
+					received = facq_net_receive(plug->priv->clt_skt,
+								   (gchar *)header,
+								   sizeof(header),
+								   0,
+								   &err);
+					if(!prod_check_received(plug,received))
+						goto error;
+					sequence = GUINT64_FROM_BE(header[0]);
+					timestamp = (gint64)GUINT64_FROM_BE(header[1]);
+					remaining = GUINT64_FROM_BE(header[2]);
+					if(started && sequence > expected)
+						facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+							"%"G_GUINT64_FORMAT" chunks lost by the client",
+							sequence - expected);
+					expected = sequence + 1;
+					started = TRUE;
+				}
+
+				if(remaining){
+					/* the chunk takes the values of the first
+					 * sent chunk that goes into it */
+					if(!facq_chunk_get_used_bytes(chunk)){
+						facq_chunk_set_sequence(chunk,sequence);
+						facq_chunk_set_timestamp(chunk,timestamp);
+					}
+					facq_log_write("calling facq_net_receive",FACQ_LOG_MSG_TYPE_DEBUG);
+					received = facq_net_receive(plug->priv->clt_skt,
+								   facq_chunk_write_pos(chunk),
+								   MIN(remaining,facq_chunk_get_free_bytes(chunk)),
+								   0,
+								   &err);
+					facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,
+							"facq_net_receive returned %"G_GSSIZE_FORMAT,
+							received);
+					if(!prod_check_received(plug,received))
+						goto error;
+					remaining -= received;
 					facq_chunk_add_used_bytes(chunk,received);
+				}
+
+				/* only full chunks are passed to the main thread */
+				if(!facq_chunk_get_free_bytes(chunk)){
 					facq_buffer_push(plug->priv->buf,chunk);
 					chunk = NULL;
 				}
@@ -559,6 +622,18 @@ static void facq_plug_accept_client(FacqPlug *plug)
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s is connected",address);
 	g_free(address);
 
+	if(!facq_net_handshake_accept(plug->priv->clt_skt,&local_err)){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
+					"Refusing client: %s",
+						(local_err) ? local_err->message : "unknown error");
+		g_clear_error(&local_err);
+		g_socket_shutdown(plug->priv->clt_skt,TRUE,TRUE,NULL);
+		g_socket_close(plug->priv->clt_skt,NULL);
+		g_object_unref(G_SOCKET(plug->priv->clt_skt));
+		plug->priv->clt_skt = NULL;
+		return;
+	}
+
 	stmd = facq_stream_data_from_socket(plug->priv->clt_skt,&local_err);
 	if(local_err){
 		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,
@@ -567,6 +642,7 @@ static void facq_plug_accept_client(FacqPlug *plug)
 		g_clear_error(&local_err);
 		g_socket_shutdown(plug->priv->clt_skt,TRUE,TRUE,NULL);
 		g_socket_close(plug->priv->clt_skt,NULL);
+		g_object_unref(G_SOCKET(plug->priv->clt_skt));
 		plug->priv->clt_skt = NULL;
 		return;
 	}
@@ -98,6 +98,10 @@
  * system will do it for you.
  * See #GIOChannel for return values and for generic read/write
  * functions to any kind of file descriptor.
+ * @sinkwritev: Virtual method like @sinkwrite but receives an array of
+ * @n_chunks #FacqChunk objects, that must be written in order, ideally with a
+ * single write to the underlying device. It's optional implementing it, if
+ * you don't provide it @sinkwrite will be called for each chunk.
  * @sinkstop: Virtual method that is called when the stream is stopped.
  * You must return %TRUE if successful or %FALSE in any other case.
  * It's optional implementing it, if you don't provide it an empty 
@@ -183,6 +187,7 @@ static void facq_sink_class_init(FacqSinkClass *klass)
 	sink_class->sinkstart = NULL;
 	sink_class->sinkpoll = NULL;
 	sink_class->sinkwrite = NULL;
+	sink_class->sinkwritev = NULL;
 	sink_class->sinkstop = NULL;
 	sink_class->sinkfree = NULL;
 
@@ -377,6 +382,40 @@ GIOStatus facq_sink_write(FacqSink *sink,const FacqStreamData *stmd,FacqChunk *c
 	return FACQ_SINK_GET_CLASS(sink)->sinkwrite(sink,stmd,chunk,err);
 }
 
+/**
+ * facq_sink_writev:
+ * @sink: A #FacqSink object, it can be of any type.
+ * @stmd: A #FacqStreamData object.
+ * @chunks: An array of #FacqChunk objects with the data to write to the sink.
+ * @n_chunks: The number of chunks in @chunks.
+ * @err: A #GError, you must set it in case of error.
+ *
+ * Writes the data of @n_chunks chunks to the sink, in the order they appear
+ * in @chunks. If the sink type doesn't implement the vectored write, the
+ * chunks are written one by one with the facq_sink_*_write function, stopping
+ * at the first one that fails. See #FacqSinkClass for more details.
+ *
+ * Returns: A #GIOStatus according to the operation result.
+ */
+GIOStatus facq_sink_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err)
+{
+	GIOStatus ret = G_IO_STATUS_NORMAL;
+	guint i = 0;
+
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_SINK(sink),G_IO_STATUS_ERROR);
+#endif
+	if(FACQ_SINK_GET_CLASS(sink)->sinkwritev)
+		return FACQ_SINK_GET_CLASS(sink)->sinkwritev(sink,stmd,chunks,n_chunks,err);
+
+	for(i = 0;i < n_chunks;i++){
+		ret = FACQ_SINK_GET_CLASS(sink)->sinkwrite(sink,stmd,chunks[i],err);
+		if(ret == G_IO_STATUS_ERROR || ret == G_IO_STATUS_EOF)
+			break;
+	}
+	return ret;
+}
+
 /* facq_sink_stop:
  * @sink: A #FacqSink object, it can be of any type of sink.
  * @stmd: A #FacqStreamData object.
@@ -47,6 +47,7 @@ struct _FacqSinkClass {
 	gboolean (*sinkstart)(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 	gint (*sinkpoll)(FacqSink *sink,const FacqStreamData *stmd);
 	GIOStatus (*sinkwrite)(FacqSink *sink,const FacqStreamData *stmd,FacqChunk *chunk,GError **err);
+	GIOStatus (*sinkwritev)(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err);
 	gboolean (*sinkstop)(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 	void (*sinkfree)(FacqSink *sink);
 };
@@ -61,6 +62,7 @@ void facq_sink_to_file(FacqSink *sink,GKeyFile *file,const gchar *group);
 gboolean facq_sink_start(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 gint facq_sink_poll(FacqSink *sink,const FacqStreamData *stmd);
 GIOStatus facq_sink_write(FacqSink *sink,const FacqStreamData *stmd,FacqChunk *chunk,GError **err);
+GIOStatus facq_sink_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err);
 gboolean facq_sink_stop(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 void facq_sink_free(FacqSink *sink);
 
@@ -24,11 +24,13 @@
 #include <config.h>
 #endif
 #include "facqresources.h"
+#include "facqlog.h"
 #include "facqunits.h"
 #include "facqchanlist.h"
 #include "facqchunk.h"
 #include "facqstreamdata.h"
 #include "facqfile.h"
+#include "facqfileindex.h"
 #include "facqsink.h"
 #include "facqsinkfile.h"
 
@@ -49,10 +51,19 @@
  * For creating a new #FacqSinkFile you must call facq_sink_file_new(),
  * to use it you must call first facq_sink_start(), and then you must call
  * in an iterative way facq_sink_file_poll() and facq_sink_file_write(), or
+ * facq_sink_file_writev() for more than one #FacqChunk, or
  * use a #FacqStream that will do all those things for you.
  * When you don't need to write more data simply call facq_sink_stop() and
  * facq_sink_file_free() or facq_sink_free() to destroy the object.
  *
+ * While the samples are written a #FacqFileIndex is written too, next to the
+ * file, so the viewer can draw zoomed out views of long recordings quickly.
+ * The index is optional, if it can't be written a warning is logged and the
+ * acquisition goes on without it.
+ *
+ * The samples can be compressed with facq_sink_file_set_compress(), the
+ * compression is done in a separate thread, see facq_file_set_compressed().
+ *
  * facq_sink_file_to_file(), facq_sink_file_key_constructor() and
  * facq_sink_file_constructor() are used by the system to store the config
  * and to recreate #FacqSinkFile objects. See facq_sink_to_file() 
@@ -79,11 +90,14 @@ G_DEFINE_TYPE_WITH_CODE(FacqSinkFile,facq_sink_file,FACQ_TYPE_SINK,G_IMPLEMENT_I
 enum {
 	PROP_0,
 	PROP_FILENAME,
+	PROP_COMPRESS
 };
 
 struct _FacqSinkFilePrivate {
 	FacqFile *file;
+	FacqFileIndexWriter *index;
 	gchar *filename;
+	gboolean compress;
 	GError *construct_error;
 };
 
@@ -95,6 +109,8 @@ static void facq_sink_file_set_property(GObject *self,guint property_id,const GV
 	switch(property_id){
 	case PROP_FILENAME: sinkfile->priv->filename = g_value_dup_string(value);
 	break;
+	case PROP_COMPRESS: sinkfile->priv->compress = g_value_get_boolean(value);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID(sinkfile,property_id,pspec);
 	}
@@ -107,6 +123,8 @@ static void facq_sink_file_get_property(GObject *self,guint property_id,GValue *
 	switch(property_id){
 	case PROP_FILENAME: g_value_set_string(value,sinkfile->priv->filename);
 	break;
+	case PROP_COMPRESS: g_value_set_boolean(value,sinkfile->priv->compress);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID(sinkfile,property_id,pspec);
 	}
@@ -119,6 +137,8 @@ static void facq_sink_file_finalize(GObject *self)
 
 	if(sinkfile->priv->file)
 		facq_file_free(sinkfile->priv->file);
+	if(sinkfile->priv->index)
+		facq_file_index_writer_free(sinkfile->priv->index);
 
 	g_free(sinkfile->priv->filename);
 	G_OBJECT_CLASS (facq_sink_file_parent_class)->finalize (self);
@@ -149,6 +169,7 @@ static void facq_sink_file_class_init(FacqSinkFileClass *klass)
 	sink_class->sinkstart = facq_sink_file_start;
 	sink_class->sinkpoll = facq_sink_file_poll;
 	sink_class->sinkwrite = facq_sink_file_write;
+	sink_class->sinkwritev = facq_sink_file_writev;
 	sink_class->sinkstop = facq_sink_file_stop;
 	sink_class->sinkfree = facq_sink_file_free;
 
@@ -160,6 +181,15 @@ static void facq_sink_file_class_init(FacqSinkFileClass *klass)
 							     G_PARAM_READWRITE |
 							     G_PARAM_CONSTRUCT_ONLY |
 							     G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_COMPRESS,
+					g_param_spec_boolean("compress",
+							     "Compress",
+							     "Compress the samples in the file",
+							     FALSE,
+							     G_PARAM_READWRITE |
+							     G_PARAM_CONSTRUCT |
+							     G_PARAM_STATIC_STRINGS));
 }
 
 static void facq_sink_file_init(FacqSinkFile *sink)
@@ -167,6 +197,37 @@ static void facq_sink_file_init(FacqSinkFile *sink)
 	sink->priv = G_TYPE_INSTANCE_GET_PRIVATE(sink,FACQ_TYPE_SINK_FILE,FacqSinkFilePrivate);
 	sink->priv->filename = NULL;
 	sink->priv->file = NULL;
+	sink->priv->index = NULL;
+	sink->priv->compress = FALSE;
+}
+
+/*****--- Private methods ---*****/
+/* The index is optional, so errors are only logged and the index is dropped */
+static void facq_sink_file_index_drop(FacqSinkFile *sinkfile,GError *err)
+{
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+			"Can't write the index of the file: %s",err->message);
+	g_error_free(err);
+	facq_file_index_writer_free(sinkfile->priv->index);
+	sinkfile->priv->index = NULL;
+}
+
+static void facq_sink_file_index_push(FacqSinkFile *sinkfile,FacqChunk **chunks,guint n_chunks)
+{
+	GError *local_err = NULL;
+	guint c = 0;
+
+	if(!sinkfile->priv->index)
+		return;
+	for(c = 0;c < n_chunks;c++){
+		if(!facq_file_index_writer_push(sinkfile->priv->index,
+				(const gdouble *)chunks[c]->data,
+					facq_chunk_get_used_bytes(chunks[c])/sizeof(gdouble),
+						&local_err)){
+			facq_sink_file_index_drop(sinkfile,local_err);
+			return;
+		}
+	}
 }
 
 /*****--- GInitable implementation ---*****/
@@ -234,14 +295,29 @@ gpointer facq_sink_file_key_constructor(const gchar *group_name,GKeyFile *key_fi
 {
 	GError *local_err = NULL;
 	gchar *filename = NULL;
+	gboolean compress = FALSE;
+	FacqSinkFile *sinkfile = NULL;
 
 	filename = g_key_file_get_string(key_file,group_name,"filename",&local_err);
 	if(local_err)
 		goto error;
 
-	return facq_sink_file_new(filename,err);
+	/* compress is optional, older files don't have it */
+	if(g_key_file_has_key(key_file,group_name,"compress",NULL)){
+		compress = g_key_file_get_boolean(key_file,group_name,"compress",&local_err);
+		if(local_err)
+			goto error;
+	}
+
+	sinkfile = facq_sink_file_new(filename,err);
+	g_free(filename);
+	if(sinkfile)
+		facq_sink_file_set_compress(sinkfile,compress);
+	return sinkfile;
 
 	error:
+	if(filename)
+		g_free(filename);
 	if(local_err){
 		if(err)
 			g_propagate_error(err,local_err);
@@ -280,7 +356,7 @@ FacqSinkFile *facq_sink_file_new(const gchar *filename,GError **error)
  * @group: A string with the group name.
  *
  * Implements the facq_sink_to_file() method.
- * Saves the filename property of a #FacqSinkFile, @sink,
+ * Saves the filename and compress properties of a #FacqSinkFile, @sink,
  * to a #GKeyFile, @file, using the group
  * name @group.
  * This is used by the facq_stream_save() function, and you shouldn't need
@@ -291,6 +367,23 @@ void facq_sink_file_to_file(FacqSink *sink,GKeyFile *file,const gchar *group)
 	FacqSinkFile *sinkfile = FACQ_SINK_FILE(sink);
 
 	g_key_file_set_string(file,group,"filename",sinkfile->priv->filename);
+	g_key_file_set_boolean(file,group,"compress",sinkfile->priv->compress);
+}
+
+/**
+ * facq_sink_file_set_compress:
+ * @sinkfile: A #FacqSinkFile object.
+ * @compress: %TRUE to compress the samples.
+ *
+ * Enables or disables the compression of the samples in the next
+ * acquisition, by default disabled. Compressed files take less space but
+ * can't be read by older versions of the software.
+ */
+void facq_sink_file_set_compress(FacqSinkFile *sinkfile,gboolean compress)
+{
+	g_return_if_fail(FACQ_IS_SINK_FILE(sinkfile));
+
+	sinkfile->priv->compress = compress;
 }
 
 /**
@@ -300,7 +393,8 @@ void facq_sink_file_to_file(FacqSink *sink,GKeyFile *file,const gchar *group)
  * @err: A #GError, it will be set in case of error if not %NULL.
  *
  * Starts the #FacqSinkFile, allowing it to prepare for the data writing.
- * The header of the #FacqFile will be written in this step.
+ * The header of the #FacqFile will be written in this step, and the index of
+ * the file will be created.
  *
  * Returns: %TRUE if successful or %FALSE in other case.
  */
@@ -309,6 +403,7 @@ gboolean facq_sink_file_start(FacqSink *sink,const FacqStreamData *stmd,GError *
 	GError *local_err = NULL;
 	FacqSinkFile *sinkfile = FACQ_SINK_FILE(sink);
 	FacqFile *file = NULL;
+	gchar *index_filename = NULL;
 
 	file = sinkfile->priv->file;
 
@@ -316,10 +411,23 @@ gboolean facq_sink_file_start(FacqSink *sink,const FacqStreamData *stmd,GError *
 	if(local_err)
 		goto error;
 
+	facq_file_set_compressed(file,sinkfile->priv->compress);
 	facq_file_write_header(file,stmd,&local_err);
 	if(local_err)
 		goto error;
 
+	if(sinkfile->priv->index)
+		facq_file_index_writer_free(sinkfile->priv->index);
+	index_filename = facq_file_index_get_filename(sinkfile->priv->filename);
+	sinkfile->priv->index =
+		facq_file_index_writer_new(index_filename,stmd->n_channels,&local_err);
+	g_free(index_filename);
+	if(local_err){
+		facq_log_write_v(FACQ_LOG_MSG_TYPE_WARNING,
+				"Can't create the index of the file: %s",local_err->message);
+		g_clear_error(&local_err);
+	}
+
 	return TRUE;
 
 	error:
@@ -362,7 +470,7 @@ gint facq_sink_file_poll(FacqSink *sink,const FacqStreamData *stmd)
  * @err: A #GError, it will be set in case of error if not %NULL.
  *
  * Writes the samples contained in the #FacqChunk, @chunk to the #FacqFile
- * managed by the @sink.
+ * managed by the @sink, and adds them to the index of the file.
  *
  * Returns: %G_IO_STATUS_NORMAL if successful, any other #GIOStatus in other
  * case.
@@ -375,8 +483,42 @@ GIOStatus facq_sink_file_write(FacqSink *sink,const FacqStreamData *stmd,FacqChu
 	GError *local_err = NULL;
 	
 	ret = facq_file_write_samples(file,chunk,&local_err);
-	if(local_err)
+	if(local_err){
+		g_propagate_error(err,local_err);
+		return ret;
+	}
+	facq_sink_file_index_push(sinkfile,&chunk,1);
+	return ret;
+}
+
+/**
+ * facq_sink_file_writev:
+ * @sink: A #FacqSinkFile object casted to #FacqSink.
+ * @stmd: A #FacqStreamData with the relevant information of the stream.
+ * @chunks: An array of #FacqChunk objects with the data to be written.
+ * @n_chunks: The number of chunks in @chunks.
+ * @err: A #GError, it will be set in case of error if not %NULL.
+ *
+ * Implements facq_sink_writev(). Writes the samples contained in all the
+ * chunks to the #FacqFile managed by the @sink, with a single write, see
+ * facq_file_write_samples_v().
+ *
+ * Returns: %G_IO_STATUS_NORMAL if successful, any other #GIOStatus in other
+ * case.
+ */
+GIOStatus facq_sink_file_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err)
+{
+	GIOStatus ret = 0;
+	FacqSinkFile *sinkfile = FACQ_SINK_FILE(sink);
+	FacqFile *file = sinkfile->priv->file;
+	GError *local_err = NULL;
+
+	ret = facq_file_write_samples_v(file,chunks,n_chunks,&local_err);
+	if(local_err){
 		g_propagate_error(err,local_err);
+		return ret;
+	}
+	facq_sink_file_index_push(sinkfile,chunks,n_chunks);
 	return ret;
 }
 
@@ -388,7 +530,8 @@ GIOStatus facq_sink_file_write(FacqSink *sink,const FacqStreamData *stmd,FacqChu
  *
  * Stops the #FacqSinkFile object. After calling this function you shouldn't
  * write data to the sink, until facq_sink_file_start() is called again.
- * It writes the so called tail to the file, see #FacqFile for more info.
+ * It writes the so called tail to the file, see #FacqFile for more info, and
+ * finishes the index of the file.
  *
  * Returns: %TRUE if sucessful, %FALSE in other case.
  */
@@ -410,6 +553,17 @@ gboolean facq_sink_file_stop(FacqSink *sink,const FacqStreamData *stmd,GError **
 		return FALSE;
 	}
 
+	if(sinkfile->priv->index){
+		if(!facq_file_index_writer_finish(sinkfile->priv->index,&local_err)){
+			facq_sink_file_index_drop(sinkfile,local_err);
+			local_err = NULL;
+		}
+		else {
+			facq_file_index_writer_free(sinkfile->priv->index);
+			sinkfile->priv->index = NULL;
+		}
+	}
+
 	return TRUE;
 
 	error:
@@ -49,12 +49,14 @@ GType facq_sink_file_get_type(void) G_GNUC_CONST;
 /* Public methods */
 gpointer facq_sink_file_constructor(const GPtrArray *user_input,GError **err);
 FacqSinkFile *facq_sink_file_new(const gchar *filename,GError **error);
+void facq_sink_file_set_compress(FacqSinkFile *sinkfile,gboolean compress);
 /* virtuals */
 void facq_sink_file_to_file(FacqSink *sink,GKeyFile *file,const gchar *group);
 gpointer facq_sink_file_key_constructor(const gchar *group_name,GKeyFile *key_file,GError **err);
 gboolean facq_sink_file_start(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 gint facq_sink_file_poll(FacqSink *sink,const FacqStreamData *stmd);
 GIOStatus facq_sink_file_write(FacqSink *sink,const FacqStreamData *stmd,FacqChunk *chunk,GError **err);
+GIOStatus facq_sink_file_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err);
 gboolean facq_sink_file_stop(FacqSink *sink,const FacqStreamData *stmd,GError **err);
 void facq_sink_file_free(FacqSink *sink);
 
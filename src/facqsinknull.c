@@ -29,6 +29,10 @@
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#if defined(G_OS_UNIX) && HAVE_SYS_UIO_H
+#include <errno.h>
+#include <sys/uio.h>
+#endif
 #include "facqresources.h"
 #include "facqglibcompat.h"
 #include "facqunits.h"
@@ -53,7 +57,8 @@
  * destroy it you can use facq_sink_null_free(). #FacqSinkNull implements
  * the virtuals in #FacqSink, so if you want to use it without a #FacqStream
  * you must call first facq_sink_start(), and then you must call in an iterative
- * way facq_sink_null_poll() and facq_sink_null_write(). When you don't need
+ * way facq_sink_null_poll() and facq_sink_null_write(), or
+ * facq_sink_null_writev(). When you don't need
  * to write more data simply call facq_sink_stop() and facq_sink_free() to
  * destroy the object.
  *
@@ -92,6 +97,9 @@ G_DEFINE_TYPE_WITH_CODE(FacqSinkNull,facq_sink_null,FACQ_TYPE_SINK,G_IMPLEMENT_I
 #define FACQ_SINK_NULL_DPATH "/dev/null"
 #endif
 
+/* maximum number of chunks passed to writev() at once, well below IOV_MAX */
+#define FACQ_SINK_NULL_IOV_MAX 64
+
 enum {
 	PROP_0,
 };
@@ -165,6 +173,7 @@ static void facq_sink_null_class_init(FacqSinkNullClass *klass)
 	object_class->constructed = facq_sink_null_constructed;
 	object_class->finalize = facq_sink_null_finalize;
 	sink_class->sinkwrite = facq_sink_null_write;
+	sink_class->sinkwritev = facq_sink_null_writev;
 	sink_class->sinkfree = facq_sink_null_free;
 }
 
@@ -311,6 +320,61 @@ GIOStatus facq_sink_null_write(FacqSink *sink,const FacqStreamData *stmd,FacqChu
 					err);
 }
 
+/**
+ * facq_sink_null_writev:
+ * @sink: A #FacqSinkNull casted to #FacqSink.
+ * @stmd: A #FacqStreamData object with the relevant stream info.
+ * @chunks: An array of #FacqChunk objects with the data to be written.
+ * @n_chunks: The number of chunks in @chunks.
+ * @err: A #GError it will be set in case of error, if not %NULL.
+ *
+ * Implements the facq_sink_writev() function.
+ * Writes the data of all the chunks to the null device. On Unix systems
+ * writev() is used, so a single system call is needed for all the chunks,
+ * in other systems the chunks are written one by one.
+ *
+ * Returns: A #GIOStatus, if all goes fine it should be %G_IO_STATUS_NORMAL.
+ */
+GIOStatus facq_sink_null_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err)
+{
+#if defined(G_OS_UNIX) && HAVE_SYS_UIO_H
+	FacqSinkNull *sinknull = FACQ_SINK_NULL(sink);
+	struct iovec iov[FACQ_SINK_NULL_IOV_MAX];
+	gssize ret = 0;
+	gsize total = 0;
+	guint i = 0, n_iov = 0;
+
+	while(i < n_chunks){
+		total = 0;
+		for(n_iov = 0;i < n_chunks && n_iov < FACQ_SINK_NULL_IOV_MAX;n_iov++,i++){
+			iov[n_iov].iov_base = chunks[i]->data;
+			iov[n_iov].iov_len = facq_chunk_get_used_bytes(chunks[i]);
+			total += iov[n_iov].iov_len;
+		}
+		ret = writev(sinknull->priv->pfd->fd,iov,n_iov);
+		if(ret < 0){
+			g_set_error(err,G_IO_ERROR,g_io_error_from_errno(errno),
+					"Error writing to the null device: %s",
+						g_strerror(errno));
+			return G_IO_STATUS_ERROR;
+		}
+		if((gsize)ret != total){
+			g_set_error_literal(err,G_IO_ERROR,G_IO_ERROR_FAILED,
+					"Can't write all bytes to the null device");
+			return G_IO_STATUS_ERROR;
+		}
+	}
+	return G_IO_STATUS_NORMAL;
+#else
+	GIOStatus ret = G_IO_STATUS_NORMAL;
+	guint i = 0;
+
+	for(i = 0;i < n_chunks && ret == G_IO_STATUS_NORMAL;i++)
+		ret = facq_sink_null_write(sink,stmd,chunks[i],err);
+	return ret;
+#endif
+}
+
 /**
  * facq_sink_null_free:
  * @sink: A #FacqSinkNull object casted to #FacqSink.
@@ -53,6 +53,7 @@ FacqSinkNull *facq_sink_null_new(GError **error);
 /* virtuals */
 gint facq_sink_null_poll(FacqSink *sink,const FacqStreamData *stmd);
 GIOStatus facq_sink_null_write(FacqSink *sink,const FacqStreamData *stmd,FacqChunk *chunk,GError **err);
+GIOStatus facq_sink_null_writev(FacqSink *sink,const FacqStreamData *stmd,FacqChunk **chunks,guint n_chunks,GError **err);
 void facq_sink_null_free(FacqSink *sink);
 
 G_END_DECLS
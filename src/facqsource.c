@@ -23,6 +23,7 @@
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include "facqglibcompat.h"
 #include "facqunits.h"
 #include "facqchanlist.h"
 #include "facqstreamdata.h"
@@ -374,8 +375,20 @@
  * method that returns %TRUE will be used.
  * @srcfree: Virtual method that is called when the source is no longer needed.
  * You must provide it. In most cases calling g_object_unref() should be enough.
+ *
+ * If your @srcpoll or @srcread methods need to wait for some time, use
+ * facq_source_sleep() instead of g_usleep(), and return as soon as possible
+ * when it returns %FALSE, this way the pipeline can be stopped without waiting
+ * for the sleep to finish, see facq_source_interrupt(). Sources that generate
+ * or read the data at a fixed rate, without hardware timing, should use
+ * facq_source_pace() instead, that sleeps until absolute deadlines, so the
+ * time spent between the sleeps doesn't lower the rate.
  */
 
+/* If the source is late more than this number of microseconds the deadlines
+ * start again from the current time, instead of catching up */
+#define FACQ_SOURCE_PACE_MAX_LAG G_USEC_PER_SEC
+
 G_DEFINE_TYPE(FacqSource,facq_source,G_TYPE_OBJECT);
 
 enum {
@@ -392,6 +405,17 @@ struct _FacqSourcePrivate {
 	gchar *desc;
 	gboolean started;
 	FacqStreamData *stmd;
+	volatile gint interrupted;
+	gint64 pace_start;
+	guint64 pace_ticks;
+	guint64 overruns;
+#if GLIB_MINOR_VERSION >= 32
+	GMutex mutex;
+	GCond cond;
+#else
+	GMutex *mutex;
+	GCond *cond;
+#endif
 };
 
 /*****--- GObject magic ---*****/
@@ -441,6 +465,13 @@ static void facq_source_finalize(GObject *self)
 		g_free(src->priv->desc);
 	if(src->priv->stmd)
 		facq_stream_data_free(src->priv->stmd);
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_clear(&src->priv->mutex);
+	g_cond_clear(&src->priv->cond);
+#else
+	g_mutex_free(src->priv->mutex);
+	g_cond_free(src->priv->cond);
+#endif
 	
 	G_OBJECT_CLASS (facq_source_parent_class)->finalize (self);
 }
@@ -534,6 +565,17 @@ static void facq_source_init(FacqSource *src)
 	src->priv->desc = NULL;
 	src->priv->started = FALSE;
 	src->priv->stmd = NULL;
+	src->priv->interrupted = FALSE;
+	src->priv->pace_start = 0;
+	src->priv->pace_ticks = 0;
+	src->priv->overruns = 0;
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_init(&src->priv->mutex);
+	g_cond_init(&src->priv->cond);
+#else
+	src->priv->mutex = g_mutex_new();
+	src->priv->cond = g_cond_new();
+#endif
 }
 
 /* Public methods */
@@ -651,6 +693,10 @@ gboolean facq_source_start(FacqSource *src,GError **err)
 	g_return_val_if_fail(FACQ_IS_SOURCE(src),FALSE);
 	
 	if(!src->priv->started){
+		g_atomic_int_set(&src->priv->interrupted,FALSE);
+		src->priv->pace_start = 0;
+		src->priv->pace_ticks = 0;
+		src->priv->overruns = 0;
 		if(FACQ_SOURCE_GET_CLASS(src)->srcstart)
 			ret = FACQ_SOURCE_GET_CLASS(src)->srcstart(src,err);
 		else
@@ -755,6 +801,146 @@ gboolean facq_source_stop(FacqSource *src,GError **err)
 	return ret;
 }
 
+/**
+ * facq_source_sleep:
+ * @src: A #FacqSource object, it can be any type of source.
+ * @microseconds: The number of microseconds to sleep.
+ *
+ * Sleeps the calling thread for @microseconds, like g_usleep(), but returns
+ * before if facq_source_interrupt() is called from other thread. Sources
+ * must use this function in their poll and read methods, see
+ * #FacqSourceClass.
+ *
+ * Returns: %TRUE if the time has elapsed, %FALSE if the source has been
+ * interrupted.
+ */
+gboolean facq_source_sleep(FacqSource *src,gint64 microseconds)
+{
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_SOURCE(src),FALSE);
+#endif
+	return facq_source_sleep_until(src,g_get_monotonic_time() + microseconds);
+}
+
+/**
+ * facq_source_sleep_until:
+ * @src: A #FacqSource object, it can be any type of source.
+ * @end_time: The monotonic time, see g_get_monotonic_time(), to wake up at.
+ *
+ * Like facq_source_sleep(), but sleeps until an absolute time.
+ *
+ * Returns: %TRUE if the time has been reached, %FALSE if the source has been
+ * interrupted.
+ */
+gboolean facq_source_sleep_until(FacqSource *src,gint64 end_time)
+{
+	gboolean ret = TRUE;
+
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_SOURCE(src),FALSE);
+#endif
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&src->priv->mutex);
+	while(!g_atomic_int_get(&src->priv->interrupted) &&
+		g_cond_wait_until(&src->priv->cond,&src->priv->mutex,end_time));
+	ret = !g_atomic_int_get(&src->priv->interrupted);
+	g_mutex_unlock(&src->priv->mutex);
+#else
+	g_mutex_lock(src->priv->mutex);
+	while(!g_atomic_int_get(&src->priv->interrupted) &&
+		g_cond_wait_until(src->priv->cond,src->priv->mutex,end_time));
+	ret = !g_atomic_int_get(&src->priv->interrupted);
+	g_mutex_unlock(src->priv->mutex);
+#endif
+	return ret;
+}
+
+/**
+ * facq_source_pace:
+ * @src: A #FacqSource object, it can be any type of source.
+ * @interval: The time between deadlines, in seconds.
+ *
+ * Sleeps until the next deadline. The first deadline is @interval seconds
+ * after the first call since facq_source_start(), and each following one
+ * @interval seconds after the previous one, so the time spent between the
+ * calls doesn't accumulate, unlike with facq_source_sleep(). The deadlines
+ * are computed from the first one, so rounding errors don't accumulate
+ * either.
+ *
+ * If the deadline has already passed the function returns without sleeping
+ * and counts an overrun, see facq_source_get_overruns(), so the source
+ * catches up. If it's late more than a second the deadlines start again
+ * from the current time.
+ *
+ * Returns: %TRUE if the deadline has been reached, %FALSE if the source has
+ * been interrupted, see facq_source_interrupt().
+ */
+gboolean facq_source_pace(FacqSource *src,gdouble interval)
+{
+	gint64 now = 0, deadline = 0;
+
+#if ENABLE_DEBUG
+	g_return_val_if_fail(FACQ_IS_SOURCE(src),FALSE);
+#endif
+	now = g_get_monotonic_time();
+	if(!src->priv->pace_start){
+		src->priv->pace_start = now;
+		src->priv->pace_ticks = 0;
+	}
+	src->priv->pace_ticks++;
+	deadline = src->priv->pace_start +
+		(gint64)(src->priv->pace_ticks*interval*G_USEC_PER_SEC);
+	if(deadline > now)
+		return facq_source_sleep_until(src,deadline);
+
+	src->priv->overruns++;
+	if(now - deadline > FACQ_SOURCE_PACE_MAX_LAG){
+		src->priv->pace_start = now;
+		src->priv->pace_ticks = 0;
+	}
+	return !g_atomic_int_get(&src->priv->interrupted);
+}
+
+/**
+ * facq_source_get_overruns:
+ * @src: A #FacqSource object, it can be any type of source.
+ *
+ * Returns: The number of deadlines missed by facq_source_pace() since the
+ * source was started.
+ */
+guint64 facq_source_get_overruns(const FacqSource *src)
+{
+	g_return_val_if_fail(FACQ_IS_SOURCE(src),0);
+
+	return src->priv->overruns;
+}
+
+/**
+ * facq_source_interrupt:
+ * @src: A #FacqSource object, it can be any type of source.
+ *
+ * Wakes up the thread sleeping in facq_source_sleep(), if any, and makes
+ * the following calls return immediately, until the source is started
+ * again with facq_source_start(). This function can be called from any
+ * thread, #FacqPipeline calls it when it's stopped.
+ */
+void facq_source_interrupt(FacqSource *src)
+{
+	g_return_if_fail(FACQ_IS_SOURCE(src));
+
+#if GLIB_MINOR_VERSION >= 32
+	g_mutex_lock(&src->priv->mutex);
+	g_atomic_int_set(&src->priv->interrupted,TRUE);
+	g_cond_broadcast(&src->priv->cond);
+	g_mutex_unlock(&src->priv->mutex);
+#else
+	g_mutex_lock(src->priv->mutex);
+	g_atomic_int_set(&src->priv->interrupted,TRUE);
+	g_cond_broadcast(src->priv->cond);
+	g_mutex_unlock(src->priv->mutex);
+#endif
+}
+
 /**
  * facq_source_free:
  * @src: A #FacqSource object, it can be any type of source.
@@ -59,6 +59,11 @@ const gchar *facq_source_get_description(const FacqSource *src);
 gboolean facq_source_get_started(const FacqSource *src);
 const FacqStreamData *facq_source_get_stream_data(const FacqSource *src);
 gboolean facq_source_needs_conv(FacqSource *src);
+gboolean facq_source_sleep(FacqSource *src,gint64 microseconds);
+gboolean facq_source_sleep_until(FacqSource *src,gint64 end_time);
+gboolean facq_source_pace(FacqSource *src,gdouble interval);
+guint64 facq_source_get_overruns(const FacqSource *src);
+void facq_source_interrupt(FacqSource *src);
 
 /* virtuals */
 void facq_source_to_file(FacqSource *src,GKeyFile *file,const gchar *group);
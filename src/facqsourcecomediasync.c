@@ -157,10 +157,10 @@
  *    <listitem>
  *     <para>
  *     Get the data for doing the conversion of the data from the device to real
- *     values. If the device can't be calibrated, the system needs for each
- *     channel the comedi_range, and maxdata, if the device can be calibrated we
- *     already have all the required data. This data is required by the
- *     <function>comedi_to_phys()</function> and <function>comedi_to_physical()</function> functions.
+ *     values. The system needs the maxdata of each channel, and if the device
+ *     can't be calibrated the comedi_range of each channel too, if the device
+ *     can be calibrated we already have the polynomials. With this data a
+ *     #FacqComediMiscConv is created with facq_comedi_misc_conv_new().
  *     </para>
  *    </listitem>
  *    <listitem>
@@ -202,9 +202,10 @@
  *   <title>facq_source_comedi_async_conv()</title>
  *    <para>
  *    Converts the data read in the facq_source_comedi_async_read() function to
- *    real values, using the <function>comedi_to_physical()</function> if the
+ *    real values, with facq_comedi_misc_conv_do(). The results are the same
+ *    than using <function>comedi_to_physical()</function> if the
  *    device can be calibrated or <function>comedi_to_phys()</function> if the
- *    device can't be calibrated.
+ *    device can't be calibrated, but using tables or vectorized polynomials.
  *    </para>
  *  </sect2>
  *  <sect2 id="stop">
@@ -272,6 +273,7 @@ struct _FacqSourceComediAsyncPrivate {
 	comedi_cmd *cmd;
 	comedi_range *rng;
 	lsampl_t *maxdata;
+	FacqComediMiscConv *conv;
 	gboolean can_poll;
 	GPollFD *pfd;
 	GIOChannel *channel;
@@ -379,19 +381,20 @@ static void facq_source_comedi_async_constructed(GObject *self)
 	n_channels = facq_stream_data_get_n_channels(stmd);
 	chanlist = facq_stream_data_get_chanlist(stmd);
 	
-	//if p is null the conversion will use
-	// comedi_to_phys, so we need each channel comedi_range,
-	// and each channel maxdata.
-	if(!source->priv->p){
+	//the conversion needs each channel maxdata, and if p is null
+	// the conversion is done like comedi_to_phys, so we need each
+	// channel comedi_range too.
+	source->priv->maxdata = g_new0(lsampl_t,n_channels);
+	if(!source->priv->p)
 		source->priv->rng = g_new0(comedi_range,n_channels);
-		source->priv->maxdata = g_new0(lsampl_t,n_channels);
-		for(i = 0;i < n_channels;i++){
-			chanspec = facq_chanlist_get_io_chanspec(chanlist,i);
-			facq_chanlist_chanspec_to_src_values(chanspec,
-							     &chan,
-							     &range,
-							     NULL,
-							     NULL);
+	for(i = 0;i < n_channels;i++){
+		chanspec = facq_chanlist_get_io_chanspec(chanlist,i);
+		facq_chanlist_chanspec_to_src_values(chanspec,
+						     &chan,
+						     &range,
+						     NULL,
+						     NULL);
+		if(!source->priv->p){
 			tmp = comedi_get_range(source->priv->dev,
 					       source->priv->subindex,
 					       chan,range);
@@ -405,22 +408,29 @@ static void facq_source_comedi_async_constructed(GObject *self)
 			source->priv->rng[i].unit = tmp->unit;
 			source->priv->rng[i].max = tmp->max;
 			source->priv->rng[i].min = tmp->min;
-			source->priv->maxdata[i] = 
-				comedi_get_maxdata(source->priv->dev,
-						   source->priv->subindex,
-						   chan);
-			if(source->priv->maxdata[i] == 0){
-				g_set_error_literal(&local_err,
-					FACQ_SOURCE_COMEDI_ASYNC_ERROR,
-						FACQ_SOURCE_COMEDI_ASYNC_ERROR_FAILED,
-						comedi_strerror(comedi_errno()));
-				goto error;
-			}
+		}
+		source->priv->maxdata[i] = 
+			comedi_get_maxdata(source->priv->dev,
+					   source->priv->subindex,
+					   chan);
+		if(source->priv->maxdata[i] == 0){
+			g_set_error_literal(&local_err,
+				FACQ_SOURCE_COMEDI_ASYNC_ERROR,
+					FACQ_SOURCE_COMEDI_ASYNC_ERROR_FAILED,
+					comedi_strerror(comedi_errno()));
+			goto error;
 		}
 	}
+	//precompute the conversion tables or polynomials
+	source->priv->conv =
+		facq_comedi_misc_conv_new(n_channels,
+					  facq_stream_data_get_bps(stmd),
+					  source->priv->maxdata,
+					  source->priv->p,
+					  source->priv->rng);
 	
 	/*---- Resume: at this point we have all the needed data, for the
-	 * conversions we have the polynomial array p, or rng+maxdata,
+	 * conversions we have the conv object,
 	 * if the device is pollable we have a GPollFD pfd. And we can
 	 * read data fromt the device using the GIOChannel channel ----*/
 
@@ -476,6 +486,10 @@ static void facq_source_comedi_async_constructed(GObject *self)
 		g_free(source->priv->rng);
 	if(source->priv->maxdata)
 		g_free(source->priv->maxdata);
+	if(source->priv->conv){
+		facq_comedi_misc_conv_free(source->priv->conv);
+		source->priv->conv = NULL;
+	}
 	if(source->priv->pfd)
 		g_free(source->priv->pfd);
 	if(source->priv->channel)
@@ -511,6 +525,9 @@ static void facq_source_comedi_async_finalize(GObject *self)
 	if(source->priv->maxdata)
 		g_free(source->priv->maxdata);
 
+	if(source->priv->conv)
+		facq_comedi_misc_conv_free(source->priv->conv);
+
 	if(source->priv->pfd)
 		g_free(source->priv->pfd);
 
@@ -606,6 +623,7 @@ static void facq_source_comedi_async_init(FacqSourceComediAsync *source)
 	source->priv->cmd = NULL;
 	source->priv->rng = NULL;
 	source->priv->maxdata = NULL;
+	source->priv->conv = NULL;
 	source->priv->can_poll = FALSE;
 	source->priv->pfd = NULL;
 	source->priv->channel = NULL;
@@ -768,6 +786,7 @@ FacqSourceComediAsync *facq_source_comedi_async_new(guint index,guint subindex,g
 	FacqUnits *units = NULL;
 	gdouble *max = NULL;
 	gdouble *min = NULL;
+	gdouble *scale = NULL, *offset = NULL;
 	gchar *devfilename = NULL;
 	comedi_t *dev = NULL;
 	GError *local_err = NULL;
@@ -886,6 +905,18 @@ FacqSourceComediAsync *facq_source_comedi_async_new(guint index,guint subindex,g
 		goto error;
 
 	stmd = facq_stream_data_new(bps,iochans_n,period,chanlist,units,max,min);
+
+	//if the conversion is linear the samples can be converted later
+	if(facq_comedi_misc_get_scale_offset(dev,subindex,chanlist,p,
+						&scale,&offset,&local_err))
+		facq_stream_data_set_format(stmd,
+				(bps == sizeof(lsampl_t)) ?
+					FACQ_SAMPLE_FORMAT_UINT32 :
+					FACQ_SAMPLE_FORMAT_UINT16,
+				scale,offset);
+	else if(local_err)
+		goto error;
+
 	source = FACQ_SOURCE_COMEDI_ASYNC(g_initable_new(FACQ_TYPE_SOURCE_COMEDI_ASYNC,NULL,err,
 					       "name",
 					       facq_resources_names_source_comedi_async(), 
@@ -1041,36 +1072,8 @@ GIOStatus facq_source_comedi_async_read(FacqSource *src,gchar *buf,gsize count,g
 void facq_source_comedi_async_conv(FacqSource *src,gpointer ori,gdouble *dst,gsize samples)
 {
 	FacqSourceComediAsync *source = FACQ_SOURCE_COMEDI_ASYNC(src);
-	const FacqStreamData *stmd = NULL;
-	guint bps = 0, n_channels = 0, i = 0, j = 0;
-	lsampl_t sample = 0;
-	gsize slices = 0;
-	gpointer slice = NULL;
-	gdouble *row = NULL;
 
-	stmd = facq_source_get_stream_data(src);
-	bps = facq_stream_data_get_bps(stmd);
-	n_channels = facq_stream_data_get_n_channels(stmd);
-	slices = samples/n_channels;
-
-	for(j = 0;j < slices;j++){
-		slice = ori+(j*bps*n_channels);
-		row = dst+(j*n_channels);
-		for(i = 0; i < n_channels;i++){
-			g_memmove(&sample,slice+(i*bps),bps);
-			//The device is soft/hard calibrated
-			if(source->priv->p){
-				row[i] = comedi_to_physical(sample,
-						&source->priv->p[i]);
-			}
-			//The device can't be calibrated
-			else {
-				row[i] = comedi_to_phys(sample,
-						&source->priv->rng[i],
-							source->priv->maxdata[i]);
-			}
-		}
-	}
+	facq_comedi_misc_conv_do(source->priv->conv,ori,dst,samples);
 }
 
 /**
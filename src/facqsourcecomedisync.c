@@ -438,6 +438,7 @@ FacqSourceComediSync *facq_source_comedi_sync_new(guint index,guint subindex,gdo
 	FacqUnits *units = NULL;
 	gdouble *max = NULL;
 	gdouble *min = NULL;
+	gdouble *scale = NULL, *offset = NULL;
 	gchar *devfilename = NULL;
 	comedi_t *dev = NULL;
 	GError *local_err = NULL;
@@ -546,6 +547,13 @@ FacqSourceComediSync *facq_source_comedi_sync_new(guint index,guint subindex,gdo
 	min[0] = rng->min;
 	
 	stmd = facq_stream_data_new(sizeof(lsampl_t),1,period,chanlist,units,max,min);
+
+	//comedi_to_phys() is linear, the samples can be converted later
+	if(!facq_comedi_misc_get_scale_offset(dev,subindex,chanlist,NULL,
+						&scale,&offset,&local_err))
+		goto error;
+	facq_stream_data_set_format(stmd,FACQ_SAMPLE_FORMAT_UINT32,scale,offset);
+
 	source = FACQ_SOURCE_COMEDI_SYNC(g_initable_new(FACQ_TYPE_SOURCE_COMEDI_SYNC,NULL,err,
 					       "name",
 					       facq_resources_names_source_comedi_sync(), 
@@ -616,10 +624,11 @@ gboolean facq_source_comedi_sync_start(FacqSource *src,GError **err)
  * Reads data from the source, (A maximum of @count bytes) putting it in the
  * memory area pointed by @buf. When the function returns the control the number
  * of bytes read will be written to @bytes_read.
- * Note that the function will block until all the requested bytes are read.
+ * Note that the function will block until all the requested bytes are read,
+ * or until facq_source_interrupt() is called.
  *
- * Returns: %G_IO_STATUS_NORMAL if successful, %G_IO_STATUS_ERROR in case of
- * error.
+ * Returns: %G_IO_STATUS_NORMAL if successful, %G_IO_STATUS_AGAIN if the
+ * source has been interrupted, %G_IO_STATUS_ERROR in case of error.
  */
 GIOStatus facq_source_comedi_sync_read(FacqSource *src,gchar *buf,gsize count,gsize *bytes_read,GError **err)
 {
@@ -642,8 +651,13 @@ GIOStatus facq_source_comedi_sync_read(FacqSource *src,gchar *buf,gsize count,gs
 	data = (lsampl_t *)buf;
 
 	for(i = 0;i < count/stmd->bps;i++){
-		/* we must sleep once for each read */
-		g_usleep(stmd->period*G_USEC_PER_SEC);
+		/* we must wait for the deadline of each read, the data read is
+		 * discarded if the source is interrupted, the pipeline is
+		 * stopping */
+		if(!facq_source_pace(src,stmd->period)){
+			*bytes_read = 0;
+			return G_IO_STATUS_AGAIN;
+		}
 
 		/* read one sample */
 		if( comedi_data_read(source->priv->dev,
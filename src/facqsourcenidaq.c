@@ -558,7 +558,8 @@ gint facq_source_nidaq_poll(FacqSource *src)
 	srcnidaq = FACQ_SOURCE_NIDAQ(src);
 
 	if(srcnidaq->priv->sleep_us){
-		g_usleep(srcnidaq->priv->sleep_us);
+		if(!facq_source_sleep(src,srcnidaq->priv->sleep_us))
+			return 0;
 
 		availSampPerChan = 
 			facq_nidaq_task_get_read_avail_samples_per_chan(srcnidaq->priv->task,
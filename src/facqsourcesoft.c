@@ -66,6 +66,13 @@
  * generator and won't be a periodic signal (It shouldn't be if you are
  * lucky enough).
  *
+ * #FacqSourceSoft can also be used as a synthetic load, to measure how many
+ * samples per second the rest of the pipeline can sustain. With
+ * facq_source_soft_set_speed() the data is generated a number of times faster
+ * than the sampling period says, or as fast as possible with a speed of 0.
+ * With facq_source_soft_set_seed() the random waveform is generated with a
+ * fixed seed, so each time the source is started the same data is generated.
+ *
  * For creating a new #FacqSourceSoft you must call facq_source_soft_new(), 
  * to use it you must call first facq_source_start(), and then you must call 
  * in an iterative way facq_source_soft_poll() and facq_source_soft_read(), 
@@ -121,7 +128,9 @@ enum {
 	PROP_0,
 	PROP_AMPLITUDE,
 	PROP_FUNC,
-	PROP_FUNC_PERIOD
+	PROP_FUNC_PERIOD,
+	PROP_SPEED,
+	PROP_SEED
 };
 
 struct _FacqSourceSoftPrivate {
@@ -132,6 +141,8 @@ struct _FacqSourceSoftPrivate {
 	guint64 iter;
 	gdouble func_period;
 	gsize multiplier;
+	gdouble speed;
+	guint32 seed;
 };
 
 GQuark facq_source_soft_error_quark(void)
@@ -151,6 +162,10 @@ static void facq_source_soft_get_property(GObject *self,guint property_id,GValue
 	break;
 	case PROP_FUNC_PERIOD: g_value_set_double(value,softsrc->priv->func_period);
 	break;
+	case PROP_SPEED: g_value_set_double(value,softsrc->priv->speed);
+	break;
+	case PROP_SEED: g_value_set_uint(value,softsrc->priv->seed);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID(softsrc,property_id,pspec);
 	}
@@ -167,6 +182,10 @@ static void facq_source_soft_set_property(GObject *self,guint property_id,const
 	break;
 	case PROP_FUNC_PERIOD: softsrc->priv->func_period = g_value_get_double(value);
 	break;
+	case PROP_SPEED: softsrc->priv->speed = g_value_get_double(value);
+	break;
+	case PROP_SEED: softsrc->priv->seed = g_value_get_uint(value);
+	break;
 	default:
 	G_OBJECT_WARN_INVALID_PROPERTY_ID(softsrc,property_id,pspec);
 	}
@@ -177,8 +196,12 @@ static void facq_source_soft_constructed(GObject *self)
 	FacqSourceSoft *softsrc = FACQ_SOURCE_SOFT(self);
 	const FacqStreamData *stmd = NULL;
 
-	if(softsrc->priv->func == FACQ_FUNC_TYPE_RAN)
-		softsrc->priv->rand = g_rand_new();
+	if(softsrc->priv->func == FACQ_FUNC_TYPE_RAN){
+		if(softsrc->priv->seed)
+			softsrc->priv->rand = g_rand_new_with_seed(softsrc->priv->seed);
+		else
+			softsrc->priv->rand = g_rand_new();
+	}
 
 	stmd = facq_source_get_stream_data(FACQ_SOURCE(softsrc));
 	if(stmd->period < 1){
@@ -219,7 +242,7 @@ static void facq_source_soft_class_init(FacqSourceSoftClass *klass)
 
 	/* override source class virtual methods */
 	source_class->srcsave = facq_source_soft_to_file;
-	source_class->srcstart = NULL;
+	source_class->srcstart = facq_source_soft_start;
 	source_class->srcpoll = facq_source_soft_poll;
 	source_class->srcread = facq_source_soft_read;
 	source_class->srcconv = NULL;
@@ -258,6 +281,28 @@ static void facq_source_soft_class_init(FacqSourceSoftClass *klass)
 							  G_PARAM_READWRITE |
 							  G_PARAM_CONSTRUCT_ONLY |
 							  G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_SPEED,
+					g_param_spec_double("speed",
+							    "Speed",
+							    "How many times faster than real time the data is generated, 0 means as fast as possible",
+							    0,
+							    G_MAXDOUBLE,
+							    1,
+							    G_PARAM_READWRITE |
+							    G_PARAM_CONSTRUCT |
+							    G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_SEED,
+					g_param_spec_uint("seed",
+							  "Seed",
+							  "The seed of the random waveform, 0 means a random seed",
+							  0,
+							  G_MAXUINT32,
+							  0,
+							  G_PARAM_READWRITE |
+							  G_PARAM_CONSTRUCT |
+							  G_PARAM_STATIC_STRINGS));
 }
 
 static void facq_source_soft_init(FacqSourceSoft *softsrc)
@@ -268,6 +313,8 @@ static void facq_source_soft_init(FacqSourceSoft *softsrc)
 	softsrc->priv->func = 0;
 	softsrc->priv->func_period = 0;
 	softsrc->priv->multiplier = 1;
+	softsrc->priv->speed = 1;
+	softsrc->priv->seed = 0;
 }
 
 /*****--- Public methods ---*****/
@@ -278,8 +325,9 @@ static void facq_source_soft_init(FacqSourceSoft *softsrc)
  * @group: The group name in the @file, #GKeyFile.
  *
  * Implements the facq_source_to_file() method.
- * Stores the function type, the amplitude, the period, the wave period, and the
- * number of channels in the requested group name, inside a #GKeyFile.
+ * Stores the function type, the amplitude, the period, the wave period, the
+ * number of channels, the speed and the seed in the requested group name,
+ * inside a #GKeyFile.
  * This is used by facq_stream_save() function, and you shouldn't need to call
  * this.
  */
@@ -294,6 +342,8 @@ void facq_source_soft_to_file(FacqSource *src,GKeyFile *file,const gchar *group)
 	g_key_file_set_double(file,group,"period",stmd->period);
 	g_key_file_set_double(file,group,"wave-period",srcsoft->priv->func_period);
 	g_key_file_set_double(file,group,"n-channels",stmd->n_channels);
+	g_key_file_set_double(file,group,"speed",srcsoft->priv->speed);
+	g_key_file_set_double(file,group,"seed",srcsoft->priv->seed);
 }
 
 /**
@@ -312,8 +362,10 @@ void facq_source_soft_to_file(FacqSource *src,GKeyFile *file,const gchar *group)
 gpointer facq_source_soft_key_constructor(const gchar *group_name,GKeyFile *key_file,GError **err)
 {
 	FacqFuncType fun = 0;
-	gdouble amplitude = 0, period = 0, wave_period = 0;
+	gdouble amplitude = 0, period = 0, wave_period = 0, speed = 1;
 	guint32 n_channels = 0;
+	gdouble seed = 0;
+	FacqSourceSoft *srcsoft = NULL;
 	GError *local_err = NULL;
 
 	fun = g_key_file_get_integer(key_file,group_name,"function",&local_err);
@@ -336,7 +388,36 @@ gpointer facq_source_soft_key_constructor(const gchar *group_name,GKeyFile *key_
 	if(local_err)
 		goto error;
 
-	return facq_source_soft_new(fun,amplitude,wave_period,period,n_channels,err);
+	/* speed and seed are optional, older files don't have them */
+	if(g_key_file_has_key(key_file,group_name,"speed",NULL)){
+		speed = g_key_file_get_double(key_file,group_name,"speed",&local_err);
+		if(local_err)
+			goto error;
+		if(speed < 0){
+			g_set_error(&local_err,FACQ_SOURCE_SOFT_ERROR,
+					FACQ_SOURCE_SOFT_ERROR_FAILED,
+						"Invalid speed %g",speed);
+			goto error;
+		}
+	}
+	if(g_key_file_has_key(key_file,group_name,"seed",NULL)){
+		seed = g_key_file_get_double(key_file,group_name,"seed",&local_err);
+		if(local_err)
+			goto error;
+		if(seed < 0 || seed > G_MAXUINT32 || seed != (guint32)seed){
+			g_set_error(&local_err,FACQ_SOURCE_SOFT_ERROR,
+					FACQ_SOURCE_SOFT_ERROR_FAILED,
+						"Invalid seed %g",seed);
+			goto error;
+		}
+	}
+
+	srcsoft = facq_source_soft_new(fun,amplitude,wave_period,period,n_channels,err);
+	if(srcsoft){
+		facq_source_soft_set_speed(srcsoft,speed);
+		facq_source_soft_set_seed(srcsoft,(guint32)seed);
+	}
+	return srcsoft;
 
 	error:
 	if(local_err){
@@ -443,6 +524,66 @@ FacqSourceSoft *facq_source_soft_new(FacqFuncType fun,gdouble amplitude,gdouble
 					       NULL));
 }
 
+/**
+ * facq_source_soft_set_speed:
+ * @srcsoft: A #FacqSourceSoft object.
+ * @speed: How many times faster than real time the data is generated, or 0
+ * to generate it as fast as possible.
+ *
+ * Sets the speed of the source, by default 1, that is, the data is generated
+ * at the sampling period. Other values make the source useful to measure the
+ * capacity of the pipeline, the operations and the sinks. Note that the
+ * stream data still reports the original sampling period.
+ */
+void facq_source_soft_set_speed(FacqSourceSoft *srcsoft,gdouble speed)
+{
+	g_return_if_fail(FACQ_IS_SOURCE_SOFT(srcsoft));
+	g_return_if_fail(speed >= 0);
+
+	srcsoft->priv->speed = speed;
+}
+
+/**
+ * facq_source_soft_set_seed:
+ * @srcsoft: A #FacqSourceSoft object.
+ * @seed: The seed for the random waveform, or 0 for a random seed.
+ *
+ * Sets the seed used to generate the random waveform. With a seed other than
+ * 0 the generator is seeded again each time the source is started, so the
+ * same data is generated in each run. It has no effect in other waveforms.
+ */
+void facq_source_soft_set_seed(FacqSourceSoft *srcsoft,guint32 seed)
+{
+	g_return_if_fail(FACQ_IS_SOURCE_SOFT(srcsoft));
+
+	srcsoft->priv->seed = seed;
+	if(srcsoft->priv->rand && seed)
+		g_rand_set_seed(srcsoft->priv->rand,seed);
+}
+
+/**
+ * facq_source_soft_start:
+ * @src: A #FacqSourceSoft casted to #FacqSource.
+ * @err: (allow-none): A #GError, it's not used.
+ *
+ * Implements facq_source_start() from #FacqSource.
+ * If a seed has been set, see facq_source_soft_set_seed(), the waveform is
+ * generated again from the beginning.
+ *
+ * Returns: %TRUE.
+ */
+gboolean facq_source_soft_start(FacqSource *src,GError **err)
+{
+	FacqSourceSoft *srcsoft = FACQ_SOURCE_SOFT(src);
+
+	if(srcsoft->priv->seed){
+		srcsoft->priv->iter = 0;
+		if(srcsoft->priv->rand)
+			g_rand_set_seed(srcsoft->priv->rand,srcsoft->priv->seed);
+	}
+	return TRUE;
+}
+
 /**
  * facq_source_soft_poll:
  * @src: A #FacqSourceSoft casted to @FacqSource.
@@ -450,9 +591,12 @@ FacqSourceSoft *facq_source_soft_new(FacqFuncType fun,gdouble amplitude,gdouble
  * Implements facq_source_poll() from #FacqSource.
  * Polls the source to check if new data it's ready to be read from the source.
  * Because this kind of source doesn't use real hardware, it's simple an elegant
- * way of calling g_usleep().
+ * way of calling facq_source_pace(), so the chunks are generated at the
+ * sampling rate even if the pipeline needs some time to process them, or at
+ * the rate set with facq_source_soft_set_speed().
  *
- * Returns: This type of source always returns 1.
+ * Returns: 1, or 0 if the source has been interrupted, see
+ * facq_source_interrupt().
  */
 gint facq_source_soft_poll(FacqSource *src)
 {
@@ -466,7 +610,12 @@ gint facq_source_soft_poll(FacqSource *src)
 	period = stmd->period;
 	srcsoft = FACQ_SOURCE_SOFT(src);
 
-	g_usleep(period*G_USEC_PER_SEC*srcsoft->priv->multiplier);
+	/* as fast as possible, only check if the source is interrupted */
+	if(srcsoft->priv->speed == 0)
+		return facq_source_sleep(src,0) ? 1 : 0;
+
+	if(!facq_source_pace(src,period*srcsoft->priv->multiplier/srcsoft->priv->speed))
+		return 0;
 
 	return 1;
 }
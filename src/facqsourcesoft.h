@@ -67,7 +67,10 @@ void facq_source_soft_to_file(FacqSource *src,GKeyFile *file,const gchar *group)
 gpointer facq_source_soft_key_constructor(const gchar *group_name,GKeyFile *key_file,GError **err);
 gpointer facq_source_soft_constructor(const GPtrArray *user_input,GError **err);
 FacqSourceSoft *facq_source_soft_new(FacqFuncType fun,gdouble amplitude,gdouble wave_period,gdouble period,guint n_channels,GError **error);
+void facq_source_soft_set_speed(FacqSourceSoft *srcsoft,gdouble speed);
+void facq_source_soft_set_seed(FacqSourceSoft *srcsoft,guint32 seed);
 /* virtual implementations */
+gboolean facq_source_soft_start(FacqSource *src,GError **err);
 gint facq_source_soft_poll(FacqSource *src);
 GIOStatus facq_source_soft_read(FacqSource *src,gchar *buf,gsize count,gsize *bytes_read,GError **err);
 void facq_source_soft_free(FacqSource *src);
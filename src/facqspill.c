@@ -0,0 +1,328 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#include <glib.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include <errno.h>
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "facqchunk.h"
+#include "facqspill.h"
+
+/* used bytes, sequence number and timestamp */
+#define FACQ_SPILL_HEADER_LEN 3
+
+/**
+ * SECTION:facqspill
+ * @short_description: A FIFO queue of chunks stored on disk.
+ * @include:facqspill.h
+ * @see_also: #FacqChunk,#FacqPipeline
+ *
+ * A #FacqSpill stores the data of #FacqChunk objects in a temporary file, so it
+ * can be recovered later in the same order. It's used by #FacqPipeline when the
+ * ring buffer is full, to avoid losing data when the consumer can't keep up
+ * with the source for some time.
+ *
+ * Create a new #FacqSpill with facq_spill_new(), store the data of a chunk
+ * with facq_spill_push() and recover it in a empty chunk with
+ * facq_spill_pop(). facq_spill_get_length() returns the number of chunks
+ * stored, and facq_spill_clear() discards all of them. When the #FacqSpill
+ * is no longer needed destroy it with facq_spill_free(), the temporary file
+ * will be deleted.
+ *
+ * Each chunk is stored as a header with the number of used bytes, the sequence
+ * number and the timestamp of the chunk, followed by the data.
+ * When all the chunks have been recovered the file is reused from the
+ * start, so the file only grows while the backlog grows.
+ *
+ * A #FacqSpill object is not thread safe, it should be used by a single
+ * thread.
+ */
+
+/**
+ * FacqSpill:
+ *
+ * Contains the private details of the #FacqSpill.
+ */
+
+/**
+ * FacqSpillClass:
+ *
+ * Class for the #FacqSpill objects.
+ */
+
+/**
+ * FacqSpillError:
+ * @FACQ_SPILL_ERROR_FAILED: Some error happened in the #FacqSpill.
+ *
+ * Enum values for errors in #FacqSpill.
+ */
+
+static void facq_spill_initable_iface_init(GInitableIface  *iface);
+static gboolean facq_spill_initable_init(GInitable *initable,GCancellable *cancellable,GError **error);
+
+G_DEFINE_TYPE_WITH_CODE(FacqSpill,facq_spill,G_TYPE_OBJECT,G_IMPLEMENT_INTERFACE(G_TYPE_INITABLE,facq_spill_initable_iface_init));
+
+GQuark facq_spill_error_quark(void)
+{
+	return g_quark_from_static_string("facq-spill-error-quark");
+}
+
+struct _FacqSpillPrivate {
+	GError *construct_error;
+	gchar *filename;
+	gint fd;
+	gint64 read_offset;
+	gint64 write_offset;
+	guint n_chunks;
+};
+
+/* Private methods */
+static gboolean facq_spill_io(FacqSpill *spill,gboolean write_op,gint64 offset,gpointer data,gsize len,GError **err)
+{
+	gchar *pos = (gchar *)data;
+	gssize ret = -1;
+
+	if(lseek(spill->priv->fd,offset,SEEK_SET) < 0)
+		goto error;
+	while(len){
+		if(write_op)
+			ret = write(spill->priv->fd,pos,len);
+		else
+			ret = read(spill->priv->fd,pos,len);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			goto error;
+		pos += ret;
+		len -= ret;
+	}
+	return TRUE;
+
+	error:
+	g_set_error(err,FACQ_SPILL_ERROR,FACQ_SPILL_ERROR_FAILED,
+			"Error %s the spill file: %s",
+			(write_op) ? "writing" : "reading",
+			(ret == 0) ? "Unexpected end of file" : g_strerror(errno));
+	return FALSE;
+}
+
+/* GObject magic */
+static void facq_spill_finalize(GObject *self)
+{
+	FacqSpill *spill = FACQ_SPILL(self);
+
+	g_clear_error(&spill->priv->construct_error);
+
+	if(spill->priv->fd >= 0)
+		close(spill->priv->fd);
+	if(spill->priv->filename){
+		g_unlink(spill->priv->filename);
+		g_free(spill->priv->filename);
+	}
+
+	if(G_OBJECT_CLASS(facq_spill_parent_class)->finalize)
+    		(*G_OBJECT_CLASS(facq_spill_parent_class)->finalize)(self);
+}
+
+static void facq_spill_constructed(GObject *self)
+{
+	FacqSpill *spill = FACQ_SPILL(self);
+
+	spill->priv->fd = g_file_open_tmp("freeacq-spill-XXXXXX",
+					  &spill->priv->filename,
+					  &spill->priv->construct_error);
+}
+
+static void facq_spill_class_init(FacqSpillClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+	g_type_class_add_private(klass,sizeof(FacqSpillPrivate));
+
+	object_class->finalize = facq_spill_finalize;
+	object_class->constructed = facq_spill_constructed;
+}
+
+static void facq_spill_init(FacqSpill *spill)
+{
+	spill->priv = G_TYPE_INSTANCE_GET_PRIVATE(spill,FACQ_TYPE_SPILL,FacqSpillPrivate);
+	spill->priv->construct_error = NULL;
+	spill->priv->filename = NULL;
+	spill->priv->fd = -1;
+	spill->priv->read_offset = 0;
+	spill->priv->write_offset = 0;
+	spill->priv->n_chunks = 0;
+}
+
+/* GInitable interface */
+static void facq_spill_initable_iface_init(GInitableIface *iface)
+{
+	iface->init = facq_spill_initable_init;
+}
+
+static gboolean facq_spill_initable_init(GInitable *initable,GCancellable *cancellable,GError  **error)
+{
+	FacqSpill *spill;
+
+	g_return_val_if_fail(FACQ_IS_SPILL(initable),FALSE);
+	spill = FACQ_SPILL(initable);
+	if(cancellable != NULL){
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			"Cancellable initialization not supported");
+		return FALSE;
+	}
+	if(spill->priv->construct_error){
+		if(error)
+			*error = g_error_copy(spill->priv->construct_error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Public methods */
+
+/**
+ * facq_spill_new:
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Creates a new #FacqSpill object, creating a new temporary file in the
+ * directory returned by g_get_tmp_dir().
+ *
+ * Returns: A new #FacqSpill or %NULL in case of error.
+ */
+FacqSpill *facq_spill_new(GError **err)
+{
+	return g_initable_new(FACQ_TYPE_SPILL,NULL,err,NULL);
+}
+
+/**
+ * facq_spill_push:
+ * @spill: A #FacqSpill object.
+ * @chunk: A #FacqChunk object, it's not modified.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Appends the data in @chunk to the end of the queue.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case, for example if the disk
+ * is full.
+ */
+gboolean facq_spill_push(FacqSpill *spill,const FacqChunk *chunk,GError **err)
+{
+	guint64 header[FACQ_SPILL_HEADER_LEN];
+
+	g_return_val_if_fail(FACQ_IS_SPILL(spill),FALSE);
+	g_return_val_if_fail(chunk != NULL,FALSE);
+
+	header[0] = facq_chunk_get_used_bytes(chunk);
+	header[1] = facq_chunk_get_sequence(chunk);
+	header[2] = (guint64)facq_chunk_get_timestamp(chunk);
+	if(!facq_spill_io(spill,TRUE,spill->priv->write_offset,
+				header,sizeof(header),err))
+		return FALSE;
+	if(!facq_spill_io(spill,TRUE,spill->priv->write_offset+sizeof(header),
+				chunk->data,header[0],err))
+		return FALSE;
+	spill->priv->write_offset += sizeof(header) + header[0];
+	spill->priv->n_chunks++;
+	return TRUE;
+}
+
+/**
+ * facq_spill_pop:
+ * @spill: A #FacqSpill object, not empty.
+ * @chunk: An empty #FacqChunk object, big enough for the stored data.
+ * @err: #GError for error reporting or %NULL to ignore.
+ *
+ * Recovers the data at the start of the queue, writing it to @chunk.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_spill_pop(FacqSpill *spill,FacqChunk *chunk,GError **err)
+{
+	guint64 header[FACQ_SPILL_HEADER_LEN];
+
+	g_return_val_if_fail(FACQ_IS_SPILL(spill),FALSE);
+	g_return_val_if_fail(chunk != NULL,FALSE);
+	g_return_val_if_fail(spill->priv->n_chunks,FALSE);
+
+	if(!facq_spill_io(spill,FALSE,spill->priv->read_offset,
+				header,sizeof(header),err))
+		return FALSE;
+	if(header[0] > facq_chunk_get_free_bytes(chunk)){
+		g_set_error_literal(err,FACQ_SPILL_ERROR,FACQ_SPILL_ERROR_FAILED,
+				"The chunk is too small for the spilled data");
+		return FALSE;
+	}
+	if(!facq_spill_io(spill,FALSE,spill->priv->read_offset+sizeof(header),
+				facq_chunk_write_pos(chunk),header[0],err))
+		return FALSE;
+	facq_chunk_add_used_bytes(chunk,header[0]);
+	facq_chunk_set_sequence(chunk,header[1]);
+	facq_chunk_set_timestamp(chunk,(gint64)header[2]);
+	spill->priv->read_offset += sizeof(header) + header[0];
+	spill->priv->n_chunks--;
+	if(!spill->priv->n_chunks)
+		facq_spill_clear(spill);
+	return TRUE;
+}
+
+/**
+ * facq_spill_get_length:
+ * @spill: A #FacqSpill object.
+ *
+ * Returns: The number of chunks stored in the @spill.
+ */
+guint facq_spill_get_length(const FacqSpill *spill)
+{
+	g_return_val_if_fail(FACQ_IS_SPILL(spill),0);
+
+	return spill->priv->n_chunks;
+}
+
+/**
+ * facq_spill_clear:
+ * @spill: A #FacqSpill object.
+ *
+ * Discards all the chunks stored in the @spill, the temporary file will be
+ * reused from the start.
+ */
+void facq_spill_clear(FacqSpill *spill)
+{
+	g_return_if_fail(FACQ_IS_SPILL(spill));
+
+	spill->priv->read_offset = 0;
+	spill->priv->write_offset = 0;
+	spill->priv->n_chunks = 0;
+}
+
+/**
+ * facq_spill_free:
+ * @spill: A #FacqSpill object.
+ *
+ * Destroys the #FacqSpill, @spill, deleting the temporary file.
+ */
+void facq_spill_free(FacqSpill *spill)
+{
+	g_return_if_fail(FACQ_IS_SPILL(spill));
+	g_object_unref(G_OBJECT(spill));
+}
@@ -0,0 +1,64 @@
+/*
+ * freeacq is the legal property of Víctor Enríquez Miguel. 
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ * 
+ */
+#ifndef _FREEACQ_SPILL_H_
+#define _FREEACQ_SPILL_H_
+
+G_BEGIN_DECLS
+
+#define FACQ_SPILL_ERROR facq_spill_error_quark()
+
+#define FACQ_TYPE_SPILL (facq_spill_get_type ())
+#define FACQ_SPILL(inst) (G_TYPE_CHECK_INSTANCE_CAST ((inst),FACQ_TYPE_SPILL, FacqSpill))
+#define FACQ_SPILL_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST ((klass),FACQ_TYPE_SPILL, FacqSpillClass))
+#define FACQ_IS_SPILL(inst) (G_TYPE_CHECK_INSTANCE_TYPE ((inst),FACQ_TYPE_SPILL))
+#define FACQ_IS_SPILL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_SPILL))
+#define FACQ_SPILL_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_SPILL, FacqSpillClass))
+
+typedef struct _FacqSpill FacqSpill;
+typedef struct _FacqSpillClass FacqSpillClass;
+typedef struct _FacqSpillPrivate FacqSpillPrivate;
+
+typedef enum {
+	FACQ_SPILL_ERROR_FAILED
+} FacqSpillError;
+
+struct _FacqSpill {
+	/*< private >*/
+	GObject parent_instance;
+	FacqSpillPrivate *priv;
+};
+
+struct _FacqSpillClass {
+	/*< private >*/
+	GObjectClass parent_class;
+};
+
+GType facq_spill_get_type(void) G_GNUC_CONST;
+
+FacqSpill *facq_spill_new(GError **err);
+gboolean facq_spill_push(FacqSpill *spill,const FacqChunk *chunk,GError **err);
+gboolean facq_spill_pop(FacqSpill *spill,FacqChunk *chunk,GError **err);
+guint facq_spill_get_length(const FacqSpill *spill);
+void facq_spill_clear(FacqSpill *spill);
+void facq_spill_free(FacqSpill *spill);
+
+G_END_DECLS
+
+#endif
@@ -77,6 +77,49 @@
  * facq_stream_set_name(), to get the name from the stream you can use
  * facq_stream_get_name().
  *
+ * The size of each chunk and the number of chunks in the ring buffer are
+ * derived, when the stream is started, from the stream latency and memory
+ * budget. The latency is the amount of time, in seconds, covered by each
+ * chunk, and can be set with facq_stream_set_latency(). The memory budget is
+ * the maximum amount of memory, in MiB, that the chunks of the ring buffer can
+ * use, and can be set with facq_stream_set_memory_budget(). If the ring size
+ * requested in facq_stream_new() doesn't fit in the budget less chunks are
+ * used, and if not even two chunks fit, the chunks are made smaller. The
+ * budget only covers the ring buffer, the chunks of the same size used out of
+ * it, by the staged operations, the extra sinks, the overflow policies and the
+ * converter thread, are not counted.
+ *
+ * With facq_stream_set_staged() each operation can run in its own thread, so
+ * a slow operation doesn't stall the rest of the stream, see #FacqPipeline for
+ * more details.
+ *
+ * If the stream has many channels, facq_stream_set_op_threads() lets the
+ * channel independent operations use more than one thread, see
+ * facq_pipeline_set_op_threads().
+ *
+ * With facq_stream_set_native_samples() the samples of the sources that
+ * support it, like the comedi ones, are kept in their native format until
+ * they leave the ring buffer, see facq_pipeline_set_native_samples().
+ * Else facq_stream_set_conv_thread() moves the conversion of the samples out
+ * of the thread reading the source, see facq_pipeline_set_conv_thread().
+ *
+ * For long recordings facq_stream_set_locked_memory() allocates the ring
+ * buffer in memory locked in RAM, when the system allows it, see
+ * facq_pipeline_set_locked_memory().
+ *
+ * The policy followed when the ring buffer is full, because the operations or
+ * the sink can't keep up with the source, can be set with
+ * facq_stream_set_overflow(), see #FacqPipelineOverflow. By default the
+ * source waits, that could make the hardware buffers overflow, other policies
+ * drop data or spill it to disk, so the acquisition never stalls.
+ *
+ * After closing the stream more sinks can be added with facq_stream_add_tee(),
+ * each one with its own #FacqPipelineOverflow policy, so the same data can be
+ * written for example to a file and to a live view at the same time. The
+ * number of extra sinks can be obtained with facq_stream_get_tee_num() and
+ * the n-esim one with facq_stream_get_tee(). They are destroyed with
+ * facq_stream_remove_tees(), or when the sink is removed.
+ *
  * Another way of creating a #FacqStream object is using an ini like file stored
  * on the filesystem. You can use facq_stream_load() for creating a new
  * #FacqStream from one of this files, and facq_stream_save() for creating one
@@ -105,6 +148,23 @@
  * <programlisting>
  * [Stream]
  * name=Untitled stream
+ * # Optional, maximum MiB used by the ring buffer chunks (0 means no limit,
+ * # the queues of staged operations, extra sinks and the converter thread are
+ * # not counted) and seconds of data per chunk.
+ * memory-budget=64
+ * latency=0.02
+ * # Optional, run each operation in its own thread.
+ * staged=false
+ * # Optional, lock the ring buffer in RAM.
+ * locked-memory=false
+ * # Optional, threads used by the channel independent operations.
+ * op-threads=1
+ * # Optional, keep the samples in the source format in the ring buffer.
+ * native-samples=false
+ * # Optional, convert the samples in their own thread.
+ * conv-thread=false
+ * # Optional, #FacqPipelineOverflow policy used when the ring buffer is full.
+ * overflow=0
  *
  * # This is a valid comment.
  * 
@@ -127,6 +187,22 @@
  * [Null,2]
  * </programlisting>
  * </informalexample>
+ * If the stream has extra sinks, added with facq_stream_add_tee(), the
+ * Stream group contains the number of them in the tees key, and they are
+ * stored after the sink, each one with the overflow policy of the sink:
+ * <informalexample>
+ * <programlisting>
+ * [Stream]
+ * name=Untitled stream
+ * tees=1
+ * ...
+ * [Null,2]
+ *
+ * # An extra sink, overflow=1 means FACQ_PIPELINE_OVERFLOW_DROP_NEWEST
+ * [Null,3]
+ * overflow=1
+ * </programlisting>
+ * </informalexample>
  * </para>
  * </sect1>
  */
@@ -153,6 +229,10 @@
 
 G_DEFINE_TYPE(FacqStream,facq_stream,G_TYPE_OBJECT);
 
+#define FACQ_STREAM_DEF_MEMORY_BUDGET 64
+#define FACQ_STREAM_DEF_LATENCY 1
+#define FACQ_STREAM_MAX_OP_THREADS 64
+
 enum {
 	PROP_0,
 	PROP_STREAM_NAME,
@@ -160,6 +240,14 @@ enum {
 	PROP_MONITOR_DATA,
 	PROP_MONITOR_ERROR_CB,
 	PROP_MONITOR_STOP_CB,
+	PROP_MEMORY_BUDGET,
+	PROP_LATENCY,
+	PROP_STAGED,
+	PROP_OVERFLOW,
+	PROP_LOCKED_MEMORY,
+	PROP_OP_THREADS,
+	PROP_NATIVE_SAMPLES,
+	PROP_CONV_THREAD
 };
 
 struct _FacqStreamPrivate {
@@ -173,8 +261,27 @@ struct _FacqStreamPrivate {
 	FacqPipelineMonitorCb error_cb;
 	FacqPipeline *p;
 	guint ring_chunks;
+	guint memory_budget;
+	gdouble latency;
+	gboolean staged;
+	gboolean locked_memory;
+	guint op_threads;
+	gboolean native_samples;
+	gboolean conv_thread;
+	FacqPipelineOverflow overflow;
+	GArray *tees;
 };
 
+/*
+ * FacqStreamTee:
+ *
+ * An extra sink of the stream and its overflow policy.
+ */
+typedef struct _FacqStreamTee {
+	FacqSink *sink;
+	FacqPipelineOverflow overflow;
+} FacqStreamTee;
+
 GQuark facq_stream_error_quark(void)
 {
 	return g_quark_from_static_string("facq-stream-error-quark");
@@ -185,7 +292,7 @@ GQuark facq_stream_error_quark(void)
 static GString *facq_stream_save_get_group_names(const FacqStream *stream)
 {
 	GString *key_file_content = NULL;
-	guint n_items = 0, i = 0;
+	guint n_items = 0, i = 0, j = 0;
 	const gchar *item_name = NULL;
 	gchar *group_name = NULL;
 
@@ -220,6 +327,15 @@ static GString *facq_stream_save_get_group_names(const FacqStream *stream)
 	key_file_content = g_string_append(key_file_content,group_name);
 	g_free(group_name);
 
+	/* and one for each extra sink if any */
+	for(j = 0;j < stream->priv->tees->len;j++){
+		i++;
+		item_name = facq_sink_get_name(facq_stream_get_tee(stream,j));
+		group_name = g_strdup_printf("[%s,%u]\n",item_name,i);
+		key_file_content = g_string_append(key_file_content,group_name);
+		g_free(group_name);
+	}
+
 	return key_file_content;
 }
 
@@ -300,6 +416,22 @@ static void facq_stream_get_property(GObject *self,guint property_id,GValue *val
 	break;
 	case PROP_RING_SIZE: g_value_set_uint(value,stream->priv->ring_chunks);
 	break;
+	case PROP_MEMORY_BUDGET: g_value_set_uint(value,stream->priv->memory_budget);
+	break;
+	case PROP_LATENCY: g_value_set_double(value,stream->priv->latency);
+	break;
+	case PROP_STAGED: g_value_set_boolean(value,stream->priv->staged);
+	break;
+	case PROP_LOCKED_MEMORY: g_value_set_boolean(value,stream->priv->locked_memory);
+	break;
+	case PROP_OP_THREADS: g_value_set_uint(value,stream->priv->op_threads);
+	break;
+	case PROP_NATIVE_SAMPLES: g_value_set_boolean(value,stream->priv->native_samples);
+	break;
+	case PROP_CONV_THREAD: g_value_set_boolean(value,stream->priv->conv_thread);
+	break;
+	case PROP_OVERFLOW: g_value_set_uint(value,stream->priv->overflow);
+	break;
 	default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(stream,property_id,pspec);
 	}
@@ -320,6 +452,22 @@ static void facq_stream_set_property(GObject *self,guint property_id,const GValu
 	break;
 	case PROP_RING_SIZE: stream->priv->ring_chunks = g_value_get_uint(value);
 	break;
+	case PROP_MEMORY_BUDGET: stream->priv->memory_budget = g_value_get_uint(value);
+	break;
+	case PROP_LATENCY: stream->priv->latency = g_value_get_double(value);
+	break;
+	case PROP_STAGED: stream->priv->staged = g_value_get_boolean(value);
+	break;
+	case PROP_LOCKED_MEMORY: stream->priv->locked_memory = g_value_get_boolean(value);
+	break;
+	case PROP_OP_THREADS: stream->priv->op_threads = g_value_get_uint(value);
+	break;
+	case PROP_NATIVE_SAMPLES: stream->priv->native_samples = g_value_get_boolean(value);
+	break;
+	case PROP_CONV_THREAD: stream->priv->conv_thread = g_value_get_boolean(value);
+	break;
+	case PROP_OVERFLOW: stream->priv->overflow = g_value_get_uint(value);
+	break;
 	default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(stream,property_id,pspec);
 	}
@@ -334,6 +482,10 @@ static void facq_stream_finalize(GObject *self)
 
 	if(FACQ_IS_SOURCE(stream->priv->src))
 		facq_source_free(stream->priv->src);
+	if(stream->priv->tees){
+		facq_stream_remove_tees(stream);
+		g_array_free(stream->priv->tees,TRUE);
+	}
 	if(FACQ_IS_SINK(stream->priv->sink))
 		facq_sink_free(stream->priv->sink);
 	if(stream->priv->oplist)
@@ -355,6 +507,7 @@ static void facq_stream_constructed(GObject *self)
 	FacqStream *stream = FACQ_STREAM(self);
 	
 	stream->priv->oplist = facq_operation_list_new();
+	stream->priv->tees = g_array_new(FALSE,TRUE,sizeof(FacqStreamTee));
 	stream->priv->mon = 
 		facq_pipeline_monitor_new(stream->priv->error_cb,
 					  stream->priv->stop_cb,
@@ -416,6 +569,86 @@ static void facq_stream_class_init(FacqStreamClass *klass)
 							     G_PARAM_CONSTRUCT |
 							     G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property(object_class,PROP_MEMORY_BUDGET,
+					g_param_spec_uint("memory-budget",
+							"Memory budget",
+							"The maximum MiB used by the chunks of the ring buffer, 0 for no limit",
+							0,
+							G_MAXINT,
+							FACQ_STREAM_DEF_MEMORY_BUDGET,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_LATENCY,
+					g_param_spec_double("latency",
+							"Latency",
+							"The number of seconds of data in each chunk",
+							0.001,
+							3600,
+							FACQ_STREAM_DEF_LATENCY,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_STAGED,
+					g_param_spec_boolean("staged",
+							"Staged",
+							"Run each operation in its own thread",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_LOCKED_MEMORY,
+					g_param_spec_boolean("locked-memory",
+							"Locked memory",
+							"Lock the ring buffer in RAM",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_OP_THREADS,
+					g_param_spec_uint("op-threads",
+							"Operation threads",
+							"Threads used by the channel independent operations",
+							1,
+							FACQ_STREAM_MAX_OP_THREADS,
+							1,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_NATIVE_SAMPLES,
+					g_param_spec_boolean("native-samples",
+							"Native samples",
+							"Keep the samples in the source format in the ring buffer",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_CONV_THREAD,
+					g_param_spec_boolean("conv-thread",
+							"Converter thread",
+							"Convert the samples in their own thread",
+							FALSE,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(object_class,PROP_OVERFLOW,
+					g_param_spec_uint("overflow",
+							"Overflow",
+							"The policy used when the ring buffer is full",
+							FACQ_PIPELINE_OVERFLOW_BLOCK,
+							FACQ_PIPELINE_OVERFLOW_SPILL,
+							FACQ_PIPELINE_OVERFLOW_BLOCK,
+							G_PARAM_READWRITE |
+							G_PARAM_CONSTRUCT |
+							G_PARAM_STATIC_STRINGS));
+
 }
 
 static void facq_stream_init(FacqStream *stream)
@@ -427,6 +660,15 @@ static void facq_stream_init(FacqStream *stream)
 	stream->priv->oplist = NULL;
 	stream->priv->p = NULL;
 	stream->priv->ring_chunks = 0;
+	stream->priv->memory_budget = FACQ_STREAM_DEF_MEMORY_BUDGET;
+	stream->priv->latency = FACQ_STREAM_DEF_LATENCY;
+	stream->priv->staged = FALSE;
+	stream->priv->locked_memory = FALSE;
+	stream->priv->op_threads = 1;
+	stream->priv->native_samples = FALSE;
+	stream->priv->conv_thread = FALSE;
+	stream->priv->overflow = FACQ_PIPELINE_OVERFLOW_BLOCK;
+	stream->priv->tees = NULL;
 }
 
 /*****--- Public methods ---*****/
@@ -621,17 +863,248 @@ FacqSink *facq_stream_get_sink(const FacqStream *stream)
  * @stream: A #FacqStream object.
  *
  * Removes the #FacqSink object (if any) from the #FacqStream object.
- * The #FacqSink is destroyed after being removed.
+ * The #FacqSink is destroyed after being removed, along with the extra
+ * sinks, if any.
  */
 void facq_stream_remove_sink(FacqStream *stream)
 {
 	g_return_if_fail(FACQ_IS_STREAM(stream));
+	facq_stream_remove_tees(stream);
 	if(FACQ_IS_SINK(stream->priv->sink)){
 		facq_sink_free(stream->priv->sink);
 		stream->priv->sink = NULL;
 	}
 }
 
+/**
+ * facq_stream_set_locked_memory:
+ * @stream: A #FacqStream object.
+ * @locked_memory: %TRUE to lock the ring buffer in RAM.
+ *
+ * Enables or disables the use of locked memory for the ring buffer, the new
+ * value will be used the next time the stream is started. See
+ * facq_pipeline_set_locked_memory().
+ */
+void facq_stream_set_locked_memory(FacqStream *stream,gboolean locked_memory)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+
+	stream->priv->locked_memory = locked_memory;
+}
+
+/**
+ * facq_stream_get_locked_memory:
+ * @stream: A #FacqStream object.
+ *
+ * Returns: %TRUE if the stream uses locked memory, %FALSE in other case.
+ */
+gboolean facq_stream_get_locked_memory(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
+
+	return stream->priv->locked_memory;
+}
+
+/**
+ * facq_stream_set_op_threads:
+ * @stream: A #FacqStream object.
+ * @n_threads: The number of threads, between 1 and 64.
+ *
+ * Sets the number of threads used by the channel independent operations, the
+ * new value will be used the next time the stream is started. See
+ * facq_pipeline_set_op_threads().
+ */
+void facq_stream_set_op_threads(FacqStream *stream,guint n_threads)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+	g_return_if_fail(n_threads >= 1 && n_threads <= FACQ_STREAM_MAX_OP_THREADS);
+
+	stream->priv->op_threads = n_threads;
+}
+
+/**
+ * facq_stream_get_op_threads:
+ * @stream: A #FacqStream object.
+ *
+ * Returns: The number of threads used by the channel independent operations.
+ */
+guint facq_stream_get_op_threads(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),1);
+
+	return stream->priv->op_threads;
+}
+
+/**
+ * facq_stream_set_native_samples:
+ * @stream: A #FacqStream object.
+ * @native_samples: %TRUE to keep the samples in the source format in the ring
+ * buffer.
+ *
+ * Enables or disables the deferred conversion of the samples, the new value
+ * will be used the next time the stream is started. See
+ * facq_pipeline_set_native_samples().
+ */
+void facq_stream_set_native_samples(FacqStream *stream,gboolean native_samples)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+
+	stream->priv->native_samples = native_samples;
+}
+
+/**
+ * facq_stream_get_native_samples:
+ * @stream: A #FacqStream object.
+ *
+ * Returns: %TRUE if the stream keeps the samples in the source format in the
+ * ring buffer, %FALSE in other case.
+ */
+gboolean facq_stream_get_native_samples(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
+
+	return stream->priv->native_samples;
+}
+
+/**
+ * facq_stream_set_conv_thread:
+ * @stream: A #FacqStream object.
+ * @conv_thread: %TRUE to convert the samples in their own thread.
+ *
+ * Enables or disables the converter thread, the new value will be used the
+ * next time the stream is started. See facq_pipeline_set_conv_thread().
+ */
+void facq_stream_set_conv_thread(FacqStream *stream,gboolean conv_thread)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+
+	stream->priv->conv_thread = conv_thread;
+}
+
+/**
+ * facq_stream_get_conv_thread:
+ * @stream: A #FacqStream object.
+ *
+ * Returns: %TRUE if the stream converts the samples in their own thread,
+ * %FALSE in other case.
+ */
+gboolean facq_stream_get_conv_thread(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
+
+	return stream->priv->conv_thread;
+}
+
+/**
+ * facq_stream_set_overflow:
+ * @stream: A #FacqStream object.
+ * @overflow: A #FacqPipelineOverflow policy.
+ *
+ * Sets the policy used when the ring buffer of the stream is full, the new
+ * value will be used the next time the stream is started. See
+ * facq_pipeline_set_overflow().
+ */
+void facq_stream_set_overflow(FacqStream *stream,FacqPipelineOverflow overflow)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+	g_return_if_fail(overflow <= FACQ_PIPELINE_OVERFLOW_SPILL);
+
+	stream->priv->overflow = overflow;
+}
+
+/**
+ * facq_stream_get_overflow:
+ * @stream: A #FacqStream object.
+ *
+ * Gets the policy used when the ring buffer of the stream is full.
+ *
+ * Returns: A #FacqPipelineOverflow value.
+ */
+FacqPipelineOverflow facq_stream_get_overflow(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FACQ_PIPELINE_OVERFLOW_BLOCK);
+
+	return stream->priv->overflow;
+}
+
+/**
+ * facq_stream_add_tee:
+ * @stream: A closed #FacqStream object.
+ * @sink: A #FacqSink object.
+ * @overflow: The #FacqPipelineOverflow policy for @sink.
+ *
+ * Adds an extra #FacqSink to the stream, the data will be written to the
+ * sink set with facq_stream_set_sink() and to each extra sink, each one in its
+ * own thread. See #FacqPipeline for more details about @overflow,
+ * %FACQ_PIPELINE_OVERFLOW_SPILL is not supported.
+ *
+ * Returns: %TRUE if successful, %FALSE in other case.
+ */
+gboolean facq_stream_add_tee(FacqStream *stream,FacqSink *sink,FacqPipelineOverflow overflow)
+{
+	FacqStreamTee tee;
+
+	g_return_val_if_fail(FACQ_IS_STREAM(stream) && FACQ_IS_SINK(sink),FALSE);
+	g_return_val_if_fail(overflow != FACQ_PIPELINE_OVERFLOW_SPILL,FALSE);
+	if(!facq_stream_is_closed(stream))
+		return FALSE;
+
+	tee.sink = sink;
+	tee.overflow = overflow;
+	g_array_append_val(stream->priv->tees,tee);
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s","Extra sink added to stream");
+	return TRUE;
+}
+
+/**
+ * facq_stream_get_tee_num:
+ * @stream: A #FacqStream object.
+ *
+ * Gets the number of extra sinks added with facq_stream_add_tee().
+ *
+ * Returns: The number of extra sinks.
+ */
+guint facq_stream_get_tee_num(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),0);
+
+	return stream->priv->tees->len;
+}
+
+/**
+ * facq_stream_get_tee:
+ * @stream: A #FacqStream object.
+ * @index: The position of the extra sink, starting at 0.
+ *
+ * Gets the extra #FacqSink at position @index.
+ *
+ * Returns: A #FacqSink object or %NULL in case of error.
+ */
+FacqSink *facq_stream_get_tee(const FacqStream *stream,guint index)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),NULL);
+	g_return_val_if_fail(index < stream->priv->tees->len,NULL);
+
+	return g_array_index(stream->priv->tees,FacqStreamTee,index).sink;
+}
+
+/**
+ * facq_stream_remove_tees:
+ * @stream: A #FacqStream object.
+ *
+ * Removes all the extra sinks from the @stream, destroying them.
+ */
+void facq_stream_remove_tees(FacqStream *stream)
+{
+	guint i = 0;
+
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+
+	for(i = 0;i < stream->priv->tees->len;i++)
+		facq_sink_free(g_array_index(stream->priv->tees,FacqStreamTee,i).sink);
+	g_array_set_size(stream->priv->tees,0);
+}
+
 /**
  * facq_stream_append_operation:
  * @stream: A #FacqStream object.
@@ -701,6 +1174,105 @@ guint facq_stream_get_operation_num(const FacqStream *stream)
 	return facq_operation_list_get_length(stream->priv->oplist);
 }
 
+/**
+ * facq_stream_set_memory_budget:
+ * @stream: A #FacqStream object.
+ * @memory_budget: The maximum number of MiB that the ring buffer can use,
+ * or 0 for no limit, at most %G_MAXINT.
+ *
+ * Sets the memory budget of the @stream, the new value will be used the next
+ * time the stream is started. Only the chunks of the ring buffer are counted,
+ * not the chunks queued out of it. See facq_misc_budget_to_ring_chunks() for
+ * details.
+ */
+void facq_stream_set_memory_budget(FacqStream *stream,guint memory_budget)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+	g_return_if_fail(memory_budget <= G_MAXINT);
+
+	stream->priv->memory_budget = memory_budget;
+}
+
+/**
+ * facq_stream_get_memory_budget:
+ * @stream: A #FacqStream object.
+ *
+ * Gets the memory budget of the @stream.
+ *
+ * Returns: The maximum number of MiB that the ring buffer can use, 0 means
+ * no limit.
+ */
+guint facq_stream_get_memory_budget(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),0);
+
+	return stream->priv->memory_budget;
+}
+
+/**
+ * facq_stream_set_latency:
+ * @stream: A #FacqStream object.
+ * @latency: The number of seconds of data in each chunk, between 0.001 and
+ * 3600.
+ *
+ * Sets the latency of the @stream, the new value will be used the next time
+ * the stream is started. Lower values make the data reach the sink sooner,
+ * at the cost of more work per sample. See facq_misc_latency_to_chunk_size()
+ * for details.
+ */
+void facq_stream_set_latency(FacqStream *stream,gdouble latency)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+	g_return_if_fail(latency >= 0.001 && latency <= 3600);
+
+	stream->priv->latency = latency;
+}
+
+/**
+ * facq_stream_get_latency:
+ * @stream: A #FacqStream object.
+ *
+ * Gets the latency of the @stream.
+ *
+ * Returns: The number of seconds of data in each chunk.
+ */
+gdouble facq_stream_get_latency(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FACQ_STREAM_DEF_LATENCY);
+
+	return stream->priv->latency;
+}
+
+/**
+ * facq_stream_set_staged:
+ * @stream: A #FacqStream object.
+ * @staged: %TRUE if each operation should run in its own thread.
+ *
+ * Enables or disables the staged mode in the stream, the new value will be
+ * used the next time the stream is started. See facq_pipeline_set_staged().
+ */
+void facq_stream_set_staged(FacqStream *stream,gboolean staged)
+{
+	g_return_if_fail(FACQ_IS_STREAM(stream));
+
+	stream->priv->staged = staged;
+}
+
+/**
+ * facq_stream_get_staged:
+ * @stream: A #FacqStream object.
+ *
+ * Checks if the @stream runs each operation in its own thread.
+ *
+ * Returns: %TRUE if the stream is staged, %FALSE in other case.
+ */
+gboolean facq_stream_get_staged(const FacqStream *stream)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
+
+	return stream->priv->staged;
+}
+
 /**
  * facq_stream_save:
  * @stream: A closed #FacqStream object, see facq_stream_is_closed() for
@@ -718,10 +1290,10 @@ gboolean facq_stream_save(FacqStream *stream,const gchar *filename,GError **err)
 {
 	GString *key_file_content = NULL;
 	GKeyFile *key_file = NULL;
-	gchar *txt_key_file_content = NULL;
+	gchar *txt_key_file_content = NULL, *group_name = NULL;
 	gboolean ret = FALSE;
 	GError *local_err = NULL;
-	guint i = 0, n_operations = 0;
+	guint i = 0, j = 0, n_operations = 0;
 	gpointer item = NULL;
 
 	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
@@ -739,8 +1311,18 @@ gboolean facq_stream_save(FacqStream *stream,const gchar *filename,GError **err)
 	if(!ret)
 		goto error;
 
-	/* save the stream name */
+	/* save the stream name and the stream options */
 	g_key_file_set_string(key_file,"Stream","name",stream->priv->name);
+	g_key_file_set_integer(key_file,"Stream","memory-budget",stream->priv->memory_budget);
+	g_key_file_set_double(key_file,"Stream","latency",stream->priv->latency);
+	g_key_file_set_boolean(key_file,"Stream","staged",stream->priv->staged);
+	g_key_file_set_boolean(key_file,"Stream","locked-memory",stream->priv->locked_memory);
+	g_key_file_set_integer(key_file,"Stream","op-threads",stream->priv->op_threads);
+	g_key_file_set_boolean(key_file,"Stream","native-samples",stream->priv->native_samples);
+	g_key_file_set_boolean(key_file,"Stream","conv-thread",stream->priv->conv_thread);
+	g_key_file_set_integer(key_file,"Stream","overflow",stream->priv->overflow);
+	if(stream->priv->tees->len)
+		g_key_file_set_integer(key_file,"Stream","tees",stream->priv->tees->len);
 	
 	/* save the source */
 	item = stream->priv->src;
@@ -761,6 +1343,17 @@ gboolean facq_stream_save(FacqStream *stream,const gchar *filename,GError **err)
 	item = stream->priv->sink;
 	facq_stream_save_item(key_file,item,i);
 
+	/* save the extra sinks */
+	for(j = 0;j < stream->priv->tees->len;j++){
+		i++;
+		item = facq_stream_get_tee(stream,j);
+		facq_stream_save_item(key_file,item,i);
+		group_name = g_strdup_printf("%s,%u",facq_sink_get_name(item),i);
+		g_key_file_set_integer(key_file,group_name,"overflow",
+			g_array_index(stream->priv->tees,FacqStreamTee,j).overflow);
+		g_free(group_name);
+	}
+
 	txt_key_file_content = g_key_file_to_data(key_file,NULL,NULL);
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_DEBUG,"FILE:\n%s\n",txt_key_file_content);
 	facq_stream_save_to_file(filename,txt_key_file_content,&local_err);
@@ -789,17 +1382,25 @@ static void facq_stream_load_from_key_file(GKeyFile *key_file,const FacqCatalog
 	gchar **groups = NULL, **tokens = NULL;
 	guint i = 0, n_items = 0, n_operations = 0;
 	gsize n_groups = 0;
+	gint n_tees = 0, overflow = 0;
 	gpointer item = NULL;
 
+	/* the number of extra sinks is optional */
+	if(g_key_file_has_key(key_file,"Stream","tees",NULL)){
+		n_tees = g_key_file_get_integer(key_file,"Stream","tees",&local_err);
+		if(local_err)
+			goto error;
+	}
+
 	/* we are not ready yet, first check that the number of groups it's >
 	 * 3 */
 	groups = g_key_file_get_groups(key_file,&n_groups);
-	if(n_groups < 3){
+	if(n_tees < 0 || n_groups < (gsize)(3 + n_tees)){
 		g_set_error_literal(&local_err,FACQ_STREAM_ERROR,
 					FACQ_STREAM_ERROR_FAILED,"Invalid file");
 		goto error;
 	}
-	n_items = n_groups - 1; //subtract the stream group
+	n_items = n_groups - 1 - n_tees; //subtract the stream group and the tees
 	n_operations = n_items - 2;//subtract the source and the sink
 
 	/* start at group 1, cause group 0 is the [Stream] group */
@@ -832,18 +1433,41 @@ static void facq_stream_load_from_key_file(GKeyFile *key_file,const FacqCatalog
 	}
 
 	/* sink */
-	tokens = g_strsplit(groups[n_groups-1],",",2);
+	tokens = g_strsplit(groups[n_items],",",2);
 	item = facq_catalog_item_from_key_file(key_file,
-					       groups[n_groups-1],
+					       groups[n_items],
 					       tokens[0],
 					       cat,
 					       FACQ_CATALOG_TYPE_SINK,
 					       &local_err);
 	g_strfreev(tokens);
+	tokens = NULL;
 	if(local_err)
 		goto error;
 	facq_stream_set_sink(stream,item);
 
+	/* extra sinks */
+	for(i = n_items+1;i < n_groups;i++){
+		tokens = g_strsplit(groups[i],",",2);
+		item = facq_catalog_item_from_key_file(key_file,
+						       groups[i],
+						       tokens[0],
+						       cat,
+						       FACQ_CATALOG_TYPE_SINK,
+						       &local_err);
+		g_strfreev(tokens);
+		tokens = NULL;
+		if(local_err)
+			goto error;
+		overflow = g_key_file_get_integer(key_file,groups[i],"overflow",&local_err);
+		if(local_err || overflow < FACQ_PIPELINE_OVERFLOW_BLOCK
+				|| overflow > FACQ_PIPELINE_OVERFLOW_DROP_OLDEST){
+			facq_sink_free(item);
+			goto error;
+		}
+		facq_stream_add_tee(stream,item,overflow);
+	}
+
 	g_strfreev(groups);
 	return;
 
@@ -885,6 +1509,12 @@ FacqStream *facq_stream_load(const gchar *filename,const FacqCatalog *cat,guint
 	GError *local_err = NULL;
 	FacqStream *stream = NULL;
 	gchar *group_name = NULL, *stream_name = NULL;
+	gint memory_budget = FACQ_STREAM_DEF_MEMORY_BUDGET;
+	gdouble latency = FACQ_STREAM_DEF_LATENCY;
+	gboolean staged = FALSE, locked_memory = FALSE, native_samples = FALSE;
+	gboolean conv_thread = FALSE;
+	gint overflow = FACQ_PIPELINE_OVERFLOW_BLOCK;
+	gint op_threads = 1;
 
 	key_file = g_key_file_new();
 	if(!g_key_file_load_from_file(key_file,filename,G_KEY_FILE_NONE,&local_err)){
@@ -903,12 +1533,91 @@ FacqStream *facq_stream_load(const gchar *filename,const FacqCatalog *cat,guint
 	stream_name = g_key_file_get_string(key_file,group_name,"name",&local_err);
 	if(local_err || !stream_name)
 		goto error;
+	/* memory-budget, latency, staged, locked-memory, op-threads,
+	 * native-samples, conv-thread and overflow are optional, older files
+	 * don't have them */
+	if(g_key_file_has_key(key_file,group_name,"memory-budget",NULL)){
+		memory_budget = g_key_file_get_integer(key_file,group_name,"memory-budget",&local_err);
+		if(local_err)
+			goto error;
+		if(memory_budget < 0){
+			g_set_error(&local_err,FACQ_STREAM_ERROR,
+					FACQ_STREAM_ERROR_FAILED,
+						"Invalid memory-budget %d",memory_budget);
+			goto error;
+		}
+	}
+	if(g_key_file_has_key(key_file,group_name,"latency",NULL)){
+		latency = g_key_file_get_double(key_file,group_name,"latency",&local_err);
+		if(local_err)
+			goto error;
+		if(latency < 0.001 || latency > 3600){
+			g_set_error(&local_err,FACQ_STREAM_ERROR,
+					FACQ_STREAM_ERROR_FAILED,
+						"Invalid latency %g",latency);
+			goto error;
+		}
+	}
+	if(g_key_file_has_key(key_file,group_name,"staged",NULL)){
+		staged = g_key_file_get_boolean(key_file,group_name,"staged",&local_err);
+		if(local_err)
+			goto error;
+	}
+	if(g_key_file_has_key(key_file,group_name,"locked-memory",NULL)){
+		locked_memory = g_key_file_get_boolean(key_file,group_name,"locked-memory",&local_err);
+		if(local_err)
+			goto error;
+	}
+	if(g_key_file_has_key(key_file,group_name,"op-threads",NULL)){
+		op_threads = g_key_file_get_integer(key_file,group_name,"op-threads",&local_err);
+		if(local_err)
+			goto error;
+		if(op_threads < 1 || op_threads > FACQ_STREAM_MAX_OP_THREADS){
+			g_set_error(&local_err,FACQ_STREAM_ERROR,
+					FACQ_STREAM_ERROR_FAILED,
+						"Invalid op-threads %d",op_threads);
+			goto error;
+		}
+	}
+	if(g_key_file_has_key(key_file,group_name,"native-samples",NULL)){
+		native_samples = g_key_file_get_boolean(key_file,group_name,"native-samples",&local_err);
+		if(local_err)
+			goto error;
+	}
+	if(g_key_file_has_key(key_file,group_name,"conv-thread",NULL)){
+		conv_thread = g_key_file_get_boolean(key_file,group_name,"conv-thread",&local_err);
+		if(local_err)
+			goto error;
+	}
+	if(g_key_file_has_key(key_file,group_name,"overflow",NULL)){
+		overflow = g_key_file_get_integer(key_file,group_name,"overflow",&local_err);
+		if(local_err)
+			goto error;
+		if(overflow < FACQ_PIPELINE_OVERFLOW_BLOCK
+				|| overflow > FACQ_PIPELINE_OVERFLOW_SPILL){
+			g_set_error(&local_err,FACQ_STREAM_ERROR,
+					FACQ_STREAM_ERROR_FAILED,
+						"Invalid overflow policy %d",overflow);
+			goto error;
+		}
+	}
 	g_free(group_name);
+	group_name = NULL;
 	stream = facq_stream_new(stream_name,
 				 ring_chunks,
 				 stop_cb,
 				 error_cb,
 				 data);
+	g_free(stream_name);
+	stream_name = NULL;
+	facq_stream_set_memory_budget(stream,memory_budget);
+	facq_stream_set_latency(stream,latency);
+	facq_stream_set_staged(stream,staged);
+	facq_stream_set_locked_memory(stream,locked_memory);
+	facq_stream_set_op_threads(stream,op_threads);
+	facq_stream_set_native_samples(stream,native_samples);
+	facq_stream_set_conv_thread(stream,conv_thread);
+	facq_stream_set_overflow(stream,overflow);
 	/* we have the name, now we must load the rest of items in the stream
 	 * we do it in this private function */
 	facq_stream_load_from_key_file(key_file,cat,stream,&local_err);
@@ -926,6 +1635,8 @@ FacqStream *facq_stream_load(const gchar *filename,const FacqCatalog *cat,guint
 		facq_stream_free(stream);
 	if(group_name)
 		g_free(group_name);
+	if(stream_name)
+		g_free(stream_name);
 	if(local_err){
 		facq_log_write_v(FACQ_LOG_MSG_TYPE_ERROR,"%s",local_err->message);
 		g_clear_error(&local_err);
@@ -951,8 +1662,8 @@ gboolean facq_stream_start(FacqStream *stream,GError **err)
 {
 	const FacqSource *src = NULL;
 	const FacqStreamData *stmd = NULL;
-	guint n_channels = 0;
-	gsize chunk_size = 0;
+	guint n_channels = 0, ring_chunks = 0, i = 0;
+	gsize chunk_size = 0, budget = 0;
 	GError *local_err = NULL;
 
 	//check that stream is closed if not set error return false
@@ -974,17 +1685,26 @@ gboolean facq_stream_start(FacqStream *stream,GError **err)
 	//Empty the monitor from previous messages if any
 	facq_pipeline_monitor_clear(stream->priv->mon);
 	
-	//Calculate a valid chunk size
-	if(stmd->period <= 1)
-		chunk_size = facq_misc_period_to_chunk_size(stmd->period,
-							    sizeof(gdouble),
-							    stmd->n_channels);
-	else
-		chunk_size = 8*n_channels;
+	//Calculate a valid chunk size and ring size, according to the
+	//latency and the memory budget.
+	chunk_size = facq_misc_latency_to_chunk_size(stmd->period,
+						     stream->priv->latency,
+						     sizeof(gdouble),
+						     n_channels);
+	budget = (gsize)stream->priv->memory_budget*1024*1024;
+	if(budget / (1024*1024) != stream->priv->memory_budget)
+		budget = G_MAXSIZE;
+	ring_chunks = facq_misc_budget_to_ring_chunks(budget,
+						      stream->priv->ring_chunks,
+						      &chunk_size,
+						      sizeof(gdouble)*n_channels);
+	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,
+			"Using %u chunks of ""%"G_GSIZE_FORMAT" bytes",
+			ring_chunks,chunk_size);
 
 	//start the pipeline
 	stream->priv->p = facq_pipeline_new(chunk_size,
-					    stream->priv->ring_chunks,
+					    ring_chunks,
 					    stream->priv->src,
 					    stream->priv->oplist,
 					    stream->priv->sink,
@@ -992,9 +1712,19 @@ gboolean facq_stream_start(FacqStream *stream,GError **err)
 					    &local_err);
 	if(local_err)
 		goto error;
-
-	//attach the monitor to the main thread, it will be polled for new
-	//messages one time each second.
+	facq_pipeline_set_staged(stream->priv->p,stream->priv->staged);
+	facq_pipeline_set_locked_memory(stream->priv->p,stream->priv->locked_memory);
+	facq_pipeline_set_op_threads(stream->priv->p,stream->priv->op_threads);
+	facq_pipeline_set_native_samples(stream->priv->p,stream->priv->native_samples);
+	facq_pipeline_set_conv_thread(stream->priv->p,stream->priv->conv_thread);
+	facq_pipeline_set_overflow(stream->priv->p,stream->priv->overflow);
+	for(i = 0;i < stream->priv->tees->len;i++)
+		facq_pipeline_add_sink(stream->priv->p,
+			g_array_index(stream->priv->tees,FacqStreamTee,i).sink,
+			g_array_index(stream->priv->tees,FacqStreamTee,i).overflow);
+
+	//attach the monitor to the main thread, new messages will be
+	//dispatched as soon as they are pushed.
 	facq_pipeline_monitor_attach(stream->priv->mon);
 
 	if(!facq_pipeline_start(stream->priv->p,&local_err)){
@@ -1036,6 +1766,27 @@ void facq_stream_stop(FacqStream *stream)
 	facq_log_write_v(FACQ_LOG_MSG_TYPE_INFO,"%s","Stream stopped");
 }
 
+/**
+ * facq_stream_get_stats:
+ * @stream: A #FacqStream object.
+ * @stats: (out caller-allocates): A #FacqPipelineStats where the values will
+ * be stored.
+ *
+ * Gets the statistics of the running stream, see facq_pipeline_get_stats().
+ *
+ * Returns: %TRUE if the stream is running and @stats has been filled,
+ * %FALSE in other case.
+ */
+gboolean facq_stream_get_stats(FacqStream *stream,FacqPipelineStats *stats)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM(stream),FALSE);
+
+	if(!stream->priv->p)
+		return FALSE;
+	facq_pipeline_get_stats(stream->priv->p,stats);
+	return TRUE;
+}
+
 /**
  * facq_stream_clear:
  * @stream: A #FacqStream object.
@@ -63,15 +63,36 @@ FacqSource *facq_stream_get_source(const FacqStream *stream);
 gboolean facq_stream_set_sink(FacqStream *stream,FacqSink *sink);
 FacqSink *facq_stream_get_sink(const FacqStream *stream);
 void facq_stream_remove_sink(FacqStream *stream);
+gboolean facq_stream_add_tee(FacqStream *stream,FacqSink *sink,FacqPipelineOverflow overflow);
+guint facq_stream_get_tee_num(const FacqStream *stream);
+FacqSink *facq_stream_get_tee(const FacqStream *stream,guint index);
+void facq_stream_remove_tees(FacqStream *stream);
 guint facq_stream_append_operation(FacqStream *stream,const FacqOperation *op);
 FacqOperation *facq_stream_get_operation(FacqStream *stream,guint index);
 guint facq_stream_remove_operation(FacqStream *stream);
 guint facq_stream_get_operation_num(const FacqStream *stream);
+void facq_stream_set_memory_budget(FacqStream *stream,guint memory_budget);
+guint facq_stream_get_memory_budget(const FacqStream *stream);
+void facq_stream_set_latency(FacqStream *stream,gdouble latency);
+gdouble facq_stream_get_latency(const FacqStream *stream);
+void facq_stream_set_staged(FacqStream *stream,gboolean staged);
+gboolean facq_stream_get_staged(const FacqStream *stream);
+void facq_stream_set_locked_memory(FacqStream *stream,gboolean locked_memory);
+gboolean facq_stream_get_locked_memory(const FacqStream *stream);
+void facq_stream_set_op_threads(FacqStream *stream,guint n_threads);
+guint facq_stream_get_op_threads(const FacqStream *stream);
+void facq_stream_set_native_samples(FacqStream *stream,gboolean native_samples);
+gboolean facq_stream_get_native_samples(const FacqStream *stream);
+void facq_stream_set_conv_thread(FacqStream *stream,gboolean conv_thread);
+gboolean facq_stream_get_conv_thread(const FacqStream *stream);
+void facq_stream_set_overflow(FacqStream *stream,FacqPipelineOverflow overflow);
+FacqPipelineOverflow facq_stream_get_overflow(const FacqStream *stream);
 void facq_stream_clear(FacqStream *stream);
 void facq_stream_free(FacqStream *stream);
 
 gboolean facq_stream_start(FacqStream *stream,GError **err);
 void facq_stream_stop(FacqStream *stream);
+gboolean facq_stream_get_stats(FacqStream *stream,FacqPipelineStats *stats);
 gboolean facq_stream_save(FacqStream *stream,const gchar *filename,GError **err);
 FacqStream *facq_stream_load(const gchar *filename,const FacqCatalog *cat,guint ring_chunks,FacqPipelineMonitorCb stop_cb,FacqPipelineMonitorCb error_cb,gpointer data,GError **err);
 
@@ -47,6 +47,12 @@
  * where the samples were taken, and expected maximum and minimum values of the
  * samples per channel.
  *
+ * Some sources can also describe the samples as they are read, before the
+ * conversion to #gdouble, with a #FacqSampleFormat and a per channel scale and
+ * offset, see facq_stream_data_set_format(). This allows to keep the samples
+ * in their native format, and to convert them later with
+ * facq_stream_data_to_double(), see facq_pipeline_set_native_samples().
+ *
  */
 
 /**
@@ -58,6 +64,11 @@
  * @chanlist: A #FacqChanlist object with information of the channels.
  * @max: The maximum expected value of the samples.
  * @min: The minimum expected value of the samples.
+ * @format: The #FacqSampleFormat of the samples before conversion.
+ * @scale: The scale applied to the samples of each channel in the conversion,
+ * or %NULL.
+ * @offset: The offset added to the samples of each channel in the conversion,
+ * or %NULL.
  *
  * Contains the attributes of the #FacqStreamData objects.
  * You shouldn't modify this fields directly, you should use the
@@ -70,6 +81,20 @@
  * Class for the #FacqStreamData objects.
  */
 
+/**
+ * FacqSampleFormat:
+ * @FACQ_SAMPLE_FORMAT_DOUBLE: The samples can only be converted by the
+ * source, see facq_source_conv(), or are already #gdouble.
+ * @FACQ_SAMPLE_FORMAT_INT16: Signed 16 bit integers.
+ * @FACQ_SAMPLE_FORMAT_UINT16: Unsigned 16 bit integers.
+ * @FACQ_SAMPLE_FORMAT_INT32: Signed 32 bit integers.
+ * @FACQ_SAMPLE_FORMAT_UINT32: Unsigned 32 bit integers.
+ * @FACQ_SAMPLE_FORMAT_FLOAT32: Single precision floats.
+ *
+ * Enum values for the format of the samples as they are read from the source,
+ * in host byte order.
+ */
+
 G_DEFINE_TYPE(FacqStreamData,facq_stream_data,G_TYPE_OBJECT);
 
 enum {
@@ -95,6 +120,10 @@ static void facq_stream_data_finalize(GObject *self)
 		g_free(stmd->max);
 	if(stmd->min)
 		g_free(stmd->min);
+	if(stmd->scale)
+		g_free(stmd->scale);
+	if(stmd->offset)
+		g_free(stmd->offset);
 
 	if(G_OBJECT_CLASS(facq_stream_data_parent_class)->finalize)
     		(*G_OBJECT_CLASS(facq_stream_data_parent_class)->finalize)(self);
@@ -231,6 +260,9 @@ static void facq_stream_data_init(FacqStreamData *stmd)
 	stmd->units = NULL;
 	stmd->max = NULL;
 	stmd->min = NULL;
+	stmd->format = FACQ_SAMPLE_FORMAT_DOUBLE;
+	stmd->scale = NULL;
+	stmd->offset = NULL;
 }
 
 /* Public methods */
@@ -368,6 +400,154 @@ const gdouble *facq_stream_data_get_min(const FacqStreamData *stmd)
 	return stmd->min;
 }
 
+/**
+ * facq_sample_format_get_size:
+ * @format: A #FacqSampleFormat.
+ *
+ * Returns: The number of bytes of a sample in the @format.
+ */
+guint facq_sample_format_get_size(FacqSampleFormat format)
+{
+	switch(format){
+	case FACQ_SAMPLE_FORMAT_INT16:
+	case FACQ_SAMPLE_FORMAT_UINT16:
+		return sizeof(guint16);
+	case FACQ_SAMPLE_FORMAT_INT32:
+	case FACQ_SAMPLE_FORMAT_UINT32:
+		return sizeof(guint32);
+	case FACQ_SAMPLE_FORMAT_FLOAT32:
+		return sizeof(gfloat);
+	case FACQ_SAMPLE_FORMAT_DOUBLE:
+	default:
+		return sizeof(gdouble);
+	}
+}
+
+/**
+ * facq_stream_data_set_format:
+ * @stmd: A #FacqStreamData object, not shared yet.
+ * @format: The #FacqSampleFormat of the samples read from the source, its
+ * size must be equal to the bps attribute.
+ * @scale: (transfer full): An array of #gdouble with a length equal to the
+ * number of channels, or %NULL for %FACQ_SAMPLE_FORMAT_DOUBLE.
+ * @offset: (transfer full): An array of #gdouble with a length equal to the
+ * number of channels, or %NULL for %FACQ_SAMPLE_FORMAT_DOUBLE.
+ *
+ * Describes the samples read from the source, so they can be converted
+ * without the source, the sample n of the channel i is converted to
+ * <code>n*scale[i]+offset[i]</code>. It should be called by the
+ * #FacqSource after creating the #FacqStreamData, and only if the result is
+ * equal to facq_source_conv(). The @stmd takes the ownership of the arrays.
+ */
+void facq_stream_data_set_format(FacqStreamData *stmd,FacqSampleFormat format,gdouble *scale,gdouble *offset)
+{
+	g_return_if_fail(FACQ_IS_STREAM_DATA(stmd));
+	g_return_if_fail(format <= FACQ_SAMPLE_FORMAT_FLOAT32);
+	g_return_if_fail(format == FACQ_SAMPLE_FORMAT_DOUBLE || (scale && offset));
+	g_return_if_fail(format == FACQ_SAMPLE_FORMAT_DOUBLE ||
+				facq_sample_format_get_size(format) == stmd->bps);
+
+	if(stmd->scale)
+		g_free(stmd->scale);
+	if(stmd->offset)
+		g_free(stmd->offset);
+	stmd->format = format;
+	stmd->scale = scale;
+	stmd->offset = offset;
+}
+
+/**
+ * facq_stream_data_get_format:
+ * @stmd: A #FacqStreamData object.
+ *
+ * Returns: The #FacqSampleFormat of the samples read from the source.
+ */
+FacqSampleFormat facq_stream_data_get_format(const FacqStreamData *stmd)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),FACQ_SAMPLE_FORMAT_DOUBLE);
+	return stmd->format;
+}
+
+/**
+ * facq_stream_data_get_scale:
+ * @stmd: A #FacqStreamData object.
+ *
+ * Returns: a read-only real array, with the scale of each channel, or %NULL.
+ */
+const gdouble *facq_stream_data_get_scale(const FacqStreamData *stmd)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),NULL);
+	return stmd->scale;
+}
+
+/**
+ * facq_stream_data_get_offset:
+ * @stmd: A #FacqStreamData object.
+ *
+ * Returns: a read-only real array, with the offset of each channel, or %NULL.
+ */
+const gdouble *facq_stream_data_get_offset(const FacqStreamData *stmd)
+{
+	g_return_val_if_fail(FACQ_IS_STREAM_DATA(stmd),NULL);
+	return stmd->offset;
+}
+
+/* the samples are converted from the last one, so a sample is never
+ * overwritten before being converted when ori and dst are the same buffer */
+#define FACQ_STREAM_DATA_CONV(type) \
+	for(i = samples;i > 0;i--){ \
+		dst[i-1] = ((const type *)ori)[i-1]*scale[chan]+offset[chan]; \
+		chan = (chan) ? chan-1 : n_channels-1; \
+	}
+
+/**
+ * facq_stream_data_to_double:
+ * @stmd: A #FacqStreamData object.
+ * @ori: The samples in the format of @stmd, see facq_stream_data_get_format().
+ * @dst: An array of #gdouble with room for @samples values, it can be the same
+ * buffer as @ori.
+ * @samples: The number of samples in @ori, it must be a multiple of the
+ * number of channels.
+ *
+ * Converts the samples read from the source to #gdouble, using the scale and
+ * offset of each channel.
+ */
+void facq_stream_data_to_double(const FacqStreamData *stmd,gconstpointer ori,gdouble *dst,gsize samples)
+{
+	const gdouble *scale = NULL, *offset = NULL;
+	guint n_channels = 0, chan = 0;
+	gsize i = 0;
+
+	g_return_if_fail(FACQ_IS_STREAM_DATA(stmd));
+
+	if(!samples)
+		return;
+	if(stmd->format == FACQ_SAMPLE_FORMAT_DOUBLE){
+		if(ori != dst)
+			g_memmove(dst,ori,samples*sizeof(gdouble));
+		return;
+	}
+	scale = stmd->scale;
+	offset = stmd->offset;
+	n_channels = stmd->n_channels;
+	chan = (samples-1) % n_channels;
+
+	switch(stmd->format){
+	case FACQ_SAMPLE_FORMAT_INT16: FACQ_STREAM_DATA_CONV(gint16);
+	break;
+	case FACQ_SAMPLE_FORMAT_UINT16: FACQ_STREAM_DATA_CONV(guint16);
+	break;
+	case FACQ_SAMPLE_FORMAT_INT32: FACQ_STREAM_DATA_CONV(gint32);
+	break;
+	case FACQ_SAMPLE_FORMAT_UINT32: FACQ_STREAM_DATA_CONV(guint32);
+	break;
+	case FACQ_SAMPLE_FORMAT_FLOAT32: FACQ_STREAM_DATA_CONV(gfloat);
+	break;
+	default:
+	break;
+	}
+}
+
 /**
  * facq_stream_data_to_socket:
  * @stmd: A #FacqStreamData object.
@@ -29,6 +29,15 @@ G_BEGIN_DECLS
 #define FACQ_IS_STREAM_DATA_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),FACQ_TYPE_STREAM_DATA))
 #define FACQ_STREAM_DATA_GET_CLASS(inst) (G_TYPE_INSTANCE_GET_CLASS ((inst),FACQ_TYPE_STREAM_DATA, FacqStreamDataClass))
 
+typedef enum {
+	FACQ_SAMPLE_FORMAT_DOUBLE,
+	FACQ_SAMPLE_FORMAT_INT16,
+	FACQ_SAMPLE_FORMAT_UINT16,
+	FACQ_SAMPLE_FORMAT_INT32,
+	FACQ_SAMPLE_FORMAT_UINT32,
+	FACQ_SAMPLE_FORMAT_FLOAT32
+} FacqSampleFormat;
+
 typedef struct _FacqStreamData FacqStreamData;
 typedef struct _FacqStreamDataClass FacqStreamDataClass;
 typedef struct _FacqStreamDataPrivate FacqStreamDataPrivate;
@@ -44,6 +53,9 @@ struct _FacqStreamData {
 	FacqChanlist *chanlist;
 	gdouble *max;
 	gdouble *min;
+	FacqSampleFormat format;
+	gdouble *scale;
+	gdouble *offset;
 };
 
 struct _FacqStreamDataClass {
@@ -61,6 +73,12 @@ const FacqUnits *facq_stream_data_get_units(const FacqStreamData *stmd);
 const FacqChanlist *facq_stream_data_get_chanlist(const FacqStreamData *stmd);
 const gdouble *facq_stream_data_get_max(const FacqStreamData *stmd);
 const gdouble *facq_stream_data_get_min(const FacqStreamData *stmd);
+guint facq_sample_format_get_size(FacqSampleFormat format);
+void facq_stream_data_set_format(FacqStreamData *stmd,FacqSampleFormat format,gdouble *scale,gdouble *offset);
+FacqSampleFormat facq_stream_data_get_format(const FacqStreamData *stmd);
+const gdouble *facq_stream_data_get_scale(const FacqStreamData *stmd);
+const gdouble *facq_stream_data_get_offset(const FacqStreamData *stmd);
+void facq_stream_data_to_double(const FacqStreamData *stmd,gconstpointer ori,gdouble *dst,gsize samples);
 gboolean facq_stream_data_to_socket(const FacqStreamData *stmd,GSocket *socket,GError **err);
 FacqStreamData *facq_stream_data_from_socket(GSocket *socket,GError **err);
 void facq_stream_data_to_checksum(const FacqStreamData *stmd,GChecksum *sum);
@@ -51,6 +51,9 @@
 #include "facqsinknidaq.h"
 #endif
 
+/* maximum time allowed to facq_stream_stop(), in microseconds */
+#define MAX_STOP_LATENCY G_USEC_PER_SEC
+
 static void error_callback(FacqPipelineMessage *msg,gpointer data)
 {
 	g_print("On error callback\n");
@@ -69,6 +72,7 @@ int main(int argc,char **argv)
 	GError *err = NULL;
 	FacqChanlist *chanlist = NULL;
 	FacqOperation *plug = NULL;        
+	gint64 stop_latency = 0;
 
 #if GLIB_MINOR_VERSION < 36
         g_type_init();
@@ -111,8 +115,16 @@ int main(int argc,char **argv)
 		goto error;
 	}
 	g_usleep(10*G_USEC_PER_SEC);
+	stop_latency = g_get_monotonic_time();
 	facq_stream_stop(stream);
+	stop_latency = g_get_monotonic_time() - stop_latency;
 	facq_stream_free(stream);
+	g_print("Stream stopped in %f seconds\n",stop_latency/1e6);
+	if(stop_latency > MAX_STOP_LATENCY){
+		g_print("Stop latency too high\n");
+		facq_log_disable();
+		return 1;
+	}
 	facq_file_to_human("test.baf","test.baf.txt",&err);
 	if(err)
 		goto error;
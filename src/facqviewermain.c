@@ -36,6 +36,10 @@ int main(int argc,char **argv)
         textdomain(PACKAGE);
 #endif
 
+#if GLIB_MINOR_VERSION < 32
+        g_thread_init(NULL);
+#endif
+
 	gtk_init(&argc,&argv);
 
 	facq_log_enable();
@@ -17,9 +17,15 @@
  * MA 02110-1301, USA.
  * 
  */
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
 #include <glib.h>
+#include <string.h>
+#if HAVE_X86_CPU_DISPATCH
+#include <immintrin.h>
+#endif
 #include "gdouble.h"
-#ifndef GDOUBLE_TO_BE
 /**
  * SECTION:gdouble
  * @short_description: Provides double real precision methods.
@@ -29,8 +35,15 @@
  * This module provides missing operations for the glib's data type #gdouble.
  * This type provides a way to use double real numbers following the IEEE754
  * standard.
+ *
+ * gdouble_array_to_be() and gdouble_array_copy_to_be() convert whole arrays,
+ * they are used for the chunks written to files and sent trough the network.
+ * On x86 the conversion uses AVX2 or SSE2 when the CPU supports it, the
+ * implementation is chosen the first time one of them is called.
  */
 
+#ifndef GDOUBLE_TO_BE
+
 /**
  * GDOUBLE_TO_BE:
  * @data: The input @gdouble.
@@ -68,3 +81,111 @@ gdouble GDOUBLE_TO_BE(gdouble data)
 */
 }
 #endif
+
+static void gdouble_array_copy_to_be_scalar(gdouble *dst,const gdouble *src,gsize n)
+{
+	gsize i = 0;
+
+	for(i = 0;i < n;i++)
+		dst[i] = GDOUBLE_TO_BE(src[i]);
+}
+
+#if HAVE_X86_CPU_DISPATCH
+/* Reverses the bytes of each 64 bits lane: first the 16 bits words, then the
+ * bytes in each word, SSE2 doesn't have a byte shuffle. */
+__attribute__((target("sse2")))
+static void gdouble_array_copy_to_be_sse2(gdouble *dst,const gdouble *src,gsize n)
+{
+	__m128i x;
+	gsize i = 0;
+
+	for(i = 0;i + 2 <= n;i += 2){
+		x = _mm_loadu_si128((const __m128i *)(src + i));
+		x = _mm_shufflelo_epi16(x,_MM_SHUFFLE(0,1,2,3));
+		x = _mm_shufflehi_epi16(x,_MM_SHUFFLE(0,1,2,3));
+		x = _mm_or_si128(_mm_slli_epi16(x,8),_mm_srli_epi16(x,8));
+		_mm_storeu_si128((__m128i *)(dst + i),x);
+	}
+	gdouble_array_copy_to_be_scalar(dst + i,src + i,n - i);
+}
+
+__attribute__((target("avx2")))
+static void gdouble_array_copy_to_be_avx2(gdouble *dst,const gdouble *src,gsize n)
+{
+	const __m256i mask = _mm256_setr_epi8(7,6,5,4,3,2,1,0,
+					      15,14,13,12,11,10,9,8,
+					      7,6,5,4,3,2,1,0,
+					      15,14,13,12,11,10,9,8);
+	__m256i x, y;
+	gsize i = 0;
+
+	for(i = 0;i + 8 <= n;i += 8){
+		x = _mm256_loadu_si256((const __m256i *)(src + i));
+		y = _mm256_loadu_si256((const __m256i *)(src + i + 4));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_shuffle_epi8(x,mask));
+		_mm256_storeu_si256((__m256i *)(dst + i + 4),
+				    _mm256_shuffle_epi8(y,mask));
+	}
+	for(;i + 4 <= n;i += 4){
+		x = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_shuffle_epi8(x,mask));
+	}
+	gdouble_array_copy_to_be_scalar(dst + i,src + i,n - i);
+}
+#endif
+
+typedef void (*GDoubleCopyFunc)(gdouble *dst,const gdouble *src,gsize n);
+
+static GDoubleCopyFunc gdouble_array_get_copy_func(void)
+{
+	static gsize func = 0;
+	GDoubleCopyFunc tmp = gdouble_array_copy_to_be_scalar;
+
+	if(g_once_init_enter(&func)){
+#if HAVE_X86_CPU_DISPATCH
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2"))
+			tmp = gdouble_array_copy_to_be_avx2;
+		else if(__builtin_cpu_supports("sse2"))
+			tmp = gdouble_array_copy_to_be_sse2;
+#endif
+		g_once_init_leave(&func,(gsize)tmp);
+	}
+	return (GDoubleCopyFunc)func;
+}
+
+/**
+ * gdouble_array_copy_to_be:
+ * @dst: The output array, with room for @n #gdouble values.
+ * @src: The input array.
+ * @n: The number of #gdouble values.
+ *
+ * Writes to @dst each #gdouble in @src translated to big endian, or to little
+ * endian if they are already in big endian, see GDOUBLE_TO_BE(). @src is not
+ * modified, but @dst and @src can be the same array. On big endian hosts it's
+ * only a copy.
+ */
+void gdouble_array_copy_to_be(gdouble *dst,const gdouble *src,gsize n)
+{
+	if(G_BYTE_ORDER == G_BIG_ENDIAN){
+		if(dst != src)
+			memmove(dst,src,n*sizeof(gdouble));
+		return;
+	}
+	gdouble_array_get_copy_func()(dst,src,n);
+}
+
+/**
+ * gdouble_array_to_be:
+ * @data: An array of #gdouble values.
+ * @n: The number of #gdouble values in @data.
+ *
+ * Translates in place each #gdouble in @data to big endian, or to little
+ * endian if they are already in big endian, see gdouble_array_copy_to_be().
+ */
+void gdouble_array_to_be(gdouble *data,gsize n)
+{
+	gdouble_array_copy_to_be(data,data,n);
+}
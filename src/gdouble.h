@@ -20,3 +20,5 @@
 #ifndef GDOUBLE_TO_BE
 gdouble GDOUBLE_TO_BE(gdouble data);
 #endif
+void gdouble_array_to_be(gdouble *data,gsize n);
+void gdouble_array_copy_to_be(gdouble *dst,const gdouble *src,gsize n);